@@ -24,10 +24,17 @@
 #include <limits>
 #include <set>
 #include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 #include <Eigen/Core>
 #include "config.h"
 #include "indexing.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace MaxDiv
 {
 
@@ -557,7 +564,7 @@ public:
         assert((range.a.vec() <= range.b.vec()).all() && (range.b.vec() <= this->m_shape.vec()).all());
         
         // Shortcut for cutting off some trailing time steps and leaving everything else unchanged
-        if (range.a == 0 && range.b.vec().tail(MAXDIV_INDEX_DIMENSION - 1) == this->m_shape.vec().tail(MAXDIV_INDEX_DIMENSION - 1))
+        if (range.a == 0 && (range.b.vec().tail(MAXDIV_INDEX_DIMENSION - 1) == this->m_shape.vec().tail(MAXDIV_INDEX_DIMENSION - 1)).all())
         {
             this->resize(range.b);
             return;
@@ -1571,17 +1578,41 @@ public:
     /**
     * Computes the cumulative sum along given dimensions of this data tensor *in-place*.
     *
+    * All dimensions in the given range except the attribute dimension are processed in a single sweep
+    * over the data: The time steps are split up into contiguous chunks, which are processed by different
+    * threads. For each time step, the cumulative sums along the spatial dimensions are computed and the
+    * previous time step of the same chunk is added. Afterwards, the last time step of each chunk is added
+    * to the following chunks. The attribute dimension is processed separately.
+    *
     * If there are missing samples, their attribute values will be set to 0 before computing the
     * cumulative sums and the mask will be removed.
     *
     * @param[in] fromDim The first dimension.
     *
     * @param[in] toDim The last dimension.
+    *
+    * @param[in] highPrecision If set to `true`, the sums of single-precision tensors will be accumulated
+    * in double precision within each chunk, so that rounding errors do not accumulate along long time
+    * series. This has no effect on tensors of other types.
     */
-    void cumsum(unsigned int fromDim, unsigned int toDim)
+    void cumsum(unsigned int fromDim, unsigned int toDim, bool highPrecision = MAXDIV_CUMSUM_HIGH_PRECISION)
     {
-        for (unsigned int d = fromDim; d <= toDim; ++d)
-            this->cumsum(d);
+        assert(fromDim <= toDim && toDim < MAXDIV_INDEX_DIMENSION);
+        
+        if (this->empty())
+            return;
+        
+        unsigned int lastFusedDim = std::min(toDim, static_cast<unsigned int>(MAXDIV_INDEX_DIMENSION - 2));
+        if (fromDim <= lastFusedDim)
+        {
+            this->unmask(static_cast<Scalar>(0));
+            if (highPrecision && std::is_same<Scalar, float>::value)
+                this->fusedCumsum<double>(fromDim, lastFusedDim);
+            else
+                this->fusedCumsum<Scalar>(fromDim, lastFusedDim);
+        }
+        if (toDim == MAXDIV_INDEX_DIMENSION - 1)
+            this->cumsum(toDim);
     };
     
     /**
@@ -1619,6 +1650,21 @@ public:
                 sum -= this->m_data(range.a.ind[this->m_nonSingletonDim] - 1, d);
             return sum;
         }
+        else if (this->m_shape.z == 1)
+        {
+            // Shortcut for data with at most two spatial dimensions
+            Scalar sum = 0;
+            const Scalar * cumsum = this->m_data_p + d;
+            const Index strides[] = { this->m_shape.prod(1), this->m_shape.prod(2), this->m_shape.d };
+            for (unsigned int s = 0; s < 8; ++s)
+            {
+                Index offset;
+                bool negative;
+                if (this->cornerOffset<3>(range, s, strides, offset, negative))
+                    sum += (negative) ? -cumsum[offset] : cumsum[offset];
+            }
+            return sum;
+        }
         else
         {
             // Extracting the sum of a block from a tensor of cumulative sums follows the Inclusion-Exclusion Principle.
@@ -1667,28 +1713,51 @@ public:
     * Assuming that this tensor contains cumulative sums over all dimensions of the data except the attribute dimension,
     * this function restores the sum of the samples in a given sub-block of the data in constant time.
     *
+    * In contrast to `sumFromCumsum(const IndexRange &)`, the sum is written to existing storage, so that no memory
+    * has to be allocated.
+    *
     * @param[in] range The sub-block to compute the sum of. The attribute dimension will be ignored.
     *
-    * @return Sum over all samples in the given sub-block.
+    * @param[out] sum Vector with `numAttrib()` elements which will receive the sum over all samples in the given sub-block.
     */
-    Sample sumFromCumsum(const IndexRange & range) const
+    void sumFromCumsum(const IndexRange & range, Eigen::Ref<Sample> sum) const
     {
         assert(!range.empty());
+        assert(sum.size() == this->numAttrib());
         
         if (this->m_nonSingletonDim >= 0)
         {
             // Shortcut for data with only one non-singleton dimension
-            Sample sum = this->sample(range.b.ind[this->m_nonSingletonDim] - 1);
+            sum = this->sample(range.b.ind[this->m_nonSingletonDim] - 1);
             if (range.a.ind[this->m_nonSingletonDim] > 0)
                 sum -= this->sample(range.a.ind[this->m_nonSingletonDim] - 1);
-            return sum;
+            return;
+        }
+        else if (this->m_shape.z == 1)
+        {
+            // Shortcut for data with at most two spatial dimensions
+            sum.setZero();
+            const Index strides[] = { this->m_shape.prod(1, MAXDIV_INDEX_DIMENSION - 2), this->m_shape.prod(2, MAXDIV_INDEX_DIMENSION - 2), 1 };
+            for (unsigned int s = 0; s < 8; ++s)
+            {
+                Index offset;
+                bool negative;
+                if (this->cornerOffset<3>(range, s, strides, offset, negative))
+                {
+                    if (negative)
+                        sum -= this->sample(offset);
+                    else
+                        sum += this->sample(offset);
+                }
+            }
+            return;
         }
         else
         {
             // Extracting the sum of a block from a tensor of cumulative sums follows the Inclusion-Exclusion Principle.
             // For example, for two dimensions we have:
             // sum([a1,b1), [a2,b2)) = cumsum(b1, b2) - cumsum(a1 - 1, b2) - cumsum(b1, a2 - 2) + cumsum(a1 - 1, a2 - 1)
-            Sample sum = Sample::Zero(this->numAttrib());
+            sum.setZero();
             IndexVector ind = this->makeIndexVector();
             ind.shape.d = 1;
             unsigned int i, s, numSummands = 1 << (MAXDIV_INDEX_DIMENSION - 1);
@@ -1723,10 +1792,24 @@ public:
                 state(i) = true;
                 
             }
-            return sum;
         }
     }
 
+    /**
+    * Assuming that this tensor contains cumulative sums over all dimensions of the data except the attribute dimension,
+    * this function restores the sum of the samples in a given sub-block of the data in constant time.
+    *
+    * @param[in] range The sub-block to compute the sum of. The attribute dimension will be ignored.
+    *
+    * @return Sum over all samples in the given sub-block.
+    */
+    Sample sumFromCumsum(const IndexRange & range) const
+    {
+        Sample sum(this->numAttrib());
+        this->sumFromCumsum(range, sum);
+        return sum;
+    }
+
 
 protected:
     
@@ -1747,6 +1830,169 @@ protected:
     Scalar m_missingValuePlaceholder; /**< Placeholder value assigned to all attributes of missing samples. */
     mutable DataTensor_<Index> * m_cumMissingCounts; /**< Cumulative counts of missing values (used by `numMissingSamplesInRange()`). */
     mutable bool m_dirty; /**< True if a non-const access to the data has happened, so that missing values may have been changed. */
+    
+    
+    /**
+    * Determines the offset of one of the corners of a sub-block summed up by `sumFromCumsum()` according to the
+    * Inclusion-Exclusion Principle, for a fixed number of leading dimensions.
+    *
+    * @param[in] range The sub-block. All dimensions except the first `NumDims` ones must be singletons.
+    *
+    * @param[in] corner Bit mask specifying for each dimension whether to use the first (bit set) or the last
+    * point (bit not set) of the range along that dimension.
+    *
+    * @param[in] strides The offset between two consecutive indices along each of the `NumDims` dimensions.
+    *
+    * @param[out] offset The offset of the corner.
+    *
+    * @param[out] negative Set to `true` if the value of the corner has to be subtracted from the sum.
+    *
+    * @return Returns `false` if the corner lies outside of the data, so that its value is 0.
+    */
+    template<unsigned int NumDims>
+    static bool cornerOffset(const IndexRange & range, unsigned int corner, const Index * strides, Index & offset, bool & negative)
+    {
+        offset = 0;
+        negative = false;
+        for (unsigned int i = 0; i < NumDims; ++i)
+        {
+            if (corner & (1u << i))
+            {
+                if (range.a.ind[i] == 0)
+                    return false;
+                offset += (range.a.ind[i] - 1) * strides[i];
+                negative = !negative;
+            }
+            else
+                offset += (range.b.ind[i] - 1) * strides[i];
+        }
+        return true;
+    };
+    
+    /**
+    * Computes the cumulative sums along the spatial dimensions in a given range for a single time step *in-place*.
+    *
+    * @param[in,out] slice Pointer to the `m_shape.prod(1)` elements of the time step.
+    *
+    * @param[in] fromDim The first dimension. The time dimension will be skipped.
+    *
+    * @param[in] toDim The last dimension. Must not be the attribute dimension.
+    */
+    template<typename Acc>
+    void spatialCumsum(Acc * slice, unsigned int fromDim, unsigned int toDim) const
+    {
+        for (unsigned int d = std::max(fromDim, 1u); d <= toDim; ++d)
+        {
+            const Index size = this->m_shape.ind[d];
+            if (size <= 1)
+                continue;
+            const Index blockSize = this->m_shape.prod(d + 1);
+            const Index numBlocks = (d > 1) ? this->m_shape.prod(1, d - 1) : 1;
+            for (Index b = 0; b < numBlocks; ++b)
+            {
+                Acc * block = slice + b * size * blockSize;
+                for (Index i = blockSize; i < size * blockSize; ++i)
+                    block[i] += block[i - blockSize];
+            }
+        }
+    };
+    
+    /**
+    * Computes the cumulative sums along a range of dimensions except the attribute dimension in a single sweep
+    * over the data, accumulating values of type `Acc`. The data must not have a mask.
+    *
+    * @param[in] fromDim The first dimension.
+    *
+    * @param[in] toDim The last dimension. Must not be the attribute dimension.
+    */
+    template<typename Acc>
+    void fusedCumsum(unsigned int fromDim, unsigned int toDim)
+    {
+        const bool temporal = (fromDim == 0 && this->m_shape.t > 1);
+        const Index numSlices = this->m_shape.t, sliceSize = this->m_shape.prod(1);
+        Scalar * const data = this->m_data_p;
+        bool spatial = false;
+        for (unsigned int d = std::max(fromDim, 1u); d <= toDim; ++d)
+            if (this->m_shape.ind[d] > 1)
+                spatial = true;
+        
+        // Split the time steps up into chunks, one per thread, but avoid the overhead of parallelization for small tensors
+        Index numChunks = 1;
+        #ifdef _OPENMP
+        const Index maxThreads = static_cast<Index>(omp_get_max_threads());
+        if (maxThreads > 1 && numSlices >= 2 * maxThreads && this->numEl() >= 32768)
+            numChunks = maxThreads;
+        #endif
+        const Index chunkLength = (numSlices + numChunks - 1) / numChunks;
+        numChunks = (numSlices + chunkLength - 1) / chunkLength;
+        
+        // 1st pass: Cumulative sums within each chunk
+        Index chunk;
+        #pragma omp parallel for num_threads(static_cast<int>(numChunks)) if(numChunks > 1)
+        for (chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const Index firstSlice = chunk * chunkLength, endSlice = std::min(firstSlice + chunkLength, numSlices);
+            if (std::is_same<Acc, Scalar>::value && !spatial)
+            {
+                // Plain cumulative sum over time which can be computed in a single flat loop
+                for (Index i = (firstSlice + 1) * sliceSize; i < endSlice * sliceSize; ++i)
+                    data[i] += data[i - sliceSize];
+            }
+            else if (std::is_same<Acc, Scalar>::value)
+            {
+                // Accumulate in-place
+                Acc * slice = reinterpret_cast<Acc*>(data + firstSlice * sliceSize);
+                for (Index t = firstSlice; t < endSlice; ++t, slice += sliceSize)
+                {
+                    this->spatialCumsum(slice, fromDim, toDim);
+                    if (temporal && t > firstSlice)
+                        for (Index i = 0; i < sliceSize; ++i)
+                            slice[i] += slice[i - sliceSize];
+                }
+            }
+            else
+            {
+                // Accumulate in a buffer of higher precision
+                std::vector<Acc> buffer(sliceSize), carry((temporal) ? sliceSize : 0, static_cast<Acc>(0));
+                Scalar * slice = data + firstSlice * sliceSize;
+                for (Index t = firstSlice; t < endSlice; ++t, slice += sliceSize)
+                {
+                    std::copy(slice, slice + sliceSize, buffer.begin());
+                    this->spatialCumsum(buffer.data(), fromDim, toDim);
+                    if (temporal)
+                        for (Index i = 0; i < sliceSize; ++i)
+                            slice[i] = static_cast<Scalar>(carry[i] += buffer[i]);
+                    else
+                        for (Index i = 0; i < sliceSize; ++i)
+                            slice[i] = static_cast<Scalar>(buffer[i]);
+                }
+            }
+        }
+        
+        if (temporal && numChunks > 1)
+        {
+            // 2nd pass: Propagate the last time step of each chunk to the last time step of the following chunk
+            for (chunk = 1; chunk < numChunks; ++chunk)
+            {
+                const Scalar * prevLast = data + (chunk * chunkLength - 1) * sliceSize;
+                Scalar * last = data + (std::min((chunk + 1) * chunkLength, numSlices) - 1) * sliceSize;
+                for (Index i = 0; i < sliceSize; ++i)
+                    last[i] += prevLast[i];
+            }
+            
+            // 3rd pass: Add the last time step of the previous chunk to the remaining time steps of each chunk
+            #pragma omp parallel for num_threads(static_cast<int>(numChunks - 1))
+            for (chunk = 1; chunk < numChunks; ++chunk)
+            {
+                const Index firstSlice = chunk * chunkLength, lastSlice = std::min(firstSlice + chunkLength, numSlices) - 1;
+                const Scalar * prevLast = data + (firstSlice - 1) * sliceSize;
+                Scalar * slice = data + firstSlice * sliceSize;
+                for (Index t = firstSlice; t < lastSlice; ++t, slice += sliceSize)
+                    for (Index i = 0; i < sliceSize; ++i)
+                        slice[i] += prevLast[i];
+            }
+        }
+    };
 
 };
 
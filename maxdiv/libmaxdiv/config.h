@@ -66,6 +66,28 @@ typedef double MaxDivScalar;
 #define MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT 2147483648
 #endif
 
+#ifndef MAXDIV_GAUSSIAN_INCREMENTAL_LIMIT
+/**
+* When fitting a Gaussian distribution to a range which extends the previously fitted range by a few samples,
+* the Cholesky decompositions of the covariance matrices can be updated by a rank-one update per new sample
+* instead of being re-computed from scratch.
+*
+* Since rounding errors accumulate over a sequence of such updates, this constant limits the number of
+* samples which may be added by consecutive incremental updates before the distributions are fitted from
+* scratch again.
+*/
+#define MAXDIV_GAUSSIAN_INCREMENTAL_LIMIT 64
+#endif
+
+#ifndef MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT
+/**
+* Gaussian distributions with full covariance matrices are fitted to batches of ranges using vectors and
+* matrices of a fixed size for data with up to this number of attributes. Specialized code is generated
+* for each number of attributes from 1 to this limit. Set to 0 to always use dynamically sized types.
+*/
+#define MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT 8
+#endif
+
 #ifndef MAXDIV_NMP_LIMIT
 /**
 * For offline non-maximum suppression, the scores of all sub-blocks in the data have to be
@@ -80,4 +102,123 @@ typedef double MaxDivScalar;
 #define MAXDIV_NMP_LIMIT 10000
 #endif
 
+#ifndef MAXDIV_STREAM_CANDIDATE_LAYERS
+/**
+* Streaming search only scores the ranges ending among the new time steps on each poll and retains a few candidates
+* from previous polls, which are re-scored on the next poll. Besides the detections, these are the ranges which
+* non-maximum suppression would keep among those suppressed by the detections, which may again be suppressed
+* by other ranges and so on. This constant specifies the number of such layers of candidates, including the
+* detections themselves. Higher values make it more likely to recover ranges once the ranges suppressing them
+* have expired or got a lower score, at the cost of more ranges being re-scored on each poll.
+*/
+#define MAXDIV_STREAM_CANDIDATE_LAYERS 3
+#endif
+
+#ifndef MAXDIV_DYNAMIC_SCHEDULE_CHUNKS
+/**
+* When the start points of the proposed ranges are distributed dynamically among several threads,
+* they are split up into chunks of consecutive start points which idle threads fetch from a shared
+* work queue. Smaller chunks lead to a better load balance, but increase the scheduling overhead
+* and, in the case of online non-maximum suppression, the memory used for intermediate results.
+*
+* This constant specifies the number of chunks the start points will be divided into if no explicit
+* chunk size has been given. It does not depend on the number of threads, so that the detections are
+* the same regardless of the degree of parallelism.
+*/
+#define MAXDIV_DYNAMIC_SCHEDULE_CHUNKS 256
+#endif
+
+#ifndef MAXDIV_KERNEL_TILE_SIZE
+/**
+* Gaussian kernel matrices which are too large to be materialized entirely are computed in square tiles
+* using matrix products of the samples in the rows and columns of each tile, which can be vectorized and
+* benefit from the cache much better than computing the distances one by one.
+*
+* This constant specifies the number of rows and columns of a tile. Each thread stores one tile at a time.
+*/
+#define MAXDIV_KERNEL_TILE_SIZE 512
+#endif
+
+#ifndef MAXDIV_BNB_LEAF_SIZE
+/**
+* The branch-and-bound search splits groups of ranges until their number of ranges is at most this
+* constant and scores the ranges in such a group explicitly afterwards. Smaller values lead to more
+* evaluations of bounds, while larger values lead to more ranges being scored unnecessarily.
+*/
+#define MAXDIV_BNB_LEAF_SIZE 64
+#endif
+
+#ifndef MAXDIV_MULTIRES_CANDIDATE_FACTOR
+/**
+* The multi-resolution search retrieves this number of candidates per requested detection from the
+* coarsest level of the pyramid and refines them at the finer levels. Higher values improve the recall
+* for the case that anomalies are ranked differently at a coarse resolution at the cost of more ranges
+* being scored during refinement.
+*/
+#define MAXDIV_MULTIRES_CANDIDATE_FACTOR 4
+#endif
+
+#ifndef MAXDIV_BATCH_INNER_PARALLEL_SIZE
+/**
+* `maxdiv_exec_batch()` distributes series with less than this number of samples (not counting attributes)
+* among several threads, each processing its series sequentially, while larger series are processed one
+* after another with all threads working on each of them.
+*/
+#define MAXDIV_BATCH_INNER_PARALLEL_SIZE 20000
+#endif
+
+#ifndef MAXDIV_SCORE_BATCH_SIZE
+/**
+* Proposal-based searches pass this number of consecutive proposals at once to `Divergence::score()`,
+* which allows divergences to share work among the ranges of a batch, e.g., by evaluating closed-form
+* solutions with a few matrix operations instead of a separate fit for each range.
+*/
+#define MAXDIV_SCORE_BATCH_SIZE 256
+#endif
+
+#ifndef MAXDIV_BATCH_PDF_SIZE_LIMIT
+/**
+* Divergences scoring a batch of ranges by the densities of all samples, like `JSDivergence::score()`, request
+* the densities from `DensityEstimator::pdfs()` for as many ranges at once as fit into matrices with this number
+* of elements.
+*/
+#define MAXDIV_BATCH_PDF_SIZE_LIMIT 1048576
+#endif
+
+#ifndef MAXDIV_PCA_BLOCK_SIZE
+/**
+* `PCAProjection` computes covariance matrices in square tiles of this number of rows and columns, which are
+* distributed among several threads. The randomized solver multiplies the data with its basis in blocks of this
+* number of samples or attributes. `SparseRandomProjection` applies its projections to blocks of this number of samples.
+*/
+#define MAXDIV_PCA_BLOCK_SIZE 256
+#endif
+
+#ifndef MAXDIV_PCA_RANDOMIZED_MIN_ATTRIB
+/**
+* In `AUTO` mode, `PCAProjection` uses the randomized solver for data with at least this number of
+* attributes, provided that the number of principal components plus oversampling is at most a quarter of the
+* number of attributes. Otherwise, the covariance matrix is decomposed entirely.
+*/
+#define MAXDIV_PCA_RANDOMIZED_MIN_ATTRIB 512
+#endif
+
+/*
+* If `MAXDIV_OFFLOAD` is defined (CMake option of the same name, disabled by default), the closed-form Gaussian
+* divergences with full covariance matrices of each batch of proposals passed to `Divergence::score()` are computed
+* in an OpenMP target region on the default device, e.g., a GPU selected by `MAXDIV_OFFLOAD_FLAGS`. The cumulative
+* sums are transferred to the device once per data set, so that only the ranges and their terms are transferred
+* per batch. Larger values of `MAXDIV_SCORE_BATCH_SIZE` reduce the overhead of launching a target region for each batch.
+* Without an accelerator, the target regions are executed on the host.
+*/
+
+#ifndef MAXDIV_CUMSUM_HIGH_PRECISION
+/**
+* If set to 1, `DataTensor::cumsum()` accumulates the cumulative sums of single-precision tensors in
+* double precision by default, which avoids the accumulation of rounding errors along long time series
+* at the cost of a temporary buffer. This has no effect unless `MAXDIV_FLOAT` is defined.
+*/
+#define MAXDIV_CUMSUM_HIGH_PRECISION 1
+#endif
+
 #endif
\ No newline at end of file
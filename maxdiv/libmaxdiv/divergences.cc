@@ -16,6 +16,8 @@
 //  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
 
 #include "divergences.h"
+#include "config.h"
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
 #include <cmath>
@@ -108,6 +110,14 @@ void KLDivergence::init(const std::shared_ptr<const DataTensor> & data)
     this->m_chiSD = std::sqrt(2 * this->m_chiMean);
 }
 
+void KLDivergence::update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired)
+{
+    this->m_densityEstimator->update(data, numExpired);
+    this->m_data = data;
+    this->m_chiMean = (this->m_data->numAttrib() * (this->m_data->numAttrib() + 3)) / 2;
+    this->m_chiSD = std::sqrt(2 * this->m_chiMean);
+}
+
 void KLDivergence::reset()
 {
     this->m_densityEstimator->reset();
@@ -134,7 +144,7 @@ Scalar KLDivergence::operator()(const IndexRange & innerRange)
             score += gde->mahalanobisDistance(gde->getInnerMean(), gde->getOuterMean(), false);
             if (gde->getMode() == GaussianDensityEstimator::CovMode::FULL)
             {
-                score += gde->getOuterCovChol().solve(gde->getInnerCov()).trace()
+                score += gde->covTraceQuotient(false)
                          + gde->getOuterCovLogDet() - gde->getInnerCovLogDet()
                          - this->m_data->numAttrib();
             }
@@ -144,7 +154,7 @@ Scalar KLDivergence::operator()(const IndexRange & innerRange)
             score += gde->mahalanobisDistance(gde->getOuterMean(), gde->getInnerMean(), true);
             if (gde->getMode() == GaussianDensityEstimator::CovMode::FULL)
             {
-                score += gde->getInnerCovChol().solve(gde->getOuterCov()).trace()
+                score += gde->covTraceQuotient(true)
                          + gde->getInnerCovLogDet() - gde->getOuterCovLogDet()
                          - this->m_data->numAttrib();
             }
@@ -174,6 +184,84 @@ Scalar KLDivergence::operator()(const IndexRange & innerRange)
     return score;
 }
 
+void KLDivergence::score(const std::vector<IndexRange> & ranges, Scalar * scores)
+{
+    assert(this->m_data != nullptr);
+    
+    if (!this->m_gaussDensityEstimator)
+    {
+        // Log-likelihoods of the samples inside and outside of all ranges
+        bool innerOmega = (this->m_mode != KLMode::OMEGA_I), omegaInner = (this->m_mode == KLMode::OMEGA_I || this->m_mode == KLMode::SYM);
+        this->m_innerLL.resize((innerOmega) ? ranges.size() : 0);
+        this->m_outerLL.resize((omegaInner) ? ranges.size() : 0);
+        this->m_densityEstimator->logLikelihoods(ranges, (innerOmega) ? this->m_innerLL.data() : nullptr, (omegaInner) ? this->m_outerLL.data() : nullptr);
+        
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            DataTensor::Index numExtremes = ranges[i].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(ranges[i]);
+            Scalar score = 0;
+            if (innerOmega)
+                score += (this->m_innerLL[i].first - this->m_innerLL[i].second) / numExtremes;
+            if (omegaInner)
+                score += (this->m_outerLL[i].second - this->m_outerLL[i].first) / (this->m_data->numValidSamples() - numExtremes);
+            if (this->m_mode == KLMode::UNBIASED)
+                score *= numExtremes;
+            scores[i] = score;
+        }
+        return;
+    }
+    
+    if (this->m_gaussDensityEstimator->getMode() == GaussianDensityEstimator::CovMode::FULL)
+    {
+        // Evaluate the closed form solution with matrices of fixed size if there are only a few attributes
+        bool innerOmega = (this->m_mode != KLMode::OMEGA_I), omegaInner = (this->m_mode == KLMode::OMEGA_I || this->m_mode == KLMode::SYM);
+        this->m_terms.resize(ranges.size());
+        if (!this->m_gaussDensityEstimator->divergenceTerms(ranges, innerOmega, omegaInner, this->m_terms.data()))
+        {
+            Divergence::score(ranges, scores);
+            return;
+        }
+        
+        Scalar numAttrib = this->m_data->numAttrib();
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            const GaussianDensityEstimator::DivergenceTerms & terms = this->m_terms[i];
+            Scalar score = 0;
+            if (innerOmega)
+                score += terms.outerQuadratic + terms.outerCovLogDet - terms.innerCovLogDet - numAttrib;
+            if (omegaInner)
+                score += terms.innerQuadratic + terms.innerCovLogDet - terms.outerCovLogDet - numAttrib;
+            if (this->m_mode == KLMode::UNBIASED)
+                score = (score * terms.numExtremes - this->m_chiMean) / this->m_chiSD;
+            scores[i] = score;
+        }
+        return;
+    }
+    
+    // Without a covariance matrix estimated for the range, both polarities reduce to the same Mahalanobis distance
+    if (this->m_mode == KLMode::UNBIASED)
+        this->m_numExtremes.resize(ranges.size());
+    this->m_gaussDensityEstimator->meanDistances(ranges, scores, (this->m_mode == KLMode::UNBIASED) ? this->m_numExtremes.data() : nullptr);
+    if (this->m_mode == KLMode::SYM)
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+            scores[i] *= 2;
+    else if (this->m_mode == KLMode::UNBIASED)
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+            scores[i] *= this->m_numExtremes[i];
+}
+
+Scalar KLDivergence::upperBound(const IndexRange & innerCore, const IndexRange & innerHull)
+{
+    assert(this->m_data != nullptr);
+    
+    if (!this->m_gaussDensityEstimator || this->m_gaussDensityEstimator->getMode() == GaussianDensityEstimator::CovMode::FULL)
+        return Divergence::upperBound(innerCore, innerHull);
+    
+    // Without a covariance matrix estimated for the range, both polarities reduce to the same Mahalanobis distance
+    Scalar bound = this->m_gaussDensityEstimator->meanDistanceUpperBound(innerCore, innerHull, (this->m_mode == KLMode::UNBIASED) ? 1 : 0);
+    return (this->m_mode == KLMode::SYM) ? 2 * bound : bound;
+}
+
 
 //---------------//
 // Cross-Entropy //
@@ -205,7 +293,7 @@ Scalar CrossEntropy::operator()(const IndexRange & innerRange)
             switch (gde->getMode())
             {
                 case GaussianDensityEstimator::CovMode::FULL:
-                    score += gde->getOuterCovChol().solve(gde->getInnerCov()).trace() + gde->getOuterCovLogDet();
+                    score += gde->covTraceQuotient(false) + gde->getOuterCovLogDet();
                     break;
                 case GaussianDensityEstimator::CovMode::SHARED:
                     score += this->m_data->numAttrib() + gde->getOuterCovLogDet();
@@ -221,7 +309,7 @@ Scalar CrossEntropy::operator()(const IndexRange & innerRange)
             switch (gde->getMode())
             {
                 case GaussianDensityEstimator::CovMode::FULL:
-                    score += gde->getInnerCovChol().solve(gde->getOuterCov()).trace() + gde->getInnerCovLogDet();
+                    score += gde->covTraceQuotient(true) + gde->getInnerCovLogDet();
                     break;
                 case GaussianDensityEstimator::CovMode::SHARED:
                     score += this->m_data->numAttrib() + gde->getInnerCovLogDet();
@@ -255,6 +343,89 @@ Scalar CrossEntropy::operator()(const IndexRange & innerRange)
 }
 
 
+void CrossEntropy::score(const std::vector<IndexRange> & ranges, Scalar * scores)
+{
+    assert(this->m_data != nullptr);
+    
+    GaussianDensityEstimator * gde = this->m_gaussDensityEstimator.get();
+    if (!gde)
+    {
+        // Log-likelihoods of the samples inside and outside of all ranges
+        bool innerOmega = (this->m_mode != KLMode::OMEGA_I), omegaInner = (this->m_mode == KLMode::OMEGA_I || this->m_mode == KLMode::SYM);
+        this->m_innerLL.resize((innerOmega) ? ranges.size() : 0);
+        this->m_outerLL.resize((omegaInner) ? ranges.size() : 0);
+        this->m_densityEstimator->logLikelihoods(ranges, (innerOmega) ? this->m_innerLL.data() : nullptr, (omegaInner) ? this->m_outerLL.data() : nullptr);
+        
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            DataTensor::Index numExtremes = ranges[i].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(ranges[i]);
+            Scalar score = 0;
+            if (innerOmega)
+                score -= this->m_innerLL[i].second / ((this->m_mode != KLMode::UNBIASED) ? numExtremes : 1);
+            if (omegaInner)
+                score -= this->m_outerLL[i].first / (this->m_data->numValidSamples() - numExtremes);
+            scores[i] = score;
+        }
+        return;
+    }
+    
+    if (gde->getMode() == GaussianDensityEstimator::CovMode::FULL)
+    {
+        // Evaluate the closed form solution with matrices of fixed size if there are only a few attributes
+        bool innerOmega = (this->m_mode != KLMode::OMEGA_I), omegaInner = (this->m_mode == KLMode::OMEGA_I || this->m_mode == KLMode::SYM);
+        this->m_terms.resize(ranges.size());
+        if (!gde->divergenceTerms(ranges, innerOmega, omegaInner, this->m_terms.data()))
+        {
+            Divergence::score(ranges, scores);
+            return;
+        }
+        
+        Scalar logNormalizer = gde->getLogNormalizer();
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            const GaussianDensityEstimator::DivergenceTerms & terms = this->m_terms[i];
+            Scalar score = 0;
+            if (innerOmega)
+                score += terms.outerQuadratic - 2 * logNormalizer + terms.outerCovLogDet;
+            if (omegaInner)
+                score += terms.innerQuadratic - 2 * logNormalizer + terms.innerCovLogDet;
+            if (this->m_mode == KLMode::UNBIASED)
+                score = (score * terms.numExtremes - this->m_chiMean) / this->m_chiSD;
+            scores[i] = score;
+        }
+        return;
+    }
+    
+    // The cross-entropy is the Mahalanobis distance between the means plus a constant depending on the polarity
+    Scalar innerOffset = this->m_data->numAttrib() - 2 * gde->getLogNormalizer(), outerOffset = innerOffset, distFactor = 1;
+    if (gde->getMode() == GaussianDensityEstimator::CovMode::SHARED)
+    {
+        innerOffset += gde->getOuterCovLogDet();
+        outerOffset += gde->getInnerCovLogDet();
+    }
+    Scalar offset = 0;
+    if (this->m_mode == KLMode::I_OMEGA || this->m_mode == KLMode::UNBIASED)
+        offset = innerOffset;
+    else if (this->m_mode == KLMode::OMEGA_I)
+        offset = outerOffset;
+    else
+    {
+        offset = innerOffset + outerOffset;
+        distFactor = 2;
+    }
+    
+    if (this->m_mode == KLMode::UNBIASED)
+        this->m_numExtremes.resize(ranges.size());
+    gde->meanDistances(ranges, scores, (this->m_mode == KLMode::UNBIASED) ? this->m_numExtremes.data() : nullptr);
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        scores[i] = distFactor * scores[i] + offset;
+        if (this->m_mode == KLMode::UNBIASED)
+            scores[i] *= this->m_numExtremes[i];
+    }
+}
+
+
 //---------------------------//
 // Jensen-Shannon Divergence //
 //---------------------------//
@@ -330,3 +501,39 @@ Scalar JSDivergence::operator()(const IndexRange & innerRange)
     
     return (scoreInner / numExtremes + scoreOuter / numNonExtremes) / (2 * std::log(2));
 }
+
+void JSDivergence::score(const std::vector<IndexRange> & ranges, Scalar * scores)
+{
+    assert(this->m_data != nullptr);
+    
+    // Densities of all samples for as many ranges at once as fit into the workspace
+    const DataTensor::Index numSamples = this->m_data->numSamples();
+    const std::size_t chunkSize = std::max<std::size_t>(1, MAXDIV_BATCH_PDF_SIZE_LIMIT / numSamples);
+    const Scalar eps = std::numeric_limits<Scalar>::epsilon(), normalizer = 2 * std::log(2);
+    ReflessIndexVector sampleShape = this->m_data->shape();
+    sampleShape.d = 1;
+    std::vector<IndexRange> chunk;
+    for (std::size_t first = 0; first < ranges.size(); first += chunkSize)
+    {
+        chunk.assign(ranges.begin() + first, ranges.begin() + std::min(first + chunkSize, ranges.size()));
+        this->m_densityEstimator->pdfs(chunk, this->m_innerPDF, this->m_outerPDF);
+        for (std::size_t i = 0; i < chunk.size(); ++i)
+        {
+            DataTensor::Index numExtremes = chunk[i].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(chunk[i]);
+            DataTensor::Index numNonExtremes = this->m_data->numValidSamples() - numExtremes;
+            Scalar scoreInner = 0, scoreOuter = 0, combined;
+            IndexVector ind(sampleShape, 0);
+            for (DataTensor::Index sampleIndex = 0; sampleIndex < numSamples; ++ind, ++sampleIndex)
+                if (!this->m_data->isMissingSample(sampleIndex))
+                {
+                    const Scalar pdfInner = this->m_innerPDF(i, sampleIndex), pdfOuter = this->m_outerPDF(i, sampleIndex);
+                    combined = std::log((pdfInner + pdfOuter) / 2 + eps);
+                    if (chunk[i].contains(ind))
+                        scoreInner += std::log(pdfInner + eps) - combined;
+                    else
+                        scoreOuter += std::log(pdfOuter + eps) - combined;
+                }
+            scores[first + i] = (scoreInner / numExtremes + scoreOuter / numNonExtremes) / normalizer;
+        }
+    }
+}
@@ -19,6 +19,8 @@
 #define MAXIDV_DIVERGENCES_H
 
 #include <memory>
+#include <limits>
+#include <vector>
 #include "DataTensor.h"
 #include "estimators.h"
 
@@ -50,11 +52,47 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data) =0;
     
+    /**
+    * Re-initializes this divergence after the time series passed to `init()` has been moved forward
+    * in time, e.g., by a sliding window over a stream of data.
+    *
+    * The default implementation just calls `init()`. Currently, only KLDivergence overrides this and
+    * forwards the update to its density estimator, which is incremental for GaussianDensityEstimator and,
+    * under the conditions given there, for EnsembleOfRandomProjectionHistograms. All other combinations,
+    * including CrossEntropy, JSDivergence and KL divergences based on kernel density estimates, are
+    * re-initialized from scratch.
+    *
+    * @param[in] data The new data. It must consist of the data passed to the previous call to `init()`
+    * or `update()` without its first @p numExpired time steps, followed by any number of new time steps.
+    * Missing samples must have been masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numExpired The number of time steps which have been removed from the beginning of the data.
+    */
+    virtual void update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index) { this->init(data); };
+    
+    /**
+    * Declares that the data passed to the next call to `init()` are the time-delay embedding of a time series
+    * with the given parameters. See `DensityEstimator::setTimeDelayEmbedding()` for details.
+    * The default implementation ignores this.
+    */
+    virtual void setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> &, DataTensor::Index, DataTensor::Index) {};
+    
     /**
     * Resets this divergence to its uninitialized state and releases any memory allocated by `init()`.
     */
     virtual void reset() =0;
     
+    /**
+    * @return Returns the counters collected by the density estimators used by this divergence.
+    * The default implementation returns empty statistics.
+    */
+    virtual EstimatorStatistics getStatistics() const { return EstimatorStatistics(); };
+    
+    /**
+    * Resets the counters of the density estimators used by this divergence to zero.
+    */
+    virtual void resetStatistics() {};
+    
     /**
     * Approximates the divergence between a given sub-block of the data passed to `init()` and the rest
     * of that data tensor.
@@ -67,6 +105,44 @@ public:
     * but low if they are similar.
     */
     virtual Scalar operator()(const IndexRange & innerRange) =0;
+    
+    /**
+    * Computes the divergence of a batch of sub-blocks of the data passed to `init()` at once.
+    *
+    * Derived classes may override this to share work among the ranges, e.g., by evaluating a closed-form
+    * solution for all of them with a few matrix operations. The default implementation calls `operator()`
+    * for each range in the given order, so that incremental fits of consecutive ranges remain possible.
+    *
+    * `init()` has to be called before this can be used. Afterwards, the state of the density estimator
+    * is not guaranteed to correspond to any of the given ranges.
+    *
+    * @param[in] ranges The sub-blocks to compare against the rest of the data passed to `init()`.
+    *
+    * @param[out] scores Array with at least `ranges.size()` elements which will receive the divergence
+    * of each range, in the same order as @p ranges.
+    */
+    virtual void score(const std::vector<IndexRange> & ranges, Scalar * scores)
+    {
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+            scores[i] = (*this)(ranges[i]);
+    };
+    
+    /**
+    * Computes an upper bound on the divergence of all sub-blocks of the data passed to `init()` which contain
+    * a given block and are contained in another one. This can be used to skip entire groups of sub-blocks
+    * during the search without computing their divergence explicitly (see `BranchAndBoundSearch`).
+    *
+    * The default implementation returns infinity, i.e., no bound is known.
+    *
+    * `init()` has to be called before this can be used.
+    *
+    * @param[in] innerCore A sub-block contained in all sub-blocks considered. May be empty.
+    *
+    * @param[in] innerHull A sub-block containing all sub-blocks considered.
+    *
+    * @return Returns a value which is not less than the divergence of any sub-block between @p innerCore and @p innerHull.
+    */
+    virtual Scalar upperBound(const IndexRange &, const IndexRange &) { return std::numeric_limits<Scalar>::infinity(); };
 
 };
 
@@ -170,12 +246,28 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data) override;
     
+    /**
+    * Updates the density estimator used by this divergence after the time series passed to `init()` has
+    * been moved forward in time. See `DensityEstimator::update()` for details.
+    */
+    virtual void update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired) override;
+    
+    /**
+    * Forwards the time-delay embedding of the data passed to the next call to `init()` to the density estimator.
+    */
+    virtual void setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> & series, DataTensor::Index k, DataTensor::Index T) override
+    { this->m_densityEstimator->setTimeDelayEmbedding(series, k, T); };
+    
     /**
     * Resets this divergence and the density estimator to their uninitialized state and releases any
     * memory allocated by `init()`.
     */
     virtual void reset() override;
     
+    virtual EstimatorStatistics getStatistics() const override { return this->m_densityEstimator->getStatistics(); };
+    
+    virtual void resetStatistics() override { this->m_densityEstimator->resetStatistics(); };
+    
     /**
     * Approximates the KL divergence between a given sub-block of the data passed to `init()` and the rest
     * of that data tensor by evaluating one of the following formulas:
@@ -193,6 +285,30 @@ public:
     * segments are very dissimilar, but zero if their distributions are identical.
     */
     virtual Scalar operator()(const IndexRange & innerRange) override;
+    
+    /**
+    * Computes the KL divergence of a batch of sub-blocks of the data passed to `init()` at once.
+    *
+    * If a GaussianDensityEstimator is used with the covariance mode `ID` or `SHARED`, the divergences
+    * of all ranges are obtained from their mean distances computed in a single pass by
+    * `GaussianDensityEstimator::meanDistances()`. With the covariance mode `FULL`, the closed-form
+    * solution is evaluated from the terms computed by `GaussianDensityEstimator::divergenceTerms()`
+    * if possible. Other density estimators provide the log-likelihoods of all ranges through
+    * `DensityEstimator::logLikelihoods()`, which EnsembleOfRandomProjectionHistograms and
+    * KernelDensityEstimator obtain from their cumulative counts or sums.
+    * Otherwise, `operator()` is called for each range.
+    */
+    virtual void score(const std::vector<IndexRange> & ranges, Scalar * scores) override;
+    
+    /**
+    * Computes an upper bound on the KL divergence of all sub-blocks of the data passed to `init()` which contain
+    * @p innerCore and are contained in @p innerHull.
+    *
+    * Bounds are available if a GaussianDensityEstimator is used with the covariance mode `ID` or `SHARED`, since
+    * the divergence is a multiple of the Mahalanobis distance between the means of the inner and the outer distribution
+    * in that case (see `GaussianDensityEstimator::meanDistanceUpperBound()`). Otherwise, infinity will be returned.
+    */
+    virtual Scalar upperBound(const IndexRange & innerCore, const IndexRange & innerHull) override;
 
 
 protected:
@@ -203,6 +319,10 @@ protected:
     std::shared_ptr<const DataTensor> m_data; /**< Pointer to the DataTensor passed to `init()`. */
     Scalar m_chiMean; /**< The theoretical mean of the length-normalized scores. */
     Scalar m_chiSD; /**< The theoretical standard deviation of the length-normalized scores. */
+    std::vector<DataTensor::Index> m_numExtremes; /**< Workspace of `score()` holding the number of samples in each range (not copied). */
+    std::vector<GaussianDensityEstimator::DivergenceTerms> m_terms; /**< Workspace of `score()` holding the terms of the closed form solution for each range (not copied). */
+    std::vector< std::pair<Scalar, Scalar> > m_innerLL; /**< Workspace of `score()` holding the log-likelihoods of the samples inside of each range (not copied). */
+    std::vector< std::pair<Scalar, Scalar> > m_outerLL; /**< Workspace of `score()` holding the log-likelihoods of the samples outside of each range (not copied). */
 
 };
 
@@ -254,6 +374,19 @@ public:
     * the one interval can not be well explained by the model learned from the data in the other interval.
     */
     virtual Scalar operator()(const IndexRange & innerRange) override;
+    
+    /**
+    * Computes the cross-entropy of a batch of sub-blocks of the data passed to `init()` at once.
+    * See `KLDivergence::score()` for the cases in which this is faster than calling `operator()`
+    * for each range.
+    */
+    virtual void score(const std::vector<IndexRange> & ranges, Scalar * scores) override;
+    
+    /**
+    * Bounds on the cross-entropy are not available yet, so this returns infinity.
+    */
+    virtual Scalar upperBound(const IndexRange & innerCore, const IndexRange & innerHull) override
+    { return Divergence::upperBound(innerCore, innerHull); };
 
 };
 
@@ -315,12 +448,22 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data) override;
     
+    /**
+    * Forwards the time-delay embedding of the data passed to the next call to `init()` to the density estimator.
+    */
+    virtual void setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> & series, DataTensor::Index k, DataTensor::Index T) override
+    { this->m_densityEstimator->setTimeDelayEmbedding(series, k, T); };
+    
     /**
     * Resets this divergence and the density estimator to their uninitialized state and releases any
     * memory allocated by `init()`.
     */
     virtual void reset() override;
     
+    virtual EstimatorStatistics getStatistics() const override { return this->m_densityEstimator->getStatistics(); };
+    
+    virtual void resetStatistics() override { this->m_densityEstimator->resetStatistics(); };
+    
     /**
     * Approximates the JS divergence between a given sub-block of the data passed to `init()` and the rest
     * of that data tensor by evaluating the following formula:
@@ -345,12 +488,24 @@ public:
     * segments are very dissimilar, but zero if their distributions are identical.
     */
     virtual Scalar operator()(const IndexRange & innerRange) override;
+    
+    /**
+    * Computes the JS divergence of a batch of sub-blocks of the data passed to `init()` at once.
+    *
+    * The densities of all samples under the distributions fitted to the ranges are obtained from
+    * `DensityEstimator::pdfs()` for as many ranges at once as fit into `MAXDIV_BATCH_PDF_SIZE_LIMIT`
+    * elements, which KernelDensityEstimator and EnsembleOfRandomProjectionHistograms compute from
+    * their cumulative sums or counts without fitting each range separately.
+    */
+    virtual void score(const std::vector<IndexRange> & ranges, Scalar * scores) override;
 
 
 protected:
 
     std::shared_ptr<DensityEstimator> m_densityEstimator;
     std::shared_ptr<const DataTensor> m_data; /**< Pointer to the DataTensor passed to `init()`. */
+    ScalarMatrix m_innerPDF; /**< Workspace of `score()` holding the inner densities of all samples for each range (not copied). */
+    ScalarMatrix m_outerPDF; /**< Workspace of `score()` holding the outer densities of all samples for each range (not copied). */
 
 };
 
@@ -34,7 +34,7 @@ using namespace MaxDiv;
 DensityEstimator::DensityEstimator() : m_data(nullptr), m_extremeRange() {}
 
 DensityEstimator::DensityEstimator(const DensityEstimator & other)
-: m_data(other.m_data), m_extremeRange(other.m_extremeRange), m_numExtremes(other.m_numExtremes)
+: m_data(other.m_data), m_extremeRange(other.m_extremeRange), m_numExtremes(other.m_numExtremes), m_stats(other.m_stats)
 {}
 
 void DensityEstimator::init(const std::shared_ptr<const DataTensor> & data)
@@ -44,6 +44,11 @@ void DensityEstimator::init(const std::shared_ptr<const DataTensor> & data)
     this->m_numExtremes = 0;
 }
 
+void DensityEstimator::update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index)
+{
+    this->init(data);
+}
+
 void DensityEstimator::fit(const IndexRange & range)
 {
     assert(this->m_data != nullptr);
@@ -52,6 +57,7 @@ void DensityEstimator::fit(const IndexRange & range)
     this->m_extremeRange.a.d = 0;
     this->m_extremeRange.b.d = this->m_data->numAttrib();
     this->m_numExtremes = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(range);
+    ++this->m_stats.numFits;
 }
 
 void DensityEstimator::reset()
@@ -61,6 +67,11 @@ void DensityEstimator::reset()
     this->m_numExtremes = 0;
 }
 
+EstimatorStatistics DensityEstimator::getStatistics() const
+{
+    return this->m_stats;
+}
+
 DataTensor DensityEstimator::pdf() const
 {
     if (this->m_data == nullptr || this->m_data->empty())
@@ -273,19 +284,48 @@ std::pair<Scalar, Scalar> DensityEstimator::logLikelihoodOutsideRange(IndexRange
     return ll;
 }
 
+void DensityEstimator::logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL)
+{
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        this->fit(ranges[i]);
+        if (innerLL != nullptr)
+            innerLL[i] = this->logLikelihoodInner();
+        if (outerLL != nullptr)
+            outerLL[i] = this->logLikelihoodOuter();
+    }
+}
+
+void DensityEstimator::pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF)
+{
+    assert(this->m_data != nullptr);
+    innerPDF.resize(ranges.size(), this->m_data->numSamples());
+    outerPDF.resize(ranges.size(), this->m_data->numSamples());
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        this->fit(ranges[i]);
+        DataTensor pdf = this->pdf();
+        innerPDF.row(i) = pdf.data().col(0).transpose();
+        outerPDF.row(i) = pdf.data().col(1).transpose();
+    }
+}
+
 
 //------------------------//
 // KernelDensityEstimator //
 //------------------------//
 
 KernelDensityEstimator::KernelDensityEstimator()
-: DensityEstimator(), m_sigma_sq(1.0), m_normed(false), m_kernel(nullptr), m_cumKernel(nullptr) {}
+: DensityEstimator(), m_sigma_sq(1.0), m_normed(false), m_kernel(nullptr), m_cumKernel(nullptr),
+  m_approxRank(0), m_factors(nullptr), m_cumFactors(nullptr) {}
 
 KernelDensityEstimator::KernelDensityEstimator(Scalar kernel_sigma_sq, bool normed)
-: DensityEstimator(), m_sigma_sq(kernel_sigma_sq), m_normed(normed), m_kernel(nullptr), m_cumKernel(nullptr) {}
+: DensityEstimator(), m_sigma_sq(kernel_sigma_sq), m_normed(normed), m_kernel(nullptr), m_cumKernel(nullptr),
+  m_approxRank(0), m_factors(nullptr), m_cumFactors(nullptr) {}
 
 KernelDensityEstimator::KernelDensityEstimator(const std::shared_ptr<const DataTensor> & data, Scalar kernel_sigma_sq, bool normed)
-: DensityEstimator(), m_sigma_sq(kernel_sigma_sq), m_normed(normed), m_kernel(nullptr), m_cumKernel(nullptr)
+: DensityEstimator(), m_sigma_sq(kernel_sigma_sq), m_normed(normed), m_kernel(nullptr), m_cumKernel(nullptr),
+  m_approxRank(0), m_factors(nullptr), m_cumFactors(nullptr)
 {
     this->init(data);
 }
@@ -293,7 +333,9 @@ KernelDensityEstimator::KernelDensityEstimator(const std::shared_ptr<const DataT
 KernelDensityEstimator::KernelDensityEstimator(const KernelDensityEstimator & other)
 : DensityEstimator(other),
   m_sigma_sq(other.m_sigma_sq), m_normed(other.m_normed),
-  m_kernel(other.m_kernel), m_cumKernel(other.m_cumKernel)
+  m_kernel(other.m_kernel), m_cumKernel(other.m_cumKernel),
+  m_approxRank(other.m_approxRank), m_factors(other.m_factors), m_cumFactors(other.m_cumFactors),
+  m_totalFactorSum(other.m_totalFactorSum), m_innerFactorSum(other.m_innerFactorSum)
 {}
 
 KernelDensityEstimator & KernelDensityEstimator::operator=(const KernelDensityEstimator & other)
@@ -301,10 +343,16 @@ KernelDensityEstimator & KernelDensityEstimator::operator=(const KernelDensityEs
     this->m_data = other.m_data;
     this->m_extremeRange = other.m_extremeRange;
     this->m_numExtremes = other.m_numExtremes;
+    this->m_stats = other.m_stats;
     this->m_sigma_sq = other.m_sigma_sq;
     this->m_normed = other.m_normed;
     this->m_kernel = other.m_kernel;
     this->m_cumKernel = other.m_cumKernel;
+    this->m_approxRank = other.m_approxRank;
+    this->m_factors = other.m_factors;
+    this->m_cumFactors = other.m_cumFactors;
+    this->m_totalFactorSum = other.m_totalFactorSum;
+    this->m_innerFactorSum = other.m_innerFactorSum;
     return *this;
 }
 
@@ -319,17 +367,37 @@ void KernelDensityEstimator::init(const std::shared_ptr<const DataTensor> & data
     
     this->m_kernel.reset();
     this->m_cumKernel.reset();
+    this->m_factors.reset();
+    this->m_cumFactors.reset();
     
     if (this->m_data && !this->m_data->empty())
     {
-        this->m_kernel.reset(new GaussKernel(*(this->m_data), this->m_sigma_sq, this->m_normed));
-        if (this->m_data->numSamples() <= MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT)
+        if (this->m_approxRank > 0 && this->m_data->numSamples() > MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT)
+        {
+            // Approximate the kernel matrix and use cumulative sums of its factors
+            DataTensor * factors = new DataTensor();
+            GaussKernel(*(this->m_data), this->m_sigma_sq, this->m_normed).lowRankFactors(*factors, this->m_approxRank);
+            this->m_factors.reset(factors);
+            
+            DataTensor * cumFactors = new DataTensor(*factors);
+            cumFactors->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+            this->m_cumFactors.reset(cumFactors);
+            
+            ReflessIndexVector lastIndex = cumFactors->shape();
+            lastIndex.vec() -= 1;
+            this->m_totalFactorSum = cumFactors->sample(lastIndex);
+        }
+        else
         {
-            ReflessIndexVector cumShape = this->m_data->shape();
-            cumShape.d = this->m_data->numSamples();
-            this->m_cumKernel.reset(new DataTensor(cumShape));
-            this->m_cumKernel->data() = this->m_kernel->materialize();
-            this->m_cumKernel->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+            this->m_kernel.reset(new GaussKernel(*(this->m_data), this->m_sigma_sq, this->m_normed));
+            if (this->m_data->numSamples() <= MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT)
+            {
+                ReflessIndexVector cumShape = this->m_data->shape();
+                cumShape.d = this->m_data->numSamples();
+                this->m_cumKernel.reset(new DataTensor(cumShape));
+                this->m_cumKernel->data() = this->m_kernel->materialize();
+                this->m_cumKernel->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+            }
         }
     }
 }
@@ -339,6 +407,30 @@ void KernelDensityEstimator::reset()
     DensityEstimator::reset();
     this->m_kernel.reset();
     this->m_cumKernel.reset();
+    this->m_factors.reset();
+    this->m_cumFactors.reset();
+}
+
+void KernelDensityEstimator::fit(const IndexRange & range)
+{
+    DensityEstimator::fit(range);
+    if (this->m_cumFactors)
+    {
+        this->m_innerFactorSum.resize(this->m_cumFactors->numAttrib());
+        this->m_cumFactors->sumFromCumsum(this->m_extremeRange, this->m_innerFactorSum);
+    }
+    else if (!this->m_cumKernel)
+        ++this->m_stats.numCacheFallbacks; // pdf() has to sum up columns of the kernel matrix explicitly
+}
+
+EstimatorStatistics KernelDensityEstimator::getStatistics() const
+{
+    EstimatorStatistics stats = DensityEstimator::getStatistics();
+    if (this->m_cumKernel)
+        stats.cumulativeMemory += this->m_cumKernel->numEl() * sizeof(Scalar);
+    if (this->m_cumFactors)
+        stats.cumulativeMemory += (this->m_cumFactors->numEl() + this->m_factors->numEl()) * sizeof(Scalar);
+    return stats;
 }
 
 std::pair<Scalar, Scalar> KernelDensityEstimator::pdf(const ReflessIndexVector & ind) const
@@ -355,7 +447,16 @@ std::pair<Scalar, Scalar> KernelDensityEstimator::pdf(const ReflessIndexVector &
     dataShape.d = 1;
     DataTensor::Index sampleIndex = IndexVector(dataShape, ind).linear();
     Scalar sum_extremes, sum_non_extremes;
-    if (this->m_cumKernel)
+    if (this->m_factors)
+    {
+        // The approximation may yield sums close to 0 or even negative, which are clamped to a small
+        // fraction of the approximate kernel value of the sample with itself to keep the logarithm finite
+        Sample factors = this->m_factors->sample(sampleIndex);
+        Scalar minSum = std::numeric_limits<Scalar>::epsilon() * factors.squaredNorm();
+        sum_extremes = std::max(factors.dot(this->m_innerFactorSum), minSum);
+        sum_non_extremes = std::max(factors.dot(this->m_totalFactorSum - this->m_innerFactorSum), minSum);
+    }
+    else if (this->m_cumKernel)
     {
         ReflessIndexVector lastIndex = dataShape;
         lastIndex.vec() -= 1;
@@ -384,19 +485,303 @@ std::pair<Scalar, Scalar> KernelDensityEstimator::pdf(const ReflessIndexVector &
     return std::make_pair(sum_extremes, sum_non_extremes);
 }
 
+void KernelDensityEstimator::logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL)
+{
+    assert(this->m_data != nullptr && !this->m_data->empty());
+    
+    // The densities of all samples are only worth computing if they are needed for the outer log-likelihood anyway
+    // and can be obtained from cumulative sums
+    if (outerLL == nullptr || (!this->m_cumKernel && !this->m_cumFactors))
+    {
+        DensityEstimator::logLikelihoods(ranges, innerLL, outerLL);
+        return;
+    }
+    
+    const Scalar eps = std::numeric_limits<Scalar>::epsilon();
+    const std::size_t chunkSize = std::max<std::size_t>(1, MAXDIV_BATCH_PDF_SIZE_LIMIT / this->m_data->numSamples());
+    std::vector<IndexRange> chunk;
+    ReflessIndexVector sampleShape = this->m_data->shape();
+    sampleShape.d = 1;
+    for (std::size_t first = 0; first < ranges.size(); first += chunkSize)
+    {
+        chunk.assign(ranges.begin() + first, ranges.begin() + std::min(first + chunkSize, ranges.size()));
+        this->pdfs(chunk, this->m_batchInnerPDF, this->m_batchOuterPDF);
+        for (std::size_t i = 0; i < chunk.size(); ++i)
+        {
+            std::pair<Scalar, Scalar> inner(0, 0), outer(0, 0);
+            IndexVector ind(sampleShape, 0);
+            for (DataTensor::Index sample = 0; sample < this->m_batchInnerPDF.cols(); ++sample, ++ind)
+                if (!this->m_data->isMissingSample(sample))
+                {
+                    std::pair<Scalar, Scalar> & ll = (chunk[i].contains(ind)) ? inner : outer;
+                    ll.first += std::log(this->m_batchInnerPDF(i, sample) + eps);
+                    ll.second += std::log(this->m_batchOuterPDF(i, sample) + eps);
+                }
+            if (innerLL != nullptr)
+                innerLL[first + i] = inner;
+            if (outerLL != nullptr)
+                outerLL[first + i] = outer;
+        }
+    }
+}
+
+void KernelDensityEstimator::pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF)
+{
+    assert(this->m_data != nullptr && !this->m_data->empty());
+    
+    if (!this->m_cumKernel && !this->m_cumFactors)
+    {
+        DensityEstimator::pdfs(ranges, innerPDF, outerPDF);
+        return;
+    }
+    
+    const DataTensor::Index numSamples = this->m_data->numSamples();
+    innerPDF.resize(ranges.size(), numSamples);
+    outerPDF.resize(ranges.size(), numSamples);
+    if (this->m_factors)
+    {
+        // Multiply the sums of the factors over all ranges with the factors of all samples at once
+        const auto factors = this->m_factors->data();
+        ScalarMatrix innerSums(ranges.size(), this->m_cumFactors->numAttrib());
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+            this->m_cumFactors->sumFromCumsum(ranges[i], innerSums.row(i).transpose());
+        innerPDF.noalias() = innerSums * factors.transpose();
+        
+        // Clamp the sums like pdf() does to keep the logarithm finite
+        Sample totalSums = factors * this->m_totalFactorSum;
+        Sample minSums = std::numeric_limits<Scalar>::epsilon() * factors.rowwise().squaredNorm();
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            outerPDF.row(i) = (totalSums - innerPDF.row(i).transpose()).cwiseMax(minSums).transpose();
+            innerPDF.row(i) = innerPDF.row(i).cwiseMax(minSums.transpose());
+        }
+    }
+    else
+    {
+        // The rows of the cumulative kernel matrix hold the cumulative sums of the kernel values of all samples
+        const auto totalSums = this->m_cumKernel->sample(numSamples - 1);
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            this->m_cumKernel->sumFromCumsum(ranges[i], innerPDF.row(i).transpose());
+            outerPDF.row(i) = totalSums.transpose() - innerPDF.row(i);
+        }
+    }
+    
+    // Divide the sums by the number of samples used for their computation
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        DataTensor::Index numExtremes = ranges[i].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(ranges[i]);
+        innerPDF.row(i) /= numExtremes;
+        outerPDF.row(i) /= this->m_data->numValidSamples() - numExtremes;
+        ++this->m_stats.numFits;
+    }
+    if (this->m_data->hasMissingSamples())
+        for (DataTensor::Index sample = 0; sample < numSamples; ++sample)
+            if (this->m_data->isMissingSample(sample))
+            {
+                innerPDF.col(sample).setOnes();
+                outerPDF.col(sample).setOnes();
+            }
+}
+
 
 //--------------------------//
 // GaussianDensityEstimator //
 //--------------------------//
 
+#ifdef MAXDIV_OFFLOAD
+
+/**
+* Cumulative sums of the samples and their outer products mapped to the default device of OpenMP target
+* offloading. They are mapped once by `init()` and unmapped when the last copy of the estimator sharing them
+* is destroyed. The host tensors are kept alive as long as they are mapped.
+*/
+struct GaussianDensityEstimator::OffloadedSums
+{
+    std::shared_ptr<const DataTensor> cumsum;
+    std::shared_ptr<const DataTensor> cumOuter;
+    
+    OffloadedSums(const std::shared_ptr<const DataTensor> & cumsum, const std::shared_ptr<const DataTensor> & cumOuter)
+    : cumsum(cumsum), cumOuter(cumOuter)
+    {
+        const Scalar * cumsumData = cumsum->raw();
+        const Scalar * cumOuterData = cumOuter->raw();
+        const DataTensor::Index cumsumSize = cumsum->numEl(), cumOuterSize = cumOuter->numEl();
+        #pragma omp target enter data map(to: cumsumData[0:cumsumSize], cumOuterData[0:cumOuterSize])
+    };
+    
+    ~OffloadedSums()
+    {
+        const Scalar * cumsumData = this->cumsum->raw();
+        const Scalar * cumOuterData = this->cumOuter->raw();
+        const DataTensor::Index cumsumSize = this->cumsum->numEl(), cumOuterSize = this->cumOuter->numEl();
+        #pragma omp target exit data map(release: cumsumData[0:cumsumSize], cumOuterData[0:cumOuterSize])
+    };
+    
+    OffloadedSums(const OffloadedSums &) = delete;
+    OffloadedSums & operator=(const OffloadedSums &) = delete;
+};
+
+/**
+* Size of the vectors and matrices allocated on the stack of the device for each range.
+*/
+static const DataTensor::Index offloadMaxAttrib = (MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT > 0) ? MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT : 1;
+
+#pragma omp declare target
+
+/**
+* Extracts the sum over a range from a tensor of cumulative sums on the device following the Inclusion-Exclusion
+* Principle, like `DataTensor::sumFromCumsum()`.
+*
+* @param[in] cumsum The raw data of the tensor of cumulative sums.
+*
+* @param[in] shape The size of the tensor along the time and the spatial dimensions.
+*
+* @param[in] bounds The first indices of the range along the time and the spatial dimensions followed by the
+* indices after its end.
+*
+* @param[in] numAttrib The number of attributes of the tensor.
+*
+* @param[out] sum Array with @p numAttrib elements which will receive the sum.
+*/
+static void offloadSumFromCumsum(const Scalar * cumsum, const DataTensor::Index * shape, const DataTensor::Index * bounds,
+                                 DataTensor::Index numAttrib, Scalar * sum)
+{
+    for (DataTensor::Index j = 0; j < numAttrib; ++j)
+        sum[j] = 0;
+    for (unsigned int s = 0; s < 16; ++s)
+    {
+        DataTensor::Index offset = 0;
+        bool negative = false, isZeroBlock = false;
+        for (unsigned int k = 0; k < 4 && !isZeroBlock; ++k)
+        {
+            if (s & (1 << k))
+            {
+                isZeroBlock = (bounds[k] == 0);
+                offset = offset * shape[k] + bounds[k] - 1;
+                negative = !negative;
+            }
+            else
+                offset = offset * shape[k] + bounds[4 + k] - 1;
+        }
+        if (!isZeroBlock)
+        {
+            const Scalar * corner = cumsum + offset * numAttrib;
+            for (DataTensor::Index j = 0; j < numAttrib; ++j)
+                sum[j] += (negative) ? -corner[j] : corner[j];
+        }
+    }
+}
+
+/**
+* Computes the lower triangular Cholesky factor of a symmetric matrix on the device and regularizes the matrix
+* in the same way as `cholesky()` if it is not positive definite.
+*
+* @param[in] mat Row-major matrix with @p n rows and columns.
+*
+* @param[in] n The number of rows and columns of the matrix.
+*
+* @param[out] chol Row-major matrix which will receive the Cholesky factor in its lower triangle.
+*
+* @param[out] logdet Pointer to a scalar which will receive the natural logarithm of the determinant of the
+* regularized matrix.
+*
+* @return Returns the regularizer which has been added to the main diagonal of @p mat.
+*/
+static Scalar offloadCholesky(const Scalar * mat, DataTensor::Index n, Scalar * chol, Scalar * logdet)
+{
+    for (Scalar regularizer = 0; ; regularizer += 1e-4)
+    {
+        bool success = true;
+        for (DataTensor::Index j = 0; j < n && success; ++j)
+        {
+            Scalar x = mat[j * n + j] + regularizer;
+            for (DataTensor::Index k = 0; k < j; ++k)
+                x -= chol[j * n + k] * chol[j * n + k];
+            if (x <= 0)
+                success = false;
+            else
+            {
+                chol[j * n + j] = std::sqrt(x);
+                for (DataTensor::Index i = j + 1; i < n; ++i)
+                {
+                    Scalar y = mat[i * n + j];
+                    for (DataTensor::Index k = 0; k < j; ++k)
+                        y -= chol[i * n + k] * chol[j * n + k];
+                    chol[i * n + j] = y / chol[j * n + j];
+                }
+            }
+        }
+        if (success)
+        {
+            *logdet = 0;
+            for (DataTensor::Index j = 0; j < n; ++j)
+                *logdet += std::log(chol[j * n + j]);
+            *logdet *= 2;
+            return regularizer;
+        }
+    }
+}
+
+/**
+* Solves `L * L^T * x = b` in-place on the device.
+*/
+static void offloadSolve(const Scalar * chol, DataTensor::Index n, Scalar * x)
+{
+    for (DataTensor::Index i = 0; i < n; ++i)
+    {
+        for (DataTensor::Index k = 0; k < i; ++k)
+            x[i] -= chol[i * n + k] * x[k];
+        x[i] /= chol[i * n + i];
+    }
+    for (DataTensor::Index i = n; i-- > 0; )
+    {
+        for (DataTensor::Index k = i + 1; k < n; ++k)
+            x[i] -= chol[k * n + i] * x[k];
+        x[i] /= chol[i * n + i];
+    }
+}
+
+/**
+* Computes `diff^T * S^-1 * diff + trace(S^-1 * cov)` on the device, given the Cholesky factor of `S`.
+*/
+static Scalar offloadQuadratic(const Scalar * chol, DataTensor::Index n, const Scalar * diff, const Scalar * cov, Scalar * solution)
+{
+    Scalar result = 0;
+    for (DataTensor::Index j = 0; j < n; ++j)
+        solution[j] = diff[j];
+    offloadSolve(chol, n, solution);
+    for (DataTensor::Index j = 0; j < n; ++j)
+        result += diff[j] * solution[j];
+    for (DataTensor::Index j = 0; j < n; ++j)
+    {
+        for (DataTensor::Index i = 0; i < n; ++i)
+            solution[i] = cov[i * n + j];
+        offloadSolve(chol, n, solution);
+        result += solution[j];
+    }
+    return result;
+}
+
+#pragma omp end declare target
+
+#endif
+
 GaussianDensityEstimator::GaussianDensityEstimator()
-: DensityEstimator(), m_covMode(CovMode::FULL) {}
+: DensityEstimator(), m_covMode(CovMode::FULL), m_blockSize(0), m_bufferOffset(0),
+  m_incrementalFit(true), m_incrementalValid(false), m_incrementalCount(0), m_tracesValid(false) {}
 
 GaussianDensityEstimator::GaussianDensityEstimator(CovMode mode)
-: DensityEstimator(), m_covMode(mode) {}
+: DensityEstimator(), m_covMode(mode), m_blockSize(0), m_bufferOffset(0),
+  m_incrementalFit(true), m_incrementalValid(false), m_incrementalCount(0), m_tracesValid(false) {}
+
+GaussianDensityEstimator::GaussianDensityEstimator(CovMode mode, DataTensor::Index blockSize)
+: DensityEstimator(), m_covMode(mode), m_blockSize(blockSize), m_bufferOffset(0),
+  m_incrementalFit(true), m_incrementalValid(false), m_incrementalCount(0), m_tracesValid(false) {}
 
 GaussianDensityEstimator::GaussianDensityEstimator(const std::shared_ptr<const DataTensor> & data, CovMode mode)
-: DensityEstimator(), m_covMode(mode)
+: DensityEstimator(), m_covMode(mode), m_blockSize(0), m_bufferOffset(0),
+  m_incrementalFit(true), m_incrementalValid(false), m_incrementalCount(0), m_tracesValid(false)
 {
     this->init(data);
 }
@@ -405,11 +790,18 @@ GaussianDensityEstimator::GaussianDensityEstimator(const GaussianDensityEstimato
 : DensityEstimator(other),
   m_covMode(other.m_covMode), m_cumsum(other.m_cumsum), m_cumOuter(other.m_cumOuter),
   m_cumOuter_offset(other.m_cumOuter_offset), m_cumOuter_maxLen(other.m_cumOuter_maxLen),
+  m_blockSize(other.m_blockSize), m_blockOuter(other.m_blockOuter),
+  m_cumLagOuter(other.m_cumLagOuter), m_embeddedSeries(other.m_embeddedSeries), m_lagDim(other.m_lagDim), m_lagDelay(other.m_lagDelay),
   m_innerMean(other.m_innerMean), m_outerMean(other.m_outerMean),
   m_innerCov(other.m_innerCov), m_outerCov(other.m_outerCov), m_outerProdSum(other.m_outerProdSum),
   m_innerCovChol(other.m_innerCovChol), m_outerCovChol(other.m_outerCovChol),
   m_innerCovLogDet(other.m_innerCovLogDet), m_outerCovLogDet(other.m_outerCovLogDet),
-  m_logNormalizer(other.m_logNormalizer), m_innerLogNormalizer(other.m_innerLogNormalizer), m_outerLogNormalizer(other.m_outerLogNormalizer)
+  m_logNormalizer(other.m_logNormalizer), m_innerLogNormalizer(other.m_innerLogNormalizer), m_outerLogNormalizer(other.m_outerLogNormalizer),
+  m_cumsumBuffer(other.m_cumsumBuffer), m_cumOuterBuffer(other.m_cumOuterBuffer), m_bufferOffset(other.m_bufferOffset),
+  m_cumsumBase(other.m_cumsumBase), m_cumOuterBase(other.m_cumOuterBase),
+  m_incrementalFit(other.m_incrementalFit), m_incrementalValid(other.m_incrementalValid), m_incrementalCount(other.m_incrementalCount),
+  m_totalCov(other.m_totalCov), m_tracesValid(other.m_tracesValid), m_innerTrace(other.m_innerTrace), m_outerTrace(other.m_outerTrace),
+  m_boundCumsum(other.m_boundCumsum), m_offloadedSums(other.m_offloadedSums)
 {}
 
 GaussianDensityEstimator & GaussianDensityEstimator::operator=(const GaussianDensityEstimator & other)
@@ -417,11 +809,18 @@ GaussianDensityEstimator & GaussianDensityEstimator::operator=(const GaussianDen
     this->m_data = other.m_data;
     this->m_extremeRange = other.m_extremeRange;
     this->m_numExtremes = other.m_numExtremes;
+    this->m_stats = other.m_stats;
     this->m_covMode = other.m_covMode;
     this->m_cumsum = other.m_cumsum;
     this->m_cumOuter = other.m_cumOuter;
     this->m_cumOuter_offset = other.m_cumOuter_offset;
     this->m_cumOuter_maxLen = other.m_cumOuter_maxLen;
+    this->m_blockSize = other.m_blockSize;
+    this->m_blockOuter = other.m_blockOuter;
+    this->m_cumLagOuter = other.m_cumLagOuter;
+    this->m_embeddedSeries = other.m_embeddedSeries;
+    this->m_lagDim = other.m_lagDim;
+    this->m_lagDelay = other.m_lagDelay;
     this->m_innerMean = other.m_innerMean;
     this->m_outerMean = other.m_outerMean;
     this->m_innerCov = other.m_innerCov;
@@ -434,6 +833,20 @@ GaussianDensityEstimator & GaussianDensityEstimator::operator=(const GaussianDen
     this->m_logNormalizer = other.m_logNormalizer;
     this->m_innerLogNormalizer = other.m_innerLogNormalizer;
     this->m_outerLogNormalizer = other.m_outerLogNormalizer;
+    this->m_cumsumBuffer = other.m_cumsumBuffer;
+    this->m_cumOuterBuffer = other.m_cumOuterBuffer;
+    this->m_bufferOffset = other.m_bufferOffset;
+    this->m_cumsumBase = other.m_cumsumBase;
+    this->m_cumOuterBase = other.m_cumOuterBase;
+    this->m_incrementalFit = other.m_incrementalFit;
+    this->m_incrementalValid = other.m_incrementalValid;
+    this->m_incrementalCount = other.m_incrementalCount;
+    this->m_totalCov = other.m_totalCov;
+    this->m_tracesValid = other.m_tracesValid;
+    this->m_innerTrace = other.m_innerTrace;
+    this->m_outerTrace = other.m_outerTrace;
+    this->m_boundCumsum = other.m_boundCumsum;
+    this->m_offloadedSums = other.m_offloadedSums;
     return *this;
 }
 
@@ -442,15 +855,49 @@ std::shared_ptr<DensityEstimator> GaussianDensityEstimator::clone() const
     return std::make_shared<GaussianDensityEstimator>(*this);
 }
 
+void GaussianDensityEstimator::setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> & series, DataTensor::Index k, DataTensor::Index T)
+{
+    this->m_embeddedSeries = series;
+    this->m_lagDim = k;
+    this->m_lagDelay = T;
+}
+
 void GaussianDensityEstimator::init(const std::shared_ptr<const DataTensor> & data)
 {
     DensityEstimator::init(data);
     
+    // The series underlying a time-delay embedding only refers to the data passed to this call
+    std::shared_ptr<const DataTensor> embeddedSeries = this->m_embeddedSeries;
+    this->m_embeddedSeries.reset();
+    
     this->m_cumOuter.reset();
+    this->m_blockOuter.reset();
+    this->m_cumLagOuter.reset();
+    this->m_cumsumBuffer.reset();
+    this->m_cumOuterBuffer.reset();
+    this->m_bufferOffset = 0;
+    this->m_cumsumBase = this->m_cumOuterBase = Sample();
+    this->m_incrementalValid = this->m_tracesValid = false;
+    this->m_totalCov = ScalarMatrix();
+    this->m_boundCumsum.reset();
+    this->m_offloadedSums.reset();
     
     if (this->m_data && !this->m_data->empty())
     {
-        this->m_cumsum.reset(new DataTensor(*(this->m_data)));
+        // Sums over time-delay embedded samples are computed from the series underlying the embedding, whose outer
+        // products consist of lagged outer products with fewer attributes, as long as their cumulative sums fit
+        const ReflessIndexVector & shape = this->m_data->shape();
+        const DataTensor::Index border = (this->m_lagDim - 1) * this->m_lagDelay;
+        bool lagged = (
+            this->m_covMode == CovMode::FULL && this->m_blockSize == 0 && embeddedSeries && this->m_lagDim > 1
+            && !embeddedSeries->hasMissingSamples() && !this->m_data->hasMissingSamples()
+            && embeddedSeries->numAttrib() * this->m_lagDim == shape.d && embeddedSeries->length() == shape.t + border
+            && embeddedSeries->shape().x == shape.x && embeddedSeries->shape().y == shape.y && embeddedSeries->shape().z == shape.z
+            && embeddedSeries->numSamples() * this->m_lagDim * embeddedSeries->numAttrib() * embeddedSeries->numAttrib() * sizeof(Scalar)
+               <= MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT
+        );
+        
+        this->m_cumsum.reset(new DataTensor((lagged) ? *embeddedSeries : *(this->m_data)));
         this->m_cumsum->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
         
         this->m_innerMean.resize(this->m_data->numAttrib());
@@ -458,25 +905,56 @@ void GaussianDensityEstimator::init(const std::shared_ptr<const DataTensor> & da
         
         this->m_logNormalizer = -0.5 * this->m_data->numAttrib() * std::log(2 * M_PI);
         
-        if (this->m_covMode == CovMode::FULL)
+        if (this->m_covMode == CovMode::FULL && this->m_blockSize > 0)
+        {
+            // Compute block prefix sums of outer products
+            this->computeBlockOuter();
+            
+            // Unpack sum of outer products of all samples
+            DataTensor::Index d = this->m_data->numAttrib(), i, j, k;
+            this->m_outerProdSum.resize(d, d);
+            for (j = 0, k = 0; j < d; ++j)
+                for (i = 0; i <= j; ++i, ++k)
+                    this->m_outerProdSum(i, j) = this->m_outerProdSum(j, i) = (*(this->m_blockOuter))(this->m_blockOuter->rows() - 1, k);
+            
+            // Resize covariance matrices
+            this->m_innerCov.resize(d, d);
+            this->m_outerCov.resize(d, d);
+        }
+        else if (this->m_covMode == CovMode::FULL)
         {
             // Determine maximum allowed size of cumulative sum of outer products
             this->m_cumOuter_maxLen = MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT / (data->shape().prod(1) * data->numAttrib() * sizeof(Scalar));
             if (this->m_cumOuter_maxLen < 20)
                 this->m_cumOuter_maxLen = 0;
             
-            // Compute (first) cumulative sum of outer products
-            this->computeCumOuter();
-            
-            // Compute sum of outer products of all samples
             this->m_outerProdSum.resize(this->m_data->numAttrib(), this->m_data->numAttrib());
-            if (this->m_cumOuter->numSamples() == this->m_data->numSamples())
+            if (lagged)
             {
-                Eigen::Map<Sample> outerSumVec(this->m_outerProdSum.data(), this->m_outerProdSum.rows() * this->m_outerProdSum.cols());
-                outerSumVec = this->m_cumOuter->sample(this->m_cumOuter->numSamples() - 1);
+                this->computeCumLagOuter(*embeddedSeries);
+                IndexRange fullRange;
+                fullRange.b = this->m_data->shape();
+                this->computeLaggedOuterSum(fullRange, this->m_outerProdSum);
             }
             else
-                this->m_outerProdSum.noalias() = this->m_data->data().transpose() * this->m_data->data();
+            {
+                // Compute (first) cumulative sum of outer products
+                this->computeCumOuter();
+                
+                // Compute sum of outer products of all samples
+                if (this->m_cumOuter->numSamples() == this->m_data->numSamples())
+                {
+                    Eigen::Map<Sample> outerSumVec(this->m_outerProdSum.data(), this->m_outerProdSum.rows() * this->m_outerProdSum.cols());
+                    outerSumVec = this->m_cumOuter->sample(this->m_cumOuter->numSamples() - 1);
+                    
+                    #ifdef MAXDIV_OFFLOAD
+                    if (this->m_data->numAttrib() <= MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT)
+                        this->m_offloadedSums = std::make_shared<OffloadedSums>(this->m_cumsum, this->m_cumOuter);
+                    #endif
+                }
+                else
+                    this->m_outerProdSum.noalias() = this->m_data->data().transpose() * this->m_data->data();
+            }
             
             // Resize covariance matrices
             this->m_innerCov.resize(this->m_data->numAttrib(), this->m_data->numAttrib());
@@ -485,7 +963,7 @@ void GaussianDensityEstimator::init(const std::shared_ptr<const DataTensor> & da
         else if (this->m_covMode == CovMode::SHARED)
         {
             this->m_outerCov = this->m_outerProdSum = ScalarMatrix();
-            this->m_outerCovChol = Eigen::LLT<ScalarMatrix>();
+            this->m_outerCovChol = ScalableLLT<ScalarMatrix>();
             
             // Compute global covariance matrix
             Sample mean = this->m_cumsum->sample(this->m_cumsum->numSamples() - 1) / static_cast<Scalar>(this->m_data->numValidSamples());
@@ -500,8 +978,8 @@ void GaussianDensityEstimator::init(const std::shared_ptr<const DataTensor> & da
         else
         {
             this->m_innerCov = this->m_outerCov = this->m_outerProdSum = ScalarMatrix();
-            this->m_innerCovChol = Eigen::LLT<ScalarMatrix>();
-            this->m_outerCovChol = Eigen::LLT<ScalarMatrix>();
+            this->m_innerCovChol = ScalableLLT<ScalarMatrix>();
+            this->m_outerCovChol = ScalableLLT<ScalarMatrix>();
             this->m_innerLogNormalizer = this->m_outerLogNormalizer = this->m_logNormalizer;
         }
     }
@@ -509,11 +987,117 @@ void GaussianDensityEstimator::init(const std::shared_ptr<const DataTensor> & da
     {
         this->m_cumsum.reset();
         this->m_innerCov = this->m_outerCov = ScalarMatrix();
-        this->m_innerCovChol = Eigen::LLT<ScalarMatrix>();
-        this->m_outerCovChol = Eigen::LLT<ScalarMatrix>();
+        this->m_innerCovChol = ScalableLLT<ScalarMatrix>();
+        this->m_outerCovChol = ScalableLLT<ScalarMatrix>();
     }
 }
 
+void GaussianDensityEstimator::update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired)
+{
+    // Fall back to a complete re-initialization if the cumulative sums can not be updated incrementally
+    if (!this->m_data || this->m_data->empty() || !this->m_cumsum || !data || data->empty()
+            || this->m_covMode == CovMode::SHARED
+            || data->numSamples() != data->length() || this->m_data->numSamples() != this->m_data->length()
+            || data->numAttrib() != this->m_data->numAttrib()
+            || numExpired > this->m_data->length() || data->length() + numExpired < this->m_data->length()
+            || (this->m_covMode == CovMode::FULL && (!this->m_cumOuter || this->m_cumOuter_offset != 0
+                || this->m_cumOuter->length() != this->m_data->length() || data->length() > this->m_cumOuter_maxLen)))
+    {
+        this->init(data);
+        return;
+    }
+    
+    DataTensor::Index numRetained = this->m_data->length() - numExpired, newLength = data->length(), d = data->numAttrib();
+    
+    // Use the cumulative sums computed by init() as initial buffers
+    if (!this->m_cumsumBuffer)
+    {
+        this->m_cumsumBuffer = this->m_cumsum;
+        this->m_cumsumBase = Sample::Zero(d);
+        if (this->m_covMode == CovMode::FULL)
+        {
+            this->m_cumOuterBuffer = this->m_cumOuter;
+            this->m_cumOuterBase = Sample::Zero(d * d);
+        }
+        this->m_bufferOffset = 0;
+    }
+    
+    // Move the window forward in the buffers
+    DataTensor::Index offset = shiftCumsumBuffer(this->m_cumsumBuffer, this->m_cumsumBase, this->m_bufferOffset, numExpired, numRetained, newLength);
+    if (this->m_covMode == CovMode::FULL)
+        shiftCumsumBuffer(this->m_cumOuterBuffer, this->m_cumOuterBase, this->m_bufferOffset, numExpired, numRetained, newLength);
+    this->m_bufferOffset = offset;
+    
+    // Compute cumulative sums for the new time steps
+    ScalarMatrix singleProd(d, d);
+    Eigen::Map<const Sample> singleProdVec(singleProd.data(), d * d);
+    for (DataTensor::Index t = numRetained; t < newLength; ++t)
+    {
+        auto cumSample = this->m_cumsumBuffer->sample(offset + t);
+        if (t > 0)
+            cumSample = this->m_cumsumBuffer->sample(offset + t - 1);
+        else
+            cumSample = this->m_cumsumBase;
+        if (!data->isMissingSample(t))
+            cumSample += data->sample(t);
+        
+        if (this->m_covMode == CovMode::FULL)
+        {
+            auto cumOuterSample = this->m_cumOuterBuffer->sample(offset + t);
+            if (t > 0)
+                cumOuterSample = this->m_cumOuterBuffer->sample(offset + t - 1);
+            else
+                cumOuterSample = this->m_cumOuterBase;
+            if (!data->isMissingSample(t))
+            {
+                singleProd.noalias() = data->sample(t) * data->sample(t).transpose();
+                cumOuterSample += singleProdVec;
+            }
+        }
+    }
+    
+    // Wrap the current window of the buffers
+    DensityEstimator::init(data);
+    this->m_incrementalValid = this->m_tracesValid = false;
+    this->m_totalCov = ScalarMatrix();
+    this->m_boundCumsum.reset();
+    this->m_offloadedSums.reset();
+    this->m_cumsum.reset(new DataTensor(this->m_cumsumBuffer->raw() + offset * d, { newLength, 1, 1, 1, d }));
+    if (this->m_covMode == CovMode::FULL)
+    {
+        this->m_cumOuter.reset(new DataTensor(this->m_cumOuterBuffer->raw() + offset * d * d, { newLength, 1, 1, 1, d * d }));
+        this->m_cumOuter_offset = 0;
+        Eigen::Map<Sample> outerSumVec(this->m_outerProdSum.data(), d * d);
+        outerSumVec = this->m_cumOuter->sample(newLength - 1) - this->m_cumOuterBase;
+    }
+}
+
+DataTensor::Index GaussianDensityEstimator::shiftCumsumBuffer(std::shared_ptr<DataTensor> & buffer, Sample & base,
+                                                              DataTensor::Index offset, DataTensor::Index numExpired,
+                                                              DataTensor::Index numRetained, DataTensor::Index newLength)
+{
+    // Remember the cumulative sum preceding the new window
+    if (numExpired > 0)
+        base = buffer->sample(offset + numExpired - 1);
+    offset += numExpired;
+    
+    // Allocate a new buffer if the new time steps wouldn't fit. The old one is not modified,
+    // since it may still be referenced by copies of this estimator.
+    // The cumulative sums are re-based to avoid an accumulation of rounding errors.
+    if (offset + newLength > buffer->length())
+    {
+        ReflessIndexVector shape = buffer->shape();
+        shape.t = std::max(2 * newLength, buffer->length());
+        std::shared_ptr<DataTensor> newBuffer = std::make_shared<DataTensor>(shape);
+        if (numRetained > 0)
+            newBuffer->data().topRows(numRetained) = buffer->data().middleRows(offset, numRetained).rowwise() - base.transpose();
+        base.setZero();
+        buffer = newBuffer;
+        offset = 0;
+    }
+    return offset;
+}
+
 void GaussianDensityEstimator::computeCumOuter(DataTensor::Index offset)
 {
     assert(this->m_data && !this->m_data->empty());
@@ -549,15 +1133,163 @@ void GaussianDensityEstimator::computeCumOuter(DataTensor::Index offset)
         this->m_cumOuter.reset();
 }
 
+void GaussianDensityEstimator::computeBlockOuter()
+{
+    assert(this->m_data && !this->m_data->empty() && this->m_blockSize > 0);
+    
+    DataTensor::Index d = this->m_data->numAttrib(),
+                      length = this->m_data->length(),
+                      numBlocks = (length + this->m_blockSize - 1) / this->m_blockSize,
+                      samplesPerStep = this->m_data->shape().prod(1, 3),
+                      i, j, k, block;
+    std::shared_ptr<ScalarMatrix> blockOuter = std::make_shared<ScalarMatrix>(numBlocks + 1, d * (d + 1) / 2);
+    blockOuter->row(0).setZero();
+    
+    // Missing samples are zero and don't contribute to the outer products
+    ScalarMatrix blockSum(d, d);
+    for (block = 0; block < numBlocks; ++block)
+    {
+        DataTensor::Index start = block * this->m_blockSize, end = std::min(start + this->m_blockSize, length);
+        blockSum.setZero();
+        blockSum.selfadjointView<Eigen::Upper>().rankUpdate(
+            this->m_data->data().middleRows(start * samplesPerStep, (end - start) * samplesPerStep).transpose()
+        );
+        for (j = 0, k = 0; j < d; ++j)
+            for (i = 0; i <= j; ++i, ++k)
+                (*blockOuter)(block + 1, k) = (*blockOuter)(block, k) + blockSum(i, j);
+    }
+    
+    this->m_blockOuter = blockOuter;
+}
+
+void GaussianDensityEstimator::computeBlockedOuterSum(const IndexRange & range, ScalarMatrix & outerSum)
+{
+    assert(this->m_data && this->m_blockOuter);
+    
+    ReflessIndexVector shape = this->m_data->shape();
+    if (range.a.x > 0 || range.a.y > 0 || range.a.z > 0 || range.b.x < shape.x || range.b.y < shape.y || range.b.z < shape.z)
+    {
+        outerSum = this->computeOuterSum(range);
+        return;
+    }
+    
+    DataTensor::Index d = shape.d, samplesPerStep = shape.prod(1, 3), i, j, k,
+                      firstBlock = (range.a.t + this->m_blockSize - 1) / this->m_blockSize,
+                      lastBlock = (range.b.t == shape.t) ? this->m_blockOuter->rows() - 1 : range.b.t / this->m_blockSize;
+    
+    outerSum.setZero(d, d);
+    if (firstBlock < lastBlock)
+    {
+        // Sum over complete blocks from the block prefix sums
+        DataTensor::Index blockStart = firstBlock * this->m_blockSize, blockEnd = std::min(lastBlock * this->m_blockSize, shape.t);
+        auto packedSum = this->m_blockOuter->row(lastBlock) - this->m_blockOuter->row(firstBlock);
+        for (j = 0, k = 0; j < d; ++j)
+            for (i = 0; i <= j; ++i, ++k)
+                outerSum(i, j) = packedSum(k);
+        
+        // Explicit sums over the remaining time steps at the borders of the range
+        if (range.a.t < blockStart)
+            outerSum.selfadjointView<Eigen::Upper>().rankUpdate(
+                this->m_data->data().middleRows(range.a.t * samplesPerStep, (blockStart - range.a.t) * samplesPerStep).transpose()
+            );
+        if (range.b.t > blockEnd)
+            outerSum.selfadjointView<Eigen::Upper>().rankUpdate(
+                this->m_data->data().middleRows(blockEnd * samplesPerStep, (range.b.t - blockEnd) * samplesPerStep).transpose()
+            );
+    }
+    else
+    {
+        // The range lies within a single block
+        outerSum.selfadjointView<Eigen::Upper>().rankUpdate(
+            this->m_data->data().middleRows(range.a.t * samplesPerStep, (range.b.t - range.a.t) * samplesPerStep).transpose()
+        );
+    }
+    outerSum.triangularView<Eigen::StrictlyLower>() = outerSum.transpose();
+}
+
+void GaussianDensityEstimator::computeCumLagOuter(const DataTensor & series)
+{
+    DataTensor::Index k = this->m_lagDim, T = this->m_lagDelay, d = series.numAttrib(),
+                      samplesPerStep = series.shape().prod(1, 3),
+                      t, loc, l;
+    assert(k > 1 && T > 0 && series.length() > (k - 1) * T);
+    
+    ReflessIndexVector lagShape = series.shape();
+    lagShape.d = k * d * d;
+    this->m_cumLagOuter.reset(new DataTensor(lagShape, 0));
+    
+    // Lagged outer products reaching before the beginning of the series are never needed and remain zero
+    for (t = 0; t < lagShape.t; ++t)
+        for (loc = 0; loc < samplesPerStep; ++loc)
+        {
+            auto lagSample = this->m_cumLagOuter->sample(t * samplesPerStep + loc);
+            for (l = 0; l < k && l * T <= t; ++l)
+                Eigen::Map<ScalarMatrix>(lagSample.data() + l * d * d, d, d).noalias()
+                    = series.sample(t * samplesPerStep + loc) * series.sample((t - l * T) * samplesPerStep + loc).transpose();
+        }
+    
+    this->m_cumLagOuter->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+}
+
+void GaussianDensityEstimator::computeLaggedOuterSum(const IndexRange & range, ScalarMatrix & outerSum)
+{
+    assert(this->m_cumLagOuter);
+    
+    DataTensor::Index k = this->m_lagDim, T = this->m_lagDelay, d = this->m_data->numAttrib() / k,
+                      border = (k - 1) * T, i, l;
+    Sample & lagSum = this->m_ws.lagSum;
+    lagSum.resize(this->m_cumLagOuter->numAttrib());
+    
+    // The block (i, i + l) of the outer product of an embedded sample at time t is the lagged outer product
+    // of the underlying time-series at time t - i * T with lag l * T
+    IndexRange lagRange = range;
+    for (i = 0; i < k; ++i)
+    {
+        lagRange.a.t = range.a.t + border - i * T;
+        lagRange.b.t = range.b.t + border - i * T;
+        this->m_cumLagOuter->sumFromCumsum(lagRange, lagSum);
+        for (l = 0; i + l < k; ++l)
+        {
+            Eigen::Map<const ScalarMatrix> lagBlock(lagSum.data() + l * d * d, d, d);
+            outerSum.block(i * d, (i + l) * d, d, d) = lagBlock;
+            if (l > 0)
+                outerSum.block((i + l) * d, i * d, d, d) = lagBlock.transpose();
+        }
+    }
+}
+
+void GaussianDensityEstimator::sumSamples(const IndexRange & range, Eigen::Ref<Sample> sum) const
+{
+    if (this->m_cumLagOuter)
+    {
+        // The attributes of an embedded sample at time t are the samples of the series at the times t + border - i * T
+        DataTensor::Index k = this->m_lagDim, T = this->m_lagDelay, d = this->m_cumsum->numAttrib(), border = (k - 1) * T;
+        IndexRange seriesRange = range;
+        for (DataTensor::Index i = 0; i < k; ++i)
+        {
+            seriesRange.a.t = range.a.t + border - i * T;
+            seriesRange.b.t = range.b.t + border - i * T;
+            this->m_cumsum->sumFromCumsum(seriesRange, sum.segment(i * d, d));
+        }
+    }
+    else
+    {
+        this->m_cumsum->sumFromCumsum(range, sum);
+        if (range.a.t == 0 && this->m_cumsumBase.size() > 0)
+            sum -= this->m_cumsumBase;
+    }
+}
+
 ScalarMatrix GaussianDensityEstimator::computeOuterSum(const IndexRange & range)
 {
     assert(this->m_data && !this->m_data->empty());
     if (this->m_data)
     {
-        ScalarMatrix outerSum(this->m_data->numAttrib(), this->m_data->numAttrib());
+        ++this->m_stats.numCacheFallbacks;
+        ScalarMatrix outerSum = ScalarMatrix::Zero(this->m_data->numAttrib(), this->m_data->numAttrib());
         ReflessIndexVector shape = range.shape(), ind;
         shape.d = 1;
-        IndexVector offs(range.shape(), 0);
+        IndexVector offs(shape, 0);
         for (; offs.t < offs.shape.t; ++offs)
         {
             ind = range.a + offs;
@@ -573,72 +1305,115 @@ ScalarMatrix GaussianDensityEstimator::computeOuterSum(const IndexRange & range)
         return ScalarMatrix();
 }
 
-void GaussianDensityEstimator::fit(const IndexRange & range)
+void GaussianDensityEstimator::sumOuterProducts(const IndexRange & range, ScalarMatrix & outerSum)
 {
-    DensityEstimator::fit(range);
-    
-    // Compute the mean of the samples inside and outside of the given range
-    DataTensor::Index numNonExtremes = this->m_data->numValidSamples() - this->m_numExtremes;
-    assert(this->m_numExtremes > 0 && numNonExtremes > 0);
-    this->m_innerMean = this->m_cumsum->sumFromCumsum(range);
-    this->m_outerMean = this->m_cumsum->sample(this->m_cumsum->numSamples() - 1) - this->m_innerMean;
-    this->m_innerMean /= static_cast<Scalar>(this->m_numExtremes);
-    this->m_outerMean /= static_cast<Scalar>(numNonExtremes);
-    
-    // Compute covariance matrices
-    if (this->m_covMode == CovMode::FULL)
+    if (this->m_cumLagOuter)
+        this->computeLaggedOuterSum(range, outerSum);
+    else if (this->m_blockOuter)
+        this->computeBlockedOuterSum(range, outerSum);
+    else
     {
         DataTensor::Index rangeLen = range.b.t - range.a.t, cumEnd = this->m_cumOuter_offset + this->m_cumOuter->length();
         
         if (!this->m_cumOuter || this->m_cumOuter->empty() || (rangeLen > this->m_cumOuter_maxLen && (range.b.t <= this->m_cumOuter_offset || range.a.t >= cumEnd)))
-            this->m_innerCov = this->computeOuterSum(range);
+            outerSum = this->computeOuterSum(range);
         else
         {
-            // Flat wrapper around m_innerCov
-            Eigen::Map<Sample> innerCovVec(this->m_innerCov.data(), this->m_cumOuter->numAttrib(), 1);
-            
+            // Flat wrapper around outerSum
+            Eigen::Map<Sample> outerSumVec(outerSum.data(), this->m_cumOuter->numAttrib(), 1);
+        
             // Adjust range covered by partial cumulative sum if it could cover the requested range, but currently doesn't.
             if (rangeLen <= this->m_cumOuter_maxLen && (this->m_cumOuter_offset > range.a.t || cumEnd < range.b.t))
             {
                 this->computeCumOuter(range.a.t);
                 cumEnd = this->m_cumOuter_offset + this->m_cumOuter->length();
             }
-            
+        
             // Determine sub-range which overlaps with the partial cumulative sum
             IndexRange cumRange = range;
             cumRange.a.t = std::max(range.a.t, this->m_cumOuter_offset) - this->m_cumOuter_offset;
             cumRange.b.t = std::min(range.b.t, cumEnd) - this->m_cumOuter_offset;
             assert(range.b.t > this->m_cumOuter_offset);
             assert(cumRange.b.t <= this->m_cumOuter->length());
-            
+        
             // Extract sum from the cumulative sum tensor
-            innerCovVec = this->m_cumOuter->sumFromCumsum(cumRange);
-            
+            this->m_cumOuter->sumFromCumsum(cumRange, outerSumVec);
+            if (cumRange.a.t == 0 && this->m_cumOuter_offset == 0 && this->m_cumOuterBase.size() > 0)
+                outerSumVec -= this->m_cumOuterBase;
+        
             // Add sum over sub-range which is not covered by the cumulative sum
             if (range.a.t < this->m_cumOuter_offset)
             {
                 cumRange.a.t = range.a.t;
                 cumRange.b.t = this->m_cumOuter_offset;
-                this->m_innerCov += this->computeOuterSum(cumRange);
+                outerSum += this->computeOuterSum(cumRange);
             }
             if (range.b.t > cumEnd)
             {
                 cumRange.a.t = cumEnd;
                 cumRange.b.t = range.b.t;
-                this->m_innerCov += this->computeOuterSum(cumRange);
+                outerSum += this->computeOuterSum(cumRange);
             }
         }
+    }
+}
+
+void GaussianDensityEstimator::fit(const IndexRange & range)
+{
+    // Remember the previous fit if the given range extends it along the time axis, so that it can be updated incrementally
+    const IndexRange & prevRange = this->m_extremeRange;
+    bool incremental = (
+        this->m_covMode == CovMode::FULL && this->m_incrementalFit && this->m_incrementalValid && this->m_numExtremes > 0
+        && range.a.t == prevRange.a.t && range.a.x == prevRange.a.x && range.a.y == prevRange.a.y && range.a.z == prevRange.a.z
+        && range.b.t >= prevRange.b.t && range.b.x == prevRange.b.x && range.b.y == prevRange.b.y && range.b.z == prevRange.b.z
+    );
+    IndexRange prevExtremeRange;
+    DataTensor::Index prevNumExtremes = 0;
+    if (incremental)
+    {
+        prevExtremeRange = prevRange;
+        prevNumExtremes = this->m_numExtremes;
+        this->m_ws.innerMean = this->m_innerMean;
+        this->m_ws.outerMean = this->m_outerMean;
+    }
+    
+    DensityEstimator::fit(range);
+    
+    // Compute the mean of the samples inside and outside of the given range
+    DataTensor::Index numNonExtremes = this->m_data->numValidSamples() - this->m_numExtremes;
+    assert(this->m_numExtremes > 0 && numNonExtremes > 0);
+    IndexRange fullRange;
+    fullRange.b = this->m_data->shape();
+    this->m_innerMean.resize(this->m_data->numAttrib());
+    this->m_outerMean.resize(this->m_data->numAttrib());
+    this->sumSamples(range, this->m_innerMean);
+    this->sumSamples(fullRange, this->m_outerMean);
+    this->m_outerMean -= this->m_innerMean;
+    this->m_innerMean /= static_cast<Scalar>(this->m_numExtremes);
+    this->m_outerMean /= static_cast<Scalar>(numNonExtremes);
+    
+    // Compute covariance matrices
+    if (this->m_covMode == CovMode::FULL && incremental && this->fitIncrementally(prevExtremeRange, prevNumExtremes))
+        ++this->m_stats.numIncrementalFits;
+    else if (this->m_covMode == CovMode::FULL)
+    {
+        this->sumOuterProducts(range, this->m_innerCov);
         this->m_outerCov = this->m_outerProdSum - this->m_innerCov;
         
         this->m_innerCov /= static_cast<Scalar>(this->m_numExtremes);
         this->m_outerCov /= static_cast<Scalar>(numNonExtremes);
         
-        this->m_innerCov -= this->m_innerMean * this->m_innerMean.transpose();
-        this->m_outerCov -= this->m_outerMean * this->m_outerMean.transpose();
+        this->m_innerCov.noalias() -= this->m_innerMean * this->m_innerMean.transpose();
+        this->m_outerCov.noalias() -= this->m_outerMean * this->m_outerMean.transpose();
         
         // Compute cholesky decomposition and log-determinant
-        cholesky(this->m_innerCov, &(this->m_innerCovChol), &(this->m_innerCovLogDet));
-        cholesky(this->m_outerCov, &(this->m_outerCovChol), &(this->m_outerCovLogDet));
+        Scalar innerRegularizer = cholesky(this->m_innerCov, &(this->m_innerCovChol), &(this->m_innerCovLogDet));
+        Scalar outerRegularizer = cholesky(this->m_outerCov, &(this->m_outerCovChol), &(this->m_outerCovLogDet));
+        
+        // Incremental updates of regularized decompositions would not be consistent with fits from scratch
+        this->m_incrementalValid = (innerRegularizer == 0 && outerRegularizer == 0);
+        this->m_incrementalCount = 0;
+        this->m_tracesValid = false;
         
         // Compute normalizing constant
         this->m_innerLogNormalizer = this->m_logNormalizer - this->m_innerCovLogDet / 2;
@@ -646,15 +1421,143 @@ void GaussianDensityEstimator::fit(const IndexRange & range)
     }
 }
 
+bool GaussianDensityEstimator::fitIncrementally(const IndexRange & prevRange, DataTensor::Index prevNumExtremes)
+{
+    DataTensor::Index numNew = this->m_numExtremes - prevNumExtremes,
+                      numValid = this->m_data->numValidSamples(),
+                      d = this->m_data->numAttrib();
+    
+    // Rank-one updates don't pay off for many new samples. Besides, both covariance matrices must be well-conditioned,
+    // since the Cholesky decomposition of a (nearly) singular matrix may succeed numerically, but not be updatable.
+    if (numNew > d || this->m_incrementalCount + numNew > MAXDIV_GAUSSIAN_INCREMENTAL_LIMIT
+            || prevNumExtremes <= 2 * d || numValid - this->m_numExtremes <= d)
+        return false;
+    if (numNew == 0)
+        return true;
+    
+    if (!this->m_tracesValid)
+        this->computeCovTraces();
+    
+    // Move the new samples from the outer to the inner distribution one by one:
+    // S_I' = n/(n+1) * (S_I + (x - mu_I) * (x - mu_I)^T / (n+1))
+    // S_Omega' = m/(m-1) * (S_Omega - (x - mu_Omega) * (x - mu_Omega)^T / (m-1))
+    Sample & innerMean = this->m_ws.innerMean, & outerMean = this->m_ws.outerMean,
+           & innerDiff = this->m_ws.innerDiff, & outerDiff = this->m_ws.outerDiff,
+           & w = this->m_ws.solution, & totalCovW = this->m_ws.product;
+    Scalar n = prevNumExtremes, m = numValid - prevNumExtremes, beta, denom;
+    IndexRange newRange = this->m_extremeRange;
+    newRange.a.t = prevRange.b.t;
+    ReflessIndexVector shape = newRange.shape(), ind;
+    shape.d = 1;
+    for (IndexVector offs(shape, 0); offs.t < offs.shape.t; ++offs)
+    {
+        ind = newRange.a + offs;
+        if (this->m_data->isMissingSample(ind))
+            continue;
+        const auto sample = this->m_data->sample(ind);
+        innerDiff = sample - innerMean;
+        outerDiff = sample - outerMean;
+        
+        // Downdate outer distribution. The trace is updated according to the Sherman-Morrison formula.
+        beta = 1 / (m - 1);
+        w = this->m_outerCovChol.solve(outerDiff);
+        denom = 1 - beta * outerDiff.dot(w);
+        if (denom <= std::numeric_limits<Scalar>::epsilon())
+            return false;
+        totalCovW.noalias() = this->m_totalCov * w;
+        this->m_outerTrace = (this->m_outerTrace + beta * w.dot(totalCovW) / denom) * (m - 1) / m;
+        this->m_outerCovChol.rankUpdate(outerDiff, -beta, this->m_ws.rankUpdateTemp);
+        if (this->m_outerCovChol.info() != Eigen::Success)
+            return false;
+        this->m_outerCovChol.scale(m / (m - 1));
+        this->m_outerCov.noalias() -= beta * outerDiff * outerDiff.transpose();
+        this->m_outerCov *= m / (m - 1);
+        
+        // Update inner distribution
+        beta = 1 / (n + 1);
+        w = this->m_innerCovChol.solve(innerDiff);
+        totalCovW.noalias() = this->m_totalCov * w;
+        this->m_innerTrace = (this->m_innerTrace - beta * w.dot(totalCovW) / (1 + beta * innerDiff.dot(w))) * (n + 1) / n;
+        this->m_innerCovChol.rankUpdate(innerDiff, beta, this->m_ws.rankUpdateTemp);
+        this->m_innerCovChol.scale(n / (n + 1));
+        this->m_innerCov.noalias() += beta * innerDiff * innerDiff.transpose();
+        this->m_innerCov *= n / (n + 1);
+        
+        innerMean += innerDiff / (n + 1);
+        outerMean -= outerDiff / (m - 1);
+        n += 1;
+        m -= 1;
+    }
+    this->m_incrementalCount += numNew;
+    
+    // Update log-determinants and normalizing constants
+    this->m_innerCovLogDet = this->m_innerCovChol.logDeterminant();
+    this->m_outerCovLogDet = this->m_outerCovChol.logDeterminant();
+    this->m_innerLogNormalizer = this->m_logNormalizer - this->m_innerCovLogDet / 2;
+    this->m_outerLogNormalizer = this->m_logNormalizer - this->m_outerCovLogDet / 2;
+    return true;
+}
+
+void GaussianDensityEstimator::computeCovTraces()
+{
+    if (this->m_totalCov.size() == 0)
+    {
+        Scalar numValid = this->m_data->numValidSamples();
+        IndexRange fullRange;
+        fullRange.b = this->m_data->shape();
+        Sample totalMean(this->m_data->numAttrib());
+        this->sumSamples(fullRange, totalMean);
+        totalMean /= numValid;
+        this->m_totalCov = this->m_outerProdSum / numValid;
+        this->m_totalCov.noalias() -= totalMean * totalMean.transpose();
+    }
+    this->m_ws.solutions = this->m_innerCovChol.solve(this->m_totalCov);
+    this->m_innerTrace = this->m_ws.solutions.trace();
+    this->m_ws.solutions = this->m_outerCovChol.solve(this->m_totalCov);
+    this->m_outerTrace = this->m_ws.solutions.trace();
+    this->m_tracesValid = true;
+}
+
 void GaussianDensityEstimator::reset()
 {
     DensityEstimator::reset();
     this->m_cumsum.reset();
     this->m_cumOuter.reset();
+    this->m_cumLagOuter.reset();
+    this->m_embeddedSeries.reset();
+    this->m_cumsumBuffer.reset();
+    this->m_cumOuterBuffer.reset();
+    this->m_bufferOffset = 0;
+    this->m_cumsumBase = this->m_cumOuterBase = Sample();
+    this->m_incrementalValid = this->m_tracesValid = false;
+    this->m_totalCov = ScalarMatrix();
+    this->m_boundCumsum.reset();
+    this->m_offloadedSums.reset();
     this->m_innerMean = this->m_outerMean = Sample();
     this->m_innerCov = this->m_outerCov = ScalarMatrix();
-    this->m_innerCovChol = Eigen::LLT<ScalarMatrix>();
-    this->m_outerCovChol = Eigen::LLT<ScalarMatrix>();
+    this->m_innerCovChol = ScalableLLT<ScalarMatrix>();
+    this->m_outerCovChol = ScalableLLT<ScalarMatrix>();
+}
+
+EstimatorStatistics GaussianDensityEstimator::getStatistics() const
+{
+    EstimatorStatistics stats = DensityEstimator::getStatistics();
+    // The cumulative sums are views of the buffers if they are maintained by update()
+    if (this->m_cumsumBuffer)
+        stats.cumulativeMemory += this->m_cumsumBuffer->numEl() * sizeof(Scalar);
+    else if (this->m_cumsum)
+        stats.cumulativeMemory += this->m_cumsum->numEl() * sizeof(Scalar);
+    if (this->m_cumOuterBuffer)
+        stats.cumulativeMemory += this->m_cumOuterBuffer->numEl() * sizeof(Scalar);
+    else if (this->m_cumOuter)
+        stats.cumulativeMemory += this->m_cumOuter->numEl() * sizeof(Scalar);
+    if (this->m_blockOuter)
+        stats.cumulativeMemory += this->m_blockOuter->size() * sizeof(Scalar);
+    if (this->m_cumLagOuter)
+        stats.cumulativeMemory += this->m_cumLagOuter->numEl() * sizeof(Scalar);
+    if (this->m_boundCumsum)
+        stats.cumulativeMemory += this->m_boundCumsum->numEl() * sizeof(Scalar);
+    return stats;
 }
 
 std::pair<Scalar, Scalar> GaussianDensityEstimator::pdf(const ReflessIndexVector & ind) const
@@ -994,14 +1897,359 @@ std::pair<Scalar, Scalar> GaussianDensityEstimator::logLikelihoodOutsideRange(In
 
 const Scalar GaussianDensityEstimator::mahalanobisDistance(const Eigen::Ref<const Sample> & x1, const Eigen::Ref<const Sample> & x2, bool innerDist) const
 {
-    Sample diff = x1 - x2;
+    Sample & diff = this->m_ws.outerDiff;
+    diff = x1 - x2;
     if (this->m_covMode == CovMode::ID)
         return diff.squaredNorm();
     else
     {
         const Eigen::LLT<ScalarMatrix> * llt = (innerDist || this->m_covMode == CovMode::SHARED) ? &(this->m_innerCovChol) : &(this->m_outerCovChol);
-        return diff.dot(llt->solve(diff));
+        this->m_ws.solution = llt->solve(diff);
+        return diff.dot(this->m_ws.solution);
+    }
+}
+
+bool GaussianDensityEstimator::meanDistances(const std::vector<IndexRange> & ranges, Scalar * distances, DataTensor::Index * numExtremes)
+{
+    if (this->m_covMode == CovMode::FULL)
+        return false;
+    assert(this->m_data != nullptr);
+    
+    // Total sum of the samples
+    IndexRange fullRange;
+    fullRange.b = this->m_data->shape();
+    Sample & totalSum = this->m_ws.totalSum;
+    totalSum.resize(this->m_data->numAttrib());
+    this->sumSamples(fullRange, totalSum);
+    
+    // Gather the differences between the inner and the outer means into the columns of a single matrix
+    Scalar numValid = this->m_data->numValidSamples();
+    if (this->m_ws.diffs.rows() != static_cast<ScalarMatrix::Index>(this->m_data->numAttrib()) || this->m_ws.diffs.cols() < static_cast<ScalarMatrix::Index>(ranges.size()))
+        this->m_ws.diffs.resize(this->m_data->numAttrib(), ranges.size());
+    auto diffs = this->m_ws.diffs.leftCols(ranges.size());
+    Sample & rangeSum = this->m_ws.innerMean;
+    rangeSum.resize(this->m_data->numAttrib());
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        const IndexRange & range = ranges[i];
+        DataTensor::Index n = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(range);
+        assert(n > 0 && n < numValid);
+        this->sumSamples(range, rangeSum);
+        // mu_I - mu_Omega = S_I / n - (S - S_I) / (N - n) = (N * S_I / n - S) / (N - n)
+        diffs.col(i) = (rangeSum * (numValid / n) - totalSum) / (numValid - n);
+        if (numExtremes != nullptr)
+            numExtremes[i] = n;
+    }
+    
+    // (mu_I - mu_Omega)^T * (L * L^T)^-1 * (mu_I - mu_Omega) = ||L^-1 * (mu_I - mu_Omega)||^2
+    if (this->m_covMode == CovMode::SHARED)
+        this->m_innerCovChol.matrixL().solveInPlace(diffs);
+    Eigen::Map<Sample>(distances, ranges.size()) = diffs.colwise().squaredNorm().transpose();
+    
+    this->m_stats.numFits += ranges.size();
+    return true;
+}
+
+bool GaussianDensityEstimator::divergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms)
+{
+    if (this->m_covMode != CovMode::FULL || !this->m_data || this->m_data->empty() || this->m_data->numAttrib() > MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT)
+        return false;
+    #ifdef MAXDIV_OFFLOAD
+    if (this->m_offloadedSums)
+        return this->offloadedDivergenceTerms(ranges, outerInverse, innerInverse, terms);
+    #endif
+    this->m_ws.outerSum.resize(this->m_data->numAttrib(), this->m_data->numAttrib());
+    return this->fixedSizeDivergenceTerms<MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT>(ranges, outerInverse, innerInverse, terms);
+}
+
+#ifdef MAXDIV_OFFLOAD
+bool GaussianDensityEstimator::offloadedDivergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms)
+{
+    const OffloadedSums & sums = *(this->m_offloadedSums);
+    const Scalar * cumsum = sums.cumsum->raw();
+    const Scalar * cumOuter = sums.cumOuter->raw();
+    const DataTensor::Index cumsumSize = sums.cumsum->numEl(), cumOuterSize = sums.cumOuter->numEl();
+    const DataTensor::Index d = this->m_data->numAttrib(), numRanges = ranges.size();
+    const ReflessIndexVector & dataShape = this->m_data->shape();
+    const DataTensor::Index shape[] = { dataShape.t, dataShape.x, dataShape.y, dataShape.z };
+    const Scalar numValid = this->m_data->numValidSamples();
+    const int computeOuter = outerInverse, computeInner = innerInverse;
+    
+    // Sums over all samples
+    std::vector<Scalar> & totals = this->m_ws.offloadTotals;
+    totals.resize(d + d * d);
+    Eigen::Map<Sample>(totals.data(), d) = this->m_cumsum->sample(this->m_cumsum->numSamples() - 1);
+    Eigen::Map<ScalarMatrix>(totals.data() + d, d, d) = this->m_outerProdSum;
+    
+    // Bounds of the ranges along the non-attribute dimensions and the number of non-missing samples in each range
+    std::vector<DataTensor::Index> & bounds = this->m_ws.offloadBounds;
+    std::vector<Scalar> & counts = this->m_ws.offloadCounts;
+    bounds.resize(8 * numRanges);
+    counts.resize(numRanges);
+    for (DataTensor::Index i = 0; i < numRanges; ++i)
+    {
+        const IndexRange & range = ranges[i];
+        for (unsigned int k = 0; k < 4; ++k)
+        {
+            bounds[8 * i + k] = range.a.ind[k];
+            bounds[8 * i + 4 + k] = range.b.ind[k];
+        }
+        terms[i].numExtremes = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(range);
+        counts[i] = terms[i].numExtremes;
+        assert(counts[i] > 0 && counts[i] < numValid);
+    }
+    
+    const DataTensor::Index * boundsData = bounds.data();
+    const Scalar * countsData = counts.data();
+    const Scalar * totalsData = totals.data();
+    std::vector<Scalar> & results = this->m_ws.offloadResults;
+    results.resize(4 * numRanges);
+    Scalar * resultsData = results.data();
+    
+    // The cumulative sums are already present on the device, so that only the ranges and the results are transferred
+    #pragma omp target teams distribute parallel for \
+        map(to: cumsum[0:cumsumSize], cumOuter[0:cumOuterSize], shape[0:4], totalsData[0:d + d * d], boundsData[0:8 * numRanges], countsData[0:numRanges]) \
+        map(from: resultsData[0:4 * numRanges])
+    for (DataTensor::Index i = 0; i < numRanges; ++i)
+    {
+        Scalar innerMean[offloadMaxAttrib], outerMean[offloadMaxAttrib], diff[offloadMaxAttrib], solution[offloadMaxAttrib];
+        Scalar innerCov[offloadMaxAttrib * offloadMaxAttrib], outerCov[offloadMaxAttrib * offloadMaxAttrib];
+        Scalar innerChol[offloadMaxAttrib * offloadMaxAttrib], outerChol[offloadMaxAttrib * offloadMaxAttrib];
+        Scalar n = countsData[i], m = numValid - n;
+        
+        // Means
+        offloadSumFromCumsum(cumsum, shape, boundsData + 8 * i, d, innerMean);
+        for (DataTensor::Index j = 0; j < d; ++j)
+        {
+            outerMean[j] = (totalsData[j] - innerMean[j]) / m;
+            innerMean[j] /= n;
+            diff[j] = innerMean[j] - outerMean[j];
+        }
+        
+        // Covariance matrices and their Cholesky decompositions
+        offloadSumFromCumsum(cumOuter, shape, boundsData + 8 * i, d * d, innerCov);
+        for (DataTensor::Index j = 0; j < d * d; ++j)
+        {
+            outerCov[j] = (totalsData[d + j] - innerCov[j]) / m - outerMean[j / d] * outerMean[j % d];
+            innerCov[j] = innerCov[j] / n - innerMean[j / d] * innerMean[j % d];
+        }
+        offloadCholesky(innerCov, d, innerChol, resultsData + 4 * i + 2);
+        offloadCholesky(outerCov, d, outerChol, resultsData + 4 * i + 3);
+        
+        if (computeOuter)
+            resultsData[4 * i] = offloadQuadratic(outerChol, d, diff, innerCov, solution);
+        if (computeInner)
+            resultsData[4 * i + 1] = offloadQuadratic(innerChol, d, diff, outerCov, solution);
+    }
+    
+    for (DataTensor::Index i = 0; i < numRanges; ++i)
+    {
+        if (outerInverse)
+            terms[i].outerQuadratic = results[4 * i];
+        if (innerInverse)
+            terms[i].innerQuadratic = results[4 * i + 1];
+        terms[i].innerCovLogDet = results[4 * i + 2];
+        terms[i].outerCovLogDet = results[4 * i + 3];
+    }
+    this->m_stats.numFits += ranges.size();
+    return true;
+}
+#endif
+
+namespace MaxDiv
+{
+
+template<>
+bool GaussianDensityEstimator::fixedSizeDivergenceTerms<0>(const std::vector<IndexRange> &, bool, bool, DivergenceTerms *)
+{
+    return false;
+}
+
+/**
+* Regularizes a variance in the same way as `cholesky()` regularizes a 1x1 covariance matrix.
+*/
+static Scalar regularizeVariance(Scalar var, Scalar * logdet)
+{
+    Scalar regularizer = 0;
+    while (var + regularizer <= 0)
+        regularizer += 1e-4;
+    var += regularizer;
+    *logdet = std::log(var);
+    return var;
+}
+
+template<>
+bool GaussianDensityEstimator::fixedSizeDivergenceTerms<1>(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms)
+{
+    if (this->m_data->numAttrib() != 1)
+        return this->fixedSizeDivergenceTerms<0>(ranges, outerInverse, innerInverse, terms);
+    
+    // Univariate case: KL(I, Omega) = (s_I^2 / s_Omega^2 + (mu_I - mu_Omega)^2 / s_Omega^2 - 1 + log(s_Omega^2) - log(s_I^2)) / 2
+    Scalar numValid = this->m_data->numValidSamples(),
+           totalSum = this->m_cumsum->sample(this->m_cumsum->numSamples() - 1)(0),
+           totalSquares = this->m_outerProdSum(0, 0);
+    if (this->m_cumsumBase.size() > 0)
+        totalSum -= this->m_cumsumBase(0);
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        const IndexRange & range = ranges[i];
+        DivergenceTerms & rangeTerms = terms[i];
+        rangeTerms.numExtremes = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(range);
+        Scalar n = rangeTerms.numExtremes, m = numValid - n;
+        assert(n > 0 && m > 0);
+        
+        Scalar innerSum = this->m_cumsum->sumFromCumsum(range, 0);
+        if (range.a.t == 0 && this->m_cumsumBase.size() > 0)
+            innerSum -= this->m_cumsumBase(0);
+        this->sumOuterProducts(range, this->m_ws.outerSum);
+        Scalar innerSquares = this->m_ws.outerSum(0, 0);
+        
+        // Like the traces in the multivariate case, the variances in the numerators are not regularized
+        Scalar innerMean = innerSum / n, outerMean = (totalSum - innerSum) / m;
+        Scalar innerVar = innerSquares / n - innerMean * innerMean, outerVar = (totalSquares - innerSquares) / m - outerMean * outerMean;
+        Scalar innerRegVar = regularizeVariance(innerVar, &rangeTerms.innerCovLogDet);
+        Scalar outerRegVar = regularizeVariance(outerVar, &rangeTerms.outerCovLogDet);
+        Scalar sqDist = (innerMean - outerMean) * (innerMean - outerMean);
+        if (outerInverse)
+            rangeTerms.outerQuadratic = sqDist / outerRegVar + innerVar / outerRegVar;
+        if (innerInverse)
+            rangeTerms.innerQuadratic = sqDist / innerRegVar + outerVar / innerRegVar;
+    }
+    this->m_stats.numFits += ranges.size();
+    return true;
+}
+
+template<int D>
+bool GaussianDensityEstimator::fixedSizeDivergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms)
+{
+    if (this->m_data->numAttrib() != D)
+        return this->fixedSizeDivergenceTerms<D - 1>(ranges, outerInverse, innerInverse, terms);
+    
+    typedef Eigen::Matrix<Scalar, D, 1> FixedSample;
+    typedef Eigen::Matrix<Scalar, D, D> FixedMatrix;
+    
+    Scalar numValid = this->m_data->numValidSamples();
+    IndexRange fullRange;
+    fullRange.b = this->m_data->shape();
+    FixedSample totalSum;
+    this->sumSamples(fullRange, totalSum);
+    const FixedMatrix totalOuterSum = this->m_outerProdSum;
+    
+    FixedSample innerMean, outerMean, diff;
+    FixedMatrix innerCov, outerCov;
+    Eigen::LLT<FixedMatrix> innerChol, outerChol;
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        const IndexRange & range = ranges[i];
+        DivergenceTerms & rangeTerms = terms[i];
+        rangeTerms.numExtremes = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(range);
+        Scalar n = rangeTerms.numExtremes, m = numValid - n;
+        assert(n > 0 && m > 0);
+        
+        // Means
+        this->sumSamples(range, innerMean);
+        outerMean = (totalSum - innerMean) / m;
+        innerMean /= n;
+        
+        // Covariance matrices and their Cholesky decompositions
+        this->sumOuterProducts(range, this->m_ws.outerSum);
+        innerCov = this->m_ws.outerSum;
+        outerCov = (totalOuterSum - innerCov) / m;
+        innerCov /= n;
+        innerCov -= innerMean * innerMean.transpose();
+        outerCov -= outerMean * outerMean.transpose();
+        cholesky(innerCov, &innerChol, &rangeTerms.innerCovLogDet);
+        cholesky(outerCov, &outerChol, &rangeTerms.outerCovLogDet);
+        
+        diff = innerMean - outerMean;
+        if (outerInverse)
+            rangeTerms.outerQuadratic = diff.dot(outerChol.solve(diff)) + outerChol.solve(innerCov).trace();
+        if (innerInverse)
+            rangeTerms.innerQuadratic = diff.dot(innerChol.solve(diff)) + innerChol.solve(outerCov).trace();
     }
+    this->m_stats.numFits += ranges.size();
+    return true;
+}
+
+}
+
+Scalar GaussianDensityEstimator::covTraceQuotient(bool innerInverse) const
+{
+    if (this->m_tracesValid)
+    {
+        // N * S = n * S_I + m * S_Omega + n * m / N * (mu_I - mu_Omega) * (mu_I - mu_Omega)^T
+        Scalar numValid = this->m_data->numValidSamples(),
+               n = this->m_numExtremes,
+               m = numValid - n,
+               d = this->m_data->numAttrib();
+        if (innerInverse)
+            return (numValid * this->m_innerTrace - n * d - n * m / numValid * this->mahalanobisDistance(this->m_outerMean, this->m_innerMean, true)) / m;
+        else
+            return (numValid * this->m_outerTrace - m * d - n * m / numValid * this->mahalanobisDistance(this->m_innerMean, this->m_outerMean, false)) / n;
+    }
+    else
+    {
+        if (innerInverse)
+            this->m_ws.solutions = this->m_innerCovChol.solve(this->m_outerCov);
+        else
+            this->m_ws.solutions = this->m_outerCovChol.solve(this->m_innerCov);
+        return this->m_ws.solutions.trace();
+    }
+}
+
+Scalar GaussianDensityEstimator::meanDistanceUpperBound(const IndexRange & innerCore, const IndexRange & innerHull, int lengthExponent)
+{
+    if (this->m_covMode == CovMode::FULL || !this->m_data || this->m_data->empty() || innerHull.empty())
+        return std::numeric_limits<Scalar>::infinity();
+    
+    DataTensor::Index d = this->m_data->numAttrib();
+    if (!this->m_boundCumsum)
+    {
+        // Center and whiten the samples, so that the Mahalanobis distance becomes the Euclidean distance: W = (X - mu) * U^-1
+        Sample mean = this->m_data->data().colwise().sum().transpose() / static_cast<Scalar>(this->m_data->numValidSamples());
+        ScalarMatrix whitened = this->m_data->data().rowwise() - mean.transpose();
+        if (this->m_covMode == CovMode::SHARED)
+            this->m_innerCovChol.matrixU().solveInPlace<Eigen::OnTheRight>(whitened);
+        for (DataTensor::Index s : this->m_data->getMissingSampleIndices())
+            whitened.row(s).setZero();
+        
+        ReflessIndexVector shape = this->m_data->shape();
+        shape.d = 2 * d + 1;
+        std::shared_ptr<DataTensor> boundCumsum = std::make_shared<DataTensor>(shape);
+        boundCumsum->data().leftCols(d) = whitened.cwiseMax(Scalar(0));
+        boundCumsum->data().middleCols(d, d) = (-whitened).cwiseMax(Scalar(0));
+        boundCumsum->data().col(2 * d) = whitened.rowwise().norm();
+        boundCumsum->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+        this->m_boundCumsum = boundCumsum;
+    }
+    
+    // Determine the range of the number of samples in the sub-blocks
+    Scalar numValid = this->m_data->numValidSamples();
+    DataTensor::Index numHull = innerHull.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(innerHull);
+    DataTensor::Index numCore = (innerCore.empty()) ? 0 : innerCore.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(innerCore);
+    Scalar minNum = std::max(numCore, static_cast<DataTensor::Index>(1)), maxNum = std::min(static_cast<Scalar>(numHull), numValid - 1);
+    if (maxNum < minNum)
+        return 0;
+    
+    // Bound the sum C of the whitened samples in the sub-blocks by the sum over the core plus the positive or the negative
+    // parts of the samples in the hull which are not in the core (box bound) or by the triangle inequality.
+    Sample hullSums = this->m_boundCumsum->sumFromCumsum(innerHull);
+    Sample coreSums = (innerCore.empty()) ? Sample::Zero(2 * d + 1) : this->m_boundCumsum->sumFromCumsum(innerCore);
+    Sample borderSums = hullSums - coreSums;
+    Sample coreSum = coreSums.head(d) - coreSums.segment(d, d);
+    Scalar boxBound = (coreSum + borderSums.head(d)).cwiseAbs2().cwiseMax((coreSum - borderSums.segment(d, d)).cwiseAbs2()).sum();
+    Scalar triangleBound = coreSum.norm() + borderSums(2 * d);
+    Scalar sumBound = std::min(boxBound, triangleBound * triangleBound);
+    
+    // The factor (N / (n * (N - n)))^2 * n^e is convex in n, so that it takes its maximum at one of the borders
+    auto factor = [numValid, lengthExponent](Scalar n)
+    {
+        Scalar f = numValid / (n * (numValid - n));
+        return (lengthExponent > 0) ? f * f * n : f * f;
+    };
+    
+    // Leave some room for rounding errors, since the bound may be tight
+    return sumBound * std::max(factor(minNum), factor(maxNum)) * (1 + std::sqrt(std::numeric_limits<Scalar>::epsilon()));
 }
 
 
@@ -1015,7 +2263,7 @@ EnsembleOfRandomProjectionHistograms::EnsembleOfRandomProjectionHistograms()
 EnsembleOfRandomProjectionHistograms::EnsembleOfRandomProjectionHistograms(DataTensor::Index num_hist, DataTensor::Index num_bins, Scalar discount)
 : DensityEstimator(), m_num_hist(num_hist), m_num_bins(num_bins), m_discount(std::max(discount, 1e-7)),
   m_hist_bins(IntTensor::Sample::Constant(num_hist, num_bins)), m_hist_offsets(num_hist),
-  m_logprob_normalized(false)
+  m_block_length(0), m_count_offset(0), m_logprob_normalized(false)
 {
     if (this->m_num_hist == 0)
         throw std::invalid_argument("Ensemble must contain at least 1 histogram.");
@@ -1043,7 +2291,12 @@ EnsembleOfRandomProjectionHistograms::EnsembleOfRandomProjectionHistograms(const
 : DensityEstimator(other),
   m_num_hist(other.m_num_hist), m_num_bins(other.m_num_bins), m_discount(other.m_discount),
   m_hist_bins(other.m_hist_bins), m_hist_offsets(other.m_hist_offsets),
-  m_proj(other.m_proj), m_indices(other.m_indices), m_counts(other.m_counts),
+  m_proj(other.m_proj), m_proj_min(other.m_proj_min), m_proj_scale(other.m_proj_scale),
+  m_min_time(other.m_min_time), m_max_time(other.m_max_time),
+  m_indices(other.m_indices), m_index_buffer(other.m_index_buffer),
+  m_count_checkpoints(other.m_count_checkpoints), m_count_deltas(other.m_count_deltas),
+  m_block_length(other.m_block_length), m_count_offset(other.m_count_offset), m_count_base(other.m_count_base),
+  m_counts_total(other.m_counts_total),
   m_hist_inner(other.m_hist_inner), m_hist_outer(other.m_hist_outer),
   m_logprob_inner(other.m_logprob_inner), m_logprob_outer(other.m_logprob_outer),
   m_log_cache(other.m_log_cache), m_log_denom_cache(other.m_log_denom_cache), m_logprob_normalized(other.m_logprob_normalized)
@@ -1054,14 +2307,25 @@ EnsembleOfRandomProjectionHistograms & EnsembleOfRandomProjectionHistograms::ope
     this->m_data = other.m_data;
     this->m_extremeRange = other.m_extremeRange;
     this->m_numExtremes = other.m_numExtremes;
+    this->m_stats = other.m_stats;
     this->m_num_hist = other.m_num_hist;
     this->m_num_bins = other.m_num_bins;
     this->m_discount = other.m_discount;
     this->m_hist_bins = other.m_hist_bins;
     this->m_hist_offsets = other.m_hist_offsets;
     this->m_proj = other.m_proj;
+    this->m_proj_min = other.m_proj_min;
+    this->m_proj_scale = other.m_proj_scale;
+    this->m_min_time = other.m_min_time;
+    this->m_max_time = other.m_max_time;
     this->m_indices = other.m_indices;
-    this->m_counts = other.m_counts;
+    this->m_index_buffer = other.m_index_buffer;
+    this->m_count_checkpoints = other.m_count_checkpoints;
+    this->m_count_deltas = other.m_count_deltas;
+    this->m_block_length = other.m_block_length;
+    this->m_count_offset = other.m_count_offset;
+    this->m_count_base = other.m_count_base;
+    this->m_counts_total = other.m_counts_total;
     this->m_hist_inner = other.m_hist_inner;
     this->m_hist_outer = other.m_hist_outer;
     this->m_logprob_inner = other.m_logprob_inner;
@@ -1082,29 +2346,18 @@ void EnsembleOfRandomProjectionHistograms::init(const std::shared_ptr<const Data
     DensityEstimator::init(data);
     
     this->m_indices.reset();
-    this->m_counts.reset();
+    this->m_index_buffer.reset();
+    this->m_count_checkpoints.reset();
+    this->m_count_deltas.reset();
+    this->m_count_offset = 0;
+    this->m_count_base = IntTensor::Sample();
     
     if (this->m_data && !this->m_data->empty())
     {
         ReflessIndexVector shape = this->m_data->shape();
         
         // Cache some logarithms
-        if (!this->m_log_cache || static_cast<DataTensor::Index>(this->m_log_cache->size()) < data->numValidSamples() + 1)
-        {
-            DataTensor::Index n;
-            if (this->m_log_cache)
-            {
-                n = this->m_log_cache->size();
-                this->m_log_cache->conservativeResize(data->numValidSamples() + 1);
-            }
-            else
-            {
-                n = 0;
-                this->m_log_cache.reset(new Sample(data->numValidSamples() + 1));
-            }
-            this->m_log_cache->segment(n, this->m_log_cache->size() - n)
-                = (Sample::LinSpaced(this->m_log_cache->size() - n, n, data->numValidSamples()).array() + this->m_discount).log();
-        }
+        this->cacheLogarithms(data->numValidSamples());
         
         // Generate random projection vectors
         if (!this->m_proj || static_cast<DataTensor::Index>(this->m_proj->cols()) != shape.d)
@@ -1136,14 +2389,43 @@ void EnsembleOfRandomProjectionHistograms::init(const std::shared_ptr<const Data
         // Project data onto 1d spaces
         shape.d = this->m_num_hist;
         DataTensor projectedData(shape);
-        projectedData.data().noalias() = this->m_data->data() * this->m_proj->transpose();
+        this->projectSamples(*this->m_data, 0, projectedData);
         projectedData.copyMask(*this->m_data);
         
         // Transform projected attributes to be in range [0,1]
         projectedData.missingValuePlaceholder(std::numeric_limits<Scalar>::max());
-        projectedData -= projectedData.data().colwise().minCoeff();
+        this->m_proj_min = projectedData.data().colwise().minCoeff();
+        projectedData -= this->m_proj_min;
         projectedData.missingValuePlaceholder(0);
-        projectedData /= projectedData.data().colwise().maxCoeff();
+        this->m_proj_scale = projectedData.data().colwise().maxCoeff();
+        
+        // Remember the last time steps where the minimum and the maximum are reached, which tells update()
+        // whether they are still reached after the first time steps have expired
+        const DataTensor::Index numLoc = shape.prod(1, MAXDIV_INDEX_DIMENSION - 2);
+        this->m_min_time = this->m_max_time = IntTensor::Sample::Zero(this->m_num_hist);
+        std::vector<bool> foundMin(this->m_num_hist, false), foundMax(this->m_num_hist, false);
+        for (DataTensor::Index i = projectedData.numSamples(), numFound = 0; i-- > 0 && numFound < 2 * this->m_num_hist; )
+            if (!projectedData.isMissingSample(i))
+            {
+                const auto sample = projectedData.sample(i);
+                for (DataTensor::Index j = 0; j < this->m_num_hist; ++j)
+                {
+                    if (!foundMin[j] && sample(j) == 0)
+                    {
+                        this->m_min_time(j) = i / numLoc;
+                        foundMin[j] = true;
+                        ++numFound;
+                    }
+                    if (!foundMax[j] && sample(j) == this->m_proj_scale(j))
+                    {
+                        this->m_max_time(j) = i / numLoc;
+                        foundMax[j] = true;
+                        ++numFound;
+                    }
+                }
+            }
+        
+        projectedData /= this->m_proj_scale;
         
         // Determine optimal number of bins for each histogram
         if (this->m_num_bins == 0)
@@ -1155,24 +2437,344 @@ void EnsembleOfRandomProjectionHistograms::init(const std::shared_ptr<const Data
         this->m_hist_inner = this->m_hist_outer = IntTensor::Sample(this->m_hist_offsets(this->m_num_hist - 1) + this->m_hist_bins(this->m_num_hist - 1));
         this->m_logprob_inner = this->m_logprob_outer = Sample(this->m_hist_inner.size());
         
-        // Determine indices of all samples and compute cumulative counts for all bins
-        this->m_indices.reset(new IntTensor(shape));
-        shape.d = this->m_hist_inner.size();
-        this->m_counts.reset(new IntTensor(shape, 0));
-        DataTensor::Index i, j;
-        for (i = 0; i < projectedData.numSamples(); ++i)
+        // Determine indices of all samples. Missing samples are never counted, but values which are not finite
+        // (e.g., if all projections of a histogram are equal) must not be converted to an integer.
+        this->m_indices.reset(new BinIndexTensor(shape));
+        const DataTensor::Index numSamples = projectedData.numSamples();
+        #pragma omp parallel for
+        for (DataTensor::Index i = 0; i < numSamples; ++i)
         {
-            const auto sample = projectedData.sample(i);
             auto ind = this->m_indices->sample(i);
-            auto c = this->m_counts->sample(i);
-            if (!projectedData.isMissingSample(i))
-                for (j = 0; j < this->m_num_hist; ++j)
+            if (projectedData.isMissingSample(i))
+            {
+                ind.setZero();
+                continue;
+            }
+            const auto sample = projectedData.sample(i);
+            for (DataTensor::Index j = 0; j < this->m_num_hist; ++j)
+            {
+                const Scalar pos = sample(j) * this->m_hist_bins(j);
+                ind(j) = (pos > 0) ? static_cast<uint32_t>(std::min(pos, static_cast<Scalar>(this->m_hist_bins(j) - 1))) : 0;
+            }
+        }
+        
+        // Compute cumulative counts for all bins
+        this->computeCumulativeCounts();
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired)
+{
+    // Fall back to a complete re-initialization if the counts can not be updated incrementally
+    if (!this->m_data || this->m_data->empty() || !this->m_indices || !this->m_count_deltas || !data || data->empty()
+            || data->numSamples() != data->length() || this->m_data->numSamples() != this->m_data->length()
+            || data->numAttrib() != this->m_data->numAttrib() || this->m_data->numValidSamples() == 0
+            || numExpired >= this->m_data->length() || data->length() + numExpired < this->m_data->length())
+    {
+        this->init(data);
+        return;
+    }
+    
+    const DataTensor::Index numRetained = this->m_data->length() - numExpired, newLength = data->length();
+    const DataTensor::Index numNew = newLength - numRetained, numBins = this->m_hist_inner.size();
+    IntTensor::Sample minTime = this->m_min_time, maxTime = this->m_max_time;
+    
+    // Project the new samples and check that they lie within the range of the projections of the previous ones.
+    // The last time steps where the minimum and the maximum are reached are tracked relative to the previous data.
+    ReflessIndexVector shape = data->shape();
+    shape.t = numNew;
+    shape.d = this->m_num_hist;
+    DataTensor projectedData(shape);
+    this->projectSamples(*data, numRetained, projectedData);
+    for (DataTensor::Index i = 0; i < numNew; ++i)
+        if (!data->isMissingSample(numRetained + i))
+        {
+            auto sample = projectedData.sample(i);
+            for (DataTensor::Index j = 0; j < this->m_num_hist; ++j)
+            {
+                sample(j) -= this->m_proj_min(j);
+                if (!(sample(j) >= 0 && sample(j) <= this->m_proj_scale(j)))
+                {
+                    this->init(data);
+                    return;
+                }
+                if (sample(j) == 0)
+                    minTime(j) = numExpired + numRetained + i;
+                if (sample(j) == this->m_proj_scale(j))
+                    maxTime(j) = numExpired + numRetained + i;
+            }
+        }
+    
+    // The bins would change if the minimum or the maximum is not reached by any remaining sample
+    if ((minTime.array() < numExpired).any() || (maxTime.array() < numExpired).any())
+    {
+        this->init(data);
+        return;
+    }
+    minTime.array() -= numExpired;
+    maxTime.array() -= numExpired;
+    
+    // Use the bin indices and cumulative counts computed by init() as initial buffers
+    if (!this->m_index_buffer)
+        this->m_index_buffer = this->m_indices;
+    
+    // Allocate new buffers if the new time steps wouldn't fit. The old ones are not modified, since they may
+    // still be referenced by copies of this estimator. The counts of the retained time steps are re-computed
+    // from their bin indices in that case, so that the blocks of compact counts start at the new window.
+    DataTensor::Index offset = this->m_count_offset + numExpired, firstCounted = numRetained;
+    if (offset + newLength > this->m_index_buffer->length())
+    {
+        ReflessIndexVector bufferShape = shape;
+        bufferShape.t = std::max(2 * newLength, this->m_index_buffer->length());
+        std::shared_ptr<BinIndexTensor> indexBuffer = std::make_shared<BinIndexTensor>(bufferShape);
+        if (numRetained > 0)
+            indexBuffer->data().topRows(numRetained) = this->m_index_buffer->data().middleRows(offset, numRetained);
+        this->m_index_buffer = indexBuffer;
+        bufferShape.d = numBins;
+        this->m_count_deltas.reset(new CountDeltaTensor(bufferShape));
+        bufferShape.t = (bufferShape.t + this->m_block_length - 1) / this->m_block_length;
+        this->m_count_checkpoints.reset(new IntTensor(bufferShape));
+        offset = firstCounted = 0;
+    }
+    
+    // Determine the bins of the new samples just like init()
+    for (DataTensor::Index i = 0; i < numNew; ++i)
+    {
+        auto ind = this->m_index_buffer->sample(offset + numRetained + i);
+        if (data->isMissingSample(numRetained + i))
+        {
+            ind.setZero();
+            continue;
+        }
+        const auto sample = projectedData.sample(i);
+        for (DataTensor::Index j = 0; j < this->m_num_hist; ++j)
+        {
+            const Scalar pos = (sample(j) / this->m_proj_scale(j)) * this->m_hist_bins(j);
+            ind(j) = (pos > 0) ? static_cast<uint32_t>(std::min(pos, static_cast<Scalar>(this->m_hist_bins(j) - 1))) : 0;
+        }
+    }
+    
+    // Wrap the current window of the buffers and count the new samples
+    DensityEstimator::init(data);
+    shape.t = newLength;
+    this->m_indices.reset(new BinIndexTensor(this->m_index_buffer->raw() + offset * this->m_num_hist, shape));
+    this->m_min_time = minTime;
+    this->m_max_time = maxTime;
+    this->cacheLogarithms(data->numValidSamples());
+    this->m_count_offset = offset;
+    this->appendCumulativeCounts(firstCounted);
+    
+    // Remember the cumulative counts preceding the window
+    if (offset > 0)
+        this->m_count_base = this->m_count_checkpoints->sample((offset - 1) / this->m_block_length)
+                             + this->m_count_deltas->sample(offset - 1).cast<DataTensor::Index>();
+    else
+        this->m_count_base = IntTensor::Sample::Zero(numBins);
+    this->m_counts_total = this->m_count_checkpoints->sample((offset + newLength - 1) / this->m_block_length)
+                           + this->m_count_deltas->sample(offset + newLength - 1).cast<DataTensor::Index>()
+                           - this->m_count_base;
+}
+
+void EnsembleOfRandomProjectionHistograms::projectSamples(const DataTensor & data, DataTensor::Index first, DataTensor & projected) const
+{
+    const DataTensor::Index numSamples = projected.numSamples();
+    data.setMissingValues(); // make sure missing values have been set before accessing the data concurrently
+    #pragma omp parallel for
+    for (DataTensor::Index i = 0; i < numSamples; ++i)
+    {
+        const auto sample = data.sample(first + i);
+        auto proj = projected.sample(i);
+        for (DataTensor::Index j = 0; j < this->m_num_hist; ++j)
+        {
+            Scalar value = 0;
+            for (SparseMatrix::InnerIterator it(*(this->m_proj), j); it; ++it)
+                value += it.value() * sample(it.index());
+            proj(j) = value;
+        }
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::cacheLogarithms(DataTensor::Index n)
+{
+    if (!this->m_log_cache || static_cast<DataTensor::Index>(this->m_log_cache->size()) < n + 1)
+    {
+        DataTensor::Index numCached;
+        if (this->m_log_cache)
+        {
+            numCached = this->m_log_cache->size();
+            this->m_log_cache->conservativeResize(n + 1);
+        }
+        else
+        {
+            numCached = 0;
+            this->m_log_cache.reset(new Sample(n + 1));
+        }
+        this->m_log_cache->segment(numCached, this->m_log_cache->size() - numCached)
+            = (Sample::LinSpaced(this->m_log_cache->size() - numCached, numCached, n).array() + this->m_discount).log();
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::computeCumulativeCounts()
+{
+    const DataTensor & data = *(this->m_data);
+    const DataTensor::Index len = data.length(), numLoc = data.shape().prod(1, MAXDIV_INDEX_DIMENSION - 2);
+    const DataTensor::Index numBins = this->m_hist_inner.size();
+    const DataTensor::Index maxDelta = std::numeric_limits<uint16_t>::max();
+    const DataTensor::Index strides[] = { data.shape().prod(2, MAXDIV_INDEX_DIMENSION - 2), data.shape().z, 1 };
+    const DataTensor::Index sizes[] = { data.width(), data.height(), data.depth() };
+    
+    // The cumulative counts within a block may not exceed the range of the compact counts.
+    // If even a single time step contains too many samples, full cumulative counts are stored for each time step,
+    // which include the time step itself, since there are no deltas which would add it.
+    ReflessIndexVector shape = data.shape();
+    this->m_block_length = std::max(static_cast<DataTensor::Index>(1), maxDelta / numLoc);
+    const bool storeDeltas = (numLoc <= maxDelta);
+    shape.t = (len + this->m_block_length - 1) / this->m_block_length;
+    shape.d = numBins;
+    this->m_count_checkpoints.reset(new IntTensor(shape));
+    if (storeDeltas)
+    {
+        shape.t = len;
+        this->m_count_deltas.reset(new CountDeltaTensor(shape));
+    }
+    else
+        this->m_count_deltas.reset();
+    this->m_counts_total.resize(numBins);
+    
+    #pragma omp parallel for schedule(dynamic)
+    for (DataTensor::Index h = 0; h < this->m_num_hist; ++h)
+    {
+        const DataTensor::Index offs = this->m_hist_offsets(h), bins = this->m_hist_bins(h);
+        IntTensor::ScalarMatrix slice(numLoc, bins), blockCounts(numLoc, bins), counts = IntTensor::ScalarMatrix::Zero(numLoc, bins);
+        for (DataTensor::Index block = 0, t0 = 0; t0 < len; ++block, t0 += this->m_block_length)
+        {
+            // Store cumulative counts before this block
+            if (storeDeltas)
+                for (DataTensor::Index loc = 0; loc < numLoc; ++loc)
+                    this->m_count_checkpoints->sample(block * numLoc + loc).segment(offs, bins) = counts.row(loc).transpose();
+            
+            blockCounts.setZero();
+            for (DataTensor::Index t = t0; t < std::min(t0 + this->m_block_length, len); ++t)
+            {
+                // Count samples at this time step and compute cumulative sums over the spatial dimensions
+                slice.setZero();
+                for (DataTensor::Index loc = 0, i = t * numLoc; loc < numLoc; ++loc, ++i)
+                    if (!data.isMissingSample(i))
+                        slice(loc, this->m_indices->sample(i)(h)) = 1;
+                for (unsigned int d = 0; d < 3; ++d)
+                    if (sizes[d] > 1)
+                        for (DataTensor::Index loc = 0; loc < numLoc; ++loc)
+                            if ((loc / strides[d]) % sizes[d] > 0)
+                                slice.row(loc) += slice.row(loc - strides[d]);
+                
+                // Accumulate counts over the time steps of the block
+                blockCounts += slice;
+                if (storeDeltas)
+                    for (DataTensor::Index loc = 0; loc < numLoc; ++loc)
+                        this->m_count_deltas->sample(t * numLoc + loc).segment(offs, bins) = blockCounts.row(loc).transpose().cast<uint16_t>();
+            }
+            counts += blockCounts;
+            
+            // Store cumulative counts up to and including the single time step of this block
+            if (!storeDeltas)
+                for (DataTensor::Index loc = 0; loc < numLoc; ++loc)
+                    this->m_count_checkpoints->sample(block * numLoc + loc).segment(offs, bins) = counts.row(loc).transpose();
+        }
+        this->m_counts_total.segment(offs, bins) = counts.row(numLoc - 1).transpose();
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::appendCumulativeCounts(DataTensor::Index first)
+{
+    const DataTensor & data = *(this->m_data);
+    IntTensor::Sample counts = IntTensor::Sample::Zero(this->m_hist_inner.size()), checkpoint = counts;
+    DataTensor::Index t = this->m_count_offset + first;
+    if (t > 0)
+    {
+        checkpoint = this->m_count_checkpoints->sample((t - 1) / this->m_block_length);
+        counts = checkpoint + this->m_count_deltas->sample(t - 1).cast<DataTensor::Index>();
+    }
+    
+    // The checkpoint of the current block is kept as a copy, which is only written to the buffer
+    for (DataTensor::Index i = first; i < data.length(); ++i, ++t)
+    {
+        if (t % this->m_block_length == 0)
+        {
+            checkpoint = counts;
+            this->m_count_checkpoints->sample(t / this->m_block_length) = checkpoint;
+        }
+        if (!data.isMissingSample(i))
+        {
+            const auto ind = this->m_indices->sample(i);
+            for (DataTensor::Index h = 0; h < this->m_num_hist; ++h)
+                ++counts(this->m_hist_offsets(h) + ind(h));
+        }
+        this->m_count_deltas->sample(t) = (counts - checkpoint).cast<uint16_t>();
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::addCumulativeCounts(DataTensor::Index t, DataTensor::Index loc, bool negative, IntTensor::Sample & hist) const
+{
+    const DataTensor::Index numLoc = this->m_data->numSamples() / this->m_data->length();
+    const auto checkpoint = this->m_count_checkpoints->sample((t / this->m_block_length) * numLoc + loc);
+    if (negative)
+        hist -= checkpoint;
+    else
+        hist += checkpoint;
+    if (this->m_count_deltas)
+    {
+        const auto delta = this->m_count_deltas->sample(t * numLoc + loc);
+        if (negative)
+            hist -= delta.cast<DataTensor::Index>();
+        else
+            hist += delta.cast<DataTensor::Index>();
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::countRange(const IndexRange & range, IntTensor::Sample & hist) const
+{
+    const ReflessIndexVector & shape = this->m_data->shape();
+    const DataTensor::Index numBins = hist.size();
+    DataTensor::Index i, * counts = hist.data();
+    if (this->m_count_deltas && shape.prod(1, MAXDIV_INDEX_DIMENSION - 2) == 1)
+    {
+        // Shortcut for data without spatial dimensions
+        const DataTensor::Index end = this->m_count_offset + range.b.t - 1;
+        const DataTensor::Index * checkpoint = this->m_count_checkpoints->sample(end / this->m_block_length).data();
+        const uint16_t * delta = this->m_count_deltas->sample(end).data();
+        for (i = 0; i < numBins; ++i)
+            counts[i] = checkpoint[i] + delta[i];
+        if (range.a.t > 0)
+        {
+            const DataTensor::Index start = this->m_count_offset + range.a.t - 1;
+            checkpoint = this->m_count_checkpoints->sample(start / this->m_block_length).data();
+            delta = this->m_count_deltas->sample(start).data();
+            for (i = 0; i < numBins; ++i)
+                counts[i] -= checkpoint[i] + delta[i];
+        }
+        else if (this->m_count_offset > 0)
+            hist -= this->m_count_base;
+    }
+    else
+    {
+        // Inclusion-Exclusion Principle over the time and the spatial dimensions
+        hist.setZero();
+        DataTensor::Index ind[MAXDIV_INDEX_DIMENSION - 1];
+        for (unsigned int corner = 0; corner < (1u << (MAXDIV_INDEX_DIMENSION - 1)); ++corner)
+        {
+            bool negative = false, isZeroBlock = false;
+            for (unsigned int d = 0; d < MAXDIV_INDEX_DIMENSION - 1 && !isZeroBlock; ++d)
+                if (corner & (1u << d))
                 {
-                    ind(j) = std::min(static_cast<DataTensor::Index>(sample(j) * this->m_hist_bins(j)), this->m_hist_bins(j) - 1);
-                    c(this->m_hist_offsets(j) + ind(j)) = 1;
+                    isZeroBlock = (range.a.ind[d] == 0);
+                    ind[d] = range.a.ind[d] - 1;
+                    negative = !negative;
                 }
+                else
+                    ind[d] = range.b.ind[d] - 1;
+            if (!isZeroBlock)
+                this->addCumulativeCounts(ind[0], (ind[1] * shape.y + ind[2]) * shape.z + ind[3], negative, hist);
         }
-        this->m_counts->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
     }
 }
 
@@ -1180,17 +2782,23 @@ void EnsembleOfRandomProjectionHistograms::fit(const IndexRange & range)
 {
     DensityEstimator::fit(range);
     
-    // Compute the histograms of the samples inside and outside of the given range
-    this->m_hist_inner = this->m_counts->sumFromCumsum(range);
-    this->m_hist_outer = this->m_counts->sample(this->m_counts->numSamples() - 1) - this->m_hist_inner;
+    // Compute the histogram of the samples inside of the given range
+    this->countRange(range, this->m_hist_inner);
     
-    // Compute logarithm of probability density estimates:
+    // Compute the histogram of the samples outside of the given range and the logarithm of probability density estimates:
     // log( bins * (n_i + discount) / (N + bins * discount) ) = log(n_i + discount) - log( N/bins + discount )
     // We only compute log(n_i + discount) here and leave the denominator for being added later, since it does not depend on n_i.
-    for (DataTensor::Index i = 0; i < static_cast<DataTensor::Index>(this->m_hist_inner.size()); ++i)
+    const DataTensor::Index numBins = this->m_hist_inner.size();
+    const DataTensor::Index * histTotal = this->m_counts_total.data();
+    const DataTensor::Index * histInner = this->m_hist_inner.data();
+    DataTensor::Index * histOuter = this->m_hist_outer.data();
+    const Scalar * logCache = this->m_log_cache->data();
+    Scalar * logprobInner = this->m_logprob_inner.data(), * logprobOuter = this->m_logprob_outer.data();
+    for (DataTensor::Index i = 0; i < numBins; ++i)
     {
-        this->m_logprob_inner(i) = (*this->m_log_cache)(this->m_hist_inner(i));
-        this->m_logprob_outer(i) = (*this->m_log_cache)(this->m_hist_outer(i));
+        histOuter[i] = histTotal[i] - histInner[i];
+        logprobInner[i] = logCache[histInner[i]];
+        logprobOuter[i] = logCache[histOuter[i]];
     }
     this->m_logprob_normalized = false;
 }
@@ -1199,11 +2807,27 @@ void EnsembleOfRandomProjectionHistograms::reset()
 {
     DensityEstimator::reset();
     this->m_indices.reset();
-    this->m_counts.reset();
-    this->m_hist_inner = this->m_hist_outer = IntTensor::Sample();
+    this->m_index_buffer.reset();
+    this->m_count_checkpoints.reset();
+    this->m_count_deltas.reset();
+    this->m_count_offset = 0;
+    this->m_count_base = IntTensor::Sample();
+    this->m_counts_total = this->m_hist_inner = this->m_hist_outer = IntTensor::Sample();
     this->m_logprob_inner = this->m_logprob_outer = Sample();
 }
 
+EstimatorStatistics EnsembleOfRandomProjectionHistograms::getStatistics() const
+{
+    EstimatorStatistics stats = DensityEstimator::getStatistics();
+    if (this->m_indices)
+        stats.cumulativeMemory += this->m_indices->numEl() * sizeof(uint32_t);
+    if (this->m_count_checkpoints)
+        stats.cumulativeMemory += this->m_count_checkpoints->numEl() * sizeof(DataTensor::Index);
+    if (this->m_count_deltas)
+        stats.cumulativeMemory += this->m_count_deltas->numEl() * sizeof(uint16_t);
+    return stats;
+}
+
 std::pair<Scalar, Scalar> EnsembleOfRandomProjectionHistograms::pdf(const ReflessIndexVector & ind) const
 {
     std::pair<Scalar, Scalar> pdf = this->logpdf(ind);
@@ -1290,6 +2914,95 @@ std::pair<Scalar, Scalar> EnsembleOfRandomProjectionHistograms::logLikelihoodOut
     return ll;
 }
 
+void EnsembleOfRandomProjectionHistograms::logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL)
+{
+    assert(this->m_data != nullptr && !this->m_data->empty() && this->m_indices != nullptr);
+    
+    const DataTensor::Index numBins = this->m_counts_total.size(), numValid = this->m_data->numValidSamples();
+    const DataTensor::Index * histTotal = this->m_counts_total.data();
+    const Scalar * logCache = this->m_log_cache->data();
+    IntTensor::Sample hist(numBins);
+    for (std::size_t r = 0; r < ranges.size(); ++r)
+    {
+        const DataTensor::Index numExtremes = ranges[r].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(ranges[r]);
+        const DataTensor::Index numNonExtremes = numValid - numExtremes;
+        this->countRange(ranges[r], hist);
+        ++this->m_stats.numFits;
+        
+        // Sum up the counts of the inner and the outer histograms weighted with the unnormalized log-probabilities of both
+        Scalar innerInner = 0, innerOuter = 0, outerInner = 0, outerOuter = 0;
+        for (DataTensor::Index i = 0; i < numBins; ++i)
+        {
+            const DataTensor::Index numInner = hist(i), numOuter = histTotal[i] - numInner;
+            const Scalar logprobInner = logCache[numInner], logprobOuter = logCache[numOuter];
+            innerInner += numInner * logprobInner;
+            innerOuter += numInner * logprobOuter;
+            outerInner += numOuter * logprobInner;
+            outerOuter += numOuter * logprobOuter;
+        }
+        
+        // Each sample falls into exactly one bin of each histogram, so the denominators can be subtracted afterwards
+        const Scalar logDenomInner = this->logDenomFromCache(numExtremes).sum(), logDenomOuter = this->logDenomFromCache(numNonExtremes).sum();
+        if (innerLL != nullptr)
+        {
+            innerLL[r].first = (innerInner - numExtremes * logDenomInner) / this->m_num_hist;
+            innerLL[r].second = (innerOuter - numExtremes * logDenomOuter) / this->m_num_hist;
+        }
+        if (outerLL != nullptr)
+        {
+            outerLL[r].first = (outerInner - numNonExtremes * logDenomInner) / this->m_num_hist;
+            outerLL[r].second = (outerOuter - numNonExtremes * logDenomOuter) / this->m_num_hist;
+        }
+    }
+}
+
+void EnsembleOfRandomProjectionHistograms::pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF)
+{
+    assert(this->m_data != nullptr && !this->m_data->empty() && this->m_indices != nullptr);
+    
+    const DataTensor::Index numBins = this->m_counts_total.size(), numValid = this->m_data->numValidSamples(), numSamples = this->m_data->numSamples();
+    const DataTensor::Index * histTotal = this->m_counts_total.data();
+    const Scalar * logCache = this->m_log_cache->data();
+    IntTensor::Sample hist(numBins);
+    Sample logprobInner(numBins), logprobOuter(numBins);
+    innerPDF.resize(ranges.size(), numSamples);
+    outerPDF.resize(ranges.size(), numSamples);
+    for (std::size_t r = 0; r < ranges.size(); ++r)
+    {
+        const DataTensor::Index numExtremes = ranges[r].shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - this->m_data->numMissingSamplesInRange(ranges[r]);
+        this->countRange(ranges[r], hist);
+        ++this->m_stats.numFits;
+        
+        // Normalized log-probabilities of all bins
+        const Sample & logDenomInner = this->logDenomFromCache(numExtremes);
+        const Sample & logDenomOuter = this->logDenomFromCache(numValid - numExtremes);
+        for (DataTensor::Index h = 0; h < this->m_num_hist; ++h)
+            for (DataTensor::Index i = this->m_hist_offsets(h); i < this->m_hist_offsets(h) + this->m_hist_bins(h); ++i)
+            {
+                logprobInner(i) = logCache[hist(i)] - logDenomInner(h);
+                logprobOuter(i) = logCache[histTotal[i] - hist(i)] - logDenomOuter(h);
+            }
+        
+        // Average log-likelihood over all histograms for each sample
+        for (DataTensor::Index sample = 0; sample < numSamples; ++sample)
+            if (this->m_data->isMissingSample(sample))
+                innerPDF(r, sample) = outerPDF(r, sample) = 1;
+            else
+            {
+                const auto bins = this->m_indices->sample(sample);
+                Scalar sumInner = 0, sumOuter = 0;
+                for (DataTensor::Index h = 0; h < this->m_num_hist; ++h)
+                {
+                    const DataTensor::Index bin = this->m_hist_offsets(h) + bins(h);
+                    sumInner += logprobInner(bin);
+                    sumOuter += logprobOuter(bin);
+                }
+                innerPDF(r, sample) = std::exp(sumInner / this->m_num_hist);
+                outerPDF(r, sample) = std::exp(sumOuter / this->m_num_hist);
+            }
+    }
+}
+
 const Sample & EnsembleOfRandomProjectionHistograms::logDenomFromCache(DataTensor::Index n) const
 {
     try
@@ -1310,21 +3023,27 @@ EnsembleOfRandomProjectionHistograms::IntTensor::Sample EnsembleOfRandomProjecti
 {
     assert(data.data().minCoeff() >= 0.0 && data.data().maxCoeff() <= 1.0);
     
-    static std::vector<Scalar> penalties; // cache for penalty terms
-    
     // Optimize bins separately for each histogram in order to allow for early exit
     IntTensor::Sample bins = IntTensor::Sample::Constant(data.numAttrib(), 1);
-    DataTensor::Index maxBins = std::ceil(data.numValidSamples() / std::log(data.numValidSamples()));
-    Scalar logLikelihood, penalty, pml, max_pml, eps = std::numeric_limits<Scalar>::epsilon();
-    Sample last_ll_cache(20), last_pen_cache(20);
-    DataTensor::Index h, b;
-    Sample::Index i, j;
-    for (h = 0; h < data.numAttrib(); ++h)
+    const DataTensor::Index maxBins = std::ceil(data.numValidSamples() / std::log(data.numValidSamples()));
+    const Scalar eps = std::numeric_limits<Scalar>::epsilon();
+    
+    // Compute penalty terms
+    std::vector<Scalar> penalties;
+    for (DataTensor::Index b = 2; b <= maxBins; ++b)
+        penalties.push_back(b - 1 + std::pow(std::log(b), 2.5));
+    
+    // The histograms are processed in parallel
+    data.setMissingValues(); // make sure missing values have been set before accessing the data concurrently
+    #pragma omp parallel for schedule(dynamic)
+    for (DataTensor::Index h = 0; h < data.numAttrib(); ++h)
     {
         const auto channel = data.channel(h);
-        max_pml = 0.0; // maximum penalized likelihood is always 0 for only 1 bin
+        Scalar logLikelihood, penalty, pml, max_pml = 0.0; // maximum penalized likelihood is always 0 for only 1 bin
+        Sample last_ll_cache(20), last_pen_cache(20);
+        Sample::Index i, j;
         
-        for (b = 2; b <= maxBins; ++b)
+        for (DataTensor::Index b = 2; b <= maxBins; ++b)
         {
             // Count entries in each bin
             IntTensor::Sample counts = IntTensor::Sample::Zero(b);
@@ -1337,11 +3056,6 @@ EnsembleOfRandomProjectionHistograms::IntTensor::Sample EnsembleOfRandomProjecti
             Sample logprob = counts.cast<Scalar>() * static_cast<Scalar>(b) / data.numValidSamples();
             logprob = (logprob.array() + eps).log();
             logLikelihood = counts.cast<Scalar>().cwiseProduct(logprob).sum();
-            if (penalties.size() <= b - 2)
-            {
-                assert(penalties.size() == b - 2);
-                penalties.push_back(b - 1 + std::pow(std::log(b), 2.5));
-            }
             penalty = penalties[b - 2];
             pml = logLikelihood - penalty;
             
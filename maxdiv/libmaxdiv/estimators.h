@@ -19,8 +19,11 @@
 #define MAXIDV_ESTIMATORS_H
 
 #include <memory>
+#include <cstdint>
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include <Eigen/Core>
 #include <Eigen/Cholesky>
 #include <Eigen/SparseCore>
@@ -30,6 +33,39 @@
 namespace MaxDiv
 {
 
+/**
+* @brief Counters describing the work done by a DensityEstimator
+*
+* These counters are always maintained, since incrementing them costs next to nothing compared with the
+* fitting of a distribution. They are copied along with the estimator, so that the counters of clones used
+* by different threads can be reset independently and summed up afterwards.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+struct EstimatorStatistics
+{
+    unsigned long long numFits; /**< Number of calls to `DensityEstimator::fit()`. */
+    unsigned long long numIncrementalFits; /**< Number of fits obtained by updating the previous fit instead of computing it from scratch. */
+    unsigned long long numCacheFallbacks; /**< Number of sums which had to be computed explicitly because they were not covered by cumulative sums, e.g., calls to `GaussianDensityEstimator::computeOuterSum()`. */
+    std::size_t cumulativeMemory; /**< Number of bytes occupied by cumulative sums and similar structures computed by `init()`. */
+    
+    EstimatorStatistics() : numFits(0), numIncrementalFits(0), numCacheFallbacks(0), cumulativeMemory(0) {};
+    
+    /**
+    * Adds the counters of @p other to the counters of this object. The memory footprint will be the maximum
+    * of both, since clones of an estimator share their cumulative sums.
+    */
+    EstimatorStatistics & operator+=(const EstimatorStatistics & other)
+    {
+        this->numFits += other.numFits;
+        this->numIncrementalFits += other.numIncrementalFits;
+        this->numCacheFallbacks += other.numCacheFallbacks;
+        this->cumulativeMemory = std::max(this->cumulativeMemory, other.cumulativeMemory);
+        return *this;
+    };
+};
+
+
 /**
 * @brief Base interface for probability density estimators
 *
@@ -64,6 +100,37 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data);
     
+    /**
+    * Re-initializes this density estimator after the time series passed to `init()` has been moved
+    * forward in time, e.g., by a sliding window over a stream of data.
+    *
+    * The default implementation just calls `init()`, but derived classes may override this to update
+    * their internal structures incrementally. Currently, GaussianDensityEstimator and, as long as its bins
+    * do not change, EnsembleOfRandomProjectionHistograms do so, while KernelDensityEstimator is re-initialized
+    * from scratch.
+    *
+    * @param[in] data The new data. It must consist of the data passed to the previous call to `init()`
+    * or `update()` without its first @p numExpired time steps, followed by any number of new time steps.
+    * Missing samples must have been masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numExpired The number of time steps which have been removed from the beginning of the data.
+    */
+    virtual void update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired);
+    
+    /**
+    * Declares that the data passed to the next call to `init()` are the time-delay embedding of a time series
+    * with the given parameters, so that the estimator may compute sums over the embedded samples from the
+    * series instead of the embedded data. The default implementation ignores this.
+    *
+    * @param[in] series The padded series underlying the embedding, as returned by `time_delay_padding()`.
+    * May be `NULL` to declare that the data passed to `init()` are not embedded.
+    *
+    * @param[in] k The embedding dimension.
+    *
+    * @param[in] T The time delay.
+    */
+    virtual void setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> &, DataTensor::Index, DataTensor::Index) {};
+    
     /**
     * Fits the parameters of the inner and outer distribution to a sub-block of the
     * DataTensor passed to `init()` specified by the given @p range.
@@ -79,6 +146,17 @@ public:
     */
     virtual void reset();
     
+    /**
+    * @return Returns the counters collected by this density estimator since its construction or the last call
+    * to `resetStatistics()`, along with the memory currently occupied by its cumulative sums.
+    */
+    virtual EstimatorStatistics getStatistics() const;
+    
+    /**
+    * Resets the counters returned by `getStatistics()` to zero.
+    */
+    void resetStatistics() { this->m_stats = EstimatorStatistics(); };
+    
     /**
     * Computes the value of the probability density function of the inner and the outer
     * distribution for the sample at a given position in the DataTensor passed to `init()`.
@@ -247,18 +325,67 @@ public:
     */
     virtual std::pair<Scalar, Scalar> logLikelihoodOutsideRange(IndexRange range) const;
 
+    /**
+    * Computes the log-likelihoods of the samples inside and outside of each range of a batch, which
+    * `logLikelihoodInner()` and `logLikelihoodOuter()` would return after fitting the distributions to that range.
+    *
+    * The default implementation calls `fit()` for each range in the given order. Derived classes may override
+    * this to obtain the log-likelihoods directly from cumulative counts or sums. Afterwards, the state of the
+    * estimator is not guaranteed to correspond to any of the given ranges.
+    *
+    * @param[in] ranges The ranges to fit the distributions to. Each of them must contain at least one
+    * non-missing sample, but not all of them.
+    *
+    * @param[out] innerLL Optionally, an array with at least `ranges.size()` elements which will receive the
+    * log-likelihoods of the samples inside of each range. May be `NULL`.
+    *
+    * @param[out] outerLL Optionally, an array with at least `ranges.size()` elements which will receive the
+    * log-likelihoods of the samples outside of each range. May be `NULL`.
+    */
+    virtual void logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL);
+    
+    /**
+    * Computes the values of the probability density functions of the inner and the outer distribution fitted to
+    * each range of a batch for all samples in the DataTensor passed to `init()`, which `pdf()` would return after
+    * fitting the distributions to that range.
+    *
+    * The default implementation calls `fit()` and `pdf()` for each range in the given order. Derived classes may
+    * override this to compute the densities for all ranges with a few matrix operations. Afterwards, the state of
+    * the estimator is not guaranteed to correspond to any of the given ranges.
+    *
+    * @param[in] ranges The ranges to fit the distributions to. Each of them must contain at least one
+    * non-missing sample, but not all of them.
+    *
+    * @param[out] innerPDF Matrix which will be resized to `ranges.size()` rows and one column per sample.
+    * Each row receives the pdf of all samples under the inner distribution fitted to the respective range.
+    * A value of 1 will be assigned to the pdf of missing samples.
+    *
+    * @param[out] outerPDF Matrix of the same size as @p innerPDF, which will receive the pdf of all samples
+    * under the outer distributions.
+    */
+    virtual void pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF);
+
 
 protected:
 
     std::shared_ptr<const DataTensor> m_data; /**< Pointer to the DataTensor passed to `init()`. */
     IndexRange m_extremeRange; /**< Range of inner block passed to `fit()`. */
     DataTensor::Index m_numExtremes; /**< Number of non-missing samples in the block passed to `fit()`. */
+    EstimatorStatistics m_stats; /**< Counters returned by `getStatistics()`. */
 
 };
 
 
 /**
 * @brief Estimates the distribution of given data by Kernel Density Estimation using a Gaussian kernel
+*
+* For data with at most `MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT` samples, cumulative sums of the materialized kernel
+* matrix are used to compute the sums of kernel values over the inner and the outer range. For more samples,
+* these sums have to be computed explicitly for each sample, unless a low-rank approximation of the kernel matrix
+* has been enabled using `setApproximationRank()`. In that case, cumulative sums of the factors of the approximation
+* obtained from `GaussKernel::lowRankFactors()` are used instead, which requires `O(n * r)` memory for `n` samples
+* and rank `r`.
+*
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
 class KernelDensityEstimator : public DensityEstimator
@@ -333,6 +460,18 @@ public:
     */
     virtual void reset() override;
     
+    /**
+    * @return Returns the counters collected by this estimator. The memory footprint comprises the cumulative sums of the
+    * kernel matrix or of the factors of its low-rank approximation.
+    */
+    virtual EstimatorStatistics getStatistics() const override;
+    
+    /**
+    * Fits the inner and outer distribution to a sub-block of the DataTensor passed to `init()`
+    * specified by the given @p range.
+    */
+    virtual void fit(const IndexRange & range) override;
+    
     /**
     * Computes the value of the probability density function of the inner and the outer
     * distribution for the sample at a given position in the DataTensor passed to `init()`.
@@ -346,6 +485,51 @@ public:
     * distribution. If the given sample is a missing sample, it will be assigned a pdf of 1.
     */
     virtual std::pair<Scalar, Scalar> pdf(const ReflessIndexVector & ind) const override;
+    
+    /**
+    * Computes the log-likelihoods of the samples inside and outside of each range of a batch.
+    *
+    * If @p outerLL is requested, which needs the densities of all samples anyway, and the cumulative kernel matrix
+    * or the low-rank approximation is available, the log-likelihoods are obtained from the densities computed by
+    * `pdfs()` for as many ranges at once as fit into `MAXDIV_BATCH_PDF_SIZE_LIMIT` elements. Otherwise, `fit()`
+    * is called for each range, since the inner log-likelihood alone only needs the densities of the samples in
+    * the range.
+    */
+    virtual void logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL) override;
+    
+    /**
+    * Computes the densities of all samples under the distributions fitted to each range of a batch.
+    *
+    * With the cumulative kernel matrix, the sums of the kernel values over each range are taken from it for all
+    * samples at once. With the low-rank approximation, the sums of the factors of all ranges are multiplied with
+    * the factors of all samples in a single matrix product. Otherwise, `fit()` and `pdf()` are called for each range.
+    */
+    virtual void pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF) override;
+    
+    /**
+    * Enables or disables the low-rank approximation of the kernel matrix for data with more than
+    * `MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT` samples. The change takes effect on the next call to `init()`.
+    *
+    * The time needed per sample for evaluating the pdf and the memory required by the cumulative sums
+    * increase linearly with the rank, while the time needed by `init()` increases quadratically.
+    * The rank actually used may be lower if the kernel matrix can be approximated well with fewer factors.
+    *
+    * @param[in] rank The maximum rank of the approximation. Set this to 0 to always use the exact kernel,
+    * which is the default.
+    */
+    void setApproximationRank(DataTensor::Index rank) { this->m_approxRank = rank; };
+    
+    /**
+    * @return Returns the maximum rank of the approximation of the kernel matrix for large data sets
+    * or 0 if the approximation is disabled.
+    */
+    DataTensor::Index getApproximationRank() const { return this->m_approxRank; };
+    
+    /**
+    * @return Returns `true` if this estimator has been initialized with data for which the kernel matrix
+    * is approximated.
+    */
+    bool isApproximated() const { return (this->m_factors != nullptr); };
 
 
 protected:
@@ -354,6 +538,14 @@ protected:
     bool m_normed; /**< Whether to normalize the kernel. */
     std::shared_ptr<GaussKernel> m_kernel; /**< Pointer to the Gaussian kernel instance. */
     std::shared_ptr<DataTensor> m_cumKernel; /**< Materialized kernel matrix with cumulated rows. */
+    
+    DataTensor::Index m_approxRank; /**< Maximum rank of the approximation of the kernel matrix for large data sets (0 = exact kernel). */
+    std::shared_ptr<const DataTensor> m_factors; /**< Factors of the low-rank approximation of the kernel matrix. */
+    std::shared_ptr<const DataTensor> m_cumFactors; /**< Cumulative sums of the factors. */
+    Sample m_totalFactorSum; /**< Sum of the factors of all samples. */
+    Sample m_innerFactorSum; /**< Sum of the factors of the samples in the range passed to `fit()`. */
+    ScalarMatrix m_batchInnerPDF; /**< Workspace of `logLikelihoods()` holding the inner densities of a batch of ranges (not copied). */
+    ScalarMatrix m_batchOuterPDF; /**< Workspace of `logLikelihoods()` holding the outer densities of a batch of ranges (not copied). */
 
 };
 
@@ -388,6 +580,26 @@ public:
     */
     GaussianDensityEstimator(CovMode mode);
     
+    /**
+    * Constructs an un-initialized GaussianDensityEstimator with a specific covariance estimation mode
+    * which stores the sums of outer products of the samples only at the boundaries of blocks of time steps.
+    * `init()` has to be called before this density estimator can be used.
+    *
+    * Instead of a cumulative sum of `d x d` outer products for each time step, only the packed upper triangles
+    * of the cumulative sums at every @p blockSize-th time step are stored. The sum of outer products over a range
+    * is then reconstructed from these block prefix sums and the explicit outer products of at most
+    * `2 * (blockSize - 1)` time steps at the borders of the range. Thus, the block size trades memory
+    * (`n / blockSize * d * (d+1) / 2` scalars) for time needed to fit the distribution to a range.
+    * The block prefix sums are computed once by `init()` and shared among all copies of this estimator.
+    *
+    * @param[in] mode Specifies how the covariance matrix should be estimated. The block size only affects
+    * `CovMode::FULL`.
+    *
+    * @param[in] blockSize Number of time steps per block. A value of 0 disables block prefix sums in favour
+    * of full cumulative sums limited by `MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT`.
+    */
+    GaussianDensityEstimator(CovMode mode, DataTensor::Index blockSize);
+    
     /**
     * Constructs and initializes a GaussianDensityEstimator for a given data tensor.
     *
@@ -430,12 +642,56 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data) override;
     
+    /**
+    * Re-initializes this density estimator after the time series passed to `init()` has been moved
+    * forward in time, e.g., by a sliding window over a stream of data.
+    *
+    * For purely temporal data, the cumulative sums of the samples and their outer products are kept
+    * in buffers which are larger than the data, so that they can be updated in time linear in the number
+    * of new time steps. `init()` will be called instead if the data are spatio-temporal, the covariance
+    * mode is `SHARED`, block prefix sums are used, or the cumulative sums of outer products do not cover
+    * the entire data.
+    *
+    * @param[in] data The new data. It must consist of the data passed to the previous call to `init()`
+    * or `update()` without its first @p numExpired time steps, followed by any number of new time steps.
+    * Missing samples must have been masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numExpired The number of time steps which have been removed from the beginning of the data.
+    */
+    virtual void update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired) override;
+    
+    /**
+    * Declares that the data passed to the next call to `init()` are the time-delay embedding of a time series
+    * with the given parameters.
+    *
+    * Every block of the outer product of an embedded sample is then a lagged outer product of the series, so that
+    * for the covariance mode `FULL` without block prefix sums, `init()` computes the cumulative sums of the samples
+    * and of the `k` lagged outer products of the series instead of those of the embedded data. This requires only
+    * `d + k * d^2` instead of `k * d + (k * d)^2` values per sample, where `d` denotes the number of attributes of
+    * the series. The series is only used if neither the series nor the data have missing samples and its shape fits
+    * the data. It is not retained after `init()`.
+    *
+    * @param[in] series The padded series underlying the embedding, as returned by `time_delay_padding()`.
+    * May be `NULL` to declare that the data passed to `init()` are not embedded.
+    *
+    * @param[in] k The embedding dimension.
+    *
+    * @param[in] T The time delay.
+    */
+    virtual void setTimeDelayEmbedding(const std::shared_ptr<const DataTensor> & series, DataTensor::Index k, DataTensor::Index T) override;
+    
     /**
     * Fits the parameters of the inner and outer distribution to a sub-block of the
     * DataTensor passed to `init()` specified by the given @p range.
     *
     * The result of this function is undefined if the inner or the outer range consists of
     * missing samples only.
+    *
+    * If the covariance mode is `FULL` and the given range extends the previously fitted one along
+    * the time axis by a few samples, the distributions will be updated by rank-one updates of the
+    * Cholesky decompositions of the covariance matrices in `O(d^2)` per new sample instead of being
+    * fitted from scratch in `O(d^3)` (see `setIncrementalFit()`). This is the case when scanning
+    * over the end points of ranges with a fixed start point, as done by `DenseProposalGenerator`.
     */
     virtual void fit(const IndexRange & range) override;
     
@@ -445,6 +701,12 @@ public:
     */
     virtual void reset() override;
     
+    /**
+    * @return Returns the counters collected by this estimator. The memory footprint comprises the cumulative sums of the
+    * samples and of their outer products, including their buffers for streaming.
+    */
+    virtual EstimatorStatistics getStatistics() const override;
+    
     /**
     * Computes the value of the probability density function of the inner and the outer
     * distribution for the sample at a given position in the DataTensor passed to `init()`.
@@ -597,6 +859,25 @@ public:
     */
     CovMode getMode() const { return this->m_covMode; };
     
+    /**
+    * @return Returns the number of time steps per block of the block prefix sums of outer products
+    * or 0 if full cumulative sums are used.
+    */
+    DataTensor::Index getBlockSize() const { return this->m_blockSize; };
+    
+    /**
+    * Enables or disables incremental updates of the distributions by `fit()` if the fitted range
+    * extends the previous one. Incremental fitting is enabled by default.
+    *
+    * @param[in] incremental Set this to `false` to always fit the distributions from scratch.
+    */
+    void setIncrementalFit(bool incremental) { this->m_incrementalFit = incremental; this->m_incrementalValid = false; };
+    
+    /**
+    * @return Returns `true` if incremental updates of the distributions by `fit()` are enabled.
+    */
+    bool isIncrementalFit() const { return this->m_incrementalFit; };
+    
     /**
     * @return Returns a reference to the estimated mean of the inner distribution.
     */
@@ -662,29 +943,211 @@ public:
     * @param[in] innerDist Specifies whether to use the inner or the outer distribution.
     *
     * @return Returns the Mahalanobis distance between x1 and x2.
+    *
+    * @note Although this method is `const`, it uses the workspace of the estimator just like `fit()`. It must
+    * hence not be called concurrently on the same instance. Use a clone for each thread, which owns a workspace
+    * of its own.
     */
     const Scalar mahalanobisDistance(const Eigen::Ref<const Sample> & x1, const Eigen::Ref<const Sample> & x2, bool innerDist = true) const;
+    
+    /**
+    * Computes `trace(S_Omega^-1 * S_I)` or `trace(S_I^-1 * S_Omega)`, where `S_I` and `S_Omega` are the covariance
+    * matrices of the inner and the outer distribution estimated during the last call to `fit()`.
+    *
+    * If the last fit has been an incremental update, this takes `O(d^2)` time by means of traces with respect to
+    * the covariance matrix of the entire data maintained along with the Cholesky decompositions. Otherwise,
+    * it takes `O(d^3)` time.
+    *
+    * @param[in] innerInverse If `true`, `trace(S_I^-1 * S_Omega)` will be computed, otherwise `trace(S_Omega^-1 * S_I)`.
+    *
+    * @return Returns the trace of the product of the inverse of one covariance matrix and the other one.
+    *
+    * @note Like `mahalanobisDistance()`, this uses the workspace of the estimator and must not be called
+    * concurrently on the same instance.
+    */
+    Scalar covTraceQuotient(bool innerInverse = false) const;
+    
+    /**
+    * Computes the squared Mahalanobis distances between the means of the inner and the outer distribution
+    * for a batch of ranges at once, without altering the distributions fitted by the last call to `fit()`.
+    *
+    * This is only supported for the covariance modes `ID` and `SHARED`, where the distributions of a range
+    * are fully determined by the sum of its samples. The sums of all ranges are gathered from the cumulative
+    * sums into the columns of a single matrix, which is whitened by one triangular solve with the Cholesky
+    * factor of the shared covariance matrix, instead of solving a linear system for every range separately.
+    * Each range is counted as a fit in the statistics.
+    *
+    * @param[in] ranges The ranges to compute the distances for. Each of them must contain at least one
+    * non-missing sample, but not all of them.
+    *
+    * @param[out] distances Array with at least `ranges.size()` elements which will receive the distances.
+    *
+    * @param[out] numExtremes Optionally, an array with at least `ranges.size()` elements which will receive
+    * the number of non-missing samples in each range. May be `NULL`.
+    *
+    * @return Returns `false` if the covariance mode is `FULL`, in which case nothing will be computed.
+    */
+    bool meanDistances(const std::vector<IndexRange> & ranges, Scalar * distances, DataTensor::Index * numExtremes = nullptr);
+    
+    /**
+    * Terms of the closed-form divergences between the inner and the outer distribution of a range
+    * with full covariance matrices.
+    */
+    struct DivergenceTerms
+    {
+        Scalar outerQuadratic; /**< `(mu_I - mu_Omega)^T * S_Omega^-1 * (mu_I - mu_Omega) + trace(S_Omega^-1 * S_I)` */
+        Scalar innerQuadratic; /**< `(mu_Omega - mu_I)^T * S_I^-1 * (mu_Omega - mu_I) + trace(S_I^-1 * S_Omega)` */
+        Scalar innerCovLogDet; /**< Natural logarithm of the determinant of `S_I`. */
+        Scalar outerCovLogDet; /**< Natural logarithm of the determinant of `S_Omega`. */
+        DataTensor::Index numExtremes; /**< Number of non-missing samples in the range. */
+    };
+    
+    /**
+    * Fits the inner and the outer distribution with full covariance matrices to each range of a batch and
+    * computes the terms of the closed-form divergences, without altering the distributions fitted by the
+    * last call to `fit()`.
+    *
+    * This is only supported for the covariance mode `FULL` and data with at most `MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT`
+    * attributes. The computations are then carried out using fixed-size vectors and matrices specialized for the
+    * number of attributes, which avoids the overhead of dynamically sized types dominating for small matrices.
+    * The univariate case is computed directly from the means and variances. Every range is fitted from scratch
+    * and counted as a fit in the statistics.
+    *
+    * If libmaxdiv has been built with the CMake option `MAXDIV_OFFLOAD`, the terms are computed on the default
+    * device of OpenMP target offloading instead, provided that the cumulative sums of outer products cover the
+    * entire data passed to `init()`. The cumulative sums are then transferred to the device once by `init()`
+    * and shared among all copies of this estimator. This does not apply after `update()`.
+    *
+    * @param[in] ranges The ranges to compute the terms for. Each of them must contain at least one
+    * non-missing sample, but not all of them.
+    *
+    * @param[in] outerInverse Specifies whether `DivergenceTerms::outerQuadratic` should be computed.
+    *
+    * @param[in] innerInverse Specifies whether `DivergenceTerms::innerQuadratic` should be computed.
+    *
+    * @param[out] terms Array with at least `ranges.size()` elements which will receive the terms of each range.
+    *
+    * @return Returns `false` if this is not supported for the covariance mode or the number of attributes,
+    * in which case nothing will be computed.
+    */
+    bool divergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms);
+    
+    /**
+    * Computes an upper bound on the squared Mahalanobis distance between the means of the inner and the outer
+    * distribution which holds for all sub-blocks of the data containing @p innerCore and being contained in
+    * @p innerHull.
+    *
+    * This is only supported for the covariance modes `ID` and `SHARED`, where the distance only depends on the sum
+    * `C` of the centered and whitened samples in the range and on their number `n`:
+    * `(mu_I - mu_Omega)^T * S^-1 * (mu_I - mu_Omega) = (N / (n * (N - n)))^2 * ||C||^2`.
+    * `||C||^2` is bounded by means of the sums of the positive parts, the negative parts and the norms of the whitened
+    * samples in the hull but not in the core, which are obtained in constant time from cumulative sums computed on
+    * the first call after `init()`.
+    *
+    * @param[in] innerCore Sub-block of the data contained in all sub-blocks considered. May be empty.
+    *
+    * @param[in] innerHull Sub-block of the data containing all sub-blocks considered.
+    *
+    * @param[in] lengthExponent If this is 1, the bound will hold for the distance multiplied with the number of
+    * samples in the sub-block instead of the distance itself. Must be either 0 or 1.
+    *
+    * @return Returns the upper bound or infinity if the covariance mode is `FULL`.
+    */
+    Scalar meanDistanceUpperBound(const IndexRange & innerCore, const IndexRange & innerHull, int lengthExponent = 0);
 
 
 protected:
 
     CovMode m_covMode; /**< Specifies how the covariance matrix should be estimated. */
-    std::shared_ptr<DataTensor> m_cumsum; /**< Cumulative sum of the data passed to `init()`. */
+    std::shared_ptr<DataTensor> m_cumsum; /**< Cumulative sum of the data passed to `init()` or of the series underlying its time-delay embedding if `m_cumLagOuter` is used. */
     std::shared_ptr<DataTensor> m_cumOuter; /**< Cumulative sum of the outer products of the samples passed to `init()`. */
     DataTensor::Index m_cumOuter_offset; /**< Offset of the first time step in `m_cumOuter` from the first time step in the data (used for partial cumulative sums). */
     DataTensor::Index m_cumOuter_maxLen; /**< Maximum number of time steps covered by `m_cumOuter` for memory's sake (used for partial cumulative sums). */
+    DataTensor::Index m_blockSize; /**< Number of time steps per block of `m_blockOuter` (0 = use `m_cumOuter` instead). */
+    std::shared_ptr<const ScalarMatrix> m_blockOuter; /**< Packed upper triangles of the sums of outer products of all time steps before the beginning of each block (one row per block boundary). */
+    std::shared_ptr<DataTensor> m_cumLagOuter; /**< Cumulative sums of the lagged outer products of the time series underlying a time-delay embedded data tensor (used instead of `m_cumOuter`, see `computeCumLagOuter()`). */
+    std::shared_ptr<const DataTensor> m_embeddedSeries; /**< Series underlying the time-delay embedding of the data passed to the next call to `init()` (see `setTimeDelayEmbedding()`). */
+    DataTensor::Index m_lagDim; /**< Embedding dimension of the time-delay embedding given by `setTimeDelayEmbedding()`. */
+    DataTensor::Index m_lagDelay; /**< Time delay of the time-delay embedding given by `setTimeDelayEmbedding()`. */
     Sample m_innerMean; /**< Mean of the inner or the shared distribution. */
     Sample m_outerMean; /**< Mean of the outer distribution. */
     ScalarMatrix m_innerCov; /**< Covariance matrix of the inner or the shared distribution. */
     ScalarMatrix m_outerCov; /**< Covariance matrix of the outer distribution. */
     ScalarMatrix m_outerProdSum; /**< Sum of outer products of the samples in the data tensor passed to `init()`. */
-    Eigen::LLT<ScalarMatrix> m_innerCovChol; /**< Cholesky decomposition of the covariance matrix of the inner or the shared distribution. */
-    Eigen::LLT<ScalarMatrix> m_outerCovChol; /**< Cholesky decomposition of the covariance matrix of the outer distribution. */
+    ScalableLLT<ScalarMatrix> m_innerCovChol; /**< Cholesky decomposition of the covariance matrix of the inner or the shared distribution. */
+    ScalableLLT<ScalarMatrix> m_outerCovChol; /**< Cholesky decomposition of the covariance matrix of the outer distribution. */
     Scalar m_innerCovLogDet; /**< Natural logarithm of the determinant of the covariance matrix of the inner or the shared distribution. */
     Scalar m_outerCovLogDet; /**< Natural logarithm of the determinant of the covariance matrix of the outer distribution. */
     Scalar m_logNormalizer; /**< `-D/2 * log(2 * pi)` */
     Scalar m_innerLogNormalizer; /**< `-D/2 * log(2 * pi) - this->m_innerCovLogDet / 2` */
     Scalar m_outerLogNormalizer; /**< `-D/2 * log(2 * pi) - this->m_outerCovLogDet / 2` */
+    std::shared_ptr<DataTensor> m_cumsumBuffer; /**< Storage for `m_cumsum` maintained by `update()`, which may be larger than the data. */
+    std::shared_ptr<DataTensor> m_cumOuterBuffer; /**< Storage for `m_cumOuter` maintained by `update()`, which may be larger than the data. */
+    DataTensor::Index m_bufferOffset; /**< Index of the time step in the buffers which corresponds to the first time step of the data. */
+    Sample m_cumsumBase; /**< Cumulative sum of the samples preceding the data in `m_cumsumBuffer`. Must be subtracted from sums starting at time 0. */
+    Sample m_cumOuterBase; /**< Cumulative sum of the outer products preceding the data in `m_cumOuterBuffer`. */
+    bool m_incrementalFit; /**< Specifies whether `fit()` may update the distributions incrementally. */
+    bool m_incrementalValid; /**< Specifies whether the last fit can be updated incrementally, i.e., none of the covariance matrices had to be regularized. */
+    DataTensor::Index m_incrementalCount; /**< Number of samples added by incremental updates since the last fit from scratch. */
+    ScalarMatrix m_totalCov; /**< Covariance matrix of all samples in the data passed to `init()` (computed on demand). */
+    bool m_tracesValid; /**< Specifies whether `m_innerTrace` and `m_outerTrace` correspond to the current fit. */
+    Scalar m_innerTrace; /**< `trace(S_I^-1 * m_totalCov)` */
+    Scalar m_outerTrace; /**< `trace(S_Omega^-1 * m_totalCov)` */
+    std::shared_ptr<const DataTensor> m_boundCumsum; /**< Cumulative sums of the positive and negative parts and of the norms of the centered and whitened samples used by `meanDistanceUpperBound()` (computed on demand). */
+    
+    struct OffloadedSums;
+    std::shared_ptr<const OffloadedSums> m_offloadedSums; /**< `m_cumsum` and `m_cumOuter` mapped to the device by `init()` (only used if built with `MAXDIV_OFFLOAD`). */
+    
+    /**
+    * @brief Temporary vectors and matrices used by `fit()` and the distance computations
+    *
+    * The workspace is not copied along with the estimator, so that each clone owns its own buffers and
+    * fitting does not allocate memory anymore once they have reached their final size. It is mutable, since
+    * some `const` methods use it as well, which makes them unsafe to call concurrently on the same instance.
+    */
+    struct Workspace
+    {
+        Sample innerMean; /**< Mean of the inner distribution during incremental updates. */
+        Sample outerMean; /**< Mean of the outer distribution during incremental updates. */
+        Sample innerDiff; /**< Difference between a sample and the mean of the inner distribution. */
+        Sample outerDiff; /**< Difference between a sample and the mean of the outer distribution or between two means. */
+        Sample solution; /**< Solution of a linear system with a covariance matrix. */
+        Sample product; /**< Product of `m_totalCov` and `solution`. */
+        Sample rankUpdateTemp; /**< Workspace of `ScalableLLT::rankUpdate()`. */
+        Sample totalSum; /**< Sum of all samples. */
+        ScalarMatrix solutions; /**< Solution of a linear system with a covariance matrix and multiple right-hand sides. */
+        ScalarMatrix diffs; /**< Differences between the inner and the outer means of multiple ranges (may have more columns than needed). */
+        ScalarMatrix outerSum; /**< Sum of the outer products of the samples in a range. */
+        Sample lagSum; /**< Sums of the lagged outer products over a shifted range. */
+        std::vector<Scalar> offloadTotals; /**< Sums of all samples and of their outer products passed to the device. */
+        std::vector<DataTensor::Index> offloadBounds; /**< Bounds of the ranges passed to the device. */
+        std::vector<Scalar> offloadCounts; /**< Numbers of non-missing samples in the ranges passed to the device. */
+        std::vector<Scalar> offloadResults; /**< Terms of the divergences of the ranges computed on the device. */
+    };
+    mutable Workspace m_ws; /**< Workspace of this estimator (not copied). */
+    
+    /**
+    * Moves the window of the data in a buffer of cumulative sums forward, while keeping the cumulative sums
+    * of the samples which are still in the data. The buffer will be re-allocated and re-based if it is too
+    * small to hold @p newLength time steps starting at the new offset.
+    *
+    * @param[in,out] buffer The buffer with cumulative sums.
+    *
+    * @param[in,out] base The cumulative sum preceding the current window.
+    *
+    * @param[in] offset The current offset of the window in the buffer.
+    *
+    * @param[in] numExpired The number of time steps removed from the beginning of the window.
+    *
+    * @param[in] numRetained The number of time steps which are still part of the window.
+    *
+    * @param[in] newLength The length of the window after the new time steps have been appended.
+    *
+    * @return Returns the new offset of the window in the buffer.
+    */
+    static DataTensor::Index shiftCumsumBuffer(std::shared_ptr<DataTensor> & buffer, Sample & base,
+                                               DataTensor::Index offset, DataTensor::Index numExpired,
+                                               DataTensor::Index numRetained, DataTensor::Index newLength);
     
     /**
     * Computes the cumulative sum of the outer products of the samples in the data tensor passed to `init()`
@@ -705,6 +1168,104 @@ protected:
     */
     ScalarMatrix computeOuterSum(const IndexRange & range);
     
+    /**
+    * Computes the sums of outer products of all time steps preceding each block boundary and stores their
+    * packed upper triangles in `m_blockOuter`.
+    */
+    void computeBlockOuter();
+    
+    /**
+    * Computes the sum of the outer products of the samples in a given @p range in the data tensor passed to
+    * `init()` using the block prefix sums in `m_blockOuter` and explicit summation over the remaining time steps
+    * at the borders of the range.
+    *
+    * @param[in] range The range to compute the sum for. If it does not span the entire spatial extent of
+    * the data, the sum will be computed explicitly by `computeOuterSum()`.
+    *
+    * @param[out] outerSum Square matrix which will receive the sum of the outer products.
+    */
+    void computeBlockedOuterSum(const IndexRange & range, ScalarMatrix & outerSum);
+    
+    /**
+    * Computes the cumulative sums of the lagged outer products `x(t) * x(t - l * T)^T` for `l = 0, ..., k - 1` of the
+    * padded time series @p series underlying the time-delay embedding of the data passed to `init()` with the
+    * parameters `k = m_lagDim` and `T = m_lagDelay`. The result will be stored in `m_cumLagOuter`.
+    *
+    * Any block of the outer product of an embedded sample is such a lagged outer product, so that this requires
+    * only `k * (D/k)^2` instead of `D^2` values per sample, where `D` denotes the number of attributes of the data.
+    *
+    * @param[in] series The series passed to `setTimeDelayEmbedding()`.
+    */
+    void computeCumLagOuter(const DataTensor & series);
+    
+    /**
+    * Computes the sum of the samples in a given @p range in the data tensor passed to `init()` from the
+    * cumulative sums of the samples in `m_cumsum`, which may be those of the series underlying a time-delay
+    * embedding of the data.
+    *
+    * @param[in] range The range to compute the sum for.
+    *
+    * @param[out] sum Vector with `numAttrib()` elements which will receive the sum.
+    */
+    void sumSamples(const IndexRange & range, Eigen::Ref<Sample> sum) const;
+    
+    /**
+    * Computes the sum of the outer products of the samples in a given @p range in the data tensor passed to
+    * `init()` from the cumulative sums of lagged outer products in `m_cumLagOuter`.
+    *
+    * @param[in] range The range to compute the sum for.
+    *
+    * @param[out] outerSum Square matrix which will receive the sum of the outer products.
+    */
+    void computeLaggedOuterSum(const IndexRange & range, ScalarMatrix & outerSum);
+    
+    /**
+    * Computes the sum of the outer products of the samples in a given @p range in the data tensor passed to
+    * `init()` using the cumulative sums of lagged outer products, the block prefix sums, the cumulative sums
+    * of outer products, or explicit summation, depending on which of them are available for the range.
+    *
+    * @param[in] range The range to compute the sum for.
+    *
+    * @param[out] outerSum Square matrix with `numAttrib()` rows which will receive the sum of the outer products.
+    */
+    void sumOuterProducts(const IndexRange & range, ScalarMatrix & outerSum);
+    
+    /**
+    * Implementation of `divergenceTerms()` for data with @p D attributes. If the data have less attributes,
+    * the call is forwarded to the implementation for `D - 1`.
+    *
+    * @return Returns `false` if the data do not have between 1 and @p D attributes.
+    */
+    template<int D>
+    bool fixedSizeDivergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms);
+    
+    /**
+    * Implementation of `divergenceTerms()` computing the terms of all ranges in a single OpenMP target region
+    * on the device which `m_offloadedSums` have been mapped to. Only available if built with `MAXDIV_OFFLOAD`.
+    */
+    bool offloadedDivergenceTerms(const std::vector<IndexRange> & ranges, bool outerInverse, bool innerInverse, DivergenceTerms * terms);
+    
+    /**
+    * Updates the distributions fitted to the previous range after the samples at the end of the current
+    * range `m_extremeRange` have been moved from the outer to the inner distribution. The means of the
+    * distributions must already have been set to those of the current range.
+    *
+    * The means of the distributions fitted to @p prevRange are expected in `m_ws.innerMean` and `m_ws.outerMean`.
+    *
+    * @param[in] prevRange The previously fitted range. Must be a prefix of `m_extremeRange` along the time axis.
+    *
+    * @param[in] prevNumExtremes The number of non-missing samples in @p prevRange.
+    *
+    * @return Returns `false` if an incremental update was not possible, in which case the distributions
+    * have to be fitted from scratch.
+    */
+    bool fitIncrementally(const IndexRange & prevRange, DataTensor::Index prevNumExtremes);
+    
+    /**
+    * Computes `m_innerTrace` and `m_outerTrace` for the current fit from scratch.
+    */
+    void computeCovTraces();
+    
 
 };
 
@@ -721,6 +1282,10 @@ public:
 
     typedef DataTensor_<DataTensor::Index> IntTensor;
     
+    typedef DataTensor_<uint32_t> BinIndexTensor; /**< Tensor type for storing the indices of the bins which the samples fall into. */
+    
+    typedef DataTensor_<uint16_t> CountDeltaTensor; /**< Tensor type for storing cumulative counts relative to the beginning of a block. */
+    
     typedef Eigen::SparseMatrix<Scalar, Eigen::RowMajor> SparseMatrix;
 
 
@@ -800,6 +1365,26 @@ public:
     */
     virtual void init(const std::shared_ptr<const DataTensor> & data) override;
     
+    /**
+    * Re-initializes this density estimator after the time series passed to `init()` has been moved
+    * forward in time, e.g., by a sliding window over a stream of data.
+    *
+    * For purely temporal data, the bin indices and the cumulative counts are kept in buffers which are
+    * larger than the data, so that only the new time steps have to be projected and counted. This is only
+    * possible as long as the projections of the new data have the same minimum and maximum as those of the
+    * previous data. `init()` will be called instead otherwise and for spatio-temporal data.
+    *
+    * If the number of bins is determined automatically, the numbers of bins determined by the last call to
+    * `init()` are kept, so that they may differ from those `init()` would determine for the new data.
+    *
+    * @param[in] data The new data. It must consist of the data passed to the previous call to `init()`
+    * or `update()` without its first @p numExpired time steps, followed by any number of new time steps.
+    * Missing samples must have been masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numExpired The number of time steps which have been removed from the beginning of the data.
+    */
+    virtual void update(const std::shared_ptr<const DataTensor> & data, DataTensor::Index numExpired) override;
+    
     /**
     * Fits the parameters of the inner and outer distribution to a sub-block of the
     * DataTensor passed to `init()` specified by the given @p range.
@@ -815,6 +1400,12 @@ public:
     */
     virtual void reset() override;
     
+    /**
+    * @return Returns the counters collected by this estimator. The memory footprint comprises the bin indices of the samples
+    * and the compact cumulative bin counts.
+    */
+    virtual EstimatorStatistics getStatistics() const override;
+    
     /**
     * Computes the value of the probability density function of the inner and the outer
     * distribution for the sample at a given position in the DataTensor passed to `init()`.
@@ -866,6 +1457,20 @@ public:
     */
     virtual std::pair<Scalar, Scalar> logLikelihoodOuter() const override;
     
+    /**
+    * Computes the log-likelihoods of the samples inside and outside of each range of a batch.
+    *
+    * The histograms of each range are obtained from the cumulative counts and combined with the cached logarithms
+    * of the counts in a single pass over the bins, without storing or normalizing the log-probabilities of the bins.
+    */
+    virtual void logLikelihoods(const std::vector<IndexRange> & ranges, std::pair<Scalar, Scalar> * innerLL, std::pair<Scalar, Scalar> * outerLL) override;
+    
+    /**
+    * Computes the densities of all samples under the distributions fitted to each range of a batch, using the
+    * histograms obtained from the cumulative counts.
+    */
+    virtual void pdfs(const std::vector<IndexRange> & ranges, ScalarMatrix & innerPDF, ScalarMatrix & outerPDF) override;
+    
     /**
     * @return Returns the number of histograms in the ensemble.
     */
@@ -895,8 +1500,18 @@ protected:
     IntTensor::Sample m_hist_bins; /**< Number of bins in each individual histogram. */
     IntTensor::Sample m_hist_offsets; /**< Offsets of the first bin of each histogram in flat vectors. */
     std::shared_ptr<SparseMatrix> m_proj; /**< Sparse random projection vectors, one per row. */
-    std::shared_ptr<IntTensor> m_indices; /**< Indices of the bins which the samples passed to `init()` fall into. */
-    std::shared_ptr<IntTensor> m_counts; /**< Cumulative counts for the bins of all histograms. */
+    Sample m_proj_min; /**< Minimum of the projections of the samples onto each projection vector. */
+    Sample m_proj_scale; /**< Difference between the maximum and the minimum of the projections onto each projection vector. */
+    IntTensor::Sample m_min_time; /**< The last time step with a sample whose projection onto each projection vector equals `m_proj_min`. */
+    IntTensor::Sample m_max_time; /**< The last time step with a sample whose projection onto each projection vector equals the maximum. */
+    std::shared_ptr<BinIndexTensor> m_indices; /**< Indices of the bins which the samples passed to `init()` fall into. */
+    std::shared_ptr<BinIndexTensor> m_index_buffer; /**< Storage for `m_indices` maintained by `update()`, which may be larger than the data. */
+    std::shared_ptr<IntTensor> m_count_checkpoints; /**< Cumulative counts for the bins of all histograms before each block of time steps or, if there are no deltas, up to and including each time step. */
+    std::shared_ptr<CountDeltaTensor> m_count_deltas; /**< Cumulative counts for the bins of all histograms relative to the checkpoint of the respective block. */
+    DataTensor::Index m_block_length; /**< Number of time steps per block of cumulative counts. */
+    DataTensor::Index m_count_offset; /**< Index of the time step in the cumulative counts which corresponds to the first time step of the data. Only non-zero after `update()`. */
+    IntTensor::Sample m_count_base; /**< Cumulative counts preceding the data, which must be subtracted from counts starting at time 0 if `m_count_offset` is non-zero. */
+    IntTensor::Sample m_counts_total; /**< Flat vector of histogram bins over all samples passed to `init()`. */
     IntTensor::Sample m_hist_inner; /**< Flat vector of histogram bins for the data in the range passed to `fit()`. */
     IntTensor::Sample m_hist_outer; /**< Flat vector of histogram bins for the data outside of the range passed to `fit()`. */
     mutable Sample m_logprob_inner; /**< Flat vector of log-PDF estimates over the inner range for each bin of all histograms. */
@@ -913,6 +1528,72 @@ protected:
     * @return Returns a vector with the log-demoninator for each histogram.
     */
     const Sample & logDenomFromCache(DataTensor::Index n) const;
+    
+    /**
+    * Computes the cumulative counts of all bins from the samples passed to `init()`.
+    *
+    * Since the cumulative counts would take up a lot of memory, they are stored in a compact form: the time
+    * steps are divided into blocks, which are short enough so that the cumulative counts relative to the
+    * beginning of a block can be stored with 16 bit. The full cumulative counts are only stored once per block.
+    * If a single time step has too many locations for the compact counts, no deltas are stored and the full
+    * cumulative counts are stored for each time step instead. The histograms are processed in parallel.
+    *
+    * `m_indices`, `m_hist_bins` and `m_hist_offsets` must have been initialized.
+    */
+    void computeCumulativeCounts();
+    
+    /**
+    * Computes the cumulative counts of purely temporal data from a given time step on, assuming that the cumulative
+    * counts before that time step have already been computed. Time step `t` of the data corresponds to time step
+    * `m_count_offset + t` of the cumulative counts, which must be large enough to hold all time steps of the data.
+    *
+    * @param[in] first The first time step of the data whose cumulative counts are to be computed.
+    */
+    void appendCumulativeCounts(DataTensor::Index first);
+    
+    /**
+    * Projects a number of consecutive samples onto the projection vectors.
+    *
+    * The projections are computed sample by sample, so that the result for a given sample does not depend
+    * on the other samples projected along with it.
+    *
+    * @param[in] data The data.
+    *
+    * @param[in] first The index of the first sample to be projected.
+    *
+    * @param[out] projected A tensor with one attribute per projection vector, whose number of samples
+    * determines the number of samples to be projected.
+    */
+    void projectSamples(const DataTensor & data, DataTensor::Index first, DataTensor & projected) const;
+    
+    /**
+    * Makes sure that `m_log_cache` contains the logarithms for up to @p n samples.
+    */
+    void cacheLogarithms(DataTensor::Index n);
+    
+    /**
+    * Adds or subtracts the cumulative counts of all bins at a given position to or from a flat vector of
+    * histogram bins.
+    *
+    * @param[in] t The time step.
+    *
+    * @param[in] loc The linear index of the spatial location.
+    *
+    * @param[in] negative If set to `true`, the counts will be subtracted instead of added.
+    *
+    * @param[in,out] hist The flat vector of histogram bins to be updated.
+    */
+    void addCumulativeCounts(DataTensor::Index t, DataTensor::Index loc, bool negative, IntTensor::Sample & hist) const;
+    
+    /**
+    * Computes the histograms of the samples in a given range from the cumulative counts.
+    *
+    * @param[in] range The range.
+    *
+    * @param[out] hist Flat vector of histogram bins with as many elements as `m_counts_total`, which
+    * will receive the counts of the samples in the range.
+    */
+    void countRange(const IndexRange & range, IntTensor::Sample & hist) const;
 
 };
 
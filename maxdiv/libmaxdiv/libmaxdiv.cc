@@ -18,12 +18,270 @@
 #include "libmaxdiv.h"
 #include "search_strategies.h"
 #include "pointwise_detectors.h"
+#include "utils.h"
 #include <vector>
 #include <algorithm>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace MaxDiv;
 
 
-std::vector< std::shared_ptr<SearchStrategy> > maxdiv_pipelines;
+/**
+* A compiled pipeline together with a pool of execution contexts.
+*
+* The prototype is never used for searching directly. Each call to `maxdiv_exec()` takes an idle context
+* from the pool or clones the prototype if all contexts are busy and returns the context to the pool afterwards,
+* so that a pipeline can be executed concurrently from several threads while the number of clones is bounded
+* by the maximum number of concurrent calls.
+*/
+struct maxdiv_pipeline_t
+{
+    std::shared_ptr<SearchStrategy> prototype; /**< The pipeline as compiled by `maxdiv_compile_pipeline()`. */
+    std::vector< std::shared_ptr<SearchStrategy> > idleContexts; /**< Clones of the prototype not in use at the moment. */
+    std::mutex contextMutex; /**< Guards `idleContexts` and `stats`. */
+    SearchStatistics stats; /**< Statistics of all executions whose contexts have been returned to the pool. */
+    std::shared_ptr<StreamingSearch> stream; /**< Clone of the prototype holding the state of the stream (streaming pipelines only). */
+    std::mutex streamMutex; /**< Serializes operations on `stream`. */
+};
+
+
+/**
+* An asynchronous execution of a pipeline started by `maxdiv_exec_async()`.
+*
+* The thread performing the search only refers to this object by a raw pointer, since the object is destroyed
+* either by `maxdiv_wait()` after the thread has been joined or, if it has never been waited for, when the
+* library is unloaded, in which case the search is cancelled and joined by the destructor.
+*/
+struct maxdiv_job_t
+{
+    std::thread thread; /**< The thread performing the search. */
+    std::shared_ptr<SearchController> controller; /**< Controller attached to the execution context used by the search. */
+    DetectionList detections; /**< The detections found by the search, valid once `status` is not `MAXDIV_JOB_RUNNING`. */
+    std::atomic<maxdiv_job_status_t> status; /**< Status of the search, set by the thread when it is done. */
+    
+    maxdiv_job_t() : thread(), controller(nullptr), detections(), status(MAXDIV_JOB_RUNNING) {};
+    
+    ~maxdiv_job_t()
+    {
+        if (this->thread.joinable())
+        {
+            this->controller->cancel();
+            this->thread.join();
+        }
+    };
+};
+
+
+static const unsigned int MAXDIV_HANDLE_INDEX_BITS = 20;
+static const unsigned int MAXDIV_HANDLE_INDEX_MASK = (1u << MAXDIV_HANDLE_INDEX_BITS) - 1;
+static const unsigned int MAXDIV_HANDLE_GENERATION_MASK = (1u << (32 - MAXDIV_HANDLE_INDEX_BITS)) - 1;
+static const unsigned int MAXDIV_HANDLE_PAGE_BITS = 10;
+static const unsigned int MAXDIV_HANDLE_PAGE_SIZE = 1u << MAXDIV_HANDLE_PAGE_BITS;
+static const unsigned int MAXDIV_HANDLE_NUM_PAGES = 1u << (MAXDIV_HANDLE_INDEX_BITS - MAXDIV_HANDLE_PAGE_BITS);
+
+
+/**
+* Table of objects referred to by handles of the C interface. Freed slots are re-used by subsequently added objects.
+*
+* A handle consists of the index of a slot plus one and the generation counter of the slot, which is incremented
+* whenever the slot is freed, so that stale handles to freed objects do not refer to the object occupying the slot now.
+* A slot whose generation counter would wrap around is retired instead of being re-used, so that no handle is ever
+* valid again once its object has been removed.
+*
+* Looking up handles does not acquire any lock: The slots are allocated in pages which are never moved or freed as
+* long as the table exists, and the generation of a slot is checked before and after its object is read. Only adding
+* and removing objects is serialized by a mutex.
+*/
+template<class T>
+class maxdiv_handle_table_t
+{
+public:
+
+    maxdiv_handle_table_t() : m_numSlots(0)
+    {
+        for (std::atomic<Slot*> & page : this->m_pages)
+            page.store(nullptr);
+    };
+    
+    ~maxdiv_handle_table_t()
+    {
+        for (std::atomic<Slot*> & page : this->m_pages)
+            delete[] page.load();
+    };
+    
+    maxdiv_handle_table_t(const maxdiv_handle_table_t &) = delete;
+    maxdiv_handle_table_t & operator=(const maxdiv_handle_table_t &) = delete;
+    
+    /**
+    * @return Returns a handle to the given object or `0` if the table is full.
+    */
+    unsigned int add(const std::shared_ptr<T> & object)
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        unsigned int index;
+        if (!this->m_freeSlots.empty())
+        {
+            index = this->m_freeSlots.back();
+            this->m_freeSlots.pop_back();
+        }
+        else if (this->m_numSlots < MAXDIV_HANDLE_INDEX_MASK)
+        {
+            index = this->m_numSlots++;
+            if (index % MAXDIV_HANDLE_PAGE_SIZE == 0)
+                this->m_pages[index >> MAXDIV_HANDLE_PAGE_BITS].store(new Slot[MAXDIV_HANDLE_PAGE_SIZE]);
+        }
+        else
+            return 0;
+        Slot & slot = this->slot(index);
+        std::atomic_store(&slot.object, object);
+        return (slot.generation.load() << MAXDIV_HANDLE_INDEX_BITS) | (index + 1);
+    };
+    
+    /**
+    * @return Returns the object referred to by a handle or `NULL` if the handle is invalid.
+    */
+    std::shared_ptr<T> get(unsigned int handle) const
+    {
+        unsigned int index = (handle & MAXDIV_HANDLE_INDEX_MASK), generation = (handle >> MAXDIV_HANDLE_INDEX_BITS);
+        if (index == 0)
+            return nullptr;
+        const Slot * page = this->m_pages[(index - 1) >> MAXDIV_HANDLE_PAGE_BITS].load();
+        if (page == nullptr)
+            return nullptr;
+        
+        // The object is removed before the generation is incremented and a slot is only re-used afterwards.
+        // Thus, if the generation matches before and after reading the object, the object belongs to the handle.
+        const Slot & slot = page[(index - 1) % MAXDIV_HANDLE_PAGE_SIZE];
+        if (slot.generation.load() != generation)
+            return nullptr;
+        std::shared_ptr<T> object = std::atomic_load(&slot.object);
+        if (slot.generation.load() != generation)
+            return nullptr;
+        return object;
+    };
+    
+    /**
+    * Removes the object referred to by a handle from the table, so that the handle becomes invalid.
+    *
+    * @return Returns the removed object or `NULL` if the handle is invalid.
+    */
+    std::shared_ptr<T> remove(unsigned int handle)
+    {
+        unsigned int index = (handle & MAXDIV_HANDLE_INDEX_MASK), generation = (handle >> MAXDIV_HANDLE_INDEX_BITS);
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        if (index == 0 || index > this->m_numSlots)
+            return nullptr;
+        Slot & slot = this->slot(index - 1);
+        if (slot.generation.load() != generation)
+            return nullptr;
+        std::shared_ptr<T> object = std::atomic_exchange(&slot.object, std::shared_ptr<T>());
+        if (object)
+        {
+            // Retired slots get a generation which no handle can have
+            slot.generation.store(generation + 1);
+            if (generation < MAXDIV_HANDLE_GENERATION_MASK)
+                this->m_freeSlots.push_back(index - 1);
+        }
+        return object;
+    };
+
+
+protected:
+
+    struct Slot
+    {
+        std::shared_ptr<T> object; /**< Only accessed by the atomic operations for shared pointers. */
+        std::atomic<unsigned int> generation;
+        
+        Slot() : object(), generation(0) {};
+    };
+    
+    std::atomic<Slot*> m_pages[MAXDIV_HANDLE_NUM_PAGES]; /**< Pages of `MAXDIV_HANDLE_PAGE_SIZE` slots, allocated on demand. */
+    unsigned int m_numSlots; /**< Number of slots allocated so far. Guarded by `m_mutex`. */
+    std::vector<unsigned int> m_freeSlots; /**< Indices of free slots which may be re-used. Guarded by `m_mutex`. */
+    std::mutex m_mutex; /**< Serializes adding and removing objects. */
+    
+    Slot & slot(unsigned int index) { return this->m_pages[index >> MAXDIV_HANDLE_PAGE_BITS].load()[index % MAXDIV_HANDLE_PAGE_SIZE]; };
+
+};
+
+static maxdiv_handle_table_t<maxdiv_pipeline_t> maxdiv_pipelines;
+static maxdiv_handle_table_t<maxdiv_job_t> maxdiv_jobs; // destroyed before the pipelines, which running jobs may still use
+
+
+static std::shared_ptr<maxdiv_pipeline_t> get_pipeline(unsigned int handle)
+{
+    return maxdiv_pipelines.get(handle);
+}
+
+
+/**
+* Takes an execution context from the pool of a pipeline for the lifetime of this object.
+*/
+class maxdiv_context_guard_t
+{
+public:
+
+    /**
+    * @param[in] pipeline The pipeline to take an execution context from.
+    *
+    * @param[in] controller Optional controller attached to the context as long as it is taken.
+    */
+    maxdiv_context_guard_t(const std::shared_ptr<maxdiv_pipeline_t> & pipeline, const std::shared_ptr<SearchController> & controller = nullptr)
+    : m_pipeline(pipeline), m_context(nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pipeline->contextMutex);
+            if (!pipeline->idleContexts.empty())
+            {
+                this->m_context = pipeline->idleContexts.back();
+                pipeline->idleContexts.pop_back();
+            }
+        }
+        if (!this->m_context)
+            this->m_context = pipeline->prototype->clone();
+        this->m_context->setController(controller);
+    };
+    
+    ~maxdiv_context_guard_t()
+    {
+        this->m_context->setController(nullptr);
+        std::lock_guard<std::mutex> lock(this->m_pipeline->contextMutex);
+        this->m_pipeline->stats += this->m_context->getStatistics();
+        this->m_context->resetStatistics();
+        this->m_pipeline->idleContexts.push_back(this->m_context);
+    };
+    
+    SearchStrategy & operator*() const { return *(this->m_context); };
+
+protected:
+
+    std::shared_ptr<maxdiv_pipeline_t> m_pipeline;
+    std::shared_ptr<SearchStrategy> m_context;
+
+};
+
+
+static void copy_detections(const DetectionList & detections, detection_t * detection_buf, unsigned int * detection_buf_size)
+{
+    // Never write more detections than the buffer can hold
+    detection_t * raw_det = detection_buf, * raw_end = detection_buf + *detection_buf_size;
+    for (DetectionList::const_iterator det = detections.begin(); det != detections.end() && raw_det != raw_end; ++det, ++raw_det)
+    {
+        std::copy(det->a.ind, det->a.ind + MAXDIV_INDEX_DIMENSION - 1, raw_det->range_start);
+        std::copy(det->b.ind, det->b.ind + MAXDIV_INDEX_DIMENSION - 1, raw_det->range_end);
+        raw_det->score = det->score;
+    }
+    *detection_buf_size = raw_det - detection_buf;
+}
 
 
 void maxdiv_init_params(maxdiv_params_t * params)
@@ -77,6 +335,57 @@ void maxdiv_init_params(maxdiv_params_t * params)
     params->preproc.detrending.z_period_len = 0;
     params->preproc.dimensionality_reduction.method = MAXDIV_PROJECT_NONE;
     params->preproc.dimensionality_reduction.ndims = 0;
+    params->preproc.dimensionality_reduction.pca_solver = MAXDIV_PCA_DENSE;
+    params->preproc.dimensionality_reduction.pca_oversampling = 10;
+    params->preproc.dimensionality_reduction.pca_power_iterations = 4;
+    
+    // Parallelization Parameters
+    params->scheduling.mode = MAXDIV_SCHEDULE_STATIC;
+    params->scheduling.chunk_size = 0;
+    params->scheduling.num_partitions = 1;
+    params->scheduling.partition = 0;
+    
+    // Streaming Parameters
+    params->streaming.window_length = 0;
+    
+    // Additional Estimator Parameters
+    params->gaussian_block_size = 0;
+    params->kde_approx_rank = 0;
+    
+    // Multi-Resolution Search Parameters
+    params->multires.levels = 2;
+    params->multires.factor = 24;
+    
+    // Spatial Proposal Parameters
+    params->spatial_proposals.margin = SpatialRegionProposalGenerator::defaultParams.margin;
+    
+    // Pre-processing Cache Parameters
+    params->preproc_cache.directory = NULL;
+}
+
+
+/**
+* Computes a key identifying the pre-processing pipeline built from a set of parameters for `PreprocessingCache`.
+*/
+static uint64_t preproc_config_key(const maxdiv_params_t * params)
+{
+    const unsigned int fields[] = {
+        static_cast<unsigned int>(params->preproc.normalization),
+        params->preproc.embedding.kt, params->preproc.embedding.kx, params->preproc.embedding.ky, params->preproc.embedding.kz,
+        params->preproc.embedding.dt, params->preproc.embedding.dx, params->preproc.embedding.dy, params->preproc.embedding.dz,
+        static_cast<unsigned int>(params->preproc.embedding.temporal_borders), static_cast<unsigned int>(params->preproc.embedding.spatial_borders),
+        static_cast<unsigned int>(params->preproc.detrending.method), params->preproc.detrending.linear_degree,
+        params->preproc.detrending.ols_period_num, params->preproc.detrending.ols_period_len,
+        params->preproc.detrending.ols_linear_trend, params->preproc.detrending.ols_linear_season_trend,
+        params->preproc.detrending.z_period_len,
+        static_cast<unsigned int>(params->preproc.dimensionality_reduction.method), params->preproc.dimensionality_reduction.ndims,
+        static_cast<unsigned int>(params->preproc.dimensionality_reduction.pca_solver),
+        params->preproc.dimensionality_reduction.pca_oversampling, params->preproc.dimensionality_reduction.pca_power_iterations
+    };
+    uint64_t key = 0x6d61786469760001ULL; // "maxdiv" + version of the layout of this key (see also MAXDIV_PREPROC_CACHE_VERSION)
+    for (unsigned int field : fields)
+        key = hashCombine(key, field);
+    return key;
 }
 
 
@@ -85,7 +394,14 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
     if (params == NULL)
         return 0;
     
-    if (params->strategy != MAXDIV_PROPOSAL_SEARCH)
+    if (params->strategy != MAXDIV_PROPOSAL_SEARCH && params->strategy != MAXDIV_STREAMING_SEARCH
+            && params->strategy != MAXDIV_BRANCH_AND_BOUND_SEARCH && params->strategy != MAXDIV_MULTIRES_SEARCH)
+        return 0;
+    if ((params->strategy == MAXDIV_BRANCH_AND_BOUND_SEARCH || params->strategy == MAXDIV_MULTIRES_SEARCH) && params->proposal_generator != MAXDIV_DENSE_PROPOSALS)
+        return 0;
+    if (params->strategy == MAXDIV_MULTIRES_SEARCH && (params->multires.levels == 0 || params->multires.factor < 2))
+        return 0;
+    if (params->strategy == MAXDIV_STREAMING_SEARCH && params->streaming.window_length == 0)
         return 0;
     
     // Create density estimator
@@ -94,10 +410,14 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
     switch (params->estimator)
         {
             case MAXDIV_KDE:
-                densityEstimator = std::make_shared<KernelDensityEstimator>(params->kernel_sigma_sq);
+                {
+                    std::shared_ptr<KernelDensityEstimator> kde = std::make_shared<KernelDensityEstimator>(params->kernel_sigma_sq);
+                    kde->setApproximationRank(params->kde_approx_rank);
+                    densityEstimator = kde;
+                }
                 break;
             case MAXDIV_GAUSSIAN:
-                densityEstimator = std::make_shared<GaussianDensityEstimator>(gaussian_cov_mode);
+                densityEstimator = std::make_shared<GaussianDensityEstimator>(gaussian_cov_mode, params->gaussian_block_size);
                 break;
             case MAXDIV_ERPH:
                 densityEstimator = std::make_shared<EnsembleOfRandomProjectionHistograms>(params->erph.num_hist, params->erph.num_bins, params->erph.discount);
@@ -137,6 +457,10 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
     ppParams.sd_th = params->pointwise_proposals.sd_th;
     MaxDivScalar ppKernelSigmaSq = params->pointwise_proposals.kernel_sigma_sq;
     
+    SpatialRegionProposalGenerator::Params spParams;
+    spParams.sd_th = params->pointwise_proposals.sd_th;
+    spParams.margin = params->spatial_proposals.margin;
+    
     switch (params->proposal_generator)
     {
         case MAXDIV_DENSE_PROPOSALS:
@@ -153,6 +477,16 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
             proposals = std::make_shared<PointwiseProposalGenerator>(lengthRange, ppParams);
             break;
         
+        case MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST:
+            spParams.scorer = &hotellings_t;
+            proposals = std::make_shared<SpatialRegionProposalGenerator>(lengthRange, spParams);
+            break;
+        
+        case MAXDIV_SPATIAL_PROPOSALS_KDE:
+            spParams.scorer = [ppKernelSigmaSq](const DataTensor & data) { return pointwise_kde(data, ppKernelSigmaSq); };
+            proposals = std::make_shared<SpatialRegionProposalGenerator>(lengthRange, spParams);
+            break;
+        
         default:
             return 0;
     }
@@ -222,7 +556,14 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
             case MAXDIV_PROJECT_NONE:
                 break;
             case MAXDIV_PROJECT_PCA:
-                preproc->push_back(std::make_shared<PCAProjection>(params->preproc.dimensionality_reduction.ndims));
+                if (params->preproc.dimensionality_reduction.pca_solver < MAXDIV_PCA_AUTO || params->preproc.dimensionality_reduction.pca_solver > MAXDIV_PCA_RANDOMIZED)
+                    return 0;
+                preproc->push_back(std::make_shared<PCAProjection>(
+                    params->preproc.dimensionality_reduction.ndims,
+                    static_cast<PCAProjection::Solver>(params->preproc.dimensionality_reduction.pca_solver),
+                    params->preproc.dimensionality_reduction.pca_oversampling,
+                    params->preproc.dimensionality_reduction.pca_power_iterations
+                ));
                 break;
             case MAXDIV_PROJECT_RANDOM:
                 preproc->push_back(std::make_shared<SparseRandomProjection>(params->preproc.dimensionality_reduction.ndims));
@@ -232,69 +573,505 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params)
         }
     
     // Put everything together and construct the SearchStrategy
-    std::shared_ptr<ProposalSearch> detector = std::make_shared<ProposalSearch>(divergence, proposals, preproc);
+    std::shared_ptr<SearchStrategy> detector;
+    if (params->strategy == MAXDIV_BRANCH_AND_BOUND_SEARCH)
+        detector = std::make_shared<BranchAndBoundSearch>(divergence, lengthRange, preproc);
+    else if (params->strategy == MAXDIV_MULTIRES_SEARCH)
+        detector = std::make_shared<MultiResolutionSearch>(divergence, lengthRange, params->multires.levels, params->multires.factor, preproc);
+    else
+    {
+        std::shared_ptr<ProposalSearch> proposalSearch;
+        if (params->strategy == MAXDIV_STREAMING_SEARCH)
+            proposalSearch = std::make_shared<StreamingSearch>(divergence, proposals, params->streaming.window_length);
+        else
+            proposalSearch = std::make_shared<ProposalSearch>(divergence, proposals, preproc);
+        switch (params->scheduling.mode)
+        {
+            case MAXDIV_SCHEDULE_STATIC:
+                proposalSearch->setScheduling(ProposalSearch::Scheduling::STATIC);
+                break;
+            case MAXDIV_SCHEDULE_DYNAMIC:
+                proposalSearch->setScheduling(ProposalSearch::Scheduling::DYNAMIC, params->scheduling.chunk_size);
+                break;
+            default:
+                return 0;
+        }
+        if (params->scheduling.num_partitions == 0 || params->scheduling.partition >= params->scheduling.num_partitions)
+            return 0;
+        if (params->strategy == MAXDIV_PROPOSAL_SEARCH)
+            proposalSearch->setPartition(params->scheduling.num_partitions, params->scheduling.partition);
+        detector = proposalSearch;
+    }
     detector->setOverlapTh(params->overlap_th);
-    maxdiv_pipelines.push_back(detector);
-    return maxdiv_pipelines.size();
+    if (params->preproc_cache.directory != NULL && params->preproc_cache.directory[0] != '\0' && !preproc->empty())
+        detector->setPreprocessingCache(std::make_shared<PreprocessingCache>(params->preproc_cache.directory, preproc_config_key(params)));
+    
+    std::shared_ptr<maxdiv_pipeline_t> pipeline = std::make_shared<maxdiv_pipeline_t>();
+    pipeline->prototype = detector;
+    if (params->strategy == MAXDIV_STREAMING_SEARCH)
+        pipeline->stream = std::static_pointer_cast<StreamingSearch>(detector->clone());
+    return maxdiv_pipelines.add(pipeline);
 }
 
 
 void maxdiv_free_pipeline(unsigned int handle)
 {
-    if (handle <= maxdiv_pipelines.size())
-        maxdiv_pipelines[handle - 1].reset();
+    // Running calls keep their own reference to the pipeline, so it will be destroyed when they are done
+    maxdiv_pipelines.remove(handle);
+}
+
+
+static DetectionList search_pipeline(SearchStrategy & detector, MaxDivScalar * data, const ReflessIndexVector & dataShape,
+                                     unsigned int max_detections, bool const_data, bool custom_missing_value, MaxDivScalar missing_value,
+                                     const std::shared_ptr<DataTensor> & workspace)
+{
+    DetectionList detections;
+    if (const_data)
+    {
+        std::shared_ptr<const DataTensor> data_view = std::make_shared<const DataTensor>(data, dataShape);
+        if (custom_missing_value)
+        {
+            // Masking a custom missing value modifies the data, so we have to work on a copy
+            std::shared_ptr<DataTensor> data_tensor = (workspace) ? workspace : std::make_shared<DataTensor>();
+            *data_tensor = *data_view;
+            data_tensor->mask(missing_value);
+            detections = detector(data_tensor, max_detections);
+        }
+        else
+            detections = detector(data_view, workspace, max_detections);
+    }
+    else
+    {
+        std::shared_ptr<DataTensor> data_tensor(new DataTensor(data, dataShape));
+        if (custom_missing_value)
+            data_tensor->mask(missing_value);
+        detections = detector(data_tensor, max_detections);
+    }
+    return detections;
+}
+
+
+static void run_pipeline(SearchStrategy & detector, MaxDivScalar * data, const ReflessIndexVector & dataShape,
+                         detection_t * detection_buf, unsigned int * detection_buf_size,
+                         bool const_data, bool custom_missing_value, MaxDivScalar missing_value,
+                         const std::shared_ptr<DataTensor> & workspace)
+{
+    DetectionList detections = search_pipeline(detector, data, dataShape, *detection_buf_size,
+                                               const_data, custom_missing_value, missing_value, workspace);
+    
+    // Copy detections to the buffer
+    copy_detections(detections, detection_buf, detection_buf_size);
+}
+
+
+static void exec_pipeline(unsigned int pipeline, MaxDivScalar * data, const unsigned int * shape,
+                          detection_t * detection_buf, unsigned int * detection_buf_size,
+                          bool const_data, bool custom_missing_value, MaxDivScalar missing_value,
+                          const std::shared_ptr<DataTensor> & workspace)
+{
+    if (detection_buf_size == NULL || *detection_buf_size == 0)
+        return;
+    
+    // Determine data shape
+    ReflessIndexVector dataShape;
+    if (shape != NULL)
+        std::copy(shape, shape + MAXDIV_INDEX_DIMENSION, dataShape.ind);
+    
+    // Check parameters
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || data == NULL || shape == NULL || dataShape.prod() == 0)
+    {
+        *detection_buf_size = 0;
+        return;
+    }
+    
+    // Run detection pipeline in an execution context of our own
+    maxdiv_context_guard_t detector(compiledPipeline);
+    run_pipeline(*detector, data, dataShape, detection_buf, detection_buf_size,
+                 const_data, custom_missing_value, missing_value, workspace);
 }
 
 
 void maxdiv_exec(unsigned int pipeline, MaxDivScalar * data, const unsigned int * shape,
                  detection_t * detection_buf, unsigned int * detection_buf_size,
                  bool const_data, bool custom_missing_value, MaxDivScalar missing_value)
+{
+    exec_pipeline(pipeline, data, shape, detection_buf, detection_buf_size, const_data, custom_missing_value, missing_value, nullptr);
+}
+
+
+void maxdiv_exec_workspace(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                           detection_t * detection_buf, unsigned int * detection_buf_size,
+                           MaxDivScalar * workspace, size_t workspace_size,
+                           bool custom_missing_value, MaxDivScalar missing_value)
+{
+    std::shared_ptr<DataTensor> workspace_tensor;
+    if (workspace != NULL && workspace_size > 0)
+        workspace_tensor = std::make_shared<DataTensor>(workspace, ReflessIndexVector(workspace_size, 1, 1, 1, 1));
+    exec_pipeline(pipeline, const_cast<MaxDivScalar*>(data), shape, detection_buf, detection_buf_size,
+                  true, custom_missing_value, missing_value, workspace_tensor);
+}
+
+
+void maxdiv_exec_strided(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape, const ptrdiff_t * strides,
+                         detection_t * detection_buf, unsigned int * detection_buf_size,
+                         bool custom_missing_value, MaxDivScalar missing_value)
 {
     if (detection_buf_size == NULL || *detection_buf_size == 0)
         return;
     
-    // Determine data shape
+    // Determine data shape and check if the data are layed out contiguously
     ReflessIndexVector dataShape;
     if (shape != NULL)
         std::copy(shape, shape + MAXDIV_INDEX_DIMENSION, dataShape.ind);
+    bool contiguous = true;
+    if (strides != NULL)
+    {
+        ptrdiff_t contiguousStride = 1;
+        for (int d = MAXDIV_INDEX_DIMENSION - 1; d >= 0; --d)
+        {
+            if (dataShape.ind[d] > 1 && strides[d] != contiguousStride)
+                contiguous = false;
+            contiguousStride *= static_cast<ptrdiff_t>(dataShape.ind[d]);
+        }
+    }
     
-    // Check parameters
-    if (pipeline == 0 || pipeline > maxdiv_pipelines.size() || !maxdiv_pipelines[pipeline - 1] || data == NULL || shape == NULL || dataShape.prod() == 0)
+    if (contiguous || data == NULL || shape == NULL || dataShape.prod() == 0)
+    {
+        exec_pipeline(pipeline, const_cast<MaxDivScalar*>(data), shape, detection_buf, detection_buf_size,
+                      true, custom_missing_value, missing_value, nullptr);
+        return;
+    }
+    
+    if (!get_pipeline(pipeline))
     {
         *detection_buf_size = 0;
         return;
     }
     
-    // Run detection pipeline
-    DetectionList detections;
-    if (const_data)
+    // Gather the data into a buffer of our own, which can be masked and pre-processed in-place
+    DataTensor data_tensor(dataShape);
+    MaxDivScalar * dest = data_tensor.raw();
+    const long numRows = static_cast<long>(dataShape.prod(0, MAXDIV_INDEX_DIMENSION - 2));
+    const DataTensor::Index nx = dataShape.x, ny = dataShape.y, nz = dataShape.z, nd = dataShape.d;
+    long row;
+    #pragma omp parallel for if(numRows * nd >= 1000000)
+    for (row = 0; row < numRows; ++row)
     {
-        if (custom_missing_value)
+        DataTensor::Index r = static_cast<DataTensor::Index>(row);
+        const MaxDivScalar * src = data + static_cast<ptrdiff_t>(r / (nx * ny * nz)) * strides[0]
+                                        + static_cast<ptrdiff_t>((r / (ny * nz)) % nx) * strides[1]
+                                        + static_cast<ptrdiff_t>((r / nz) % ny) * strides[2]
+                                        + static_cast<ptrdiff_t>(r % nz) * strides[3];
+        MaxDivScalar * rowDest = dest + r * nd;
+        for (DataTensor::Index d = 0; d < nd; ++d, src += strides[4])
+            rowDest[d] = *src;
+    }
+    
+    exec_pipeline(pipeline, data_tensor.raw(), shape, detection_buf, detection_buf_size,
+                  false, custom_missing_value, missing_value, nullptr);
+}
+
+
+void maxdiv_merge_detections(unsigned int pipeline, unsigned int num_lists, const detection_t * const * lists, const unsigned int * list_sizes,
+                             detection_t * detection_buf, unsigned int * detection_buf_size, bool keep_suppressed)
+{
+    if (detection_buf_size == NULL || *detection_buf_size == 0)
+        return;
+    
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || detection_buf == NULL || (num_lists > 0 && (lists == NULL || list_sizes == NULL)))
+    {
+        *detection_buf_size = 0;
+        return;
+    }
+    
+    // Convert the detections of all lists, which may overlap each other if they contain suppressed detections
+    // of previous merges, and merge them at once
+    DetectionList candidates;
+    for (unsigned int i = 0; i < num_lists; ++i)
+        if (lists[i] != NULL)
+            for (const detection_t * det = lists[i]; det != lists[i] + list_sizes[i]; ++det)
+            {
+                IndexVector a(det->range_start[0], det->range_start[1], det->range_start[2], det->range_start[3], 0);
+                IndexVector b(det->range_end[0], det->range_end[1], det->range_end[2], det->range_end[3], 1);
+                candidates.push_back(Detection(a, b, det->score));
+            }
+    MaximumDetectionList merged(*detection_buf_size, compiledPipeline->prototype->getOverlapTh());
+    merged.mergeCandidates(candidates);
+    
+    // Copy detections to the buffer, followed by the suppressed ones for further merges
+    DetectionList detections(merged.begin(), merged.end());
+    if (keep_suppressed)
+        detections.insert(detections.end(), merged.getSuppressed().begin(), merged.getSuppressed().end());
+    copy_detections(detections, detection_buf, detection_buf_size);
+}
+
+
+void maxdiv_exec_batch(unsigned int pipeline, unsigned int num_series, MaxDivScalar * const * data, const unsigned int * shapes,
+                       detection_t * detection_buf, unsigned int max_detections, unsigned int * num_detections,
+                       bool const_data, bool custom_missing_value, MaxDivScalar missing_value)
+{
+    if (num_detections == NULL || num_series == 0)
+        return;
+    std::fill(num_detections, num_detections + num_series, 0);
+    
+    // Check parameters
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || data == NULL || shapes == NULL || detection_buf == NULL || max_detections == 0)
+        return;
+    
+    // Split the series up into small ones, which are distributed among the threads, and large ones,
+    // which are processed one after another with all threads working on each of them
+    std::vector<ReflessIndexVector> seriesShapes(num_series);
+    std::vector<unsigned int> smallSeries, largeSeries;
+    for (unsigned int i = 0; i < num_series; ++i)
+    {
+        std::copy(shapes + i * MAXDIV_INDEX_DIMENSION, shapes + (i + 1) * MAXDIV_INDEX_DIMENSION, seriesShapes[i].ind);
+        if (data[i] == NULL || seriesShapes[i].prod() == 0)
+            continue;
+        if (seriesShapes[i].prod(0, MAXDIV_INDEX_DIMENSION - 2) < MAXDIV_BATCH_INNER_PARALLEL_SIZE)
+            smallSeries.push_back(i);
+        else
+            largeSeries.push_back(i);
+    }
+    
+    // Process small series in parallel. Each thread uses a single execution context and workspace for all
+    // of its series, so that the clones of the divergence and their buffers are re-used across the batch.
+    if (!smallSeries.empty())
+    {
+        long numSmallSeries = static_cast<long>(smallSeries.size());
+        #pragma omp parallel if(numSmallSeries > 1)
         {
-            std::shared_ptr<DataTensor> data_tensor(new DataTensor(DataTensor(data, dataShape)));
-            data_tensor->mask(missing_value);
-            detections = (*(maxdiv_pipelines[pipeline - 1]))(data_tensor, *detection_buf_size);
+            #ifdef _OPENMP
+            if (omp_get_num_threads() > 1)
+                omp_set_num_threads(1); // prevent each series from forking threads of its own
+            #endif
+            std::unique_ptr<maxdiv_context_guard_t> detector;
+            std::shared_ptr<DataTensor> workspace = std::make_shared<DataTensor>();
+            long s;
+            #pragma omp for schedule(dynamic)
+            for (s = 0; s < numSmallSeries; ++s)
+            {
+                if (!detector)
+                    detector.reset(new maxdiv_context_guard_t(compiledPipeline));
+                unsigned int i = smallSeries[s];
+                num_detections[i] = max_detections;
+                run_pipeline(**detector, data[i], seriesShapes[i], detection_buf + static_cast<std::size_t>(i) * max_detections,
+                             num_detections + i, const_data, custom_missing_value, missing_value, workspace);
+            }
         }
+    }
+    
+    // Process large series sequentially with inner parallelism
+    if (!largeSeries.empty())
+    {
+        maxdiv_context_guard_t detector(compiledPipeline);
+        std::shared_ptr<DataTensor> workspace = std::make_shared<DataTensor>();
+        for (std::vector<unsigned int>::const_iterator i = largeSeries.begin(); i != largeSeries.end(); ++i)
+        {
+            num_detections[*i] = max_detections;
+            run_pipeline(*detector, data[*i], seriesShapes[*i], detection_buf + static_cast<std::size_t>(*i) * max_detections,
+                         num_detections + *i, const_data, custom_missing_value, missing_value, workspace);
+        }
+    }
+}
+
+
+unsigned int maxdiv_exec_async(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                               unsigned int max_detections, double timeout,
+                               maxdiv_progress_callback_t progress_callback, void * user_data,
+                               bool custom_missing_value, MaxDivScalar missing_value)
+{
+    // Determine data shape
+    ReflessIndexVector dataShape;
+    if (shape != NULL)
+        std::copy(shape, shape + MAXDIV_INDEX_DIMENSION, dataShape.ind);
+    
+    // Check parameters
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || data == NULL || shape == NULL || dataShape.prod() == 0 || max_detections == 0)
+        return 0;
+    
+    // Set up the controller, whose deadline is relative to this call
+    std::shared_ptr<maxdiv_job_t> job = std::make_shared<maxdiv_job_t>();
+    job->controller = std::make_shared<SearchController>(timeout);
+    if (progress_callback != NULL)
+        job->controller->setProgressCallback([progress_callback, user_data](Scalar progress) { progress_callback(progress, user_data); });
+    
+    unsigned int handle = maxdiv_jobs.add(job);
+    if (handle == 0)
+        return 0;
+    
+    // Run detection pipeline in an execution context of our own in the background
+    maxdiv_job_t * jobPtr = job.get();
+    try
+    {
+        job->thread = std::thread([jobPtr, compiledPipeline, data, dataShape, max_detections, custom_missing_value, missing_value]()
+        {
+            try
+            {
+                maxdiv_context_guard_t detector(compiledPipeline, jobPtr->controller);
+                jobPtr->detections = search_pipeline(*detector, const_cast<MaxDivScalar*>(data), dataShape, max_detections,
+                                                     true, custom_missing_value, missing_value, nullptr);
+                jobPtr->status = (jobPtr->controller->isPartial()) ? MAXDIV_JOB_PARTIAL : MAXDIV_JOB_COMPLETE;
+            }
+            catch (const std::exception &)
+            {
+                jobPtr->detections.clear();
+                jobPtr->status = MAXDIV_JOB_FAILED;
+            }
+        });
+    }
+    catch (const std::system_error &)
+    {
+        maxdiv_jobs.remove(handle);
+        return 0;
+    }
+    return handle;
+}
+
+
+void maxdiv_cancel(unsigned int job)
+{
+    std::shared_ptr<maxdiv_job_t> asyncJob = maxdiv_jobs.get(job);
+    if (asyncJob)
+        asyncJob->controller->cancel();
+}
+
+
+maxdiv_job_status_t maxdiv_job_status(unsigned int job)
+{
+    std::shared_ptr<maxdiv_job_t> asyncJob = maxdiv_jobs.get(job);
+    return (asyncJob) ? asyncJob->status.load() : MAXDIV_JOB_INVALID;
+}
+
+
+maxdiv_job_status_t maxdiv_wait(unsigned int job, detection_t * detection_buf, unsigned int * detection_buf_size)
+{
+    // Removing the job first ensures that it is waited for only once
+    std::shared_ptr<maxdiv_job_t> asyncJob = maxdiv_jobs.remove(job);
+    maxdiv_job_status_t status = MAXDIV_JOB_INVALID;
+    if (asyncJob)
+    {
+        asyncJob->thread.join();
+        status = asyncJob->status;
+    }
+    
+    if (detection_buf_size != NULL)
+    {
+        if (detection_buf != NULL && (status == MAXDIV_JOB_COMPLETE || status == MAXDIV_JOB_PARTIAL))
+            copy_detections(asyncJob->detections, detection_buf, detection_buf_size);
         else
-            detections = (*(maxdiv_pipelines[pipeline - 1]))(std::make_shared<const DataTensor>(data, dataShape), *detection_buf_size);
+            *detection_buf_size = 0;
+    }
+    return status;
+}
+
+
+bool maxdiv_stream_push(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                        bool custom_missing_value, MaxDivScalar missing_value)
+{
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || !compiledPipeline->stream || data == NULL || shape == NULL)
+        return false;
+    
+    ReflessIndexVector dataShape;
+    std::copy(shape, shape + MAXDIV_INDEX_DIMENSION, dataShape.ind);
+    if (dataShape.prod() == 0)
+        return true;
+    
+    // The data are only read by push(), but masking requires a copy
+    const DataTensor dataView(const_cast<MaxDivScalar*>(data), dataShape);
+    std::lock_guard<std::mutex> lock(compiledPipeline->streamMutex);
+    if (custom_missing_value)
+    {
+        DataTensor samples(dataView);
+        samples.mask(missing_value);
+        return compiledPipeline->stream->push(samples);
     }
     else
+        return compiledPipeline->stream->push(dataView);
+}
+
+
+void maxdiv_stream_poll(unsigned int pipeline, detection_t * detection_buf, unsigned int * detection_buf_size)
+{
+    if (detection_buf_size == NULL || *detection_buf_size == 0)
+        return;
+    
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || !compiledPipeline->stream || detection_buf == NULL)
     {
-        std::shared_ptr<DataTensor> data_tensor(new DataTensor(data, dataShape));
-        if (custom_missing_value)
-            data_tensor->mask(missing_value);
-        detections = (*(maxdiv_pipelines[pipeline - 1]))(data_tensor, *detection_buf_size);
+        *detection_buf_size = 0;
+        return;
     }
     
-    // Copy detections to the buffer
-    detection_t * raw_det = detection_buf;
-    for (DetectionList::const_iterator det = detections.begin(); det != detections.end(); ++det, ++raw_det)
+    std::lock_guard<std::mutex> lock(compiledPipeline->streamMutex);
+    copy_detections(compiledPipeline->stream->poll(*detection_buf_size), detection_buf, detection_buf_size);
+}
+
+
+void maxdiv_stream_reset(unsigned int pipeline)
+{
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (compiledPipeline && compiledPipeline->stream)
     {
-        std::copy(det->a.ind, det->a.ind + MAXDIV_INDEX_DIMENSION - 1, raw_det->range_start);
-        std::copy(det->b.ind, det->b.ind + MAXDIV_INDEX_DIMENSION - 1, raw_det->range_end);
-        raw_det->score = det->score;
+        std::lock_guard<std::mutex> lock(compiledPipeline->streamMutex);
+        compiledPipeline->stream->resetStream();
+    }
+}
+
+
+bool maxdiv_get_stats(unsigned int pipeline, maxdiv_stats_t * stats,
+                      unsigned long long * thread_proposals, double * thread_time, unsigned int * num_threads,
+                      bool reset)
+{
+    std::shared_ptr<maxdiv_pipeline_t> compiledPipeline = get_pipeline(pipeline);
+    if (!compiledPipeline || stats == NULL)
+        return false;
+    
+    // Collect statistics of finished executions and of the stream
+    SearchStatistics searchStats;
+    {
+        std::lock_guard<std::mutex> lock(compiledPipeline->contextMutex);
+        searchStats = compiledPipeline->stats;
+        if (reset)
+            compiledPipeline->stats = SearchStatistics();
+    }
+    if (compiledPipeline->stream)
+    {
+        std::lock_guard<std::mutex> lock(compiledPipeline->streamMutex);
+        searchStats += compiledPipeline->stream->getStatistics();
+        if (reset)
+            compiledPipeline->stream->resetStatistics();
+    }
+    
+    // Copy statistics to the C structures
+    stats->num_searches = searchStats.numSearches;
+    stats->num_proposals = searchStats.numProposals;
+    stats->num_fits = searchStats.estimator.numFits;
+    stats->num_incremental_fits = searchStats.estimator.numIncrementalFits;
+    stats->num_cache_fallbacks = searchStats.estimator.numCacheFallbacks;
+    stats->cumulative_memory = searchStats.estimator.cumulativeMemory;
+    stats->preprocessing_time = searchStats.preprocessingTime;
+    stats->init_time = searchStats.initTime;
+    stats->proposal_time = searchStats.proposalTime;
+    stats->scoring_time = searchStats.scoringTime;
+    stats->nms_time = searchStats.nmsTime;
+    stats->total_time = searchStats.totalTime;
+    stats->num_preproc_cache_hits = searchStats.numPreprocCacheHits;
+    stats->num_partial_searches = searchStats.numPartialSearches;
+    if (num_threads != NULL)
+    {
+        std::size_t numCopied = std::min(static_cast<std::size_t>(*num_threads), searchStats.threadProposals.size());
+        if (thread_proposals != NULL)
+            std::copy(searchStats.threadProposals.begin(), searchStats.threadProposals.begin() + numCopied, thread_proposals);
+        if (thread_time != NULL)
+            std::copy(searchStats.threadTime.begin(), searchStats.threadTime.begin() + numCopied, thread_time);
+        *num_threads = searchStats.threadProposals.size();
     }
-    *detection_buf_size = detections.size();
+    return true;
 }
 
 
@@ -27,6 +27,7 @@
 #define LIBMAXDIV
 
 #include "config.h"
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -44,7 +45,13 @@ typedef struct {
 } detection_t;
 
 
-enum maxdiv_search_strategy_t { MAXDIV_PROPOSAL_SEARCH };
+enum maxdiv_search_strategy_t
+{
+    MAXDIV_PROPOSAL_SEARCH, /**< Search over proposed ranges in a given data set */
+    MAXDIV_STREAMING_SEARCH, /**< Search over proposed ranges in a sliding window over a stream of data (see `maxdiv_stream_push()`) */
+    MAXDIV_BRANCH_AND_BOUND_SEARCH, /**< Exact search over all ranges which skips groups of ranges by means of upper bounds on their scores. Requires `MAXDIV_DENSE_PROPOSALS`. */
+    MAXDIV_MULTIRES_SEARCH /**< Approximate coarse-to-fine search on a temporal pyramid of the data (see `maxdiv_params_t::multires`). Requires `MAXDIV_DENSE_PROPOSALS`. */
+};
 
 enum maxdiv_divergence_t
 {
@@ -64,7 +71,9 @@ enum maxdiv_proposal_generator_t
 {
     MAXDIV_DENSE_PROPOSALS, /**< Dense Proposals (proposes every possible range) */
     MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST, /**< Proposals based an point-wise Hotelling's T^2 scores */
-    MAXDIV_POINTWISE_PROPOSALS_KDE /**< Proposals based an point-wise KDE scores */
+    MAXDIV_POINTWISE_PROPOSALS_KDE, /**< Proposals based an point-wise KDE scores */
+    MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST, /**< Dense proposals limited to spatial regions of high point-wise Hotelling's T^2 scores (see `maxdiv_params_t::spatial_proposals`) */
+    MAXDIV_SPATIAL_PROPOSALS_KDE /**< Dense proposals limited to spatial regions of high point-wise KDE scores (see `maxdiv_params_t::spatial_proposals`) */
 };
 
 enum maxdiv_kl_mode_t
@@ -112,6 +121,19 @@ enum maxdiv_projection_method_t
     MAXDIV_PROJECT_RANDOM   /**< Project data onto sparse random projection vectors */
 };
 
+enum maxdiv_pca_solver_t
+{
+    MAXDIV_PCA_AUTO,        /**< Use the randomized solver if the number of principal components is much smaller than the number of attributes */
+    MAXDIV_PCA_DENSE,       /**< Decompose the entire covariance matrix */
+    MAXDIV_PCA_RANDOMIZED   /**< Approximate the leading principal components by randomized subspace iteration without computing the covariance matrix */
+};
+
+enum maxdiv_scheduling_t
+{
+    MAXDIV_SCHEDULE_STATIC, /**< Each thread processes an equally sized, contiguous slice of start points. */
+    MAXDIV_SCHEDULE_DYNAMIC /**< Idle threads fetch chunks of start points from a shared work queue. */
+};
+
 
 typedef struct {
     
@@ -131,7 +153,7 @@ typedef struct {
         bool mad; /**< Specifies whether to use *Median Absolute Deviation (MAD)* for a robust computation of mean and standard deviation of the scores. */
         MaxDivScalar sd_th; /**< Thresholds for scores will be `mean + sd_th * standard_deviation`. */
         MaxDivScalar kernel_sigma_sq; /**< The variance of the Gauss kernel used by KDE. */
-    } pointwise_proposals; /**< Parameters for the proposal generator if `strategy` is `MAXDIV_PROPOSAL_SEARCH` and `proposal_generator` is `MAXDIV_POINTWISE_PROPOSALS_*`. */
+    } pointwise_proposals; /**< Parameters for the proposal generator if `strategy` is `MAXDIV_PROPOSAL_SEARCH` and `proposal_generator` is `MAXDIV_POINTWISE_PROPOSALS_*`. `sd_th` and `kernel_sigma_sq` also apply to `MAXDIV_SPATIAL_PROPOSALS_*`. */
     
     /* Divergence Parameters */
     maxdiv_kl_mode_t kl_mode; /**< Variant of the KL divergence. */
@@ -180,12 +202,98 @@ typedef struct {
         {
             maxdiv_projection_method_t method; /**< Dimensionality reduction method */
             unsigned int ndims; /**< New number of dimensions. */
+            maxdiv_pca_solver_t pca_solver; /**< Eigensolver used to compute the principal components for `MAXDIV_PROJECT_PCA`. Defaults to `MAXDIV_PCA_DENSE`. */
+            unsigned int pca_oversampling; /**< Number of additional basis vectors used by the randomized PCA solver. */
+            unsigned int pca_power_iterations; /**< Number of subspace iterations performed by the randomized PCA solver. */
         } dimensionality_reduction; /**< Parameters for dimensionality reduction. */
     } preproc; /**< Preprocessing parameters */
     
+    /* Parallelization Parameters */
+    struct
+    {
+        maxdiv_scheduling_t mode; /**< Strategy used to distribute the start points of the proposed ranges among threads. */
+        unsigned int chunk_size; /**< Number of start points per chunk for `MAXDIV_SCHEDULE_DYNAMIC` (0 = determine automatically). */
+        unsigned int num_partitions; /**< Number of partitions the start points are divided into for distributing the search among several processes. See `maxdiv_merge_detections()`. */
+        unsigned int partition; /**< Index of the partition of start points searched by the pipeline. Must be less than `num_partitions`. */
+    } scheduling; /**< Parameters regarding the distribution of work among threads if `strategy` is `MAXDIV_PROPOSAL_SEARCH`. */
+    
+    /* Streaming Parameters */
+    struct
+    {
+        unsigned int window_length; /**< Maximum number of time steps in the sliding window. */
+    } streaming; /**< Parameters for the sliding window if `strategy` is `MAXDIV_STREAMING_SEARCH`. Pre-processing is not applied in that case. */
+    
+    /* Additional Estimator Parameters */
+    unsigned int gaussian_block_size; /**< If greater than 0, `MAXDIV_GAUSSIAN` with `MAXDIV_GAUSSIAN_COV_FULL` stores sums of outer products only every `gaussian_block_size` time steps instead of for every time step, which reduces memory consumption at the cost of up to `2 * (gaussian_block_size - 1)` explicit outer products per interval. */
+    unsigned int kde_approx_rank; /**< If greater than 0, `MAXDIV_KDE` approximates the kernel matrix by a factorization of rank up to `kde_approx_rank` for data with more than `MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT` samples, which allows using cumulative sums of the factors instead of summing over all samples explicitly. Higher values give a better approximation. */
+    
+    /* Multi-Resolution Search Parameters */
+    struct
+    {
+        unsigned int levels; /**< Number of levels of the temporal pyramid, including the original data. */
+        unsigned int factor; /**< Number of time steps averaged into a single one from one level to the next coarser one (e.g., 24 for daily means of hourly data). Must be greater than 1. */
+    } multires; /**< Parameters for the pyramid if `strategy` is `MAXDIV_MULTIRES_SEARCH`. Candidates found on the coarsest level are refined at each finer level. */
+    
+    /* Spatial Proposal Parameters */
+    struct
+    {
+        unsigned int margin; /**< Number of locations the bounding boxes of the regions of high scores are enlarged by in each spatial direction. */
+    } spatial_proposals; /**< Parameters for the proposal generator if `proposal_generator` is `MAXDIV_SPATIAL_PROPOSALS_*`. */
+    
+    /* Pre-processing Cache Parameters */
+    struct
+    {
+        const char * directory; /**< Existing directory where the results of pre-processing are stored and re-used by subsequent searches on the same data with the same pre-processing parameters, even across processes. `NULL` disables the cache. The string is copied by `maxdiv_compile_pipeline()`. */
+    } preproc_cache; /**< Parameters of the persistent cache for pre-processed data. The cache is not used by `MAXDIV_STREAMING_SEARCH`. */
+    
 } maxdiv_params_t;
 
 
+/**
+* @brief Profiling information collected by a processing pipeline
+*
+* All times are wall-clock times in seconds, accumulated over all executions of the pipeline.
+*/
+typedef struct {
+    unsigned long long num_searches; /**< Number of searches performed by `maxdiv_exec()` or `maxdiv_stream_poll()`. */
+    unsigned long long num_proposals; /**< Total number of proposed intervals which have been scored. */
+    unsigned long long num_fits; /**< Number of distributions fitted to proposed intervals. */
+    unsigned long long num_incremental_fits; /**< Number of fits obtained by updating the previous fit instead of computing it from scratch. */
+    unsigned long long num_cache_fallbacks; /**< Number of sums which estimators had to compute explicitly because they were not covered by cumulative sums. */
+    size_t cumulative_memory; /**< Maximum number of bytes occupied by the cumulative sums of an estimator during a search. */
+    double preprocessing_time; /**< Time spent on masking and pre-processing the data. */
+    double init_time; /**< Time spent on initializing the density estimator, e.g., computing cumulative sums. */
+    double proposal_time; /**< Time spent on initializing the proposal generator. */
+    double scoring_time; /**< Time spent on fitting distributions to proposed intervals and computing their divergence. */
+    double nms_time; /**< Time spent on non-maximum suppression after scoring. */
+    double total_time; /**< Total time spent on searching. */
+    unsigned long long num_preproc_cache_hits; /**< Number of searches whose pre-processed data have been loaded from the pre-processing cache. */
+    unsigned long long num_partial_searches; /**< Number of searches started by `maxdiv_exec_async()` which have been stopped by their deadline or cancelled before all proposals had been scored. */
+} maxdiv_stats_t;
+
+
+/**
+* @brief Status of an asynchronous execution started by `maxdiv_exec_async()`
+*/
+enum maxdiv_job_status_t
+{
+    MAXDIV_JOB_INVALID,     /**< The handle does not refer to an execution which has not been waited for yet. */
+    MAXDIV_JOB_RUNNING,     /**< The search is still running. */
+    MAXDIV_JOB_COMPLETE,    /**< The search is done and all proposed intervals have been scored. */
+    MAXDIV_JOB_PARTIAL,     /**< The search has been stopped by its deadline or cancelled. The detections are the best ones among the intervals scored so far. */
+    MAXDIV_JOB_FAILED       /**< The search has been aborted by an error, e.g., because memory was exhausted. */
+};
+
+/**
+* Callback receiving the progress of an asynchronous execution.
+*
+* @param[in] progress Fraction of the search completed so far (between 0 and 1).
+*
+* @param[in] user_data The pointer passed to `maxdiv_exec_async()`.
+*/
+typedef void (*maxdiv_progress_callback_t)(MaxDivScalar progress, void * user_data);
+
+
 /**
 * Initializes a structure with the parameters for the MaxDiv algorithm with the default values.
 *
@@ -204,6 +312,10 @@ void maxdiv_init_params(maxdiv_params_t * params);
 *
 * @note You have to free the pipeline using `maxdiv_free_pipeline()` when you're done with it to avoid
 * memory leaks.
+*
+* @note This function is thread-safe. The slots of freed pipelines may be re-used for new pipelines, but their
+* handles differ, so that stale handles obtained before a pipeline has been freed will never refer to a new pipeline.
+* Looking up a handle does not acquire any lock, so that concurrent calls on existing pipelines are not serialized.
 */
 unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params);
 
@@ -211,6 +323,9 @@ unsigned int maxdiv_compile_pipeline(const maxdiv_params_t * params);
 * Frees a processing pipeline built by `maxdiv_compile_pipeline()`.
 *
 * @param[in] handle The internal handle to the pipeline returned by `maxdiv_compile_pipeline()`.
+*
+* @note This function is thread-safe. Calls to `maxdiv_exec()` running on the pipeline at the same time
+* will finish normally, the pipeline will be destroyed as soon as they are done.
 */
 void maxdiv_free_pipeline(unsigned int handle);
 
@@ -235,18 +350,346 @@ void maxdiv_free_pipeline(unsigned int handle);
 * @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
 * pointed to will be set to the actual number of elements written to the buffer.
 *
-* @param[in] const_data If `false`, the given data may be modified. Otherwise, a copy will be made.
+* @param[in] const_data If `false`, the data will be processed in-place, i.e., missing values will be masked and
+* pre-processing will be applied directly in the given buffer without making a copy of the data. Otherwise, a copy
+* will be made if the data have to be masked or pre-processed.
 *
 * @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
 * floating point value, set this to `true` and specify the missing value in `missing_value`.
 *
 * @param[in] missing_value A special floating point value which is used to encode missing values in the data.
 * This parameter has no effect if `custom_missing_value` is set to `false`.
+*
+* @note The same pipeline may be executed concurrently from several threads. Each call uses an execution
+* context of its own, which is taken from a pool of contexts of the pipeline and created by cloning the
+* pipeline only if all contexts are busy. Calling this function on a streaming pipeline does not affect
+* the state of its stream.
 */
 void maxdiv_exec(unsigned int pipeline, MaxDivScalar * data, const unsigned int * shape,
                  detection_t * detection_buf, unsigned int * detection_buf_size,
                  bool const_data = true, bool custom_missing_value = false, MaxDivScalar missing_value = 0);
 
+/**
+* Uses a processing pipeline built in advance to search for maximally divergent intervals in spatio-temporal data
+* without modifying them, using a scratch buffer provided by the caller for the copy of the data which has to be
+* made if they have to be masked or pre-processed.
+*
+* If the scratch buffer is large enough and re-used for subsequent calls, no memory will be allocated for copies
+* of the data. Pre-processing steps which change the shape of the data, such as embeddings, may still allocate
+* memory for their results.
+*
+* @param[in] pipeline The internal handle to the processing pipeline obtained by `maxdiv_compile_pipeline()`.
+*
+* @param[in] data Pointer to the raw data array. See `maxdiv_exec()` for details. The data will not be modified.
+*
+* @param[in] shape Pointer to an array with 5 elements which specify the size of each dimension of the given data.
+*
+* @param[out] detection_buf Pointer to a buffer where the detected intervals will be stored.
+*
+* @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
+* pointed to will be set to the actual number of elements written to the buffer.
+*
+* @param[in,out] workspace Pointer to a scratch buffer with `workspace_size` elements. Its contents on return are
+* undefined. It should have at least as many elements as the data to avoid allocation of memory. If this is `NULL`,
+* this function behaves like `maxdiv_exec()` with `const_data` set to `true`.
+*
+* @param[in] workspace_size The number of elements in the scratch buffer.
+*
+* @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
+* floating point value, set this to `true` and specify the missing value in `missing_value`.
+*
+* @param[in] missing_value A special floating point value which is used to encode missing values in the data.
+* This parameter has no effect if `custom_missing_value` is set to `false`.
+*
+* @note Concurrent calls must not share the same scratch buffer.
+*/
+void maxdiv_exec_workspace(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                           detection_t * detection_buf, unsigned int * detection_buf_size,
+                           MaxDivScalar * workspace, size_t workspace_size,
+                           bool custom_missing_value = false, MaxDivScalar missing_value = 0);
+
+/**
+* Uses a processing pipeline built in advance to search for maximally divergent intervals in spatio-temporal data
+* with an arbitrary memory layout, such as views of arrays provided by foreign language bindings.
+*
+* If the layout of the data matches the one expected by `maxdiv_exec()`, the data are used without making a copy.
+* Otherwise, they will be gathered into a contiguous buffer, which is processed in-place afterwards.
+*
+* @param[in] pipeline The internal handle to the processing pipeline obtained by `maxdiv_compile_pipeline()`.
+*
+* @param[in] data Pointer to the first element of the data. The data will not be modified.
+*
+* @param[in] shape Pointer to an array with 5 elements which specify the size of each dimension of the given data.
+* See `maxdiv_exec()` for details.
+*
+* @param[in] strides Pointer to an array with 5 elements which specify the distance between two consecutive indices
+* of each dimension in number of elements (not bytes). They may be negative. If this is `NULL`, the data are assumed
+* to be layed out as for `maxdiv_exec()`.
+*
+* @param[out] detection_buf Pointer to a buffer where the detected intervals will be stored.
+*
+* @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
+* pointed to will be set to the actual number of elements written to the buffer.
+*
+* @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
+* floating point value, set this to `true` and specify the missing value in `missing_value`.
+*
+* @param[in] missing_value A special floating point value which is used to encode missing values in the data.
+* This parameter has no effect if `custom_missing_value` is set to `false`.
+*/
+void maxdiv_exec_strided(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape, const ptrdiff_t * strides,
+                         detection_t * detection_buf, unsigned int * detection_buf_size,
+                         bool custom_missing_value = false, MaxDivScalar missing_value = 0);
+
+/**
+* Merges the detections obtained by several pipelines searching different partitions of the start points
+* of the same data, as specified by `scheduling.num_partitions` and `scheduling.partition`.
+*
+* Each process of a distributed search executes a pipeline compiled for its own partition on the entire data.
+* The detections of all processes are then merged by greedy non-maximum suppression of all of them, either by
+* a single call to this function with the lists of all partitions, e.g., after gathering them at a root process,
+* or by a tree of merges, e.g., a pairwise reduction. The order of the lists does not matter.
+*
+* A detection suppressed by an intermediate merge may become a final detection if the detection suppressing it
+* is suppressed by a detection of another partition. Thus, intermediate merges must set @p keep_suppressed, so
+* that their results also contain the detections they suppressed. Merging such results yields the same detections
+* as a single merge of the lists of all partitions, as long as the buffers of the intermediate merges are large
+* enough for all detections of their lists. How the lists are transferred between processes is up to the caller.
+*
+* @param[in] pipeline The internal handle to a processing pipeline obtained by `maxdiv_compile_pipeline()`,
+* whose overlap threshold will be used for non-maximum suppression.
+*
+* @param[in] num_lists The number of lists of detections to be merged.
+*
+* @param[in] lists Array with `num_lists` pointers to the lists of detections.
+*
+* @param[in] list_sizes Array with the number of detections in each list.
+*
+* @param[out] detection_buf Pointer to a buffer where the merged detections will be stored.
+*
+* @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
+* pointed to will be set to the actual number of elements written to the buffer.
+*
+* @param[in] keep_suppressed If `true`, the detections will be followed by the suppressed ones in the buffer, so
+* that the result can be passed as one of the lists to a further merge. It should only be used for intermediate merges.
+*/
+void maxdiv_merge_detections(unsigned int pipeline, unsigned int num_lists, const detection_t * const * lists, const unsigned int * list_sizes,
+                             detection_t * detection_buf, unsigned int * detection_buf_size, bool keep_suppressed = false);
+
+/**
+* Uses a processing pipeline built in advance to search for maximally divergent intervals in a batch of
+* independent series of spatio-temporal data.
+*
+* Instead of parallelizing the search within each series, series with less than `MAXDIV_BATCH_INNER_PARALLEL_SIZE`
+* samples are distributed among the threads, which avoids the overhead of parallelizing the search on small data.
+* Each thread uses a single execution context for all of its series. Larger series are processed one after another
+* afterwards, using all threads for each of them.
+*
+* @param[in] pipeline The internal handle to the processing pipeline obtained by `maxdiv_compile_pipeline()`.
+*
+* @param[in] num_series The number of series in the batch.
+*
+* @param[in] data Pointer to an array of `num_series` pointers to the raw data arrays of the individual series.
+* See `maxdiv_exec()` for details on the memory layout of each series.
+*
+* @param[in] shapes Pointer to an array with `5 * num_series` elements, which specify the 5 dimensions of each series
+* one after another. See `maxdiv_exec()` for details.
+*
+* @param[out] detection_buf Pointer to a buffer with `num_series * max_detections` elements. The detections for the
+* `i`-th series will be stored starting at `detection_buf + i * max_detections`.
+*
+* @param[in] max_detections The maximum number of detections to be retrieved for each series.
+*
+* @param[out] num_detections Pointer to an array with `num_series` elements, which will be set to the actual number
+* of detections written to the buffer for each series. Invalid or empty series will yield no detections.
+*
+* @param[in] const_data If `false`, the data will be processed in-place. Otherwise, a copy will be made if the data
+* have to be masked or pre-processed. See `maxdiv_exec()` for details.
+*
+* @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
+* floating point value, set this to `true` and specify the missing value in `missing_value`.
+*
+* @param[in] missing_value A special floating point value which is used to encode missing values in the data.
+* This parameter has no effect if `custom_missing_value` is set to `false`.
+*
+* @note The detections for each series are the same as those obtained by calling `maxdiv_exec()` for each series
+* individually.
+*/
+void maxdiv_exec_batch(unsigned int pipeline, unsigned int num_series, MaxDivScalar * const * data, const unsigned int * shapes,
+                       detection_t * detection_buf, unsigned int max_detections, unsigned int * num_detections,
+                       bool const_data = true, bool custom_missing_value = false, MaxDivScalar missing_value = 0);
+
+
+/**
+* Starts searching for maximally divergent intervals in a background thread, with an optional deadline.
+*
+* Once the deadline has passed or `maxdiv_cancel()` has been called, the search stops scoring proposals and yields
+* the best detections among the intervals scored so far. Proposal-based searches score the most promising intervals
+* first, ordered by the point-wise scores of the proposal generator or, for dense proposals, by Hotelling's T^2 scores.
+* With a deadline, non-maximum suppression is applied while scoring, so that it does not delay the results once the
+* deadline has passed. The detections may hence differ slightly from those of `maxdiv_exec()` for data with at most
+* `MAXDIV_NMP_LIMIT` samples, for which `maxdiv_exec()` applies non-maximum suppression to all scores at once. Without
+* a deadline, a search which completes yields the same detections as `maxdiv_exec()`. Pre-processing and the
+* initialization of the density estimator can not be interrupted, so that a search may exceed its deadline by the
+* time those take.
+*
+* @param[in] pipeline The internal handle to the processing pipeline obtained by `maxdiv_compile_pipeline()`.
+*
+* @param[in] data Pointer to the raw data array, layed out as for `maxdiv_exec()`. The data will not be modified,
+* but they are not copied either and must remain valid until `maxdiv_wait()` has returned.
+*
+* @param[in] shape Pointer to an array with 5 elements which specify the size of each dimension of the given data.
+* See `maxdiv_exec()` for details.
+*
+* @param[in] max_detections The maximum number of detections to be retrieved.
+*
+* @param[in] timeout Number of seconds after which the search will be stopped. If this is not positive, the search
+* will only stop when it is complete or cancelled.
+*
+* @param[in] progress_callback Optional function which will be called with the fraction of the search completed
+* whenever a chunk of proposals has been scored. It is called from the threads performing the search, but never
+* concurrently, and should return quickly. May be `NULL`.
+*
+* @param[in] user_data Arbitrary pointer passed to `progress_callback`.
+*
+* @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
+* floating point value, set this to `true` and specify the missing value in `missing_value`.
+*
+* @param[in] missing_value A special floating point value which is used to encode missing values in the data.
+* This parameter has no effect if `custom_missing_value` is set to `false`.
+*
+* @return Returns a handle to the execution or `0` if the parameters are invalid.
+*
+* @note `maxdiv_wait()` has to be called for every execution to retrieve its results and release its resources.
+* Searches of the streaming strategy ignore the deadline.
+*/
+unsigned int maxdiv_exec_async(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                               unsigned int max_detections, double timeout = 0,
+                               maxdiv_progress_callback_t progress_callback = NULL, void * user_data = NULL,
+                               bool custom_missing_value = false, MaxDivScalar missing_value = 0);
+
+/**
+* Requests an asynchronous execution to stop as soon as possible. Its status will be `MAXDIV_JOB_PARTIAL` afterwards,
+* unless it has been complete already.
+*
+* @param[in] job The handle to the execution obtained by `maxdiv_exec_async()`.
+*/
+void maxdiv_cancel(unsigned int job);
+
+/**
+* Queries the status of an asynchronous execution without waiting for it.
+*
+* @param[in] job The handle to the execution obtained by `maxdiv_exec_async()`.
+*
+* @return Returns `MAXDIV_JOB_RUNNING` if the search is still running, its final status if it is done, or
+* `MAXDIV_JOB_INVALID` if the handle is invalid or the execution has been waited for already.
+*/
+maxdiv_job_status_t maxdiv_job_status(unsigned int job);
+
+/**
+* Waits for an asynchronous execution to finish, retrieves its detections and releases it. The handle will be
+* invalid afterwards.
+*
+* @param[in] job The handle to the execution obtained by `maxdiv_exec_async()`.
+*
+* @param[out] detection_buf Pointer to a buffer where the detected intervals will be stored. May be `NULL` to
+* discard the detections.
+*
+* @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
+* pointed to will be set to the actual number of elements written to the buffer. May be `NULL`.
+*
+* @return Returns `MAXDIV_JOB_COMPLETE` if the detections are the final result, `MAXDIV_JOB_PARTIAL` if the search
+* has been stopped early, `MAXDIV_JOB_FAILED` if it has been aborted by an error, or `MAXDIV_JOB_INVALID` if the
+* handle is invalid. No detections are written in the latter two cases.
+*/
+maxdiv_job_status_t maxdiv_wait(unsigned int job, detection_t * detection_buf, unsigned int * detection_buf_size);
+
+
+/**
+* Appends new time steps to the sliding window of a streaming pipeline. Time steps which do not fit into the window
+* anymore will be discarded.
+*
+* @param[in] pipeline The internal handle to a processing pipeline obtained by `maxdiv_compile_pipeline()` with
+* `strategy` set to `MAXDIV_STREAMING_SEARCH`.
+*
+* @param[in] data Pointer to the raw data array of the new time steps, layed out as for `maxdiv_exec()`.
+* The data will be copied.
+*
+* @param[in] shape Pointer to an array with 5 elements which specify the size of each dimension of the given data.
+* All dimensions except the first (temporal) one must match the shape of the time steps pushed before.
+*
+* @param[in] custom_missing_value If missing values in the given data aren't encoded as `NaN`, but another special
+* floating point value, set this to `true` and specify the missing value in `missing_value`.
+*
+* @param[in] missing_value A special floating point value which is used to encode missing values in the data.
+* This parameter has no effect if `custom_missing_value` is set to `false`.
+*
+* @return Returns `false` if the pipeline is not a streaming pipeline or the shape of the data does not match,
+* otherwise `true`.
+*/
+bool maxdiv_stream_push(unsigned int pipeline, const MaxDivScalar * data, const unsigned int * shape,
+                        bool custom_missing_value = false, MaxDivScalar missing_value = 0);
+
+/**
+* Searches for maximally divergent intervals in the current window of a streaming pipeline. Only the intervals ending
+* among the time steps pushed since the last poll are scored, along with a few candidates retained from previous polls
+* (see `MAXDIV_STREAM_CANDIDATE_LAYERS`), which are re-scored on the current window. The detections may hence differ
+* from those of `maxdiv_exec()` on the window.
+*
+* @param[in] pipeline The internal handle to a processing pipeline obtained by `maxdiv_compile_pipeline()` with
+* `strategy` set to `MAXDIV_STREAMING_SEARCH`.
+*
+* @param[out] detection_buf Pointer to a buffer where the detected intervals will be stored. Their time indices
+* are relative to the first time step ever pushed to the stream.
+*
+* @param[in,out] detection_buf_size Pointer to the number of elements allocated for `detection_buf`. The integer
+* pointed to will be set to the actual number of elements written to the buffer.
+*
+* @note The density estimate of the window is only updated incrementally for `MAXDIV_KL_DIVERGENCE` with
+* `MAXDIV_GAUSSIAN` or `MAXDIV_ERPH`, in the latter case as long as the range of the random projections of the
+* window does not change. If `erph.num_bins` is 0, the numbers of bins determined when the window has been
+* re-initialized the last time are kept by incremental updates. All other combinations are re-initialized on
+* the entire window on every poll.
+*/
+void maxdiv_stream_poll(unsigned int pipeline, detection_t * detection_buf, unsigned int * detection_buf_size);
+
+/**
+* Discards all time steps and detections in the sliding window of a streaming pipeline.
+*
+* @param[in] pipeline The internal handle to a processing pipeline obtained by `maxdiv_compile_pipeline()` with
+* `strategy` set to `MAXDIV_STREAMING_SEARCH`.
+*/
+void maxdiv_stream_reset(unsigned int pipeline);
+
+
+/**
+* Retrieves the profiling information collected by all executions of a processing pipeline since it has been
+* compiled or the statistics have been reset. Collecting this information is cheap, so it is always enabled.
+*
+* @param[in] pipeline The internal handle to the processing pipeline obtained by `maxdiv_compile_pipeline()`.
+*
+* @param[out] stats Pointer to a structure which the statistics will be stored in.
+*
+* @param[out] thread_proposals Optional pointer to a buffer where the number of proposed intervals scored by
+* each thread will be stored. May be `NULL`.
+*
+* @param[out] thread_time Optional pointer to a buffer where the time spent on scoring by each thread will be
+* stored. Dividing the elements of `thread_proposals` by these gives the throughput of each thread. May be `NULL`.
+*
+* @param[in,out] num_threads Pointer to the number of elements allocated for `thread_proposals` and `thread_time`.
+* The integer pointed to will be set to the number of threads, which may be greater than the number of elements
+* written to the buffers. May be `NULL` if both buffers are `NULL`.
+*
+* @param[in] reset If set to `true`, the statistics of the pipeline will be reset after they have been retrieved.
+*
+* @return Returns `false` if the handle is invalid or `stats` is `NULL`, otherwise `true`.
+*
+* @note Statistics of calls to `maxdiv_exec()` which are still running will only be included once they are done.
+*/
+bool maxdiv_get_stats(unsigned int pipeline, maxdiv_stats_t * stats,
+                      unsigned long long * thread_proposals = NULL, double * thread_time = NULL, unsigned int * num_threads = NULL,
+                      bool reset = false);
+
 
 /**
 * Searches for maximally divergent intervals in spatio-temporal data.
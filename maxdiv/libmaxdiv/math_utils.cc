@@ -16,6 +16,7 @@
 //  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
 
 #include "math_utils.h"
+#include <algorithm>
 using namespace MaxDiv;
 
 
@@ -37,7 +38,9 @@ ScalarMatrix MaxDiv::gauss_kernel(const DataTensor & data, Scalar kernel_sigma_s
 
 
 GaussKernel::GaussKernel(const DataTensor & data, Scalar kernel_sigma_sq, bool normed)
-: m_data(data), m_sigma_sq(-2 * kernel_sigma_sq), m_norm(std::pow(2 * M_PI * kernel_sigma_sq, data.numAttrib() / 2.0)), m_normed(normed) {}
+: m_data(data), m_sigma_sq(-2 * kernel_sigma_sq), m_norm(std::pow(2 * M_PI * kernel_sigma_sq, data.numAttrib() / 2.0)), m_normed(normed),
+  m_sqNorms(data.data().rowwise().squaredNorm())
+{}
     
 Scalar GaussKernel::operator()(DataTensor::Index x, DataTensor::Index y) const
 {
@@ -63,12 +66,11 @@ Sample GaussKernel::column(DataTensor::Index col) const
         return Sample::Zero(this->m_data.numSamples());
     else
     {
+        // Compute distances ||x - y||^2 = ||x||^2 + ||y||^2 - 2 * x^T * y
         Sample column(this->m_data.numSamples());
-        
-        // Compute distances
-        Sample sample = this->m_data.sample(col);
-        for (DataTensor::Index row = 0; row < static_cast<DataTensor::Index>(column.size()); ++row)
-            column(row) = (sample - this->m_data.sample(row)).squaredNorm();
+        column.noalias() = this->m_data.data() * this->m_data.sample(col);
+        column = (this->m_sqNorms.array() + this->m_sqNorms(col) - 2 * column.array()).max(static_cast<Scalar>(0));
+        column(col) = 0;
         
         // Compute kernel values
         column = (column.array() / this->m_sigma_sq).exp();
@@ -85,33 +87,51 @@ Sample GaussKernel::column(DataTensor::Index col) const
 
 Sample GaussKernel::rowwiseSum() const
 {
-    if (this->m_data.numSamples() < 10000)
-        // explicit materialization of the kernel matrix is faster for few samples
-        return this->materialize().rowwise().sum();
+    const DataTensor::Index n = this->m_data.numSamples(), tileSize = MAXDIV_KERNEL_TILE_SIZE;
+    const DataTensor::Index numTiles = (n + tileSize - 1) / tileSize;
+    Eigen::Map<const ScalarMatrix> X = this->m_data.data();
+    Sample sum = Sample::Zero(n);
     
-    Sample sum = Sample::Zero(this->m_data.numSamples());
-    DataTensor::Index x, y;
+    // Weights of the columns of the kernel matrix, excluding missing samples
+    Sample weights = Sample::Ones(n);
+    for (const DataTensor::Index & missing : this->m_data.getMissingSampleIndices())
+        weights(missing) = 0;
     
-    #if defined(_OPENMP) and _OPENMP >= 201307
-    #pragma omp parallel for private(x,y) reduction(+:sum) schedule(static,1)
-    #endif
-    for (x = 0; x < static_cast<DataTensor::Index>(sum.size()); ++x)
+    // Compute the upper triangle of the kernel tile by tile and accumulate the sums
+    // of the rows and, for tiles off the diagonal, of the columns of each tile
+    #pragma omp parallel
     {
-        if (!this->m_data.isMissingSample(x))
-            for (y = x + 1; y < static_cast<DataTensor::Index>(sum.size()); ++y)
-                if (!this->m_data.isMissingSample(y))
-                {
-                    Scalar k = std::exp((this->m_data.sample(x) - this->m_data.sample(y)).squaredNorm() / this->m_sigma_sq);
-                    sum(x) += k;
-                    sum(y) += k;
-                }
+        ScalarMatrix tile(tileSize, tileSize);
+        Sample localSum = Sample::Zero(n);
+        DataTensor::Index rowTile, colTile, rowStart, colStart, numRows, numCols;
+        
+        #pragma omp for schedule(dynamic)
+        for (rowTile = 0; rowTile < numTiles; ++rowTile)
+        {
+            rowStart = rowTile * tileSize;
+            numRows = std::min(tileSize, n - rowStart);
+            for (colTile = rowTile; colTile < numTiles; ++colTile)
+            {
+                colStart = colTile * tileSize;
+                numCols = std::min(tileSize, n - colStart);
+                auto block = tile.topLeftCorner(numRows, numCols);
+                block.noalias() = X.middleRows(rowStart, numRows) * X.middleRows(colStart, numCols).transpose();
+                block = ((
+                    ((block.array() * -2).colwise() + this->m_sqNorms.segment(rowStart, numRows).array()).rowwise()
+                    + this->m_sqNorms.segment(colStart, numCols).transpose().array()
+                ).max(static_cast<Scalar>(0)) / this->m_sigma_sq).exp();
+                localSum.segment(rowStart, numRows).noalias() += block * weights.segment(colStart, numCols);
+                if (colTile != rowTile)
+                    localSum.segment(colStart, numCols).noalias() += block.transpose() * weights.segment(rowStart, numRows);
+            }
+        }
+        
+        #pragma omp critical
+        sum += localSum;
     }
     
-    // Add diagonal elements
-    if (!this->m_data.hasMissingSamples())
-        sum.array() += 1;
-    else
-        sum += this->m_data.getMask().asVector().cwiseEqual(false).cast<Scalar>();
+    // Rows of missing samples are 0
+    sum.array() *= weights.array();
     
     // Normalize
     if (this->m_normed)
@@ -125,4 +145,40 @@ Sample GaussKernel::rowwiseMean() const
     Sample mean = this->rowwiseSum();
     mean /= this->m_data.numValidSamples();
     return mean;
+}
+
+DataTensor::Index GaussKernel::lowRankFactors(DataTensor & factors, DataTensor::Index maxRank, Scalar tolerance) const
+{
+    DataTensor::Index n = this->m_data.numSamples();
+    maxRank = std::min(maxRank, n - static_cast<DataTensor::Index>(this->m_data.numMissingSamples()));
+    
+    // Initialize residual of the diagonal
+    Scalar diag = (this->m_normed) ? 1 / this->m_norm : 1;
+    Sample residual = Sample::Constant(n, diag);
+    for (const DataTensor::Index & missing : this->m_data.getMissingSampleIndices())
+        residual(missing) = 0;
+    
+    // Pivoted incomplete Cholesky decomposition
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> F(n, std::max(maxRank, static_cast<DataTensor::Index>(0)));
+    DataTensor::Index rank, pivot;
+    for (rank = 0; rank < maxRank; ++rank)
+    {
+        Scalar maxResidual = residual.maxCoeff(&pivot);
+        if (maxResidual <= tolerance * diag)
+            break;
+        
+        Sample col = this->column(pivot);
+        if (rank > 0)
+            col.noalias() -= F.leftCols(rank) * F.row(pivot).head(rank).transpose();
+        F.col(rank) = col / std::sqrt(maxResidual);
+        residual -= F.col(rank).cwiseAbs2();
+        residual(pivot) = 0;
+    }
+    
+    ReflessIndexVector factorShape = this->m_data.shape();
+    factorShape.d = rank;
+    factors.resize(factorShape);
+    if (rank > 0)
+        factors.data() = F.leftCols(rank);
+    return rank;
 }
\ No newline at end of file
@@ -55,15 +55,18 @@ namespace MaxDiv
 *
 * @param[out] logdet A pointer to a scalar vlaue where the natural logarithm of the determinant of `mat` will be
 * stored. May be `NULL`.
+*
+* @return Returns the regularizer which has been added to the main diagonal of `mat`, i.e., 0 if the
+* decomposition of the original matrix succeeded.
 */
 template<typename Derived>
-void cholesky(const Eigen::MatrixBase<Derived> & mat, Eigen::LLT<typename Derived::PlainObject> * llt, typename Derived::Scalar * logdet = NULL)
+typename Derived::Scalar cholesky(const Eigen::MatrixBase<Derived> & mat, Eigen::LLT<typename Derived::PlainObject> * llt, typename Derived::Scalar * logdet = NULL)
 {
     typedef typename Derived::Scalar Scalar;
     typedef typename Derived::PlainObject Matrix;
     
     if (llt == NULL && logdet == NULL)
-        return;
+        return 0;
     
     // Try Cholesky decomposition of original matrix
     Eigen::LLT<Matrix> * chol = (llt != NULL) ? llt : new Eigen::LLT<Matrix>();
@@ -90,8 +93,123 @@ void cholesky(const Eigen::MatrixBase<Derived> & mat, Eigen::LLT<typename Derive
     // Clean up
     if (llt == NULL)
         delete chol;
+    
+    return regularizer;
 }
 
+/**
+* @brief Cholesky decomposition which can be scaled in-place
+*
+* Together with `rankUpdate()`, this allows updating the decomposition of a matrix of the form
+* `alpha * (A + sigma * v * v^T)` in quadratic time, given the decomposition of `A`.
+*/
+template<typename MatrixType>
+class ScalableLLT : public Eigen::LLT<MatrixType>
+{
+public:
+
+    typedef typename MatrixType::Scalar Scalar;
+
+    ScalableLLT() : Eigen::LLT<MatrixType>() {};
+    
+    /**
+    * Turns this decomposition of a matrix `A` into a decomposition of `factor * A`.
+    *
+    * @param[in] factor Positive scaling factor.
+    *
+    * @return Returns a reference to this object.
+    */
+    ScalableLLT & scale(Scalar factor)
+    {
+        eigen_assert(this->m_isInitialized && factor > 0);
+        this->m_matrix *= std::sqrt(factor);
+#if EIGEN_VERSION_AT_LEAST(3,3,0)
+        this->m_l1_norm *= factor;
+#endif
+        return *this;
+    };
+    
+    using Eigen::LLT<MatrixType>::rankUpdate;
+    
+    /**
+    * Turns this decomposition of a matrix `A` into a decomposition of `A + sigma * v * v^T`.
+    *
+    * This is the same algorithm as `Eigen::LLT::rankUpdate()`, but it uses a given workspace vector
+    * instead of allocating a temporary one on each call.
+    *
+    * @param[in] v The update vector.
+    *
+    * @param[in] sigma The factor of the rank-one update. May be negative for a downdate.
+    *
+    * @param[in,out] temp Workspace, which will be resized to the size of @p v if necessary.
+    *
+    * @return Returns a reference to this object. `info()` will report `Eigen::NumericalIssue` if the
+    * updated matrix is not positive definite.
+    */
+    template<typename VectorType>
+    ScalableLLT & rankUpdate(const VectorType & v, Scalar sigma, Eigen::Matrix<Scalar, Eigen::Dynamic, 1> & temp)
+    {
+        typedef typename MatrixType::Index Index;
+        eigen_assert(this->m_isInitialized && v.size() == this->m_matrix.cols());
+        
+        MatrixType & L = this->m_matrix;
+        Index n = L.cols();
+        this->m_info = Eigen::Success;
+        if (sigma > 0)
+        {
+            // Updates are based on Givens rotations
+            temp = std::sqrt(sigma) * v;
+            for (Index i = 0; i < n; ++i)
+            {
+                Eigen::JacobiRotation<Scalar> g;
+                g.makeGivens(L(i, i), -temp(i), &L(i, i));
+                if (i < n - 1)
+                {
+                    auto x = L.col(i).tail(n - i - 1);
+                    auto y = temp.tail(n - i - 1);
+                    Eigen::internal::apply_rotation_in_the_plane(x, y, g);
+                }
+            }
+        }
+        else
+        {
+            temp = v;
+            Scalar beta = 1;
+            for (Index j = 0; j < n; ++j)
+            {
+                Scalar Ljj = L(j, j), dj = Ljj * Ljj, wj = temp(j), swj2 = sigma * (wj * wj), gamma = dj * beta + swj2;
+                Scalar x = dj + swj2 / beta;
+                if (x <= 0)
+                {
+                    this->m_info = Eigen::NumericalIssue;
+                    break;
+                }
+                Scalar nLjj = std::sqrt(x);
+                L(j, j) = nLjj;
+                beta += swj2 / dj;
+                
+                Index rs = n - j - 1;
+                if (rs > 0)
+                {
+                    temp.tail(rs) -= (wj / Ljj) * L.col(j).tail(rs);
+                    if (gamma != 0)
+                        L.col(j).tail(rs) = (nLjj / Ljj) * L.col(j).tail(rs) + (nLjj * sigma * wj / gamma) * temp.tail(rs);
+                }
+            }
+        }
+        return *this;
+    };
+    
+    /**
+    * @return Returns the natural logarithm of the determinant of the decomposed matrix.
+    */
+    Scalar logDeterminant() const
+    {
+        return 2 * this->m_matrix.diagonal().array().log().sum();
+    };
+
+};
+
 /**
 * Computes a Gaussian kernel: \f$k(x,y) = \left( 2 \pi \sigma^2 \right)^{-D/2} \cdot \exp \left( - \frac{\left \| x-y \right \|^2}{2 \sigma^2} \right)\f$
 *
@@ -106,23 +224,24 @@ void cholesky(const Eigen::MatrixBase<Derived> & mat, Eigen::LLT<typename Derive
 template<typename Derived>
 typename Derived::PlainObject gauss_kernel(const Eigen::MatrixBase<Derived> & X, typename Derived::Scalar kernel_sigma_sq = 1, bool normed = true)
 {
-    // Compute distance matrix
-    typename Derived::PlainObject kernel(X.rows(), X.rows());
-    typename Derived::Index x, y;
-    #pragma omp parallel for private(x,y) schedule(static,1)
+    typedef typename Derived::Scalar Scalar;
+    
+    // Compute the lower triangle of -2 * X * X^T by a single (blocked and vectorized) matrix product
+    typename Derived::PlainObject kernel = Derived::PlainObject::Zero(X.rows(), X.rows());
+    kernel.template selfadjointView<Eigen::Lower>().rankUpdate(X, -2);
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> sqNorms = X.rowwise().squaredNorm();
+    
+    // Compute kernel from the squared distances ||x - y||^2 = ||x||^2 + ||y||^2 - 2 * x^T * y
+    typename Derived::Index x;
+    #pragma omp parallel for private(x) schedule(dynamic,16)
     for (x = 0; x < X.rows(); ++x)
     {
-        kernel(x, x) = 0;
-        for (y = x + 1; y < X.rows(); ++y)
-        {
-            kernel(x, y) = (X.row(x) - X.row(y)).squaredNorm();
-            kernel(y, x) = kernel(x, y);
-        }
+        kernel.row(x).head(x) = (
+            (kernel.row(x).head(x).array() + sqNorms.head(x).transpose().array() + sqNorms(x)).max(Scalar(0)) / (-2 * kernel_sigma_sq)
+        ).exp();
+        kernel(x, x) = 1;
     }
-    
-    // Compute kernel
-    kernel /= -2 * kernel_sigma_sq;
-    kernel = kernel.array().exp();
+    kernel.template triangularView<Eigen::StrictlyUpper>() = kernel.transpose();
     if (normed)
         kernel /= std::pow(2 * M_PI * kernel_sigma_sq, X.cols() / 2.0);
     return kernel;
@@ -186,8 +305,8 @@ public:
     /**
     * Explicitely computes a single column of the Gaussian kernel matrix.
     *
-    * This is slightly faster than computing the values of the column one by one, but not as memory-efficient
-    * if the values are only needed independently.
+    * This is faster than computing the values of the column one by one, since the distances are obtained
+    * from a single matrix-vector product, but not as memory-efficient if the values are only needed independently.
     *
     * @param[in] col The index of the column to compute.
     *
@@ -198,9 +317,9 @@ public:
     /**
     * Computes the sum of each row of the Gaussian kernel without having to materialize the entire kernel matrix.
     *
-    * For a small number of samples a materialized representation of the kernel matrix will be used in order to
-    * leverage vectorization, while for a large number of samples the sum will be computed without storing the
-    * entire kernel matrix in order to save memory.
+    * The kernel matrix will be computed in tiles of `MAXDIV_KERNEL_TILE_SIZE` rows and columns in order to save
+    * memory. The distances are obtained from matrix products, so that most of the work is blocked and vectorized
+    * by Eigen, and the symmetry of the kernel is exploited by computing only tiles above the diagonal.
     *
     * @return Returns a vector with the sums of each row.
     */
@@ -209,13 +328,37 @@ public:
     /**
     * Computes the mean of each row of the Gaussian kernel without having to materialize the entire kernel matrix.
     *
-    * For a small number of samples a materialized representation of the kernel matrix will be used in order to
-    * leverage vectorization, while for a large number of samples the mean will be computed without storing the
-    * entire kernel matrix in order to save memory.
+    * The sums of the rows are computed tile by tile as described for `rowwiseSum()`.
     *
     * @return Returns a vector with the means of each row.
     */
     Sample rowwiseMean() const;
+    
+    /**
+    * Computes a low-rank approximation `K ~= F * F^T` of the Gaussian kernel matrix `K` by pivoted incomplete
+    * Cholesky decomposition, without having to materialize the entire kernel matrix.
+    *
+    * In each step, the sample whose kernel value with itself is approximated worst is chosen as pivot and
+    * the corresponding column of the kernel matrix is computed. Thus, this is a Nystroem approximation with
+    * greedily selected landmarks, which also covers isolated groups of samples. It requires `O(n * r * (D + r))`
+    * time for `n` samples with `D` attributes and rank `r`.
+    *
+    * Since the kernel is approximated by an inner product, sums of kernel values of a sample with all samples
+    * in a sub-block of the data can be obtained in `O(r)` from cumulative sums of the factors.
+    *
+    * @param[out] factors A tensor which will be resized to the shape of the data with the number of attributes
+    * replaced by the rank `r` of the approximation. Each sample will be assigned its row of `F`. The rows of
+    * missing samples will be 0.
+    *
+    * @param[in] maxRank The maximum rank of the approximation. Higher values lead to a better approximation
+    * at the cost of time and memory.
+    *
+    * @param[in] tolerance The decomposition stops before reaching @p maxRank as soon as the error of the
+    * approximation of the kernel value of every sample with itself is at most `tolerance * k(x, x)`.
+    *
+    * @return Returns the actual rank `r` of the approximation.
+    */
+    DataTensor::Index lowRankFactors(DataTensor & factors, DataTensor::Index maxRank, Scalar tolerance = 1e-8) const;
 
 
 protected:
@@ -224,6 +367,7 @@ protected:
     Scalar m_sigma_sq;
     Scalar m_norm;
     bool m_normed;
+    Sample m_sqNorms; /**< Squared norms of all samples for computing distances by matrix products. */
 
 };
 
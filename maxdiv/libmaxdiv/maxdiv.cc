@@ -20,7 +20,8 @@
 *
 * Command line interface to libmaxdiv, the Maximally Divergent Intervals anomaly detector.
 *
-* Time-series data can be read from CSV files, but tempo-spatial data is not supported by the CLI yet.
+* Time-series data can be read from CSV files. Spatio-temporal data can be read from binary tensor files
+* (see `MaxDiv::TensorFileHeader`), which are mapped into memory without copying them.
 *
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
@@ -44,7 +45,7 @@ using namespace std::chrono;
 
 enum maxdiv_divergence_t { MAXDIV_KL_DIVERGENCE, MAXDIV_JS_DIVERGENCE, MAXDIV_CROSS_ENTROPY };
 enum maxdiv_estimator_t { MAXDIV_KDE, MAXDIV_GAUSSIAN, MAXDIV_ERPH };
-enum maxdiv_proposal_generator_t { MAXDIV_DENSE_PROPOSALS, MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST, MAXDIV_POINTWISE_PROPOSALS_KDE };
+enum maxdiv_proposal_generator_t { MAXDIV_DENSE_PROPOSALS, MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST, MAXDIV_POINTWISE_PROPOSALS_KDE, MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST, MAXDIV_SPATIAL_PROPOSALS_KDE };
 
 
 void printHelp(const char *);
@@ -96,28 +97,42 @@ DetectionList apply_maxdiv(const std::shared_ptr<DataTensor> & data,
             return detections;
     }
     
-    // Create proposal generator
+    // Create proposal generator (the length constraints apply to the time axis only, so that the spatial extent is not restricted)
     std::shared_ptr<ProposalGenerator> proposal_gen;
+    IndexRange lengthRange(IndexVector(min_len, 1, 1, 1), IndexVector(max_len, 0, 0, 0));
     
     PointwiseProposalGenerator::Params ppParams;
     ppParams.gradientFilter = prop_filter;
     ppParams.mad = prop_mad;
     ppParams.sd_th = prop_th;
     
+    SpatialRegionProposalGenerator::Params spParams = SpatialRegionProposalGenerator::defaultParams;
+    spParams.sd_th = prop_th;
+    
     switch (proposals)
     {
         case MAXDIV_DENSE_PROPOSALS:
-            proposal_gen = std::make_shared<DenseProposalGenerator>(min_len, max_len);
+            proposal_gen = std::make_shared<DenseProposalGenerator>(lengthRange);
             break;
         
         case MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST:
             ppParams.scorer = &hotellings_t;
-            proposal_gen = std::make_shared<PointwiseProposalGenerator>(min_len, max_len, ppParams);
+            proposal_gen = std::make_shared<PointwiseProposalGenerator>(lengthRange, ppParams);
             break;
         
         case MAXDIV_POINTWISE_PROPOSALS_KDE:
             ppParams.scorer = [](const DataTensor & data) { return pointwise_kde(data); };
-            proposal_gen = std::make_shared<PointwiseProposalGenerator>(min_len, max_len, ppParams);
+            proposal_gen = std::make_shared<PointwiseProposalGenerator>(lengthRange, ppParams);
+            break;
+        
+        case MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST:
+            spParams.scorer = &hotellings_t;
+            proposal_gen = std::make_shared<SpatialRegionProposalGenerator>(lengthRange, spParams);
+            break;
+        
+        case MAXDIV_SPATIAL_PROPOSALS_KDE:
+            spParams.scorer = [](const DataTensor & data) { return pointwise_kde(data); };
+            proposal_gen = std::make_shared<SpatialRegionProposalGenerator>(lengthRange, spParams);
             break;
         
         default:
@@ -173,6 +188,7 @@ int main(int argc, char * argv[])
     Scalar overlap_th = 0.0, kernel_sigma_sq = 1.0, discount = 1.0, prop_th = 1.5, missing_value = std::numeric_limits<Scalar>::quiet_NaN();
     int prop_mad = 0, prop_filter = 1, normalize = 0, zscore_deseas = 0, linear_trend = 0, linear_season_trend = 0, timing = 0;
     char delimiter = ',';
+    string write_tensor;
     
     // Parse options
     int c;
@@ -223,12 +239,13 @@ int main(int argc, char * argv[])
             {"first_col",           required_argument,  NULL,       'c'},
             {"last_col",            required_argument,  NULL,       'z'},
             {"missing_value",       required_argument,  NULL,       'm'},
+            {"write_tensor",        required_argument,  NULL,       'W'},
             
             {0, 0, 0, 0}
         };
         
         int option_index = 0;
-        c = getopt_long(argc, argv, "a:b:c:d:e:f:g:hi:j:l:m:n:o:p:q:r:st::u:w:x:z:P:Q:", long_options, &option_index);
+        c = getopt_long(argc, argv, "a:b:c:d:e:f:g:hi:j:l:m:n:o:p:q:r:st::u:w:x:z:P:Q:W:", long_options, &option_index);
         switch (c)
         {
             case 'h':
@@ -373,6 +390,10 @@ int main(int argc, char * argv[])
                     proposals = MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST;
                 else if (argstr == "kde")
                     proposals = MAXDIV_POINTWISE_PROPOSALS_KDE;
+                else if (argstr == "spatial_hotellings_t")
+                    proposals = MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST;
+                else if (argstr == "spatial_kde")
+                    proposals = MAXDIV_SPATIAL_PROPOSALS_KDE;
                 else
                 {
                     cerr << "Unknown proposal generator: " << argstr << endl << "See --help for a list of possible values." << endl;
@@ -497,12 +518,15 @@ int main(int argc, char * argv[])
                     return 1;
                 }
                 break;
+            case 'W':
+                write_tensor = optarg;
+                break;
         }
     }
     
     if (optind >= argc)
     {
-        cerr << "No CSV file has been specified." << endl << endl;
+        cerr << "No input file has been specified." << endl << endl;
         printHelp(argv[0]);
         return 1;
     }
@@ -524,8 +548,12 @@ int main(int argc, char * argv[])
     Eigen::initParallel();
     
     // Read data
-    shared_ptr<DataTensor> data = make_shared<DataTensor>(readDataFromCSV(argv[optind], delimiter, first_row, first_col, last_col));
-    if (data->empty())
+    shared_ptr<DataTensor> data;
+    if (isTensorFile(argv[optind]))
+        data = mapTensorFile(argv[optind]);
+    else
+        data = make_shared<DataTensor>(readDataFromCSV(argv[optind], delimiter, first_row, first_col, last_col));
+    if (!data || data->empty())
     {
         cerr << "Could not read file: " << argv[optind] << endl;
         return 2;
@@ -533,6 +561,18 @@ int main(int argc, char * argv[])
     if (!std::isnan(missing_value))
         data->mask(missing_value);
     
+    // Convert data to a binary tensor file if requested
+    if (!write_tensor.empty())
+    {
+        data->mask();
+        if (!writeTensorFile(write_tensor, *data))
+        {
+            cerr << "Could not write file: " << write_tensor << endl;
+            return 2;
+        }
+        return 0;
+    }
+    
     // Apply MaxDiv algorithm
     auto start = high_resolution_clock::now();
     DetectionList detections = apply_maxdiv(data, divergence, estimator, proposals, kl_mode, gauss_cov_mode,
@@ -546,8 +586,14 @@ int main(int argc, char * argv[])
         cerr << duration_cast<milliseconds>(stop - start).count() << " ms" << endl;
     
     // Print detections
+    bool isSpatial = (data->width() > 1 || data->height() > 1 || data->depth() > 1);
     for (const Detection & det : detections)
-        cout << det.a.t << "," << det.b.t << "," << det.score << endl;
+    {
+        cout << det.a.t << "," << det.b.t << ",";
+        if (isSpatial)
+            cout << det.a.x << "," << det.b.x << "," << det.a.y << "," << det.b.y << "," << det.a.z << "," << det.b.z << ",";
+        cout << det.score << endl;
+    }
     
     return 0;
 }
@@ -555,15 +601,18 @@ int main(int argc, char * argv[])
 
 void printHelp(const char * progName)
 {
-    cout << progName << " [options] <csv-file>" << endl
+    cout << progName << " [options] <csv-file|tensor-file>" << endl
          << endl
-         << "Searches for Maximally Divergent Intervals in multivariate time-series." << endl
-         << "Spatio-temporal data is supported by libmaxdiv, but not by this command line interface." << endl
+         << "Searches for Maximally Divergent Intervals in multivariate time-series or spatio-temporal data." << endl
+         << "Time-series can be given as CSV file. Spatio-temporal data must be given as binary tensor file" << endl
+         << "(see MaxDiv::TensorFileHeader in utils.h), which is recognized automatically and mapped into" << endl
+         << "memory instead of being read. CSV files can be converted using --write_tensor." << endl
          << endl
          << "The detections will be written to stdout, one detection per line, where each line" << endl
          << "consists of 3 comma-separated values: The first point in the range, the first point" << endl
-         << "after the end of the range and the detection score. The results will be sorted in" << endl
-         << "decreasing order by their scores." << endl
+         << "after the end of the range and the detection score. For spatio-temporal data, the first and" << endl
+         << "the last point after the end of the range along the x, y and z axis will be inserted before the" << endl
+         << "score. The results will be sorted in decreasing order by their scores." << endl
          << endl
          << "OPTIONS:" << endl
          << endl
@@ -571,10 +620,10 @@ void printHelp(const char * progName)
          << "        Print this message." << endl
          << endl
          << "    --min_len <int>, -a <int>" << endl
-         << "        Minimum length of intervals to be taken into account." << endl
+         << "        Minimum length of intervals to be taken into account along the time axis." << endl
          << endl
          << "    --max_len <int>, -b <int>" << endl
-         << "        Maximum length of intervals to be taken into account." << endl
+         << "        Maximum length of intervals to be taken into account along the time axis." << endl
          << endl
          << "    --num <int>, -n <int>" << endl
          << "        Maximum number of detections to be returned." << endl
@@ -607,10 +656,13 @@ void printHelp(const char * progName)
          << "        unseen values not completely unlikely." << endl
          << endl
          << "    --proposals <str>, -p <str> (default: DENSE)" << endl
-         << "        Interval proposal generation method. One of: DENSE, HOTELLINGS_T, KDE" << endl
+         << "        Interval proposal generation method. One of: DENSE, HOTELLINGS_T, KDE," << endl
+         << "        SPATIAL_HOTELLINGS_T, SPATIAL_KDE" << endl
+         << "        The SPATIAL_* methods propose all ranges within connected spatial regions of high" << endl
+         << "        point-wise scores and are intended for spatio-temporal data." << endl
          << endl
          << "    --prop_th <float>, -q <float> (default: 1.5)" << endl
-         << "        Threshold for the point-wise proposal generators." << endl
+         << "        Threshold for the point-wise and spatial proposal generators." << endl
          << endl
          << "    --prop_mad" << endl
          << "        Use the Median Absolute Deviation From Median as robust estimate for the" << endl
@@ -672,5 +724,9 @@ void printHelp(const char * progName)
          << "    --missing_value <float>, -m <float>" << endl
          << "        If missing values in the CSV file are not encoded as 'nan', but as a special floating" << endl
          << "        point value, that missing value may be specified using this option." << endl
+         << endl
+         << "    --write_tensor <file>, -W <file>" << endl
+         << "        Write the data read from the input file to a binary tensor file instead of searching" << endl
+         << "        for anomalies. Missing values will be stored in the mask of the file." << endl
          << endl;
 }
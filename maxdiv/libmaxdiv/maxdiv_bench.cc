@@ -0,0 +1,583 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Micro-benchmarks for the components of libmaxdiv.
+*
+* Every benchmark is run for each combination of series length, number of attributes and number of threads
+* given on the command line. The timed operation is repeated with an increasing number of iterations until
+* a minimum amount of time has elapsed. The results are written as JSON, so that they can be compared between
+* releases to detect performance regressions.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+
+#include "search_strategies.h"
+#include "preproc.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace MaxDiv;
+using namespace std;
+using namespace std::chrono;
+
+
+/**
+* Parameters of a single run of a benchmark.
+*/
+struct BenchmarkParams
+{
+    DataTensor::Index n; /**< Number of time steps. */
+    DataTensor::Index d; /**< Number of attributes. */
+    int threads; /**< Number of threads. */
+};
+
+/**
+* A single timed operation, which returns the number of items processed.
+*/
+typedef std::function<unsigned long long()> BenchmarkOperation;
+
+/**
+* Prepares everything needed by a benchmark for a given set of parameters and returns the operation to be timed.
+*/
+typedef std::function<BenchmarkOperation(const BenchmarkParams &)> BenchmarkSetup;
+
+/**
+* A benchmark registered for execution.
+*/
+struct Benchmark
+{
+    std::string name;
+    BenchmarkSetup setup;
+    bool threaded; /**< Whether the benchmark depends on the number of threads. Otherwise, it will only be run with a single thread. */
+};
+
+/**
+* The result of running a benchmark with a certain set of parameters.
+*/
+struct BenchmarkResult
+{
+    std::string name;
+    BenchmarkParams params;
+    unsigned long long iterations;
+    double realTime; /**< Mean wall-clock time per iteration in seconds. */
+    double itemsPerSecond;
+};
+
+
+void printHelp(const char *);
+
+bool parseList(const char * str, std::vector<DataTensor::Index> & values);
+
+
+//------------//
+// Test data  //
+//------------//
+
+/**
+* Generates a random multivariate time-series with a shifted interval in the middle.
+*/
+static std::shared_ptr<DataTensor> makeData(const BenchmarkParams & params)
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<Scalar> normal;
+    std::shared_ptr<DataTensor> data = std::make_shared<DataTensor>(ReflessIndexVector{ params.n, 1, 1, 1, params.d });
+    for (DataTensor::Index t = 0; t < params.n; ++t)
+        for (DataTensor::Index i = 0; i < params.d; ++i)
+            data->data()(t, i) = normal(rng) + ((t >= params.n / 2 && t < params.n / 2 + params.n / 20) ? 3 : 0);
+    return data;
+}
+
+/**
+* Generates a fixed set of random intervals with lengths between 10 and 100 time steps.
+*/
+static std::vector<IndexRange> makeRanges(const DataTensor & data, std::size_t numRanges = 256)
+{
+    std::mt19937 rng(7);
+    DataTensor::Index maxLen = std::max(std::min(static_cast<DataTensor::Index>(100), data.length() / 4), static_cast<DataTensor::Index>(10));
+    std::uniform_int_distribution<DataTensor::Index> lenDist(10, maxLen);
+    std::vector<IndexRange> ranges;
+    ranges.reserve(numRanges);
+    for (std::size_t i = 0; i < numRanges; ++i)
+    {
+        DataTensor::Index len = lenDist(rng);
+        DataTensor::Index start = std::uniform_int_distribution<DataTensor::Index>(0, data.length() - len)(rng);
+        IndexRange range(data.makeIndexVector(start), data.makeIndexVector(start + len));
+        range.b.x = data.width();
+        range.b.y = data.height();
+        range.b.z = data.depth();
+        range.b.d = data.numAttrib();
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+
+//-------------------//
+// Benchmark factory //
+//-------------------//
+
+/**
+* Creates a benchmark of a density estimator which fits the estimator to a set of random intervals and computes
+* the log-likelihood of the data under the fitted distributions in parallel.
+*/
+static BenchmarkSetup estimatorFitBenchmark(std::function<std::shared_ptr<DensityEstimator>()> factory)
+{
+    return [factory](const BenchmarkParams & params) -> BenchmarkOperation
+    {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<DensityEstimator> estimator = factory();
+        estimator->init(data);
+        std::shared_ptr< std::vector<IndexRange> > ranges = std::make_shared< std::vector<IndexRange> >(makeRanges(*data));
+        return [estimator, ranges]()
+        {
+            long numRanges = ranges->size();
+            #pragma omp parallel
+            {
+                std::shared_ptr<DensityEstimator> localEstimator = estimator->clone();
+                volatile Scalar sink = 0;
+                #pragma omp for schedule(static)
+                for (long i = 0; i < numRanges; ++i)
+                {
+                    localEstimator->fit((*ranges)[i]);
+                    sink = sink + localEstimator->logLikelihood().first;
+                }
+            }
+            return static_cast<unsigned long long>(numRanges);
+        };
+    };
+}
+
+/**
+* Creates a benchmark of a density estimator which measures the time needed for initialization,
+* e.g., for computing cumulative sums.
+*/
+static BenchmarkSetup estimatorInitBenchmark(std::function<std::shared_ptr<DensityEstimator>()> factory)
+{
+    return [factory](const BenchmarkParams & params) -> BenchmarkOperation
+    {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<DensityEstimator> estimator = factory();
+        return [estimator, data]()
+        {
+            estimator->init(data);
+            estimator->reset();
+            return static_cast<unsigned long long>(data->numSamples());
+        };
+    };
+}
+
+/**
+* Creates a benchmark of a divergence which scores a set of random intervals in parallel.
+*/
+static BenchmarkSetup divergenceBenchmark(std::function<std::shared_ptr<Divergence>()> factory)
+{
+    return [factory](const BenchmarkParams & params) -> BenchmarkOperation
+    {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<Divergence> divergence = factory();
+        divergence->init(data);
+        std::shared_ptr< std::vector<IndexRange> > ranges = std::make_shared< std::vector<IndexRange> >(makeRanges(*data));
+        return [divergence, ranges]()
+        {
+            long numRanges = ranges->size();
+            #pragma omp parallel
+            {
+                std::shared_ptr<Divergence> localDivergence = divergence->clone();
+                volatile Scalar sink = 0;
+                #pragma omp for schedule(static)
+                for (long i = 0; i < numRanges; ++i)
+                    sink = sink + (*localDivergence)((*ranges)[i]);
+            }
+            return static_cast<unsigned long long>(numRanges);
+        };
+    };
+}
+
+/**
+* Creates a benchmark of a pre-processor applied to the entire data set.
+*/
+static BenchmarkSetup preprocessingBenchmark(std::function<std::shared_ptr<Preprocessor>(const BenchmarkParams &)> factory)
+{
+    return [factory](const BenchmarkParams & params) -> BenchmarkOperation
+    {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<Preprocessor> preproc = factory(params);
+        std::shared_ptr<DataTensor> out = std::make_shared<DataTensor>();
+        return [preproc, data, out]()
+        {
+            (*preproc)(*data, *out);
+            return static_cast<unsigned long long>(data->numSamples());
+        };
+    };
+}
+
+
+//-----------------------//
+// Benchmark registry    //
+//-----------------------//
+
+static std::vector<Benchmark> createBenchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+
+    // Density estimators
+    std::vector< std::pair< std::string, std::function<std::shared_ptr<DensityEstimator>()> > > estimators = {
+        { "KernelDensityEstimator", []() { return std::make_shared<KernelDensityEstimator>(); } },
+        { "GaussianDensityEstimator/FULL", []() { return std::make_shared<GaussianDensityEstimator>(GaussianDensityEstimator::CovMode::FULL); } },
+        { "GaussianDensityEstimator/SHARED", []() { return std::make_shared<GaussianDensityEstimator>(GaussianDensityEstimator::CovMode::SHARED); } },
+        { "GaussianDensityEstimator/ID", []() { return std::make_shared<GaussianDensityEstimator>(GaussianDensityEstimator::CovMode::ID); } },
+        { "EnsembleOfRandomProjectionHistograms", []() { return std::make_shared<EnsembleOfRandomProjectionHistograms>(); } }
+    };
+    for (const auto & estimator : estimators)
+    {
+        benchmarks.push_back({ "estimator/" + estimator.first + "/init", estimatorInitBenchmark(estimator.second), false });
+        benchmarks.push_back({ "estimator/" + estimator.first + "/fit", estimatorFitBenchmark(estimator.second), true });
+    }
+
+    // Divergences
+    benchmarks.push_back({ "divergence/KLDivergence/I_OMEGA", divergenceBenchmark([]() {
+        return std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::I_OMEGA);
+    }), true });
+    benchmarks.push_back({ "divergence/KLDivergence/OMEGA_I", divergenceBenchmark([]() {
+        return std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::OMEGA_I);
+    }), true });
+    benchmarks.push_back({ "divergence/KLDivergence/SYM", divergenceBenchmark([]() {
+        return std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::SYM);
+    }), true });
+    benchmarks.push_back({ "divergence/KLDivergence/UNBIASED", divergenceBenchmark([]() {
+        return std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::UNBIASED);
+    }), true });
+    benchmarks.push_back({ "divergence/CrossEntropy", divergenceBenchmark([]() {
+        return std::make_shared<CrossEntropy>(std::make_shared<GaussianDensityEstimator>());
+    }), true });
+    benchmarks.push_back({ "divergence/JSDivergence", divergenceBenchmark([]() {
+        return std::make_shared<JSDivergence>(std::make_shared<GaussianDensityEstimator>());
+    }), true });
+
+    // Pre-processors
+    benchmarks.push_back({ "preproc/Normalizer", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<Normalizer>();
+    }), false });
+    benchmarks.push_back({ "preproc/LinearDetrending", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<LinearDetrending>(1);
+    }), false });
+    benchmarks.push_back({ "preproc/OLSDetrending", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<OLSDetrending>(OLSDetrending::Period{ 12, 1 });
+    }), false });
+    benchmarks.push_back({ "preproc/ZScoreDeseasonalization", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<ZScoreDeseasonalization>(12);
+    }), false });
+    benchmarks.push_back({ "preproc/TimeDelayEmbedding", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<TimeDelayEmbedding>(3, 1);
+    }), false });
+    benchmarks.push_back({ "preproc/TimeDelayEmbedding/auto", preprocessingBenchmark([](const BenchmarkParams &) {
+        return std::make_shared<TimeDelayEmbedding>();
+    }), false });
+    benchmarks.push_back({ "preproc/PCAProjection", preprocessingBenchmark([](const BenchmarkParams & params) {
+        return std::make_shared<PCAProjection>(std::max(params.d / 2, static_cast<DataTensor::Index>(1)));
+    }), false });
+    benchmarks.push_back({ "preproc/SparseRandomProjection", preprocessingBenchmark([](const BenchmarkParams & params) {
+        return std::make_shared<SparseRandomProjection>(std::max(params.d / 2, static_cast<DataTensor::Index>(1)));
+    }), false });
+
+    // Cumulative sums over the time axis
+    benchmarks.push_back({ "DataTensor/cumsum", [](const BenchmarkParams & params) -> BenchmarkOperation {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<DataTensor> work = std::make_shared<DataTensor>(*data);
+        return [data, work]()
+        {
+            work->data() = data->data();
+            work->cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+            return static_cast<unsigned long long>(data->numEl());
+        };
+    }, false });
+
+    // Insertion into a list of detections with online non-maximum suppression
+    benchmarks.push_back({ "MaximumDetectionList/insert", [](const BenchmarkParams & params) -> BenchmarkOperation {
+        std::shared_ptr<const DataTensor> data = makeData(params);
+        std::shared_ptr<DetectionList> detections = std::make_shared<DetectionList>();
+        std::mt19937 rng(13);
+        std::uniform_real_distribution<Scalar> scoreDist;
+        for (const IndexRange & range : makeRanges(*data, params.n))
+            detections->push_back(Detection(range, scoreDist(rng)));
+        return [detections]()
+        {
+            MaximumDetectionList list;
+            for (const Detection & detection : *detections)
+                list.insert(detection);
+            return static_cast<unsigned long long>(detections->size());
+        };
+    }, false });
+
+    return benchmarks;
+}
+
+
+//------------------//
+// Benchmark runner //
+//------------------//
+
+static BenchmarkResult runBenchmark(const Benchmark & benchmark, const BenchmarkParams & params, double minTime)
+{
+    #ifdef _OPENMP
+    omp_set_num_threads(params.threads);
+    #endif
+
+    BenchmarkOperation op = benchmark.setup(params);
+    op(); // warm-up
+
+    // Double the number of iterations until the minimum time has elapsed
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.params = params;
+    unsigned long long numItems = 0;
+    double elapsed = 0;
+    for (unsigned long long iterations = 1; ; iterations *= 2)
+    {
+        numItems = 0;
+        auto start = high_resolution_clock::now();
+        for (unsigned long long i = 0; i < iterations; ++i)
+            numItems += op();
+        elapsed = duration_cast< duration<double> >(high_resolution_clock::now() - start).count();
+        result.iterations = iterations;
+        if (elapsed >= minTime)
+            break;
+    }
+    result.realTime = elapsed / result.iterations;
+    result.itemsPerSecond = (elapsed > 0) ? numItems / elapsed : 0;
+    return result;
+}
+
+static void writeJSON(std::ostream & out, const std::vector<BenchmarkResult> & results)
+{
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    #ifdef _OPENMP
+    int maxThreads = omp_get_num_procs();
+    #else
+    int maxThreads = 1;
+    #endif
+
+    out << "{" << endl
+        << "  \"context\": {" << endl
+        << "    \"date\": \"" << date << "\"," << endl
+        << "    \"num_cpus\": " << maxThreads << "," << endl
+        << "    \"scalar\": \"" << ((sizeof(Scalar) == sizeof(float)) ? "float" : "double") << "\"," << endl
+        << "    \"kde_cumulative_size_limit\": " << MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT << "," << endl
+        << "    \"nmp_limit\": " << MAXDIV_NMP_LIMIT << "," << endl
+        << "    \"kernel_tile_size\": " << MAXDIV_KERNEL_TILE_SIZE << endl
+        << "  }," << endl
+        << "  \"benchmarks\": [" << endl;
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult & result = results[i];
+        out << "    {"
+            << "\"name\": \"" << result.name << "/n:" << result.params.n << "/d:" << result.params.d << "/threads:" << result.params.threads << "\", "
+            << "\"benchmark\": \"" << result.name << "\", "
+            << "\"n\": " << result.params.n << ", "
+            << "\"d\": " << result.params.d << ", "
+            << "\"threads\": " << result.params.threads << ", "
+            << "\"iterations\": " << result.iterations << ", "
+            << "\"real_time\": " << result.realTime * 1000 << ", "
+            << "\"time_unit\": \"ms\", "
+            << "\"items_per_second\": " << result.itemsPerSecond
+            << "}" << ((i + 1 < results.size()) ? "," : "") << endl;
+    }
+    out << "  ]" << endl << "}" << endl;
+}
+
+
+int main(int argc, char * argv[])
+{
+    std::vector<DataTensor::Index> lengths = { 1000, 5000 }, dims = { 1, 10 }, threads = { 1 };
+    #ifdef _OPENMP
+    if (omp_get_max_threads() > 1)
+        threads.push_back(omp_get_max_threads());
+    #endif
+    double minTime = 0.5;
+    std::string filter, outFile;
+
+    // Parse options
+    int c = 0;
+    char * conv_end;
+    while (c != -1)
+    {
+        static struct option long_options[] =
+        {
+            {"help",        no_argument,        NULL,       'h'},
+            {"filter",      required_argument,  NULL,       'f'},
+            {"lengths",     required_argument,  NULL,       'n'},
+            {"dims",        required_argument,  NULL,       'd'},
+            {"threads",     required_argument,  NULL,       't'},
+            {"min_time",    required_argument,  NULL,       'm'},
+            {"out",         required_argument,  NULL,       'o'},
+            {0, 0, 0, 0}
+        };
+
+        int option_index = 0;
+        c = getopt_long(argc, argv, "hf:n:d:t:m:o:", long_options, &option_index);
+        switch (c)
+        {
+            case 'h':
+                printHelp(argv[0]);
+                return 0;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'n':
+                if (!parseList(optarg, lengths))
+                {
+                    cerr << "Invalid value specified for option --lengths" << endl;
+                    return 1;
+                }
+                break;
+            case 'd':
+                if (!parseList(optarg, dims))
+                {
+                    cerr << "Invalid value specified for option --dims" << endl;
+                    return 1;
+                }
+                break;
+            case 't':
+                if (!parseList(optarg, threads))
+                {
+                    cerr << "Invalid value specified for option --threads" << endl;
+                    return 1;
+                }
+                break;
+            case 'm':
+                minTime = strtod(optarg, &conv_end);
+                if (conv_end == NULL || *conv_end != '\0' || minTime < 0)
+                {
+                    cerr << "Invalid value specified for option --min_time" << endl;
+                    return 1;
+                }
+                break;
+            case 'o':
+                outFile = optarg;
+                break;
+            case '?':
+                return 1;
+        }
+    }
+
+    // Run benchmarks
+    std::vector<BenchmarkResult> results;
+    for (const Benchmark & benchmark : createBenchmarks())
+    {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+            continue;
+        for (DataTensor::Index n : lengths)
+            for (DataTensor::Index d : dims)
+                for (DataTensor::Index numThreads : threads)
+                {
+                    if (!benchmark.threaded && numThreads != threads.front())
+                        continue;
+                    BenchmarkParams params = { n, d, static_cast<int>((benchmark.threaded) ? numThreads : 1) };
+                    results.push_back(runBenchmark(benchmark, params, minTime));
+                    cerr << benchmark.name << "/n:" << n << "/d:" << d << "/threads:" << params.threads
+                         << "\t" << results.back().realTime * 1000 << " ms" << endl;
+                }
+    }
+
+    // Write results
+    if (outFile.empty())
+        writeJSON(cout, results);
+    else
+    {
+        std::ofstream out(outFile);
+        if (!out)
+        {
+            cerr << "Could not open output file: " << outFile << endl;
+            return 1;
+        }
+        writeJSON(out, results);
+    }
+    return 0;
+}
+
+
+bool parseList(const char * str, std::vector<DataTensor::Index> & values)
+{
+    std::vector<std::string> tokens;
+    splitString(str, ",", tokens);
+    values.clear();
+    for (const std::string & token : tokens)
+    {
+        char * conv_end;
+        unsigned long value = strtoul(token.c_str(), &conv_end, 10);
+        if (conv_end == NULL || *conv_end != '\0' || value == 0)
+            return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+
+void printHelp(const char * progName)
+{
+    cout << progName << " [options]" << endl
+         << endl
+         << "Runs micro-benchmarks of the components of libmaxdiv on random data and writes the" << endl
+         << "results as JSON to stdout. Progress is reported on stderr." << endl
+         << endl
+         << "Each benchmark is run for every combination of the given series lengths, numbers of" << endl
+         << "attributes and numbers of threads. Benchmarks which do not use multiple threads are" << endl
+         << "only run once per length and number of attributes." << endl
+         << endl
+         << "OPTIONS:" << endl
+         << endl
+         << "    --filter <str>, -f <str>" << endl
+         << "        Only run benchmarks whose name contains the given string." << endl
+         << endl
+         << "    --lengths <list>, -n <list> (default: 1000,5000)" << endl
+         << "        Comma-separated list of numbers of time steps." << endl
+         << endl
+         << "    --dims <list>, -d <list> (default: 1,10)" << endl
+         << "        Comma-separated list of numbers of attributes." << endl
+         << endl
+         << "    --threads <list>, -t <list> (default: 1 and the maximum number of threads)" << endl
+         << "        Comma-separated list of numbers of threads." << endl
+         << endl
+         << "    --min_time <float>, -m <float> (default: 0.5)" << endl
+         << "        Minimum number of seconds each benchmark is repeated for." << endl
+         << endl
+         << "    --out <file>, -o <file>" << endl
+         << "        Write the results to the given file instead of stdout." << endl
+         << endl
+         << "    --help, -h" << endl
+         << "        Show this help message." << endl;
+}
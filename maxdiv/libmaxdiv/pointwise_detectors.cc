@@ -37,26 +37,25 @@ DataTensor MaxDiv::hotellings_t(const DataTensor & data)
     }
     else
     {
-        // Multivariate case: score = (x - mu)^T * S^-1 * (x - mu)
-        ScalarMatrix normed;
-        
+        // Multivariate case: score = (x - mu)^T * S^-1 * (x - mu) = ||L^-1 * (x - mu)||^2 with S = L * L^T
         {
             // Compute covariance matrix S
-            ScalarMatrix cov;
-            cov.noalias() = centered.data().transpose() * centered.data();
+            ScalarMatrix cov = ScalarMatrix::Zero(data.shape().d, data.shape().d);
+            cov.selfadjointView<Eigen::Lower>().rankUpdate(centered.data().transpose());
+            cov.triangularView<Eigen::StrictlyUpper>() = cov.transpose();
             cov /= static_cast<Scalar>(centered.numValidSamples());
             
-            // Compute S^-1 * (x - mu)
+            // Whiten the centered samples in-place: (x - mu)^T * L^-T
             Eigen::LLT<ScalarMatrix> llt;
             cholesky(cov, &llt);
-            normed = llt.solve(centered.data().transpose());
+            llt.matrixU().solveInPlace<Eigen::OnTheRight>(centered.data());
         }
         
-        // Create tensor for scores and compute (x - mu)^T * (S^-1 * (x - mu))
+        // Create tensor for scores and compute the squared norms of the whitened samples
         ReflessIndexVector scoresShape = data.shape();
         scoresShape.d = 1;
         DataTensor scores(scoresShape);
-        scores.data() = centered.data().transpose().cwiseProduct(normed).colwise().sum().transpose();
+        scores.data() = centered.data().rowwise().squaredNorm();
         scores.copyMask(data);
         return scores;
     }
@@ -17,29 +17,52 @@
 
 #include "preproc.h"
 #include "math_utils.h"
+#include "utils.h"
 #include <algorithm>
+#include <limits>
 #include <random>
 #include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
 #include <Eigen/QR>
 #include <Eigen/Cholesky>
 #include <Eigen/Eigenvalues>
 #include <Eigen/SparseCore>
+#include <unsupported/Eigen/FFT>
 using namespace MaxDiv;
 
 DataTensor & PreprocessingPipeline::operator()(DataTensor & data) const
 {
-    if (this->m_timing.empty())
+    return this->apply(data, nullptr);
+}
+
+DataTensor & PreprocessingPipeline::operator()(DataTensor & data, EmbeddedSeries & embedded) const
+{
+    return this->apply(data, &embedded);
+}
+
+DataTensor & PreprocessingPipeline::apply(DataTensor & data, EmbeddedSeries * embedded) const
+{
+    const TimeDelayEmbedding * embedding = nullptr;
+    if (embedded != nullptr)
     {
-        for (const_iterator prep = this->begin(); prep != this->end(); ++prep)
-            (**prep)(data, data);
+        embedded->series.reset();
+        if (!this->empty())
+            embedding = dynamic_cast<const TimeDelayEmbedding*>(this->back().get());
     }
-    else
+    
+    std::size_t i = 0;
+    for (const_iterator prep = this->begin(); prep != this->end(); ++prep, ++i)
     {
-        std::size_t i = 0;
-        for (const_iterator prep = this->begin(); prep != this->end(); ++prep, ++i)
-        {
-            auto start = std::chrono::high_resolution_clock::now();
+        auto start = std::chrono::high_resolution_clock::now();
+        if (embedding != nullptr && prep + 1 == this->end())
+            (*embedding)(data, data, *embedded);
+        else
             (**prep)(data, data);
+        if (!this->m_timing.empty())
+        {
             auto stop = std::chrono::high_resolution_clock::now();
             this->m_timing[i] = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() / 1000.f;
         }
@@ -71,6 +94,15 @@ DataTensor & TimeDelayEmbedding::operator()(const DataTensor & dataIn, DataTenso
     return (dataOut = time_delay_embedding(dataIn, params.first, params.second, this->borderPolicy));
 };
 
+DataTensor & TimeDelayEmbedding::operator()(const DataTensor & dataIn, DataTensor & dataOut, EmbeddedSeries & embedded) const
+{
+    std::pair<int, int> params = this->getEmbeddingParams(dataIn);
+    embedded.series = std::make_shared<DataTensor>(time_delay_padding(dataIn, params.first, params.second, this->borderPolicy));
+    embedded.k = params.first;
+    embedded.T = params.second;
+    return (dataOut = time_delay_embedding(dataIn, params.first, params.second, this->borderPolicy));
+};
+
 ReflessIndexVector TimeDelayEmbedding::borderSize(const DataTensor & data) const
 {
     ReflessIndexVector bs;
@@ -106,130 +138,270 @@ std::pair<int, int> TimeDelayEmbedding::getEmbeddingParams(const DataTensor & da
     return std::make_pair(k, T);
 };
 
-int TimeDelayEmbedding::determineContextWindowSize(const DataTensor & data) const
+/**
+* Computes the linear cross-correlations `c(d) = sum_t a(t + d) * b(t)` for several pairs of real-valued signals
+* given their discrete Fourier transforms, which must have been computed with sufficient zero-padding to avoid
+* circular overlap of the lags of interest.
+*
+* Since the results are real-valued, two pairs are processed at once by a single complex inverse transform.
+*
+* @param[in] fft FFT object used for the inverse transforms.
+*
+* @param[in] spectra Matrix with the spectra of the signals in its columns.
+*
+* @param[in] pairs Vector of pairs of column indices `(a, b)` in @p spectra.
+*
+* @param[in] maxLag The maximum absolute lag to retrieve the cross-correlation for.
+*
+* @param[out] corr Matrix which will receive the cross-correlation of each pair in the corresponding column.
+* The row `maxLag + d` contains the correlation at lag `d` for `-maxLag <= d <= maxLag`.
+*/
+static void lagged_cross_correlations(Eigen::FFT<double> & fft, const Eigen::MatrixXcd & spectra,
+                                      const std::vector< std::pair<int, int> > & pairs, int maxLag,
+                                      Eigen::MatrixXd & corr)
 {
-    DataTensor::Index na = data.numAttrib();
+    const Eigen::Index nfft = spectra.rows();
+    const std::complex<double> imag(0, 1);
+    Eigen::VectorXcd prod(nfft), xcorr(nfft);
+    corr.resize(2 * maxLag + 1, pairs.size());
+    for (std::size_t i = 0; i < pairs.size(); i += 2)
+    {
+        const std::pair<int, int> & p1 = pairs[i];
+        const std::pair<int, int> & p2 = pairs[std::min(i + 1, pairs.size() - 1)];
+        prod = spectra.col(p1.first).cwiseProduct(spectra.col(p1.second).conjugate())
+             + imag * spectra.col(p2.first).cwiseProduct(spectra.col(p2.second).conjugate());
+        fft.inv(xcorr.data(), prod.data(), nfft);
+        for (int d = -maxLag; d <= maxLag; ++d)
+        {
+            const std::complex<double> & c = xcorr((d >= 0) ? d : nfft + d);
+            corr(maxLag + d, i) = c.real();
+            if (i + 1 < pairs.size())
+                corr(maxLag + d, i + 1) = c.imag();
+        }
+    }
+}
+
+/**
+* Determines the context window size for a single spatial location according to
+* `TimeDelayEmbedding::determineContextWindowSize()`.
+*
+* The sums of lagged outer products required for the covariance matrices of all lags are obtained at once from
+* cross-correlations computed via FFT. For locations with missing samples, the sums over the samples which are
+* jointly valid at a certain lag are obtained from cross-correlations with the indicator of valid samples.
+* The mutual information is evaluated lag by lag until the threshold criterion is met.
+*
+* @return Returns the context window size or 0 if the location has too few valid samples.
+*/
+static int context_window_size_at_location(const DataTensor & data, const DataTensor::Mask & mask,
+                                           DataTensor::Index loc, int numLags, Scalar opt_th,
+                                           Eigen::Index nfft, Eigen::FFT<double> & fft)
+{
+    const Eigen::Index len = data.length(), na = data.numAttrib();
+    const int maxLag = numLags - 1;
+    const auto ts = data.asTemporalMatrix().middleCols(loc * na, na);
+    const auto tsMask = mask.asTemporalMatrix();
     
-    // Compute sum along time dimension
-    ReflessIndexVector flatShape = data.shape();
-    flatShape.t = 1;
-    DataTensor sum(flatShape);
-    sum.asTemporalMatrix() = data.asTemporalMatrix().colwise().sum();
+    // Gather valid samples, centred by their mean, and zero-pad them
+    Eigen::MatrixXd x = Eigen::MatrixXd::Zero(nfft, na);
+    Eigen::VectorXd valid = Eigen::VectorXd::Zero(nfft);
+    Eigen::Index numValid = 0;
+    for (Eigen::Index t = 0; t < len; ++t)
+        if (mask.empty() || !tsMask(t, loc))
+        {
+            x.row(t) = ts.row(t).cast<double>();
+            valid(t) = 1;
+            ++numValid;
+        }
+    if (numValid < 2)
+        return 0;
+    const bool hasMissing = (numValid < len);
+    const Eigen::RowVectorXd mean = x.topRows(len).colwise().sum() / numValid;
+    for (Eigen::Index t = 0; t < len; ++t)
+        if (valid(t) != 0)
+            x.row(t) -= mean;
+    const Eigen::VectorXd sum = x.topRows(len).colwise().sum().transpose();
     
-    // Get missing sample mask
-    DataTensor::Mask mask;
-    if (data.hasMissingSamples())
-        data.getMask(mask);
+    // Both regions cropped from the series must retain some valid samples for all lags
+    Eigen::Index numValidLeft = (valid.head(maxLag).array() != 0).count();
+    Eigen::Index numValidRight = (valid.segment(len - maxLag, maxLag).array() != 0).count();
+    if (numValid <= numValidLeft || numValid <= numValidRight)
+        return 0;
+    
+    // Compute spectra of all attributes and of the indicator of valid samples
+    Eigen::MatrixXcd spectra(nfft, na + 1);
+    for (Eigen::Index a = 0; a < na; ++a)
+        fft.fwd(spectra.col(a).data(), x.col(a).data(), nfft);
+    if (hasMissing)
+        fft.fwd(spectra.col(na).data(), valid.data(), nfft);
     
-    // Compute mutual information for each location and various distances
-    flatShape.d = std::min(data.length() / 20, this->maxContextWindowSize);
-    DataTensor mi(flatShape);
-    mi.channel(0).setConstant(1); // valid location indicator
-    DataTensor::Index numValidSamples, numValidLeft, numValidRight, numValidJoint;
-    Sample sumLeft(na), sumRight(na), mean(2 * na), centered(2 * na);
-    ScalarMatrix cov(2 * na, 2 * na);
-    ScalarMatrix indepCov = ScalarMatrix::Zero(2 * na, 2 * na);
-    Scalar covLogDet, indepCovLogDet;
-    Eigen::LLT<ScalarMatrix> indepCovChol;
-    for (IndexVector loc = mi.makeIndexVector(); loc.t < loc.shape.t; ++loc)
-        if (loc.d == 0)
+    // Compute lagged cross-correlations between all pairs of attributes, which provide the sums of the
+    // off-diagonal blocks of the joint covariance matrices.
+    std::vector< std::pair<int, int> > pairs;
+    for (int i = 0; i < na; ++i)
+        for (int j = i; j < na; ++j)
+            pairs.push_back(std::make_pair(i, j));
+    auto pairIndex = [na](Eigen::Index i, Eigen::Index j) { return i * na - i * (i - 1) / 2 + j - i; };
+    Eigen::MatrixXd crossCorr, validCorr, squareCorr;
+    lagged_cross_correlations(fft, spectra, pairs, maxLag, crossCorr);
+    
+    if (hasMissing)
+    {
+        // Correlate samples and their outer products with the indicator of valid samples to obtain the sums of
+        // the samples and the diagonal blocks of the covariance matrices over the jointly valid time steps.
+        std::vector< std::pair<int, int> > validPairs;
+        for (int a = 0; a <= na; ++a)
+            validPairs.push_back(std::make_pair(a, static_cast<int>(na)));
+        lagged_cross_correlations(fft, spectra, validPairs, maxLag, validCorr);
+        for (int d = 1; d < numLags; ++d)
+            if (std::round(validCorr(maxLag + d, na)) < 2)
+                return 0;
+        
+        squareCorr.resize(2 * maxLag + 1, pairs.size());
+        Eigen::MatrixXcd squareSpectra(nfft, na + 1);
+        squareSpectra.col(na) = spectra.col(na);
+        Eigen::VectorXd square(nfft);
+        Eigen::MatrixXd corr;
+        for (int i = 0; i < na; ++i)
+        {
+            validPairs.clear();
+            for (int j = i; j < na; ++j)
+            {
+                square = x.col(i).cwiseProduct(x.col(j));
+                fft.fwd(squareSpectra.col(j - i).data(), square.data(), nfft);
+                validPairs.push_back(std::make_pair(j - i, static_cast<int>(na)));
+            }
+            lagged_cross_correlations(fft, squareSpectra, validPairs, maxLag, corr);
+            squareCorr.middleCols(pairIndex(i, i), na - i) = corr;
+        }
+    }
+    
+    // Compute mutual information for increasing distances until the negative gradient of the
+    // relative mutual information falls below the threshold
+    const Eigen::MatrixXd sumSquares = x.topRows(len).transpose() * x.topRows(len);
+    Eigen::VectorXd sumLeft = Eigen::VectorXd::Zero(na), sumRight = Eigen::VectorXd::Zero(na);
+    Eigen::MatrixXd sqLeft = Eigen::MatrixXd::Zero(na, na), sqRight = Eigen::MatrixXd::Zero(na, na);
+    Eigen::VectorXd meanCurrent(na), meanDelayed(na), jointSumCurrent(na), jointSumDelayed(na);
+    Eigen::MatrixXd cov(2 * na, 2 * na), indepCov = Eigen::MatrixXd::Zero(2 * na, 2 * na);
+    Eigen::LLT<Eigen::MatrixXd> indepCovChol;
+    double covLogDet, indepCovLogDet, numValidJoint;
+    std::vector<Scalar> mi(numLags, 0);
+    Scalar grad, minGrad = 1;
+    int minInd = 0;
+    numValidLeft = numValidRight = 0;
+    for (int d = 1; d < numLags; ++d)
+    {
+        // Sum up samples in cropped regions
+        if (valid(d - 1) != 0)
+        {
+            sumLeft += x.row(d - 1).transpose();
+            if (!hasMissing)
+                sqLeft.noalias() += x.row(d - 1).transpose() * x.row(d - 1);
+            ++numValidLeft;
+        }
+        if (valid(len - d) != 0)
+        {
+            sumRight += x.row(len - d).transpose();
+            if (!hasMissing)
+                sqRight.noalias() += x.row(len - d).transpose() * x.row(len - d);
+            ++numValidRight;
+        }
+        meanCurrent = (sum - sumLeft) / (numValid - numValidLeft);
+        meanDelayed = (sum - sumRight) / (numValid - numValidRight);
+        
+        // Obtain sums over the jointly valid samples
+        auto blockCurrent = cov.topLeftCorner(na, na);
+        auto blockDelayed = cov.bottomRightCorner(na, na);
+        auto blockCross = cov.topRightCorner(na, na);
+        if (hasMissing)
         {
-            sumLeft.setZero();
-            sumRight.setZero();
-            numValidSamples = (mask.empty()) ? data.length() : data.length() - mask.asTemporalMatrix().col(loc.prod(1, 3)).count();
-            numValidLeft = numValidRight = 0;
+            numValidJoint = std::round(validCorr(maxLag + d, na));
+            jointSumCurrent = validCorr.block(maxLag + d, 0, 1, na).transpose();
+            jointSumDelayed = validCorr.block(maxLag - d, 0, 1, na).transpose();
         }
         else
         {
-            // Sum up samples in cropped regions
-            if (mask.empty() || !mask({ loc.d - 1, loc.x, loc.y, loc.z, 0 }))
-            {
-                sumLeft += data(loc.d - 1, loc.x, loc.y, loc.z);
-                ++numValidLeft;
-            }
-            if (mask.empty() || !mask({ data.length() - loc.d, loc.x, loc.y, loc.z, 0 }))
-            {
-                sumRight += data(data.length() - loc.d, loc.x, loc.y, loc.z);
-                ++numValidRight;
-            }
-            
-            if (numValidSamples <= numValidLeft || numValidSamples <= numValidRight)
+            numValidJoint = len - d;
+            jointSumCurrent = sum - sumLeft;
+            jointSumDelayed = sum - sumRight;
+        }
+        for (Eigen::Index i = 0; i < na; ++i)
+            for (Eigen::Index j = 0; j < na; ++j)
             {
-                mi(loc) = 1;
-                mi({ loc.t, loc.x, loc.y, loc.z, 0 }) = 0; // indicate invalid location
-                continue;
-            }
-            
-            // Compute mean and covariance of joint distribution
-            mean.head(na) = (sum(0, loc.x, loc.y, loc.z) - sumLeft) / (numValidSamples - numValidLeft);
-            mean.tail(na) = (sum(0, loc.x, loc.y, loc.z) - sumRight) / (numValidSamples - numValidRight);
-            cov.setZero();
-            numValidJoint = 0;
-            for (DataTensor::Index t = loc.d; t < data.length(); ++t)
-                if (mask.empty() || (!mask({ t, loc.x, loc.y, loc.z, 0 }) && !mask({ t - loc.d, loc.x, loc.y, loc.z, 0 })))
+                blockCross(i, j) = (i <= j) ? crossCorr(maxLag + d, pairIndex(i, j)) : crossCorr(maxLag - d, pairIndex(j, i));
+                if (hasMissing && i <= j)
                 {
-                    centered.head(na) = data(t, loc.x, loc.y, loc.z);
-                    centered.tail(na) = data(t - loc.d, loc.x, loc.y, loc.z);
-                    centered -= mean;
-                    cov.noalias() += centered * centered.transpose();
-                    ++numValidJoint;
+                    blockCurrent(i, j) = blockCurrent(j, i) = squareCorr(maxLag + d, pairIndex(i, j));
+                    blockDelayed(i, j) = blockDelayed(j, i) = squareCorr(maxLag - d, pairIndex(i, j));
                 }
-            if (numValidJoint < 2)
+            }
+        if (!hasMissing)
+        {
+            blockCurrent = sumSquares - sqLeft;
+            blockDelayed = sumSquares - sqRight;
+        }
+        
+        // Compute covariance of joint distribution around the means of the cropped regions
+        blockCurrent -= meanCurrent * jointSumCurrent.transpose() + jointSumCurrent * meanCurrent.transpose() - numValidJoint * meanCurrent * meanCurrent.transpose();
+        blockDelayed -= meanDelayed * jointSumDelayed.transpose() + jointSumDelayed * meanDelayed.transpose() - numValidJoint * meanDelayed * meanDelayed.transpose();
+        blockCross -= meanCurrent * jointSumDelayed.transpose() + jointSumCurrent * meanDelayed.transpose() - numValidJoint * meanCurrent * meanDelayed.transpose();
+        cov.bottomLeftCorner(na, na) = blockCross.transpose();
+        cov /= numValidJoint - 1;
+        
+        // Set up covariance of independent distribution
+        indepCov.topLeftCorner(na, na) = cov.topLeftCorner(na, na);
+        indepCov.bottomRightCorner(na, na) = cov.bottomRightCorner(na, na);
+        
+        // Compute KL divergence between p(x_t, x_(t-d)) and p(x_t)*p(x_(t-d))
+        cholesky(cov, static_cast<Eigen::LLT<Eigen::MatrixXd>*>(nullptr), &covLogDet);
+        cholesky(indepCov, &indepCovChol, &indepCovLogDet);
+        mi[d] = static_cast<Scalar>((indepCovChol.solve(cov).trace() + indepCovLogDet - covLogDet - 2 * na) / 2);
+        assert(mi[d] >= 0);
+        
+        // Check negative gradient of relative mutual information at the previous distance
+        if (d >= 2)
+        {
+            // For compatibility, the gradient at distance 2 is taken with respect to the unnormalized mutual information at distance 1.
+            grad = ((d > 3) ? mi[d - 2] / mi[1] : ((d == 3) ? mi[1] : 1)) - mi[d] / mi[1];
+            if (grad <= opt_th)
+                return d;
+            if (grad < minGrad)
             {
-                mi(loc) = 1;
-                mi({ loc.t, loc.x, loc.y, loc.z, 0 }) = 0; // indicate invalid location
-                continue;
+                minGrad = grad;
+                minInd = d - 1;
             }
-            cov /= numValidJoint - 1;
-            
-            // Set up covariance of independent distribution
-            indepCov.block(0, 0, na, na) = cov.block(0, 0, na, na);
-            indepCov.block(na, na, na, na) = cov.block(na, na, na, na);
-            
-            // Compute KL divergence between p(x_t, x_(t-d)) and p(x_t)*p(x_(t-d))
-            cholesky(cov, static_cast<Eigen::LLT<ScalarMatrix>*>(nullptr), &covLogDet);
-            cholesky(indepCov, &indepCovChol, &indepCovLogDet);
-            mi(loc) = (indepCovChol.solve(cov).trace() + indepCovLogDet - covLogDet - 2 * na) / 2;
         }
-    assert((mi.data().array() >= 0).all());
+    }
+    return minInd + 1;
+}
+
+int TimeDelayEmbedding::determineContextWindowSize(const DataTensor & data) const
+{
+    const int numLags = static_cast<int>(std::min(data.length() / 20, this->maxContextWindowSize));
+    if (numLags < 3)
+        return 1;
     
-    // Normalize MI by dividing by the first value
-    for (DataTensor::Index d = 2; d < mi.numAttrib(); ++d)
-        mi.channel(d) = mi.channel(d).cwiseQuotient(mi.channel(1));
+    // Get missing sample mask
+    DataTensor::Mask mask;
+    if (data.hasMissingSamples())
+        data.getMask(mask);
+    data.asTemporalMatrix(); // make sure missing values have been set before accessing the data concurrently
     
-    // Compute negative gradient of relative mutual information
-    ScalarMatrix tmpChannel1 = ScalarMatrix::Constant(1, mi.numSamples(), 1);
-    ScalarMatrix tmpChannel2(1, mi.numSamples());
-    for (DataTensor::Index d = 1; d < mi.numAttrib() - 1; ++d)
-    {
-        tmpChannel2 = tmpChannel1 - mi.channel(d+1);
-        tmpChannel1 = mi.channel(d);
-        mi.channel(d) = tmpChannel2;
-    }
+    // Zero-pad the time series to size which is a power of 2 and avoids circular overlap of the lags of interest
+    Eigen::Index nfft = 1;
+    while (nfft < static_cast<Eigen::Index>(data.length()) + numLags)
+        nfft <<= 1;
     
-    // Select first context window size below threshold for each location
-    std::vector<int> cws;
-    cws.reserve(mi.numSamples());
-    for (DataTensor::Index loc = 0; loc < mi.numSamples(); ++loc)
+    // Determine context window size for each location
+    const DataTensor::Index numLocations = data.shape().prod(1, 3);
+    std::vector<int> cws(numLocations, 0);
+    #pragma omp parallel
     {
-        const auto sample = mi.sample(loc);
-        if (sample(0) != 0)
-        {
-            DataTensor::Index minInd = 0, d;
-            for (d = 1; d < mi.numAttrib() - 1; ++d)
-            {
-                if (sample(d) <= opt_th)
-                {
-                    cws.push_back(d + 1);
-                    break;
-                }
-                if (sample(d) < sample(minInd))
-                    minInd = d;
-            }
-            if (d >= mi.numAttrib() - 1)
-                cws.push_back(minInd + 1);
-        }
+        Eigen::FFT<double> fft;
+        #pragma omp for schedule(dynamic)
+        for (DataTensor::Index loc = 0; loc < numLocations; ++loc)
+            cws[loc] = context_window_size_at_location(data, mask, loc, numLags, this->opt_th, nfft, fft);
     }
+    cws.erase(std::remove(cws.begin(), cws.end(), 0), cws.end());
     
     // Return median context window size
     if (cws.empty())
@@ -322,6 +494,294 @@ DataTensor & LinearDetrending::operator()(const DataTensor & dataIn, DataTensor
 }
 
 
+namespace
+{
+
+/**
+* @brief Normal equations of the least squares problem solved by `OLSDetrending` without a dense design matrix
+*
+* The seasonal indicators of the period with the most seasonal units (the *primary* period) are mutually exclusive,
+* so that the coefficients of each of its seasons (the indicator and, optionally, its seasonal trend) only interact
+* with each other and with the remaining *dense* coefficients (intercept, linear trend and the other periods).
+* The normal equations `A^T * A * x = A^T * y` are hence block-structured: eliminating the small blocks of the
+* seasons leaves a Schur complement whose size is the number of dense coefficients only.
+*
+* The sums of the blocks are accumulated row by row from the closed-form entries of the design matrix, and
+* missing samples can be removed by subtracting their contributions.
+*/
+class SeasonalNormalEquations
+{
+public:
+
+    typedef std::vector< std::pair<DataTensor::Index, Scalar> > RowEntries; /**< Dense coefficients and values in a row of the design matrix. */
+
+    /**
+    * Accumulates the normal equations of the model specified by @p model for a time-series of the given @p length.
+    */
+    SeasonalNormalEquations(const OLSDetrending & model, DataTensor::Index length);
+    
+    /**
+    * Removes the time step @p t from the normal equations, e.g., because it is a missing sample.
+    * `factorize()` has to be called afterwards.
+    */
+    void removeSample(DataTensor::Index t, RowEntries & row);
+    
+    /**
+    * Eliminates the coefficients of the primary period and decomposes the Schur complement of the dense coefficients.
+    */
+    void factorize();
+    
+    /**
+    * Solves the normal equations for a given time-series @p y, ignoring the time steps in @p missing (which must
+    * be the ones removed by `removeSample()`), and subtracts the fitted model from @p y.
+    *
+    * @param[out] params Vector which will receive the coefficients in the order used by `OLSDetrending::getParams()`.
+    */
+    template<typename Derived>
+    void detrend(Eigen::DenseBase<Derived> & y, const std::vector<DataTensor::Index> & missing, Sample & params, RowEntries & row) const;
+
+
+protected:
+
+    /**
+    * Retrieves the row of the design matrix corresponding to time step @p t.
+    *
+    * @param[out] tau Value of the seasonal trend term of the primary period.
+    *
+    * @param[out] dense The non-zero dense coefficients of the row.
+    *
+    * @return Returns the season of the primary period which the time step belongs to.
+    */
+    DataTensor::Index row(DataTensor::Index t, Scalar & tau, RowEntries & dense) const;
+    
+    void addSample(DataTensor::Index t, Scalar weight, RowEntries & row);
+    
+    const OLSDetrending::PeriodVector & m_periods;
+    bool m_linearTrend;
+    bool m_seasonTrend;
+    DataTensor::Index m_length;
+    DataTensor::Index m_numSeasons; /**< Total number of seasonal units of all periods. */
+    std::size_t m_primary; /**< Index of the primary period. */
+    DataTensor::Index m_primaryOffset; /**< Index of the first coefficient of the primary period among all coefficients. */
+    std::vector<DataTensor::Index> m_denseIndex; /**< Maps coefficients not belonging to the primary period to dense coefficients. */
+    std::vector<DataTensor::Index> m_denseParams; /**< Maps dense coefficients back to all coefficients. */
+    
+    Sample m_count; /**< Number of samples per primary season. */
+    Sample m_tauSum; /**< Sum of the seasonal trend terms per primary season. */
+    Sample m_tauSqSum; /**< Sum of the squared seasonal trend terms per primary season. */
+    ScalarMatrix m_indicatorCross; /**< Sums of the dense terms per primary season. */
+    ScalarMatrix m_tauCross; /**< Sums of the products of the seasonal trend terms and the dense terms per primary season. */
+    ScalarMatrix m_dense; /**< Sums of the products of the dense terms. */
+    
+    Sample m_inv00, m_inv01, m_inv11; /**< (Pseudo-)inverses of the blocks of the primary seasons. */
+    ScalarMatrix m_indicatorSolved, m_tauSolved; /**< The cross terms multiplied with the inverses of the seasonal blocks. */
+    Eigen::CompleteOrthogonalDecomposition<ScalarMatrix> m_schur; /**< Decomposition of the Schur complement (may be rank-deficient). */
+
+};
+
+SeasonalNormalEquations::SeasonalNormalEquations(const OLSDetrending & model, DataTensor::Index length)
+: m_periods(model.periods), m_linearTrend(model.linear_trend), m_seasonTrend(model.linear_season_trend),
+  m_length(length), m_numSeasons(model.totalSeasonNum()), m_primary(0), m_primaryOffset(0)
+{
+    // Choose the period with the most seasonal units as primary period
+    for (std::size_t i = 1; i < this->m_periods.size(); ++i)
+        if (this->m_periods[i].num > this->m_periods[this->m_primary].num)
+            this->m_primary = i;
+    for (std::size_t i = 0; i < this->m_primary; ++i)
+        this->m_primaryOffset += this->m_periods[i].num;
+    this->m_primaryOffset += (this->m_linearTrend) ? 2 : 1;
+    
+    // Enumerate dense coefficients
+    DataTensor::Index numParams = model.getNumParams(), primaryNum = this->m_periods[this->m_primary].num, i;
+    this->m_denseIndex.assign(numParams, 0);
+    for (i = 0; i < numParams; ++i)
+        if ((i < this->m_primaryOffset || i >= this->m_primaryOffset + primaryNum)
+                && (!this->m_seasonTrend || i < this->m_primaryOffset + this->m_numSeasons || i >= this->m_primaryOffset + this->m_numSeasons + primaryNum))
+        {
+            this->m_denseIndex[i] = this->m_denseParams.size();
+            this->m_denseParams.push_back(i);
+        }
+    
+    // Accumulate normal equations
+    this->m_count.setZero(primaryNum);
+    this->m_indicatorCross.setZero(primaryNum, this->m_denseParams.size());
+    if (this->m_seasonTrend)
+    {
+        this->m_tauSum.setZero(primaryNum);
+        this->m_tauSqSum.setZero(primaryNum);
+        this->m_tauCross.setZero(primaryNum, this->m_denseParams.size());
+    }
+    this->m_dense.setZero(this->m_denseParams.size(), this->m_denseParams.size());
+    RowEntries row;
+    for (DataTensor::Index t = 0; t < length; ++t)
+        this->addSample(t, 1, row);
+}
+
+DataTensor::Index SeasonalNormalEquations::row(DataTensor::Index t, Scalar & tau, RowEntries & dense) const
+{
+    dense.clear();
+    dense.emplace_back(this->m_denseIndex[0], static_cast<Scalar>(1));
+    if (this->m_linearTrend)
+        dense.emplace_back(this->m_denseIndex[1], static_cast<Scalar>(t));
+    
+    DataTensor::Index offs = (this->m_linearTrend) ? 2 : 1, season = 0;
+    for (std::size_t i = 0; i < this->m_periods.size(); offs += this->m_periods[i].num, ++i)
+    {
+        DataTensor::Index ind = (t / this->m_periods[i].len) % this->m_periods[i].num;
+        Scalar periodTau = static_cast<Scalar>(t) / static_cast<Scalar>(this->m_periods[i].num);
+        if (i == this->m_primary)
+        {
+            season = ind;
+            tau = periodTau;
+        }
+        else
+        {
+            dense.emplace_back(this->m_denseIndex[offs + ind], static_cast<Scalar>(1));
+            if (this->m_seasonTrend)
+                dense.emplace_back(this->m_denseIndex[offs + this->m_numSeasons + ind], periodTau);
+        }
+    }
+    return season;
+}
+
+void SeasonalNormalEquations::addSample(DataTensor::Index t, Scalar weight, RowEntries & row)
+{
+    Scalar tau;
+    DataTensor::Index season = this->row(t, tau, row);
+    this->m_count(season) += weight;
+    if (this->m_seasonTrend)
+    {
+        this->m_tauSum(season) += weight * tau;
+        this->m_tauSqSum(season) += weight * tau * tau;
+    }
+    for (const auto & entry : row)
+    {
+        this->m_indicatorCross(season, entry.first) += weight * entry.second;
+        if (this->m_seasonTrend)
+            this->m_tauCross(season, entry.first) += weight * tau * entry.second;
+        for (const auto & other : row)
+            this->m_dense(entry.first, other.first) += weight * entry.second * other.second;
+    }
+}
+
+void SeasonalNormalEquations::removeSample(DataTensor::Index t, RowEntries & row)
+{
+    this->addSample(t, -1, row);
+}
+
+void SeasonalNormalEquations::factorize()
+{
+    // (Pseudo-)invert the blocks of the primary seasons. The sample counts are exact, so that blocks with
+    // less than two samples can be recognized as singular.
+    DataTensor::Index primaryNum = this->m_count.size(), j;
+    this->m_inv00.resize(primaryNum);
+    if (this->m_seasonTrend)
+    {
+        this->m_inv01.resize(primaryNum);
+        this->m_inv11.resize(primaryNum);
+    }
+    for (j = 0; j < primaryNum; ++j)
+    {
+        Scalar count = this->m_count(j);
+        if (!this->m_seasonTrend)
+            this->m_inv00(j) = (count > 0.5) ? 1 / count : 0;
+        else if (count < 0.5)
+            this->m_inv00(j) = this->m_inv01(j) = this->m_inv11(j) = 0;
+        else if (count < 1.5)
+        {
+            // The block v * v^T with v = [1, tau] has the pseudo-inverse v * v^T / |v|^4
+            Scalar tau = this->m_tauSum(j), norm = 1 + tau * tau;
+            norm *= norm;
+            this->m_inv00(j) = 1 / norm;
+            this->m_inv01(j) = tau / norm;
+            this->m_inv11(j) = tau * tau / norm;
+        }
+        else
+        {
+            Scalar det = count * this->m_tauSqSum(j) - this->m_tauSum(j) * this->m_tauSum(j);
+            this->m_inv00(j) = this->m_tauSqSum(j) / det;
+            this->m_inv01(j) = -this->m_tauSum(j) / det;
+            this->m_inv11(j) = count / det;
+        }
+    }
+    
+    // Schur complement of the dense coefficients
+    this->m_indicatorSolved.noalias() = this->m_inv00.asDiagonal() * this->m_indicatorCross;
+    ScalarMatrix schur = this->m_dense;
+    if (this->m_seasonTrend)
+    {
+        this->m_indicatorSolved.noalias() += this->m_inv01.asDiagonal() * this->m_tauCross;
+        this->m_tauSolved.noalias() = this->m_inv01.asDiagonal() * this->m_indicatorCross;
+        this->m_tauSolved.noalias() += this->m_inv11.asDiagonal() * this->m_tauCross;
+        schur.noalias() -= this->m_tauCross.transpose() * this->m_tauSolved;
+    }
+    schur.noalias() -= this->m_indicatorCross.transpose() * this->m_indicatorSolved;
+    
+    // The intercept is the sum of the indicators of each period, so that the Schur complement is rank-deficient
+    this->m_schur.compute(schur);
+}
+
+template<typename Derived>
+void SeasonalNormalEquations::detrend(Eigen::DenseBase<Derived> & y, const std::vector<DataTensor::Index> & missing, Sample & params, RowEntries & row) const
+{
+    DataTensor::Index primaryNum = this->m_count.size(), t;
+    Scalar tau;
+    
+    // Right-hand side of the normal equations: A^T * y
+    Sample indicatorRhs = Sample::Zero(primaryNum), tauRhs, denseRhs = Sample::Zero(this->m_denseParams.size());
+    if (this->m_seasonTrend)
+        tauRhs.setZero(primaryNum);
+    auto addRhs = [&](DataTensor::Index t, Scalar weight)
+    {
+        DataTensor::Index season = this->row(t, tau, row);
+        Scalar value = weight * y(t);
+        indicatorRhs(season) += value;
+        if (this->m_seasonTrend)
+            tauRhs(season) += tau * value;
+        for (const auto & entry : row)
+            denseRhs(entry.first) += entry.second * value;
+    };
+    for (t = 0; t < this->m_length; ++t)
+        addRhs(t, 1);
+    for (DataTensor::Index missingTime : missing)
+        addRhs(missingTime, -1);
+    
+    // Solve for the dense coefficients via the Schur complement and then for the seasonal ones
+    Sample indicatorCoeffs = this->m_inv00.cwiseProduct(indicatorRhs), tauCoeffs;
+    if (this->m_seasonTrend)
+    {
+        indicatorCoeffs += this->m_inv01.cwiseProduct(tauRhs);
+        tauCoeffs = this->m_inv01.cwiseProduct(indicatorRhs) + this->m_inv11.cwiseProduct(tauRhs);
+        denseRhs.noalias() -= this->m_tauCross.transpose() * tauCoeffs;
+    }
+    denseRhs.noalias() -= this->m_indicatorCross.transpose() * indicatorCoeffs;
+    Sample denseCoeffs = this->m_schur.solve(denseRhs);
+    indicatorCoeffs.noalias() -= this->m_indicatorSolved * denseCoeffs;
+    if (this->m_seasonTrend)
+        tauCoeffs.noalias() -= this->m_tauSolved * denseCoeffs;
+    
+    // Subtract the fitted model
+    for (t = 0; t < this->m_length; ++t)
+    {
+        DataTensor::Index season = this->row(t, tau, row);
+        Scalar fit = indicatorCoeffs(season);
+        if (this->m_seasonTrend)
+            fit += tau * tauCoeffs(season);
+        for (const auto & entry : row)
+            fit += entry.second * denseCoeffs(entry.first);
+        y(t) -= fit;
+    }
+    
+    // Gather coefficients
+    for (std::size_t i = 0; i < this->m_denseParams.size(); ++i)
+        params(this->m_denseParams[i]) = denseCoeffs(i);
+    params.segment(this->m_primaryOffset, primaryNum) = indicatorCoeffs;
+    if (this->m_seasonTrend)
+        params.segment(this->m_primaryOffset + this->m_numSeasons, primaryNum) = tauCoeffs;
+}
+
+}
+
 OLSDetrending::OLSDetrending(PeriodVector periods, bool linear_trend, bool linear_season_trend, bool store_params)
 : periods(periods), linear_trend(linear_trend), linear_season_trend(linear_season_trend), m_storeParams(store_params), m_params()
 {}
@@ -360,7 +820,6 @@ DataTensor & OLSDetrending::operator()(const DataTensor & dataIn, DataTensor & d
     
     dataOut = dataIn;
     unsigned int numParams = this->getNumParams();
-    unsigned int numSeasonCoeffs = this->totalSeasonNum();
     
     if (this->m_storeParams)
     {
@@ -369,56 +828,70 @@ DataTensor & OLSDetrending::operator()(const DataTensor & dataIn, DataTensor & d
         this->m_params.resize(paramsShape);
     }
     
-    // Construct the design matrix
-    ScalarMatrix A = ScalarMatrix::Zero(dataIn.length(), numParams);
-    A.col(0).setConstant(1); // intercept term
-    if (this->linear_trend)
-        A.col(1).setLinSpaced(static_cast<Scalar>(0), static_cast<Scalar>(dataIn.length() - 1));
-    for (DataTensor::Index t = 0; t < dataIn.length(); t++)
-    {
-        DataTensor::Index offs = (this->linear_trend) ? 2 : 1;
-        for (PeriodVector::const_iterator period = this->periods.begin(); period != this->periods.end(); ++period)
-        {
-            DataTensor::Index ind = (t / period->len) % period->num;
-            A(t, offs + ind) = static_cast<Scalar>(1);
-            if (this->linear_season_trend)
-                A(t, offs + numSeasonCoeffs + ind) = static_cast<Scalar>(t) / static_cast<Scalar>(period->num);
-            offs += period->num;
-        }
-    }
-    // We use the Cholesky decomposition, because it is orders of magnitude faster than the ColPivHouseholderQR,
-    // though not as accurate.
-    Eigen::LLT<ScalarMatrix> llt(A.transpose() * A);
+    // The normal equations are block-structured due to the seasonal indicators, so that we neither need
+    // the design matrix nor a decomposition of its full Gram matrix.
+    SeasonalNormalEquations equations(*this, dataIn.length());
+    equations.factorize();
     
     // Construct selector matrix for exclusion of missing values
     DataTensor::Mask mask;
     if (dataIn.hasMissingSamples())
         dataIn.getMask(mask);
     
-    // Perform least squares estimation for each spatial location and attribute
+    // Perform least squares estimation for each spatial location and attribute.
+    // The normal equations of locations with missing samples are obtained by removing those from the full ones.
     auto tsOut = dataOut.asTemporalMatrix();
     auto tsMask = mask.asTemporalMatrix();
-    Sample params(numParams);
+    DataTensor::Index numAttrib = dataIn.numAttrib();
     ScalarMatrix::Index ts;
     
-    #pragma omp parallel for private(params)
-    for (ts = 0; ts < tsOut.cols(); ++ts)
+    #pragma omp parallel
     {
-        // Least squares solving
-        if (mask.empty() || !tsMask.col(ts / dataIn.numAttrib()).any())
-            params = llt.solve(A.transpose() * tsOut.col(ts));
-        else if (tsMask.rows() - tsMask.col(ts / dataIn.numAttrib()).count() > params.size())
+        Sample params(numParams);
+        SeasonalNormalEquations::RowEntries row;
+        std::vector<DataTensor::Index> missing;
+        std::unique_ptr<SeasonalNormalEquations> maskedEquations;
+        const SeasonalNormalEquations * locEquations = nullptr;
+        DataTensor::Index lastLoc = std::numeric_limits<DataTensor::Index>::max();
+        
+        #pragma omp for
+        for (ts = 0; ts < tsOut.cols(); ++ts)
         {
-            ScalarMatrix maskedA = tsMask.col(ts / dataIn.numAttrib()).replicate(1, A.cols()).select(static_cast<Scalar>(0), A);
-            params = Eigen::LLT<ScalarMatrix>(maskedA.transpose() * maskedA).solve(maskedA.transpose() * tsOut.col(ts));
+            // Set up the normal equations once for all attributes at the same location
+            DataTensor::Index loc = ts / numAttrib;
+            if (loc != lastLoc)
+            {
+                missing.clear();
+                locEquations = &equations;
+                if (!mask.empty() && tsMask.col(loc).any())
+                {
+                    for (DataTensor::Index t = 0; t < dataIn.length(); ++t)
+                        if (tsMask(t, loc))
+                            missing.push_back(t);
+                    if (tsMask.rows() - static_cast<ScalarMatrix::Index>(missing.size()) > params.size())
+                    {
+                        maskedEquations.reset(new SeasonalNormalEquations(equations));
+                        for (DataTensor::Index t : missing)
+                            maskedEquations->removeSample(t, row);
+                        maskedEquations->factorize();
+                        locEquations = maskedEquations.get();
+                    }
+                    else
+                        locEquations = nullptr;
+                }
+                lastLoc = loc;
+            }
+            
+            // Least squares solving and subtraction of the trend
+            auto y = tsOut.col(ts);
+            if (locEquations)
+                locEquations->detrend(y, missing, params, row);
+            else
+                params.setZero();
+            // Store parameters
+            if (this->m_storeParams)
+                this->m_params.asTemporalMatrix().col(ts) = params;
         }
-        else
-            params.setZero();
-        // Subtract trend
-        tsOut.col(ts).noalias() -= A * params;
-        // Store parameters
-        if (this->m_storeParams)
-            this->m_params.asTemporalMatrix().col(ts) = params;
     }
     
     return dataOut;
@@ -529,46 +1002,147 @@ DataTensor & ZScoreDeseasonalization::operator()(DataTensor & data) const
 }
 
 
+/**
+* Computes the lower triangle of the Gram matrix `data^T * data` in square tiles of `MAXDIV_PCA_BLOCK_SIZE` rows
+* and columns, which are distributed among several threads. The strictly upper triangle of @p gram is not referenced.
+*/
+static void pca_gram_matrix(const ScalarMatrix & data, ScalarMatrix & gram)
+{
+    const Eigen::Index d = data.cols(), bs = MAXDIV_PCA_BLOCK_SIZE, numBlocks = (d + bs - 1) / bs;
+    if (numBlocks <= 1)
+    {
+        gram.noalias() = data.transpose() * data;
+        return;
+    }
+    
+    std::vector< std::pair<Eigen::Index, Eigen::Index> > tiles;
+    for (Eigen::Index i = 0; i < numBlocks; ++i)
+        for (Eigen::Index j = 0; j <= i; ++j)
+            tiles.push_back(std::make_pair(i * bs, j * bs));
+    
+    gram.resize(d, d);
+    #pragma omp parallel for schedule(dynamic)
+    for (long t = 0; t < static_cast<long>(tiles.size()); ++t)
+    {
+        const Eigen::Index row = tiles[t].first, col = tiles[t].second;
+        const Eigen::Index numRows = std::min(bs, d - row), numCols = std::min(bs, d - col);
+        gram.block(row, col, numRows, numCols).noalias() = data.middleCols(row, numRows).transpose() * data.middleCols(col, numCols);
+    }
+}
+
+/**
+* Computes `data^T * (data * basis)` without forming the Gram matrix of @p data.
+*
+* Both products are computed in blocks of `MAXDIV_PCA_BLOCK_SIZE` samples or attributes, respectively, which are
+* distributed among several threads. Each block of the result is computed by a single thread, so that the result
+* does not depend on the number of threads.
+*/
+static void pca_gram_product(const ScalarMatrix & data, const ScalarMatrix & basis, ScalarMatrix & result)
+{
+    const Eigen::Index n = data.rows(), d = data.cols(), bs = MAXDIV_PCA_BLOCK_SIZE;
+    ScalarMatrix projected(n, basis.cols());
+    result.resize(d, basis.cols());
+    #pragma omp parallel
+    {
+        #pragma omp for schedule(static)
+        for (Eigen::Index start = 0; start < n; start += bs)
+            projected.middleRows(start, std::min(bs, n - start)).noalias() = data.middleRows(start, std::min(bs, n - start)) * basis;
+        
+        #pragma omp for schedule(static)
+        for (Eigen::Index start = 0; start < d; start += bs)
+            result.middleRows(start, std::min(bs, d - start)).noalias() = data.middleCols(start, std::min(bs, d - start)).transpose() * projected;
+    }
+}
+
+/**
+* Replaces the columns of @p basis with an orthonormal basis of the space spanned by them.
+*/
+static void orthonormalize(ScalarMatrix & basis)
+{
+    Eigen::HouseholderQR<ScalarMatrix> qr(basis);
+    basis = qr.householderQ() * ScalarMatrix::Identity(basis.rows(), basis.cols());
+}
+
+
 DataTensor & PCAProjection::operator()(const DataTensor & dataIn, DataTensor & dataOut) const
 {
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> ScalarVector;
+    
     // Center data
     ScalarMatrix data = dataIn.data();
     data.rowwise() -= data.colwise().sum() / static_cast<Scalar>(dataIn.numValidSamples());
     for (const DataTensor::Index & missing : dataIn.getMissingSampleIndices())
         data.row(missing).setZero();
     
-    // Compute covariance matrix
-    ScalarMatrix cov;
-    cov.noalias() = data.transpose() * data;
-    cov /= static_cast<Scalar>(dataIn.numValidSamples() - 1);
+    const DataTensor::Index d = dataIn.numAttrib();
+    const Scalar norm = static_cast<Scalar>(dataIn.numValidSamples() - 1);
+    const DataTensor::Index maxK = (this->k > 0) ? std::min(this->k, d) : 1;
     
-    // Perform Eigen decomposition
-    Eigen::SelfAdjointEigenSolver<ScalarMatrix> eigensolver(cov);
+    Solver solver = this->solver;
+    if (solver == Solver::AUTO)
+        solver = (d >= MAXDIV_PCA_RANDOMIZED_MIN_ATTRIB && 4 * (maxK + this->oversampling) <= d) ? Solver::RANDOMIZED : Solver::DENSE;
+    
+    // Compute principal components and their variances, sorted in decreasing order
+    ScalarVector eigenvalues;
+    ScalarMatrix eigenvectors;
+    Scalar totalEnergy;
+    Eigen::SelfAdjointEigenSolver<ScalarMatrix> eigensolver;
+    if (solver == Solver::RANDOMIZED)
+    {
+        // Draw a random basis and refine it by subspace iteration
+        const Eigen::Index l = std::min(maxK + this->oversampling, d);
+        std::mt19937 gen(0);
+        std::normal_distribution<Scalar> ndis;
+        ScalarMatrix basis(d, l), product;
+        for (Eigen::Index i = 0; i < basis.size(); ++i)
+            basis.data()[i] = ndis(gen);
+        orthonormalize(basis);
+        for (unsigned int it = 0; it < this->power_iterations; ++it)
+        {
+            pca_gram_product(data, basis, product);
+            basis.swap(product);
+            orthonormalize(basis);
+        }
+        
+        // Decompose the covariance matrix projected onto the basis
+        pca_gram_product(data, basis, product);
+        ScalarMatrix projCov;
+        projCov.noalias() = basis.transpose() * product;
+        projCov /= norm;
+        eigensolver.compute(projCov);
+        eigenvalues = eigensolver.eigenvalues().reverse();
+        eigenvectors.noalias() = basis * eigensolver.eigenvectors().rowwise().reverse();
+        totalEnergy = data.squaredNorm() / norm;
+    }
+    else
+    {
+        ScalarMatrix cov;
+        pca_gram_matrix(data, cov);
+        cov /= norm;
+        eigensolver.compute(cov);
+        eigenvalues = eigensolver.eigenvalues().reverse();
+        eigenvectors = eigensolver.eigenvectors().rowwise().reverse();
+        totalEnergy = eigenvalues.sum();
+    }
     
     // Determine number of principal components to be kept
-    DataTensor::Index k = (this->k > 0) ? this->k : 1;
+    DataTensor::Index k = maxK;
     if (this->variability < 1.0)
     {
-        Scalar totalEnergy = eigensolver.eigenvalues().sum(), curEnergy = 0.0;
-        for (k = 1; k <= this->k && k <= dataIn.numAttrib(); ++k)
+        Scalar curEnergy = 0.0;
+        for (k = 1; k < maxK; ++k)
         {
-            curEnergy += eigensolver.eigenvalues()(dataIn.numAttrib() - k);
+            curEnergy += eigenvalues(k - 1);
             if (curEnergy >= this->variability * totalEnergy)
                 break;
         }
     }
-    if (k > dataIn.numAttrib())
-        k = dataIn.numAttrib();
-    
-    // Compose projection matrix of eigenvectors.
-    // Eigenvectors are sorted by eigenvalue in increasing order, so we take the last right columns and reverse their order:
-    ScalarMatrix proj = eigensolver.eigenvectors().rightCols(k) * Eigen::PermutationMatrix<Eigen::Dynamic>(Eigen::VectorXi::LinSpaced(k, k - 1, 0));
     
     // Project data
     ReflessIndexVector shape = dataIn.shape();
     shape.d = k;
     dataOut.resize(shape);
-    dataOut.data().noalias() = data * proj;
+    dataOut.data().noalias() = data * eigenvectors.leftCols(k);
     dataOut.copyMask(dataIn);
     
     return dataOut;
@@ -605,11 +1179,106 @@ DataTensor & SparseRandomProjection::operator()(const DataTensor & dataIn, DataT
         proj.row(i) /= proj.row(i).norm();
     }
     
-    // Project data
+    // Project data in blocks of samples
     shape.d = this->k;
     dataOut.resize(shape);
-    dataOut.data().noalias() = dataIn.data() * proj.transpose();
+    const auto dataMat = dataIn.data();
+    auto outMat = dataOut.data();
+    const Eigen::Index n = dataMat.rows(), bs = MAXDIV_PCA_BLOCK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (Eigen::Index start = 0; start < n; start += bs)
+        outMat.middleRows(start, std::min(bs, n - start)).noalias() = dataMat.middleRows(start, std::min(bs, n - start)) * proj.transpose();
     dataOut.copyMask(dataIn);
     
     return dataOut;
 }
+
+
+//--------------------//
+// PreprocessingCache //
+//--------------------//
+
+PreprocessingCache::PreprocessingCache(const std::string & directory, uint64_t configKey)
+: m_directory(directory), m_configKey(configKey)
+{
+    while (this->m_directory.size() > 1 && (this->m_directory.back() == '/' || this->m_directory.back() == '\\'))
+        this->m_directory.pop_back();
+}
+
+uint64_t PreprocessingCache::key(const DataTensor & data) const
+{
+    return fingerprint(data, hashCombine(this->m_configKey, MAXDIV_PREPROC_CACHE_VERSION));
+}
+
+std::string PreprocessingCache::entryPath(uint64_t key) const
+{
+    std::ostringstream path;
+    path << this->m_directory << "/maxdiv-" << std::hex << std::setfill('0') << std::setw(16) << key;
+    return path.str();
+}
+
+std::shared_ptr<DataTensor> PreprocessingCache::load(uint64_t key, const ReflessIndexVector & origShape, ReflessIndexVector & borderSize) const
+{
+    std::string path = this->entryPath(key);
+    
+    // Read and check meta data
+    std::ifstream metaFile(path + ".meta");
+    if (!metaFile.is_open())
+        return nullptr;
+    ReflessIndexVector storedShape;
+    unsigned int d;
+    for (d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+        metaFile >> storedShape.ind[d];
+    for (d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+        metaFile >> borderSize.ind[d];
+    if (metaFile.fail() || storedShape != origShape)
+        return nullptr;
+    
+    // Map pre-processed data
+    std::shared_ptr<DataTensor> data = mapTensorFile(path + ".mdt");
+    if (!data || data->empty())
+        return nullptr;
+    return data;
+}
+
+bool PreprocessingCache::store(uint64_t key, const ReflessIndexVector & origShape, const DataTensor & data, const ReflessIndexVector & borderSize) const
+{
+    std::string path = this->entryPath(key);
+    std::random_device rd;
+    std::ostringstream tmpSuffix;
+    tmpSuffix << ".tmp" << std::hex << rd() << rd();
+    
+    // Write meta data first, so that the tensor file is only visible if its meta data exist
+    std::string metaTmp = path + ".meta" + tmpSuffix.str();
+    {
+        std::ofstream metaFile(metaTmp);
+        if (!metaFile.is_open())
+            return false;
+        unsigned int d;
+        for (d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+            metaFile << origShape.ind[d] << ' ';
+        for (d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+            metaFile << borderSize.ind[d] << ' ';
+        metaFile << std::endl;
+        if (metaFile.fail())
+        {
+            metaFile.close();
+            std::remove(metaTmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(metaTmp.c_str(), (path + ".meta").c_str()) != 0)
+    {
+        std::remove(metaTmp.c_str());
+        return false;
+    }
+    
+    // Write pre-processed data
+    std::string dataTmp = path + ".mdt" + tmpSuffix.str();
+    if (!writeTensorFile(dataTmp, data) || std::rename(dataTmp.c_str(), (path + ".mdt").c_str()) != 0)
+    {
+        std::remove(dataTmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -20,6 +20,8 @@
 
 #include <memory>
 #include <vector>
+#include <string>
+#include <cstdint>
 #include <cmath>
 #include <cassert>
 #include "DataTensor.h"
@@ -127,6 +129,81 @@ DataTensor_<Scalar> time_delay_embedding(const DataTensor_<Scalar> & data, int k
 }
 
 
+/**
+* @brief Series underlying a Time Delay Embedding
+*
+* Creates the time series whose samples make up the result of time_delay_embedding() with the same
+* parameters: The attributes of the embedded sample at time step `t` are the samples of the returned series
+* at the time steps `t + (k - 1) * T, t + (k - 2) * T, ..., t`. Compared with @p data, the series is padded at
+* the beginning by `(k - 1) * T` time steps according to @p borders, unless the invalid border would be cropped.
+* Missing samples are retained.
+*
+* This allows describing an embedding by a tensor with the number of attributes of @p data instead of `k` times
+* as many attributes.
+*
+* @return Returns the padded time series.
+*/
+template<typename Scalar>
+DataTensor_<Scalar> time_delay_padding(const DataTensor_<Scalar> & data, int k = 3, int T = 1, BorderPolicy borders = BorderPolicy::MIRROR)
+{
+    assert(k > 0 && T > 0);
+    if (k == 1 || data.length() <= 1)
+        return data;
+    
+    // Determine size of invalid border in the same way as time_delay_embedding()
+    typename DataTensor_<Scalar>::Index borderSize = 0;
+    if (borders == BorderPolicy::AUTO || borders == BorderPolicy::VALID)
+    {
+        borderSize = (k - 1) * T;
+        if (borderSize >= data.length() || (borders == BorderPolicy::AUTO && borderSize * 20 > data.length()))
+        {
+            borders = BorderPolicy::MIRROR;
+            borderSize = 0;
+        }
+    }
+    
+    // Create new tensor
+    ReflessIndexVector newShape = data.shape();
+    newShape.t += (k - 1) * T - borderSize;
+    DataTensor_<Scalar> series(newShape);
+    
+    auto newTM = series.asTemporalMatrix();
+    const auto tm = data.asTemporalMatrix();
+    const int numSteps = tm.rows(), period = 2 * numSteps - 2, offset = static_cast<int>(borderSize) - (k - 1) * T;
+    IndexVector missingInd(data.shape(), 0);
+    missingInd.shape.d = 1;
+    
+    // Copy data
+    int t, pt;
+    for (t = 0; t < newTM.rows(); ++t)
+    {
+        // Determine index of the corresponding time step in the data
+        pt = t + offset;
+        if (borders == BorderPolicy::MIRROR)
+        {
+            pt = std::abs(pt) % period;
+            if (pt >= numSteps)
+                pt = period - pt;
+        }
+        else
+            pt = std::max(pt, 0);
+        newTM.row(t) = tm.row(pt);
+        
+        // Propagate missing values
+        if (data.hasMissingSamples())
+        {
+            missingInd.t = pt;
+            missingInd.x = missingInd.y = missingInd.z = 0;
+            for (; missingInd.t == pt; ++missingInd)
+                if (data.isMissingSample(missingInd))
+                    series.setMissingSample(t, missingInd.x, missingInd.y, missingInd.z);
+        }
+    }
+    
+    return series;
+}
+
+
 /**
 * @brief Spatial Neighbour Embedding
 *
@@ -261,6 +338,22 @@ DataTensor_<Scalar> spatial_neighbour_embedding(const DataTensor_<Scalar> & data
 }
 
 
+/**
+* @brief Time series underlying a Time Delay Embedding
+*
+* Describes data obtained from time_delay_embedding() by the series returned by time_delay_padding()
+* and the parameters of the embedding.
+*/
+struct EmbeddedSeries
+{
+    std::shared_ptr<const DataTensor> series; /**< The padded series whose samples make up the embedded samples. */
+    int k; /**< Embedding Dimension */
+    int T; /**< Time Delay */
+    
+    EmbeddedSeries() : series(), k(1), T(1) {};
+};
+
+
 /**
 * @brief Abstract base class for components of the pre-processing pipeline
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
@@ -360,6 +453,17 @@ public:
         return (*this)(dataOut = dataIn);
     };
     
+    /**
+    * Applies each pre-processor in the pipeline sequentially to @p data like `operator()(DataTensor &)`.
+    * If the last pre-processor is a TimeDelayEmbedding, the series underlying the embedding and its parameters
+    * will be stored in @p embedded. Otherwise, `embedded.series` will be reset.
+    *
+    * @note If the data contain missing values, they must have been masked by calling `DataTensor::mask()`.
+    *
+    * @return Reference to `data`.
+    */
+    virtual DataTensor & operator()(DataTensor & data, EmbeddedSeries & embedded) const;
+    
     /**
     * Some pre-processors may crop the data to a smaller sub-block. In this case, this method
     * specifies the accumulated size of the border that would be cut off at the beginning of the
@@ -378,6 +482,12 @@ protected:
     
     mutable std::vector<float> m_timing;
     
+    /**
+    * Implementation of `operator()`, which stores the series underlying a final TimeDelayEmbedding in
+    * @p embedded unless it is `NULL`.
+    */
+    DataTensor & apply(DataTensor & data, EmbeddedSeries * embedded) const;
+    
 };
 
 
@@ -407,6 +517,15 @@ public:
     
     virtual DataTensor & operator()(const DataTensor & dataIn, DataTensor & dataOut) const override;
     
+    /**
+    * Applies the time-delay embedding to @p dataIn and stores the result in @p dataOut like `operator()`.
+    * In addition, the series underlying the embedding, as obtained from time_delay_padding(), and the
+    * parameters of the embedding will be stored in @p embedded.
+    *
+    * @return Reference to `dataOut`.
+    */
+    virtual DataTensor & operator()(const DataTensor & dataIn, DataTensor & dataOut, EmbeddedSeries & embedded) const;
+    
     /**
     * This method specifies the size of the border that would be cut off at the beginning of the given time series
     * @p data if `borderPolicy` is `VALID` or `AUTO`.
@@ -440,8 +559,12 @@ public:
     * The `opt_th` attribute sets a threshold on the gradient of MI. If MI drops slowlier than
     * this threshold, the respective context window size will be chosen.
     *
-    * For spatio-temporal data, this will be done for each location separately and the median context
-    * window size will be returned.
+    * For spatio-temporal data, this will be done for each location separately and in parallel and the median
+    * context window size will be returned.
+    *
+    * The covariance matrices for all distances are obtained at once from cross-correlations computed via FFT,
+    * so that the cost of the automatic parameter determination is dominated by `O(n log n)` transforms instead
+    * of scanning the time-series once for every distance.
     *
     * @return Returns the number of timesteps contained in the context for a sample in the time-series
     * (including that sample itself).
@@ -594,6 +717,11 @@ protected:
 * Multivariate time series will be detrended separately dimension by dimension,
 * each spatial location will be handled separately as well.
 *
+* The design matrix is never materialized: since the seasonal indicators are one-hot vectors, the normal equations
+* are accumulated in closed form and solved block-wise. The cost is linear in the length of the time series and in
+* the number of seasonal units of the period with the most units; only the intercept, the linear trend and the
+* coefficients of the other periods are solved for jointly.
+*
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
 class OLSDetrending : public Preprocessor
@@ -740,28 +868,64 @@ public:
 * PCA is used to find a matrix \f$A\f$ that maximizes the amount of variance in the reduced
 * feature space.
 *
+* The `DENSE` solver computes the covariance matrix in tiles distributed among several threads and
+* decomposes it entirely, which takes \f$\mathcal{O}(n \cdot d^2 + d^3)\f$ time. If only a few principal
+* components of high-dimensional data are needed, e.g., after time-delay and spatial-neighbour embedding,
+* the `RANDOMIZED` solver approximates them by subspace iteration on a random starting basis with `k + oversampling`
+* vectors (Halko et al., 2011). It multiplies the data with that basis `power_iterations + 1` times and never
+* forms the covariance matrix, which takes \f$\mathcal{O}(n \cdot d \cdot k)\f$ time per iteration. The random
+* basis is drawn with a fixed seed, so that the projection is reproducible. Since its result is only an approximation,
+* the `DENSE` solver is used unless `RANDOMIZED` or `AUTO` is requested explicitly.
+*
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
 class PCAProjection : public Preprocessor
 {
 public:
 
+    enum class Solver
+    {
+        AUTO,       /**< Use `RANDOMIZED` for data with at least `MAXDIV_PCA_RANDOMIZED_MIN_ATTRIB` attributes if `k + oversampling` is at most a quarter of their number, otherwise `DENSE`. */
+        DENSE,      /**< Decompose the entire covariance matrix. */
+        RANDOMIZED  /**< Approximate the leading principal components by randomized subspace iteration. */
+    };
+
+
     DataTensor::Index k; /**< Maximum number of principal components to keep. */
     Scalar variability; /**< Fraction of the data's variability to capture. */
+    Solver solver; /**< Eigensolver used to compute the principal components. Defaults to `DENSE`. */
+    DataTensor::Index oversampling; /**< Number of additional basis vectors used by the randomized solver. */
+    unsigned int power_iterations; /**< Number of subspace iterations performed by the randomized solver. */
 
     PCAProjection() = delete;
     
     /**
     * @param[in] k Number of principal components to keep.
     */
-    PCAProjection(DataTensor::Index k) : k(k), variability(1.0) {};
+    PCAProjection(DataTensor::Index k)
+    : k(k), variability(1.0), solver(Solver::DENSE), oversampling(10), power_iterations(4) {};
     
     /**
     * @param[in] k Maximum number of principal components to keep.
     *
     * @param[in] v Fraction of the data's variability to capture (value between 0 and 1).
     */
-    PCAProjection(DataTensor::Index k, Scalar v) : k(k), variability(v) {};
+    PCAProjection(DataTensor::Index k, Scalar v)
+    : k(k), variability(v), solver(Solver::DENSE), oversampling(10), power_iterations(4) {};
+    
+    /**
+    * @param[in] k Number of principal components to keep.
+    *
+    * @param[in] solver Eigensolver used to compute the principal components.
+    *
+    * @param[in] oversampling Number of basis vectors in addition to @p k used by the randomized solver.
+    * Larger values improve the accuracy of the last components.
+    *
+    * @param[in] power_iterations Number of subspace iterations performed by the randomized solver.
+    * More iterations improve the accuracy if the eigenvalues of the covariance matrix decay slowly.
+    */
+    PCAProjection(DataTensor::Index k, Solver solver, DataTensor::Index oversampling = 10, unsigned int power_iterations = 4)
+    : k(k), variability(1.0), solver(solver), oversampling(oversampling), power_iterations(power_iterations) {};
 
     /**
     * Computes the first `k` principal components of the samples in @p dataIn and stores them in
@@ -783,6 +947,8 @@ public:
 * \f$x' = x \cdot W^T\f$, where \f$W \in \mathbb{R}^{k \times d}\f$ is a collection of \f$n\f$ sparse random projection
 * vectors, each of those having only \f$\sqrt{d}\f$ non-zero entries which are drawn from the standard normal distribution.
 *
+* The projection is applied to blocks of samples distributed among several threads.
+*
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
 class SparseRandomProjection : public Preprocessor
@@ -809,6 +975,99 @@ public:
 
 };
 
+
+/**
+* Version of the results of the pre-processing steps, which is part of the keys of all entries of a
+* `PreprocessingCache`. It must be incremented whenever a change of the implementation of any pre-processing step
+* alters its results, so that entries stored by previous versions of the library are not used anymore.
+*/
+#define MAXDIV_PREPROC_CACHE_VERSION 2
+
+/**
+* @brief Persistent cache for the results of a pre-processing pipeline
+*
+* When the same data are analyzed repeatedly with the same pre-processing, but, e.g., a different number of detections
+* or another divergence, caching the pre-processed data avoids re-computing expensive steps such as the automatic
+* determination of embedding parameters.
+*
+* Each entry is stored in the cache directory as binary tensor file (see `TensorFileHeader`), which is memory-mapped
+* when it is loaded, along with a small file containing the border size of the pipeline and the shape of the original
+* data. Entries are identified by a fingerprint of the original data combined with a key which must identify the
+* configuration of the pre-processing pipeline uniquely. Entries are written to temporary files first and renamed
+* afterwards, so that concurrent processes sharing a cache directory never read incomplete entries.
+*
+* The cache does never delete entries. Stale entries have to be removed from the directory manually.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class PreprocessingCache
+{
+public:
+
+    /**
+    * @param[in] directory The directory where the entries will be stored. It must exist already.
+    *
+    * @param[in] configKey A key identifying the configuration of the pre-processing pipeline whose results
+    * are to be cached. Caches with different keys may share the same directory.
+    */
+    PreprocessingCache(const std::string & directory, uint64_t configKey = 0);
+    
+    const std::string & getDirectory() const { return this->m_directory; };
+    
+    uint64_t getConfigKey() const { return this->m_configKey; };
+    
+    /**
+    * Computes the key of the entry for the pre-processed version of given data.
+    *
+    * @param[in] data The original data, before pre-processing and masking.
+    *
+    * @return Returns a fingerprint of the data, combined with the configuration key of this cache and
+    * `MAXDIV_PREPROC_CACHE_VERSION`.
+    */
+    uint64_t key(const DataTensor & data) const;
+    
+    /**
+    * Loads an entry from the cache.
+    *
+    * @param[in] key The key of the entry, obtained from `key()`.
+    *
+    * @param[in] origShape The shape of the original data, which is compared with the shape stored with the
+    * entry to guard against collisions of fingerprints.
+    *
+    * @param[out] borderSize Will be set to the border size of the pipeline stored with the entry.
+    *
+    * @return Returns a pointer to the memory-mapped pre-processed data or `NULL` if there is no matching entry.
+    */
+    std::shared_ptr<DataTensor> load(uint64_t key, const ReflessIndexVector & origShape, ReflessIndexVector & borderSize) const;
+    
+    /**
+    * Stores an entry in the cache. Existing entries with the same key will be replaced.
+    *
+    * @param[in] key The key of the entry, obtained from `key()`.
+    *
+    * @param[in] origShape The shape of the original data.
+    *
+    * @param[in] data The pre-processed data.
+    *
+    * @param[in] borderSize The border size of the pipeline for the original data.
+    *
+    * @return Returns `true` if the entry has been written successfully, otherwise `false`.
+    */
+    bool store(uint64_t key, const ReflessIndexVector & origShape, const DataTensor & data, const ReflessIndexVector & borderSize) const;
+
+
+protected:
+
+    std::string m_directory; /**< The directory where entries are stored. */
+    uint64_t m_configKey; /**< Key identifying the configuration of the cached pipeline. */
+    
+    /**
+    * @return Returns the path of the file of a given entry without extension.
+    */
+    std::string entryPath(uint64_t key) const;
+
+};
+
 }
 
 #endif
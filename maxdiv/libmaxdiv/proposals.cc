@@ -18,6 +18,8 @@
 #include "proposals.h"
 #include <algorithm>
 #include <vector>
+#include <limits>
+#include <cmath>
 #include <cassert>
 #include "pointwise_detectors.h"
 using namespace MaxDiv;
@@ -111,6 +113,28 @@ ProposalIterator ProposalGenerator::iteratePartial(unsigned int num_groups, unsi
     );
 }
 
+ProposalIterator ProposalGenerator::iterateStartPoints(DataTensor::Index firstStartPoint, DataTensor::Index lastStartPoint) const
+{
+    DataTensor::Index numSamples = this->numStartPoints();
+    if (firstStartPoint >= numSamples || firstStartPoint >= lastStartPoint)
+        return ProposalIterator();
+
+    ReflessIndexVector shape = this->m_curStartPoint.shape;
+    shape.d = 1;
+    return ProposalIterator(
+        this,
+        IndexVector(shape, firstStartPoint),
+        (lastStartPoint < numSamples) ? IndexVector(shape, lastStartPoint) : IndexVector()
+    );
+}
+
+DataTensor::Index ProposalGenerator::numStartPoints() const
+{
+    ReflessIndexVector shape = this->m_curStartPoint.shape;
+    shape.d = 1;
+    return shape.prod();
+}
+
 
 //------------------------//
 // DenseProposalGenerator //
@@ -141,6 +165,11 @@ DenseProposalGenerator::DenseProposalGenerator(IndexRange lengthRange, const std
     this->init(data);
 }
 
+std::shared_ptr<ProposalGenerator> DenseProposalGenerator::clone() const
+{
+    return std::make_shared<DenseProposalGenerator>(*this);
+}
+
 void DenseProposalGenerator::initState(const ReflessIndexVector & startIndex, std::shared_ptr<void> & state) const
 {
     // Start with smallest length
@@ -324,8 +353,9 @@ void PointwiseProposalGenerator::init(const std::shared_ptr<const DataTensor> &
             }
         }
         
+        // The threshold is not finite if all scores are missing or not finite, which no score would ever reach
         this->m_th = mean + sd_th * sd;
-        while (!(this->m_scores.data().array() >= this->m_th).any())
+        while (std::isfinite(this->m_th) && !(this->m_scores.data().array() >= this->m_th).any())
         {
             sd_th *= 0.8;
             this->m_th = mean + sd_th * sd;
@@ -341,6 +371,21 @@ void PointwiseProposalGenerator::reset()
     this->m_scores.release();
 }
 
+std::shared_ptr<ProposalGenerator> PointwiseProposalGenerator::clone() const
+{
+    return std::make_shared<PointwiseProposalGenerator>(*this);
+}
+
+bool PointwiseProposalGenerator::startPointPriorities(std::vector<Scalar> & priorities) const
+{
+    if (this->m_scores.empty())
+        return false;
+    priorities.assign(this->m_scores.raw(), this->m_scores.raw() + this->m_scores.numSamples());
+    for (const DataTensor::Index & missing : this->m_scores.getMissingSampleIndices())
+        priorities[missing] = -std::numeric_limits<Scalar>::infinity();
+    return true;
+}
+
 void PointwiseProposalGenerator::initState(const ReflessIndexVector & startIndex, std::shared_ptr<void> & state) const
 {
     if (!state)
@@ -504,3 +549,176 @@ void PointwiseProposalGenerator::computeGradient(DataTensor & data) const
         data.data() = grad.data().cwiseSqrt();
     }
 }
+
+
+//--------------------------------//
+// SpatialRegionProposalGenerator //
+//--------------------------------//
+
+const SpatialRegionProposalGenerator::Params SpatialRegionProposalGenerator::defaultParams = {
+    &hotellings_t,
+    1.5,
+    1
+};
+
+SpatialRegionProposalGenerator::SpatialRegionProposalGenerator()
+: DenseProposalGenerator(), m_params(defaultParams), m_regions(), m_regionEnds()
+{}
+
+SpatialRegionProposalGenerator::SpatialRegionProposalGenerator(const Params & params)
+: DenseProposalGenerator(), m_params(params), m_regions(), m_regionEnds()
+{}
+
+SpatialRegionProposalGenerator::SpatialRegionProposalGenerator(IndexRange lengthRange)
+: DenseProposalGenerator(lengthRange), m_params(defaultParams), m_regions(), m_regionEnds()
+{}
+
+SpatialRegionProposalGenerator::SpatialRegionProposalGenerator(IndexRange lengthRange, const Params & params)
+: DenseProposalGenerator(lengthRange), m_params(params), m_regions(), m_regionEnds()
+{}
+
+SpatialRegionProposalGenerator::SpatialRegionProposalGenerator(IndexRange lengthRange, const Params & params, const std::shared_ptr<const DataTensor> & data)
+: DenseProposalGenerator(lengthRange), m_params(params), m_regions(), m_regionEnds()
+{
+    this->init(data);
+}
+
+void SpatialRegionProposalGenerator::init(const std::shared_ptr<const DataTensor> & data)
+{
+    DenseProposalGenerator::init(data);
+    this->m_regions.clear();
+    this->m_regionEnds.clear();
+    
+    const ReflessIndexVector & shape = data->shape();
+    const DataTensor::Index numLocations = shape.prod(1, MAXDIV_INDEX_DIMENSION - 2);
+    if (data->empty() || numLocations <= 1)
+        return;
+    
+    // Determine the maximum point-wise score of each location
+    DataTensor scores = this->m_params.scorer(*data);
+    Sample maxScores = Sample::Constant(numLocations, -std::numeric_limits<Scalar>::infinity());
+    DataTensor::Index sample, loc, numValidLocations = 0;
+    for (sample = 0; sample < scores.numSamples(); ++sample)
+        if (!scores.isMissingSample(sample))
+        {
+            loc = sample % numLocations;
+            maxScores(loc) = std::max(maxScores(loc), scores.sample(sample)(0));
+        }
+    
+    // Determine threshold based on mean and standard deviation of the valid locations, i.e., the locations with
+    // a finite maximum score
+    Scalar mean = 0, sd = 0;
+    for (loc = 0; loc < numLocations; ++loc)
+        if (std::isfinite(maxScores(loc)))
+        {
+            mean += maxScores(loc);
+            ++numValidLocations;
+        }
+    if (numValidLocations == 0)
+        return;
+    mean /= numValidLocations;
+    for (loc = 0; loc < numLocations; ++loc)
+        if (std::isfinite(maxScores(loc)))
+            sd += (maxScores(loc) - mean) * (maxScores(loc) - mean);
+    sd = std::sqrt(sd / numValidLocations);
+    Scalar sd_th = this->m_params.sd_th, th = mean + sd_th * sd;
+    if (!std::isfinite(th))
+        return;
+    while (!(maxScores.array() >= th).any())
+    {
+        sd_th *= 0.8;
+        th = mean + sd_th * sd;
+    }
+    
+    // Find connected regions of locations above the threshold and their bounding boxes
+    const DataTensor::Index strides[] = { 0, shape.y * shape.z, shape.z, 1 };
+    std::vector<bool> visited(numLocations, false);
+    std::vector<DataTensor::Index> queue;
+    unsigned int d;
+    for (DataTensor::Index seed = 0; seed < numLocations; ++seed)
+        if (!visited[seed] && maxScores(seed) >= th)
+        {
+            IndexRange box;
+            box.a.t = 0;
+            box.b.t = shape.t;
+            box.a.x = shape.x; box.a.y = shape.y; box.a.z = shape.z;
+            box.b.d = shape.d;
+            
+            visited[seed] = true;
+            queue.assign(1, seed);
+            while (!queue.empty())
+            {
+                loc = queue.back();
+                queue.pop_back();
+                for (d = 1; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+                {
+                    DataTensor::Index pos = (loc / strides[d]) % shape.ind[d];
+                    box.a.ind[d] = std::min(box.a.ind[d], pos);
+                    box.b.ind[d] = std::max(box.b.ind[d], pos + 1);
+                    if (pos > 0 && !visited[loc - strides[d]] && maxScores(loc - strides[d]) >= th)
+                    {
+                        visited[loc - strides[d]] = true;
+                        queue.push_back(loc - strides[d]);
+                    }
+                    if (pos + 1 < shape.ind[d] && !visited[loc + strides[d]] && maxScores(loc + strides[d]) >= th)
+                    {
+                        visited[loc + strides[d]] = true;
+                        queue.push_back(loc + strides[d]);
+                    }
+                }
+            }
+            
+            // Enlarge bounding box by the margin
+            for (d = 1; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+            {
+                box.a.ind[d] = (box.a.ind[d] > this->m_params.margin) ? box.a.ind[d] - this->m_params.margin : 0;
+                box.b.ind[d] = std::min(box.b.ind[d] + this->m_params.margin, shape.ind[d]);
+            }
+            this->m_regions.push_back(box);
+        }
+    
+    // Store the maximum end point of all boxes containing each location
+    this->m_regionEnds.assign(numLocations, ReflessIndexVector());
+    for (const IndexRange & box : this->m_regions)
+    {
+        ReflessIndexVector pos;
+        for (pos.x = box.a.x; pos.x < box.b.x; ++pos.x)
+            for (pos.y = box.a.y; pos.y < box.b.y; ++pos.y)
+                for (pos.z = box.a.z; pos.z < box.b.z; ++pos.z)
+                {
+                    ReflessIndexVector & end = this->m_regionEnds[pos.x * strides[1] + pos.y * strides[2] + pos.z];
+                    for (d = 1; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+                        end.ind[d] = std::max(end.ind[d], box.b.ind[d]);
+                }
+    }
+}
+
+void SpatialRegionProposalGenerator::reset()
+{
+    DenseProposalGenerator::reset();
+    this->m_regions.clear();
+    this->m_regionEnds.clear();
+}
+
+std::shared_ptr<ProposalGenerator> SpatialRegionProposalGenerator::clone() const
+{
+    return std::make_shared<SpatialRegionProposalGenerator>(*this);
+}
+
+void SpatialRegionProposalGenerator::initState(const ReflessIndexVector & startIndex, std::shared_ptr<void> & state) const
+{
+    DenseProposalGenerator::initState(startIndex, state);
+    if (this->m_regionEnds.empty())
+        return;
+    
+    IndexVector * rangeEndOffs = reinterpret_cast<IndexVector*>(state.get());
+    const ReflessIndexVector & shape = this->m_curStartPoint.shape;
+    const ReflessIndexVector & end = this->m_regionEnds[(startIndex.x * shape.y + startIndex.y) * shape.z + startIndex.z];
+    for (unsigned int d = 1; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+    {
+        // Locations outside of all regions (indicated by an end point of 0) do not yield any proposals
+        ReflessIndexVector::Index maxLen = (end.ind[d] > startIndex.ind[d]) ? end.ind[d] - startIndex.ind[d] : 0;
+        if (rangeEndOffs->shape.ind[d] > maxLen)
+            rangeEndOffs->shape.ind[d] = maxLen;
+    }
+}
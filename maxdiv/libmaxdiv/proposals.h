@@ -21,6 +21,7 @@
 #include <iterator>
 #include <memory>
 #include <functional>
+#include <vector>
 #include "DataTensor.h"
 
 namespace MaxDiv
@@ -87,6 +88,16 @@ public:
     
     virtual ~ProposalGenerator();
     
+    /**
+    * Creates a copy of this object by calling the copy constructor of the actual derived class.
+    *
+    * @return Returns a pointer to a copy of this object.
+    *
+    * @note The internal state of iteration used by `next()` is shared with the copy. Thus, copies which are
+    * meant to be used independently from each other should be created before `init()` is called.
+    */
+    virtual std::shared_ptr<ProposalGenerator> clone() const =0;
+    
     /**
     * Initializes this proposal generator to make proposals for the data in @p data.
     *
@@ -167,6 +178,45 @@ public:
     * @return A ProposalIterator pointing to the next proposed range.
     */
     ProposalIterator iteratePartial(unsigned int num_groups, unsigned int group_num) const;
+    
+    /**
+    * Returns an iterator over proposals within a range of start points given by their linear indices
+    * in the non-attribute dimensions of the data. This is intended to be used for dynamically scheduled
+    * multi-threading, where the start points are split up into chunks which are distributed among threads.
+    * init() has to be called before this may be used.
+    *
+    * @param[in] firstStartPoint Linear index of the first start point (inclusively).
+    *
+    * @param[in] lastStartPoint Linear index of the last start point (exclusively).
+    *
+    * @return A ProposalIterator pointing to the next proposed range.
+    */
+    ProposalIterator iterateStartPoints(DataTensor::Index firstStartPoint, DataTensor::Index lastStartPoint) const;
+    
+    /**
+    * @return Returns the number of possible start points of proposals, i.e. the number of samples in
+    * the data passed to `init()`, or 0 if this generator has not been initialized yet.
+    */
+    DataTensor::Index numStartPoints() const;
+    
+    /**
+    * Retrieves a priority for each start point indicating how promising the ranges starting there are, so that
+    * searches with limited time can score the most promising proposals first. init() has to be called before
+    * this may be used.
+    *
+    * @param[out] priorities Vector which will be resized to `numStartPoints()` and receive the priority of each
+    * start point, indexed by its linear index in the non-attribute dimensions of the data.
+    *
+    * @return Returns `false` if this generator does not distinguish between start points, in which case
+    * @p priorities will not be modified.
+    */
+    virtual bool startPointPriorities(std::vector<Scalar> &) const { return false; };
+    
+    /**
+    * @return Returns a range whose start specifies the minimum length of the proposed ranges for each
+    * dimension and whose end specifies the maximum length (0 = unlimited).
+    */
+    const IndexRange & getLengthRange() const { return this->m_lengthRange; };
 
 
 protected:
@@ -358,6 +408,8 @@ public:
     */
     DenseProposalGenerator(IndexRange lengthRange, const std::shared_ptr<const DataTensor> & data);
     
+    virtual std::shared_ptr<ProposalGenerator> clone() const override;
+    
     /**
     * Fetches the next proposal for a specific start point, based on a given state of iteration.
     * init() has to be called before this can be used.
@@ -562,6 +614,13 @@ public:
     */
     virtual void reset() override;
     
+    virtual std::shared_ptr<ProposalGenerator> clone() const override;
+    
+    /**
+    * Provides the point-wise scores which proposals are derived from as priorities of the start points.
+    */
+    virtual bool startPointPriorities(std::vector<Scalar> & priorities) const override;
+    
     /**
     * Fetches the next proposal for a specific start point, based on a given state of iteration.
     * init() has to be called before this can be used.
@@ -609,6 +668,124 @@ protected:
 
 };
 
+
+/**
+* @brief Proposes spatio-temporal ranges within connected spatial regions of high point-wise scores
+*
+* The maximum point-wise score over time is computed for each spatial location and thresholded.
+* Connected regions of locations above the threshold (with respect to the 6-neighbourhood) are
+* determined and their bounding boxes are enlarged by a margin. Ranges are proposed densely along
+* the time axis, but only for those start points whose location lies within one of these boxes and
+* the spatial extent of the ranges is limited to the boxes containing the start point.
+*
+* For data without spatial extent, this proposal generator is equivalent to `DenseProposalGenerator`.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class SpatialRegionProposalGenerator : public DenseProposalGenerator
+{
+public:
+
+    typedef PointwiseProposalGenerator::PointwiseScorer PointwiseScorer;
+    
+    struct Params
+    {
+        PointwiseScorer scorer; /**< The point-wise scoring function used to obtain scores. */
+        Scalar sd_th; /**< Thresholds for the maximum scores of the locations will be `mean + sd_th * standard_deviation`. */
+        DataTensor::Index margin; /**< Number of locations the bounding boxes of the regions will be enlarged by in each spatial direction. */
+    };
+    
+    static const Params defaultParams;
+    
+
+    /**
+    * Constructs an un-initialized proposal generator. `init()` has to be called before it may be used.
+    */
+    SpatialRegionProposalGenerator();
+    
+    /**
+    * Constructs an un-initialized proposal generator. `init()` has to be called before it may be used.
+    *
+    * @param[in] params A structure with parameters for this proposal generator. Default parameters
+    * can be found in `SpatialRegionProposalGenerator::defaultParams`.
+    */
+    SpatialRegionProposalGenerator(const Params & params);
+    
+    /**
+    * Constructs an un-initialized proposal generator and specifies a minimum and a maximum length for
+    * the proposed ranges. `init()` has to be called before proposals can be made.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the proposed ranges
+    * for each dimension and whose end specifies the maximum length. The attribute dimension will be
+    * ignored.
+    */
+    SpatialRegionProposalGenerator(IndexRange lengthRange);
+    
+    /**
+    * Constructs an un-initialized proposal generator and specifies a minimum and a maximum length for
+    * the proposed ranges. `init()` has to be called before proposals can be made.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the proposed ranges
+    * for each dimension and whose end specifies the maximum length. The attribute dimension will be
+    * ignored.
+    *
+    * @param[in] params A structure with parameters for this proposal generator. Default parameters
+    * can be found in `SpatialRegionProposalGenerator::defaultParams`.
+    */
+    SpatialRegionProposalGenerator(IndexRange lengthRange, const Params & params);
+    
+    /**
+    * Constructs and initializes proposal generator and specifies a minimum and a maximum length for
+    * the proposed ranges.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the proposed ranges
+    * for each dimension and whose end specifies the maximum length. The attribute dimension will be
+    * ignored.
+    *
+    * @param[in] params A structure with parameters for this proposal generator. Default parameters
+    * can be found in `SpatialRegionProposalGenerator::defaultParams`.
+    *
+    * @param[in] data Pointer to the data to generate range proposals for.  
+    * If the data contain missing samples, they must have been masked by calling `DataTensor::mask()`.
+    */
+    SpatialRegionProposalGenerator(IndexRange lengthRange, const Params & params, const std::shared_ptr<const DataTensor> & data);
+    
+    /**
+    * Initializes this proposal generator to make proposals for the data in @p data.
+    *
+    * @note If the data contain missing samples, they must have been masked by calling `DataTensor::mask()`.
+    */
+    virtual void init(const std::shared_ptr<const DataTensor> & data) override;
+    
+    /**
+    * Resets this proposal generator to its un-initialized state and releases any memory allocated
+    * by `init()`.
+    */
+    virtual void reset() override;
+    
+    virtual std::shared_ptr<ProposalGenerator> clone() const override;
+    
+    /**
+    * @return Returns the bounding boxes of the spatial regions found by `init()`, enlarged by the margin.
+    * The time dimension of each box covers the entire time series.
+    */
+    const std::vector<IndexRange> & getRegions() const { return this->m_regions; };
+
+
+protected:
+
+    Params m_params; /**< Parameters of this instance */
+    std::vector<IndexRange> m_regions; /**< Bounding boxes of the regions of high scores. */
+    std::vector<ReflessIndexVector> m_regionEnds; /**< Maximum spatial end point of all boxes containing a location, indexed by the linear index of the location. Empty if there are no spatial dimensions. */
+    
+    /**
+    * Limits the spatial extent of the ranges starting at @p startIndex to the boxes containing that start point
+    * in addition to the initialization done by `DenseProposalGenerator::initState()`.
+    */
+    virtual void initState(const ReflessIndexVector & startIndex, std::shared_ptr<void> & state) const override;
+
+};
+
 }
 
 #endif
\ No newline at end of file
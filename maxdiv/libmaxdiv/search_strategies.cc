@@ -16,10 +16,15 @@
 //  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
 
 #include "search_strategies.h"
+#include "pointwise_detectors.h"
 #include "config.h"
 #include <algorithm>
 #include <utility>
 #include <stdexcept>
+#include <limits>
+#include <chrono>
+#include <cmath>
+#include <queue>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -27,42 +32,391 @@
 
 using namespace MaxDiv;
 
+typedef std::chrono::steady_clock StatClock;
+
+static double secondsSince(const StatClock::time_point & start)
+{
+    return std::chrono::duration<double>(StatClock::now() - start).count();
+}
+
+
+namespace
+{
+
+/**
+* Storage for the batches of ranges and scores processed by `scoreProposals()`, which is allocated once
+* per thread and reused for all batches.
+*/
+struct ScoringBuffers
+{
+    std::vector<IndexRange> batch;
+    std::vector<Scalar> scores;
+    
+    ScoringBuffers() : scores(MAXDIV_SCORE_BATCH_SIZE) { this->batch.reserve(MAXDIV_SCORE_BATCH_SIZE); };
+};
+
+
+/**
+* Per-thread buffers for the detections collected for offline non-maximum suppression.
+*
+* Each thread appends its detections to its own buffer, which avoids synchronization and the re-allocation
+* of many small lists. The detections belonging to each chunk of start points are recorded as a segment of
+* the buffer of the thread which processed the chunk, so that the results can be concatenated in the order
+* of the chunks independently of the number of threads.
+*/
+class ChunkedDetections
+{
+public:
+
+    /**
+    * @param[in] numChunks The number of chunks of start points.
+    *
+    * @param[in] sizeHint Expected total number of detections, used to pre-size the buffers of the threads.
+    */
+    ChunkedDetections(std::size_t numChunks, std::size_t sizeHint)
+    : m_sizeHint(sizeHint), m_segments(numChunks)
+    {
+        #ifdef _OPENMP
+        this->m_buffers.resize(omp_get_max_threads());
+        #else
+        this->m_buffers.resize(1);
+        #endif
+    };
+    
+    /**
+    * @return Returns the buffer of the calling thread, which will be pre-sized on the first call.
+    */
+    DetectionList & local()
+    {
+        #ifdef _OPENMP
+        DetectionList & buffer = this->m_buffers[omp_get_thread_num()];
+        std::size_t numThreads = omp_get_num_threads();
+        #else
+        DetectionList & buffer = this->m_buffers[0];
+        std::size_t numThreads = 1;
+        #endif
+        if (buffer.capacity() == 0 && this->m_sizeHint > 0)
+            buffer.reserve(this->m_sizeHint / numThreads + this->m_sizeHint / (16 * numThreads) + 1);
+        return buffer;
+    };
+    
+    /**
+    * Assigns the detections appended to the buffer of the calling thread since it had @p begin elements to @p chunk.
+    */
+    void assign(std::size_t chunk, std::size_t begin)
+    {
+        #ifdef _OPENMP
+        std::size_t thread = omp_get_thread_num();
+        #else
+        std::size_t thread = 0;
+        #endif
+        this->m_segments[chunk] = Segment{ thread, begin, this->m_buffers[thread].size() };
+    };
+    
+    /**
+    * Appends all detections to a given list in the order of the chunks and releases the buffers.
+    */
+    void concatenate(DetectionList & detections)
+    {
+        std::size_t numDetections = detections.size();
+        for (const DetectionList & buffer : this->m_buffers)
+            numDetections += buffer.size();
+        detections.reserve(numDetections);
+        for (const Segment & segment : this->m_segments)
+            if (segment.end > segment.begin)
+                detections.insert(
+                    detections.end(),
+                    this->m_buffers[segment.thread].begin() + segment.begin,
+                    this->m_buffers[segment.thread].begin() + segment.end
+                );
+        std::vector<DetectionList>().swap(this->m_buffers);
+    };
+
+
+protected:
+
+    /**
+    * The detections of a chunk, given by the index of a thread and a range of elements in its buffer.
+    */
+    struct Segment
+    {
+        std::size_t thread;
+        std::size_t begin;
+        std::size_t end;
+    };
+    
+    std::size_t m_sizeHint; /**< Expected total number of detections. */
+    std::vector<DetectionList> m_buffers; /**< Detection buffers of all threads. */
+    std::vector<Segment> m_segments; /**< The segment of the buffers corresponding to each chunk. */
+
+};
+
+
+/**
+* Scores the ranges yielded by a ProposalIterator for which @p accept returns `true` in batches of
+* `MAXDIV_SCORE_BATCH_SIZE` ranges by means of `Divergence::score()` and passes the resulting detections
+* to @p consume in the order of the proposals.
+*
+* If a @p controller is given, it is checked before each batch and the remaining ranges are skipped once it
+* requests the search to stop.
+*
+* @return Returns the number of ranges scored.
+*/
+template<class Predicate, class Consumer>
+unsigned long long scoreProposals(ProposalIterator range, const ProposalIterator & end, Divergence & divergence,
+                                  ScoringBuffers & buffers, Predicate accept, Consumer consume,
+                                  SearchController * controller = nullptr)
+{
+    std::vector<IndexRange> & batch = buffers.batch;
+    unsigned long long numScored = 0;
+    while (range != end && !(controller && controller->shouldStop()))
+    {
+        batch.clear();
+        for (; range != end && batch.size() < MAXDIV_SCORE_BATCH_SIZE; ++range)
+            if (accept(*range))
+                batch.push_back(*range);
+        divergence.score(batch, buffers.scores.data());
+        for (std::size_t i = 0; i < batch.size(); ++i)
+            consume(Detection(batch[i], buffers.scores[i]));
+        numScored += batch.size();
+    }
+    return numScored;
+}
+
+template<class Consumer>
+unsigned long long scoreProposals(ProposalIterator range, const ProposalIterator & end, Divergence & divergence,
+                                  ScoringBuffers & buffers, Consumer consume, SearchController * controller = nullptr)
+{
+    return scoreProposals(range, end, divergence, buffers, [](const IndexRange &) { return true; }, consume, controller);
+}
+
+/**
+* Orders the chunks of consecutive start points with indices in `[firstChunk, lastChunk)` by the maximum priority
+* of their start points in decreasing order.
+*
+* The priorities are provided by the proposal generator or, if it does not distinguish between start points,
+* given by the Hotelling's T^2 scores of the samples.
+*/
+std::vector<DataTensor::Index> prioritizedChunks(const ProposalGenerator & generator, const DataTensor & data,
+                                                 DataTensor::Index chunkSize, DataTensor::Index firstChunk, DataTensor::Index lastChunk)
+{
+    std::vector<Scalar> priorities;
+    if (!generator.startPointPriorities(priorities))
+    {
+        DataTensor scores = hotellings_t(data);
+        priorities.assign(scores.raw(), scores.raw() + scores.numSamples());
+        for (const DataTensor::Index & missing : data.getMissingSampleIndices())
+            priorities[missing] = -std::numeric_limits<Scalar>::infinity();
+    }
+    
+    std::vector<Scalar> chunkPriorities(lastChunk - firstChunk, -std::numeric_limits<Scalar>::infinity());
+    for (std::size_t i = firstChunk * chunkSize; i < priorities.size() && i / chunkSize < lastChunk; ++i)
+        if (priorities[i] > chunkPriorities[i / chunkSize - firstChunk])
+            chunkPriorities[i / chunkSize - firstChunk] = priorities[i];
+    
+    std::vector<DataTensor::Index> order(lastChunk - firstChunk);
+    for (DataTensor::Index i = 0; i < order.size(); ++i)
+        order[i] = firstChunk + i;
+    std::stable_sort(order.begin(), order.end(), [&chunkPriorities, firstChunk](DataTensor::Index a, DataTensor::Index b) {
+        return chunkPriorities[a - firstChunk] > chunkPriorities[b - firstChunk];
+    });
+    return order;
+}
+
+/**
+* Applies non-maximum suppression to @p detections in several layers: The first layer consists of the detections
+* which would be kept by `nonMaximumSuppression()`. Each further layer consists of the detections which would be
+* kept among those suppressed by all previous layers.
+*
+* @param[in,out] detections The detections to be processed. Will be replaced by the detections of the first
+* @p numLayers layers, sorted by score in decreasing order.
+*
+* @param[out] firstLayer Will be set to the detections of the first layer, sorted by score in decreasing order.
+*
+* @param[in] numLayers The number of layers to retain. Must be at least 1.
+*
+* @param[in] overlap_th Threshold for the Intersection over Union of overlapping ranges.
+*/
+void layeredNonMaximumSuppression(DetectionList & detections, DetectionList & firstLayer, unsigned int numLayers, double overlap_th)
+{
+    std::sort(detections.begin(), detections.end());
+    std::vector<DetectionList> layers(numLayers);
+    DetectionList kept;
+    for (const Detection & detection : detections)
+        for (DetectionList & layer : layers)
+            if (std::none_of(layer.begin(), layer.end(), [&detection, overlap_th](const Detection & other) { return other.IoU(detection) > overlap_th; }))
+            {
+                layer.push_back(detection);
+                kept.push_back(detection);
+                break;
+            }
+    detections.swap(kept);
+    firstLayer.swap(layers[0]);
+}
+
+}
+
+SearchStatistics & SearchStatistics::operator+=(const SearchStatistics & other)
+{
+    this->numSearches += other.numSearches;
+    this->numProposals += other.numProposals;
+    this->preprocessingTime += other.preprocessingTime;
+    this->initTime += other.initTime;
+    this->proposalTime += other.proposalTime;
+    this->scoringTime += other.scoringTime;
+    this->nmsTime += other.nmsTime;
+    this->totalTime += other.totalTime;
+    this->numPreprocCacheHits += other.numPreprocCacheHits;
+    this->numPartialSearches += other.numPartialSearches;
+    if (this->threadProposals.size() < other.threadProposals.size())
+    {
+        this->threadProposals.resize(other.threadProposals.size(), 0);
+        this->threadTime.resize(other.threadTime.size(), 0);
+    }
+    for (std::size_t i = 0; i < other.threadProposals.size(); ++i)
+    {
+        this->threadProposals[i] += other.threadProposals[i];
+        this->threadTime[i] += other.threadTime[i];
+    }
+    this->estimator += other.estimator;
+    return *this;
+}
+
+void SearchStatistics::addThread(std::size_t thread, unsigned long long numProposals, double time, const EstimatorStatistics & estimatorStats)
+{
+    if (this->threadProposals.size() <= thread)
+    {
+        this->threadProposals.resize(thread + 1, 0);
+        this->threadTime.resize(thread + 1, 0);
+    }
+    this->threadProposals[thread] += numProposals;
+    this->threadTime[thread] += time;
+    this->numProposals += numProposals;
+    this->estimator += estimatorStats;
+}
+
+
+
+SearchController::SearchController()
+: m_hasDeadline(false), m_deadline(), m_cancelled(false), m_stopped(false), m_progress(0), m_total(0), m_progressCallback() {}
+
+SearchController::SearchController(double timeout)
+: m_hasDeadline(timeout > 0), m_deadline(), m_cancelled(false), m_stopped(false), m_progress(0), m_total(0), m_progressCallback()
+{
+    if (this->m_hasDeadline)
+        this->m_deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+}
+
+SearchController::SearchController(const Clock::time_point & deadline)
+: m_hasDeadline(true), m_deadline(deadline), m_cancelled(false), m_stopped(false), m_progress(0), m_total(0), m_progressCallback() {}
+
+bool SearchController::shouldStop()
+{
+    if (this->m_stopped)
+        return true;
+    if (this->m_cancelled || (this->m_hasDeadline && Clock::now() >= this->m_deadline))
+    {
+        this->m_stopped = true;
+        return true;
+    }
+    return false;
+}
+
+void SearchController::beginProgress(unsigned long long total)
+{
+    std::lock_guard<std::mutex> lock(this->m_progressMutex);
+    this->m_progress = 0;
+    this->m_total = total;
+}
+
+void SearchController::addProgress(unsigned long long amount)
+{
+    std::lock_guard<std::mutex> lock(this->m_progressMutex);
+    this->m_progress = std::min(this->m_progress + amount, this->m_total);
+    if (this->m_progressCallback && this->m_total > 0)
+        this->m_progressCallback(static_cast<Scalar>(this->m_progress) / static_cast<Scalar>(this->m_total));
+}
+
 
 SearchStrategy::SearchStrategy()
-: autoReset(true), m_divergence(new KLDivergence(std::make_shared<GaussianDensityEstimator>())), m_preproc(nullptr), m_overlap_th(0.0) {}
+: autoReset(true), m_divergence(new KLDivergence(std::make_shared<GaussianDensityEstimator>())), m_preproc(nullptr), m_preprocCache(nullptr),
+  m_overlap_th(0.0) {}
 
 SearchStrategy::SearchStrategy(const std::shared_ptr<Divergence> & divergence)
-: autoReset(true), m_divergence(divergence), m_preproc(nullptr), m_overlap_th(0.0)
+: autoReset(true), m_divergence(divergence), m_preproc(nullptr), m_preprocCache(nullptr), m_overlap_th(0.0)
 {
     if (divergence == nullptr)
         throw std::invalid_argument("divergence must not be NULL.");
 }
 
 SearchStrategy::SearchStrategy(const std::shared_ptr<Divergence> & divergence, const std::shared_ptr<const PreprocessingPipeline> & preprocessing)
-: autoReset(true), m_divergence(divergence), m_preproc(preprocessing), m_overlap_th(0.0)
+: autoReset(true), m_divergence(divergence), m_preproc(preprocessing), m_preprocCache(nullptr), m_overlap_th(0.0)
 {
     if (divergence == nullptr)
         throw std::invalid_argument("divergence must not be NULL.");
 }
 
+void SearchStrategy::addThreadStatistics(unsigned long long numProposals, double time, const Divergence & divergence)
+{
+    EstimatorStatistics estimatorStats = divergence.getStatistics();
+    #ifdef _OPENMP
+    std::size_t thread = omp_get_thread_num();
+    #else
+    std::size_t thread = 0;
+    #endif
+    #pragma omp critical(maxdiv_search_statistics)
+    this->m_stats.addThread(thread, numProposals, time, estimatorStats);
+}
+
 DetectionList SearchStrategy::operator()(const std::shared_ptr<DataTensor> & data, unsigned int numDetections)
 {
     DetectionList detections;
     if (data)
     {
+        StatClock::time_point start = StatClock::now();
+        
         // Mask missing values
         data->mask();
         
-        // Apply pre-processing
+        // Apply pre-processing or fetch pre-processed data from the cache
         ReflessIndexVector borderSize;
+        EmbeddedSeries embedded;
+        std::shared_ptr<const DataTensor> modData = data;
         if (this->m_preproc && !this->m_preproc->empty())
         {
-            borderSize = this->m_preproc->borderSize(*data);
-            (*(this->m_preproc))(*data);
+            uint64_t cacheKey = 0;
+            std::shared_ptr<DataTensor> cachedData;
+            if (this->m_preprocCache)
+            {
+                cacheKey = this->m_preprocCache->key(*data);
+                cachedData = this->m_preprocCache->load(cacheKey, data->shape(), borderSize);
+            }
+            if (cachedData)
+            {
+                modData = cachedData;
+                ++this->m_stats.numPreprocCacheHits;
+            }
+            else
+            {
+                ReflessIndexVector origShape = data->shape();
+                borderSize = this->m_preproc->borderSize(*data);
+                (*(this->m_preproc))(*data, embedded);
+                if (this->m_preprocCache)
+                    this->m_preprocCache->store(cacheKey, origShape, *data, borderSize);
+            }
         }
+        this->m_stats.preprocessingTime += secondsSince(start);
+        
+        // Let the divergence compute sums over time-delay embedded samples from the series underlying the embedding
+        // (not available for data loaded from the cache)
+        this->m_divergence->setTimeDelayEmbedding(embedded.series, embedded.k, embedded.T);
         
         // Detect anomalous intervals
-        detections = this->detect(data, numDetections);
+        detections = this->detect(modData, numDetections);
+        this->m_stats.totalTime += secondsSince(start);
+        ++this->m_stats.numSearches;
+        if (this->m_controller && this->m_controller->isPartial())
+            ++this->m_stats.numPartialSearches;
         
         // Add offset to the detected ranges if a border has been cut off from the original data
         if (borderSize != 0)
@@ -80,8 +434,11 @@ DetectionList SearchStrategy::operator()(const std::shared_ptr<const DataTensor>
     DetectionList detections;
     if (data)
     {
+        StatClock::time_point start = StatClock::now();
+        
         // Apply pre-processing
         ReflessIndexVector borderSize;
+        EmbeddedSeries embedded;
         std::shared_ptr<const DataTensor> modData;
         bool hasMissingValues = data->hasMissingValues();
         if ((this->m_preproc && !this->m_preproc->empty()) || hasMissingValues)
@@ -92,24 +449,50 @@ DetectionList SearchStrategy::operator()(const std::shared_ptr<const DataTensor>
                 md = new DataTensor(*data);
                 md->mask();
             }
-            if (this->m_preproc && !this->m_preproc->empty())
+            
+            // Fetch pre-processed data from the cache if possible
+            uint64_t cacheKey = 0;
+            std::shared_ptr<DataTensor> cachedData;
+            if (this->m_preproc && !this->m_preproc->empty() && this->m_preprocCache)
             {
-                borderSize = this->m_preproc->borderSize(*data);
-                if (md == nullptr)
+                cacheKey = this->m_preprocCache->key((md == nullptr) ? *data : *md);
+                cachedData = this->m_preprocCache->load(cacheKey, data->shape(), borderSize);
+            }
+            
+            if (cachedData)
+            {
+                delete md;
+                modData = cachedData;
+                ++this->m_stats.numPreprocCacheHits;
+            }
+            else
+            {
+                if (this->m_preproc && !this->m_preproc->empty())
                 {
-                    md = new DataTensor();
-                    (*(this->m_preproc))(*data, *md);
+                    borderSize = this->m_preproc->borderSize((md == nullptr) ? *data : *md);
+                    if (md == nullptr)
+                        md = new DataTensor(*data);
+                    (*(this->m_preproc))(*md, embedded);
+                    if (this->m_preprocCache)
+                        this->m_preprocCache->store(cacheKey, data->shape(), *md, borderSize);
                 }
-                else
-                    (*(this->m_preproc))(*md);
+                modData = std::shared_ptr<const DataTensor>(md);
             }
-            modData = std::shared_ptr<const DataTensor>(md);
         }
         else
             modData = data;
+        this->m_stats.preprocessingTime += secondsSince(start);
+        
+        // Let the divergence compute sums over time-delay embedded samples from the series underlying the embedding
+        // (not available for data loaded from the cache)
+        this->m_divergence->setTimeDelayEmbedding(embedded.series, embedded.k, embedded.T);
         
         // Detect anomalous intervals
         detections = this->detect(modData, numDetections);
+        this->m_stats.totalTime += secondsSince(start);
+        ++this->m_stats.numSearches;
+        if (this->m_controller && this->m_controller->isPartial())
+            ++this->m_stats.numPartialSearches;
         
         // Add offset to the detected ranges if a border has been cut off from the original data
         if (borderSize != 0)
@@ -122,15 +505,30 @@ DetectionList SearchStrategy::operator()(const std::shared_ptr<const DataTensor>
     return detections;
 }
 
+DetectionList SearchStrategy::operator()(const std::shared_ptr<const DataTensor> & data, const std::shared_ptr<DataTensor> & workspace,
+                                        unsigned int numDetections)
+{
+    if (!data || !workspace || !((this->m_preproc && !this->m_preproc->empty()) || data->hasMissingValues()))
+        return (*this)(data, numDetections);
+    
+    // Copy data to the workspace and process them there in-place
+    *workspace = *data;
+    return (*this)(workspace, numDetections);
+}
+
 
-ProposalSearch::ProposalSearch() : SearchStrategy(), m_proposals(new DenseProposalGenerator()) {}
+ProposalSearch::ProposalSearch()
+: SearchStrategy(), m_proposals(new DenseProposalGenerator()), m_scheduling(Scheduling::STATIC), m_chunkSize(0),
+  m_numPartitions(1), m_partition(0) {}
 
 ProposalSearch::ProposalSearch(const std::shared_ptr<Divergence> & divergence)
-: SearchStrategy(divergence), m_proposals(new DenseProposalGenerator())
+: SearchStrategy(divergence), m_proposals(new DenseProposalGenerator()), m_scheduling(Scheduling::STATIC), m_chunkSize(0),
+  m_numPartitions(1), m_partition(0)
 {}
 
 ProposalSearch::ProposalSearch(const std::shared_ptr<Divergence> & divergence, const std::shared_ptr<ProposalGenerator> & generator)
-: SearchStrategy(divergence), m_proposals(generator)
+: SearchStrategy(divergence), m_proposals(generator), m_scheduling(Scheduling::STATIC), m_chunkSize(0),
+  m_numPartitions(1), m_partition(0)
 {
     if (generator == nullptr)
         throw std::invalid_argument("generator must not be NULL.");
@@ -139,240 +537,1243 @@ ProposalSearch::ProposalSearch(const std::shared_ptr<Divergence> & divergence, c
 ProposalSearch::ProposalSearch(const std::shared_ptr<Divergence> & divergence,
                                const std::shared_ptr<ProposalGenerator> & generator,
                                const std::shared_ptr<const PreprocessingPipeline> & preprocessing)
-: SearchStrategy(divergence, preprocessing), m_proposals(generator)
+: SearchStrategy(divergence, preprocessing), m_proposals(generator), m_scheduling(Scheduling::STATIC), m_chunkSize(0),
+  m_numPartitions(1), m_partition(0)
 {
     if (generator == nullptr)
         throw std::invalid_argument("generator must not be NULL.");
 }
 
+std::shared_ptr<SearchStrategy> ProposalSearch::clone() const
+{
+    std::shared_ptr<ProposalSearch> copy = std::make_shared<ProposalSearch>(*this);
+    copy->m_divergence = this->m_divergence->clone();
+    copy->m_proposals = this->m_proposals->clone();
+    copy->resetStatistics();
+    return copy;
+}
+
+void ProposalSearch::setPartition(unsigned int numPartitions, unsigned int partition)
+{
+    if (numPartitions == 0)
+        throw std::invalid_argument("numPartitions must be greater than 0.");
+    if (partition >= numPartitions)
+        throw std::invalid_argument("partition must be less than numPartitions.");
+    this->m_numPartitions = numPartitions;
+    this->m_partition = partition;
+}
+
 DetectionList ProposalSearch::detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections)
 {
     DetectionList detections;
     if (data)
     {
-        // Initialize density estimator and proposal generator
+        // Initialize density estimator
+        StatClock::time_point start = StatClock::now();
         this->m_divergence->init(data);
-        this->m_proposals->init(data);
+        this->m_stats.initTime += secondsSince(start);
         
-        // Score every proposed range
-        if (data->numSamples() <= MAXDIV_NMP_LIMIT)
+        detections = this->searchProposals(data, numDetections);
+        
+        // Release memory
+        if (this->autoReset)
+        {
+            this->m_divergence->reset();
+            this->m_proposals->reset();
+        }
+    }
+    return detections;
+}
+
+DetectionList ProposalSearch::searchProposals(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections)
+{
+    DetectionList detections;
+    
+    // Initialize proposal generator
+    StatClock::time_point start = StatClock::now();
+    this->m_proposals->init(data);
+    this->m_stats.proposalTime += secondsSince(start);
+    
+    // Split start points up into chunks for dynamic scheduling
+    DataTensor::Index numStartPoints = this->m_proposals->numStartPoints();
+    DataTensor::Index chunkSize = this->m_chunkSize;
+    if (chunkSize == 0)
+        chunkSize = std::max(numStartPoints / MAXDIV_DYNAMIC_SCHEDULE_CHUNKS, static_cast<DataTensor::Index>(1));
+    DataTensor::Index numChunks = (numStartPoints + chunkSize - 1) / chunkSize;
+    
+    // A partitioned search only processes the chunks of its own partition
+    const DataTensor::Index firstChunk = numChunks * this->m_partition / this->m_numPartitions;
+    const DataTensor::Index numPartitionChunks = numChunks * (this->m_partition + 1) / this->m_numPartitions - firstChunk;
+    
+    // A controlled search processes the chunks dynamically in the order of decreasing priority,
+    // so that the most promising ranges have been scored if it is stopped early
+    SearchController * controller = this->m_controller.get();
+    const bool chunked = (this->m_scheduling == Scheduling::DYNAMIC || controller != nullptr || this->m_numPartitions > 1);
+    std::vector<DataTensor::Index> chunkOrder;
+    if (controller != nullptr)
+    {
+        start = StatClock::now();
+        chunkOrder = prioritizedChunks(*(this->m_proposals), *data, chunkSize, firstChunk, firstChunk + numPartitionChunks);
+        this->m_stats.proposalTime += secondsSince(start);
+        controller->beginProgress(std::min(numPartitionChunks * chunkSize, numStartPoints - firstChunk * chunkSize));
+    }
+    
+    // Score every proposed range. A search with a deadline always uses online non-maximum suppression,
+    // since offline non-maximum suppression of all scores could not be stopped at the deadline.
+    start = StatClock::now();
+    if (data->numSamples() <= MAXDIV_NMP_LIMIT && (controller == nullptr || !controller->hasDeadline()))
+    {
+        // Offline non-maximum suppression: Collect all scores first, then apply non-maximum suppression.
+        // The buffers of the threads are pre-sized according to the average number of proposals of previous searches.
+        std::size_t sizeHint = (this->m_stats.numSearches > 0) ? this->m_stats.numProposals / this->m_stats.numSearches : 0;
+        Eigen::setNbThreads(1);
+        if (chunked)
+        {
+            // Collect detections per chunk and concatenate them in the order of the chunks afterwards,
+            // so that the input to non-maximum suppression is independent of the number of threads.
+            ChunkedDetections chunkDetections(numChunks, sizeHint);
+            #pragma omp parallel
+            {
+                StatClock::time_point threadStart = StatClock::now();
+                std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
+                divergence->resetStatistics();
+                ScoringBuffers buffers;
+                DetectionList & localDetections = chunkDetections.local();
+                unsigned long long numScored = 0;
+                DataTensor::Index i;
+                #pragma omp for schedule(dynamic,1) nowait
+                for (i = 0; i < numPartitionChunks; ++i)
+                {
+                    if (controller != nullptr && controller->shouldStop())
+                        continue;
+                    DataTensor::Index chunk = (controller != nullptr) ? chunkOrder[i] : firstChunk + i;
+                    std::size_t begin = localDetections.size();
+                    numScored += scoreProposals(
+                        this->m_proposals->iterateStartPoints(chunk * chunkSize, (chunk + 1) * chunkSize), this->m_proposals->end(), *divergence,
+                        buffers, [&localDetections](Detection && detection) { localDetections.push_back(std::move(detection)); }, controller
+                    );
+                    chunkDetections.assign(chunk, begin);
+                    if (controller != nullptr)
+                        controller->addProgress(std::min(chunkSize, numStartPoints - chunk * chunkSize));
+                }
+                this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
+            }
+            chunkDetections.concatenate(detections);
+        }
+        else
         {
-            // Offline non-maximum suppression: Collect all scores first, then apply non-maximum suppression
             #ifdef _OPENMP
-            Eigen::setNbThreads(1);
+            // Each thread forms a single chunk, so that the detections are concatenated in the order of the threads
+            ChunkedDetections threadDetections(omp_get_max_threads(), sizeHint);
             #pragma omp parallel
             {
+                StatClock::time_point threadStart = StatClock::now();
                 std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
-                DetectionList localDetections;
-                for (ProposalIterator range = this->m_proposals->iteratePartial(omp_get_num_threads(), omp_get_thread_num()); range != this->m_proposals->end(); ++range)
-                    localDetections.push_back(Detection(*range, (*divergence)(*range)));
-                #pragma omp critical
-                detections.insert(detections.end(), localDetections.begin(), localDetections.end());
+                divergence->resetStatistics();
+                ScoringBuffers buffers;
+                DetectionList & localDetections = threadDetections.local();
+                unsigned long long numScored = scoreProposals(
+                    this->m_proposals->iteratePartial(omp_get_num_threads(), omp_get_thread_num()), this->m_proposals->end(), *divergence,
+                    buffers, [&localDetections](Detection && detection) { localDetections.push_back(std::move(detection)); }
+                );
+                threadDetections.assign(omp_get_thread_num(), 0);
+                this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
             }
-            Eigen::setNbThreads(0);
+            threadDetections.concatenate(detections);
             #else
-            for (const IndexRange & range : *(this->m_proposals))
-                detections.push_back(Detection(range, (*(this->m_divergence))(range)));
+            this->m_divergence->resetStatistics();
+            ScoringBuffers buffers;
+            detections.reserve(sizeHint);
+            scoreProposals(
+                this->m_proposals->begin(), this->m_proposals->end(), *(this->m_divergence),
+                buffers, [&detections](Detection && detection) { detections.push_back(std::move(detection)); }
+            );
+            this->addThreadStatistics(detections.size(), secondsSince(start), *(this->m_divergence));
             #endif
-            
-            // Non-maximum suppression
-            nonMaximumSuppression(detections, numDetections, this->m_overlap_th);
+        }
+        Eigen::setNbThreads(0);
+        this->m_stats.scoringTime += secondsSince(start);
+        
+        // Non-maximum suppression
+        start = StatClock::now();
+        nonMaximumSuppression(detections, numDetections, this->m_overlap_th);
+        this->m_stats.nmsTime += secondsSince(start);
+    }
+    else
+    {
+        // Online non-maximum suppression: Apply non-maximum suppression concurrently while retrieving scores.
+        // The lists share a threshold for rejecting detections which can not be among the final ones.
+        std::vector<MaximumDetectionList> detectionLists;
+        std::shared_ptr<MaximumDetectionList::ScoreThreshold> threshold = std::make_shared<MaximumDetectionList::ScoreThreshold>(
+            -std::numeric_limits<Scalar>::infinity()
+        );
+        Eigen::setNbThreads(1);
+        if (chunked)
+        {
+            // The result of online non-maximum suppression depends on the order of insertion.
+            // Thus, we maintain a separate list for each chunk and merge them in a fixed order.
+            detectionLists.assign(numChunks, MaximumDetectionList(numDetections, this->m_overlap_th));
+            for (MaximumDetectionList & localDetections : detectionLists)
+                localDetections.shareScoreThreshold(threshold);
+            #pragma omp parallel
+            {
+                StatClock::time_point threadStart = StatClock::now();
+                std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
+                divergence->resetStatistics();
+                ScoringBuffers buffers;
+                unsigned long long numScored = 0;
+                DataTensor::Index i;
+                #pragma omp for schedule(dynamic,1) nowait
+                for (i = 0; i < numPartitionChunks; ++i)
+                {
+                    if (controller != nullptr && controller->shouldStop())
+                        continue;
+                    DataTensor::Index chunk = (controller != nullptr) ? chunkOrder[i] : firstChunk + i;
+                    MaximumDetectionList & localDetections = detectionLists[chunk];
+                    numScored += scoreProposals(
+                        this->m_proposals->iterateStartPoints(chunk * chunkSize, (chunk + 1) * chunkSize), this->m_proposals->end(), *divergence,
+                        buffers, [&localDetections](Detection && detection) { localDetections.insert(std::move(detection)); }, controller
+                    );
+                    if (controller != nullptr)
+                        controller->addProgress(std::min(chunkSize, numStartPoints - chunk * chunkSize));
+                }
+                this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
+            }
         }
         else
         {
-            // Online non-maximum suppression: Apply non-maximum suppression concurrently while retrieving scores
             #ifdef _OPENMP
-            std::vector<MaximumDetectionList> detectionLists(omp_get_max_threads(), MaximumDetectionList(numDetections, this->m_overlap_th));
-            Eigen::setNbThreads(1);
+            detectionLists.assign(omp_get_max_threads(), MaximumDetectionList(numDetections, this->m_overlap_th));
+            for (MaximumDetectionList & localDetections : detectionLists)
+                localDetections.shareScoreThreshold(threshold);
             #pragma omp parallel
             {
+                StatClock::time_point threadStart = StatClock::now();
                 std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
+                divergence->resetStatistics();
+                ScoringBuffers buffers;
                 MaximumDetectionList & localDetections = detectionLists[omp_get_thread_num()];
-                for (ProposalIterator range = this->m_proposals->iteratePartial(omp_get_num_threads(), omp_get_thread_num()); range != this->m_proposals->end(); ++range)
-                    localDetections.insert(Detection(*range, (*divergence)(*range)));
+                unsigned long long numScored = scoreProposals(
+                    this->m_proposals->iteratePartial(omp_get_num_threads(), omp_get_thread_num()), this->m_proposals->end(), *divergence,
+                    buffers, [&localDetections](Detection && detection) { localDetections.insert(std::move(detection)); }
+                );
+                this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
             }
-            Eigen::setNbThreads(0);
             #else
-            std::vector<MaximumDetectionList> detectionLists(1, MaximumDetectionList(numDetections, this->m_overlap_th));
-            for (const IndexRange & range : *(this->m_proposals))
-                detectionLists[0].insert(Detection(range, (*(this->m_divergence))(range)));
+            this->m_divergence->resetStatistics();
+            detectionLists.assign(1, MaximumDetectionList(numDetections, this->m_overlap_th));
+            MaximumDetectionList & localDetections = detectionLists[0];
+            ScoringBuffers buffers;
+            unsigned long long numScored = scoreProposals(
+                this->m_proposals->begin(), this->m_proposals->end(), *(this->m_divergence),
+                buffers, [&localDetections](Detection && detection) { localDetections.insert(std::move(detection)); }
+            );
+            this->addThreadStatistics(numScored, secondsSince(start), *(this->m_divergence));
             #endif
-            
-            // Merge results from different threads
-            if (detectionLists.size() > 1)
-                detectionLists[0].merge(detectionLists.begin() + 1, detectionLists.end());
-            detections.insert(detections.begin(), detectionLists[0].begin(), detectionLists[0].end());
         }
+        Eigen::setNbThreads(0);
+        this->m_stats.scoringTime += secondsSince(start);
         
-        // Release memory
-        if (this->autoReset)
-        {
-            this->m_divergence->reset();
-            this->m_proposals->reset();
-        }
+        // Merge results from different threads
+        start = StatClock::now();
+        if (detectionLists.size() > 1)
+            detectionLists[0].merge(detectionLists.begin() + 1, detectionLists.end());
+        if (!detectionLists.empty())
+            detections.insert(detections.begin(), detectionLists[0].begin(), detectionLists[0].end());
+        this->m_stats.nmsTime += secondsSince(start);
     }
     return detections;
 }
 
 
-MaximumDetectionList::MaximumDetectionList()
-: m_detections(), m_maxDetections(0), m_overlap_th(0.0) {}
-
-MaximumDetectionList::MaximumDetectionList(unsigned int maxDetections)
-: m_detections(), m_maxDetections(maxDetections), m_overlap_th(0.0) {}
-
-MaximumDetectionList::MaximumDetectionList(Scalar overlap_th)
-: m_detections(), m_maxDetections(0), m_overlap_th(overlap_th) {}
 
-MaximumDetectionList::MaximumDetectionList(unsigned int maxDetections, Scalar overlap_th)
-: m_detections(), m_maxDetections(maxDetections), m_overlap_th(overlap_th) {}
+StreamingSearch::StreamingSearch(DataTensor::Index windowLength)
+: ProposalSearch(), m_windowLength(windowLength), m_buffer(nullptr), m_bufferOffset(0), m_bufferLength(0),
+  m_streamOffset(0), m_numNew(0), m_numExpired(0), m_window(nullptr), m_windowValid(false), m_detections()
+{
+    if (windowLength == 0)
+        throw std::invalid_argument("windowLength must be greater than 0.");
+}
 
-MaximumDetectionList::MaximumDetectionList(const MaximumDetectionList & other)
-: m_detections(other.m_detections), m_maxDetections(other.m_maxDetections), m_overlap_th(other.m_overlap_th) {}
+StreamingSearch::StreamingSearch(const std::shared_ptr<Divergence> & divergence, DataTensor::Index windowLength)
+: ProposalSearch(divergence), m_windowLength(windowLength), m_buffer(nullptr), m_bufferOffset(0), m_bufferLength(0),
+  m_streamOffset(0), m_numNew(0), m_numExpired(0), m_window(nullptr), m_windowValid(false), m_detections()
+{
+    if (windowLength == 0)
+        throw std::invalid_argument("windowLength must be greater than 0.");
+}
 
-MaximumDetectionList::MaximumDetectionList(MaximumDetectionList && other)
-: m_detections(std::move(other.m_detections)), m_maxDetections(other.m_maxDetections), m_overlap_th(other.m_overlap_th) {}
+StreamingSearch::StreamingSearch(const std::shared_ptr<Divergence> & divergence, const std::shared_ptr<ProposalGenerator> & generator,
+                                 DataTensor::Index windowLength)
+: ProposalSearch(divergence, generator), m_windowLength(windowLength), m_buffer(nullptr), m_bufferOffset(0), m_bufferLength(0),
+  m_streamOffset(0), m_numNew(0), m_numExpired(0), m_window(nullptr), m_windowValid(false), m_detections()
+{
+    if (windowLength == 0)
+        throw std::invalid_argument("windowLength must be greater than 0.");
+}
 
-MaximumDetectionList & MaximumDetectionList::operator=(const MaximumDetectionList & other)
+std::shared_ptr<SearchStrategy> StreamingSearch::clone() const
 {
-    this->m_detections = other.m_detections;
-    this->m_maxDetections = other.m_maxDetections;
-    this->m_overlap_th = other.m_overlap_th;
+    std::shared_ptr<StreamingSearch> copy = std::make_shared<StreamingSearch>(
+        this->m_divergence->clone(), this->m_proposals->clone(), this->m_windowLength
+    );
+    copy->autoReset = this->autoReset;
+    copy->setPreprocessingPipeline(this->m_preproc);
+    copy->setOverlapTh(this->m_overlap_th);
+    copy->setScheduling(this->m_scheduling, this->m_chunkSize);
+    copy->setController(this->m_controller);
+    return copy;
 }
 
-MaximumDetectionList & MaximumDetectionList::operator=(MaximumDetectionList && other)
+bool StreamingSearch::push(const DataTensor & samples)
 {
-    this->m_detections = std::move(other.m_detections);
-    this->m_maxDetections = other.m_maxDetections;
-    this->m_overlap_th = other.m_overlap_th;
+    if (samples.empty())
+        return true;
+    
+    // Check shape of the samples or allocate buffer on first push
+    if (this->m_buffer)
+    {
+        const ReflessIndexVector & shape = this->m_buffer->shape();
+        if (samples.width() != shape.x || samples.height() != shape.y || samples.depth() != shape.z || samples.numAttrib() != shape.d)
+            return false;
+    }
+    else
+    {
+        ReflessIndexVector shape = samples.shape();
+        shape.t = 2 * this->m_windowLength;
+        this->m_buffer = std::make_shared<DataTensor>(shape);
+        this->m_bufferOffset = this->m_bufferLength = 0;
+    }
+    DataTensor::Index stepSize = samples.numEl() / samples.length();
+    
+    // Skip samples which would expire immediately
+    DataTensor::Index numSkipped = (samples.length() > this->m_windowLength) ? samples.length() - this->m_windowLength : 0;
+    DataTensor::Index numAdded = samples.length() - numSkipped;
+    
+    // Discard the oldest time steps
+    DataTensor::Index numDiscarded = (this->m_bufferLength + numAdded > this->m_windowLength)
+                                     ? this->m_bufferLength + numAdded - this->m_windowLength
+                                     : 0;
+    this->m_bufferOffset += numDiscarded;
+    this->m_bufferLength -= numDiscarded;
+    this->m_streamOffset += numDiscarded + numSkipped;
+    this->m_numExpired += numDiscarded + numSkipped;
+    
+    // Move the window to the beginning of the buffer if the new samples wouldn't fit
+    Scalar * buffer = this->m_buffer->raw();
+    if (this->m_bufferOffset + this->m_bufferLength + numAdded > this->m_buffer->length())
+    {
+        std::copy(buffer + this->m_bufferOffset * stepSize, buffer + (this->m_bufferOffset + this->m_bufferLength) * stepSize, buffer);
+        this->m_bufferOffset = 0;
+    }
+    
+    // Copy new samples to the buffer and encode missing samples as NaN
+    Scalar * dest = buffer + (this->m_bufferOffset + this->m_bufferLength) * stepSize;
+    std::copy(samples.raw() + numSkipped * stepSize, samples.raw() + samples.numEl(), dest);
+    if (samples.hasMissingSamples())
+    {
+        DataTensor::Index firstSample = numSkipped * stepSize / samples.numAttrib();
+        for (DataTensor::Index s : samples.getMissingSampleIndices())
+            if (s >= firstSample)
+                std::fill(
+                    dest + (s - firstSample) * samples.numAttrib(), dest + (s - firstSample + 1) * samples.numAttrib(),
+                    std::numeric_limits<Scalar>::quiet_NaN()
+                );
+    }
+    
+    this->m_bufferLength += numAdded;
+    this->m_numNew += numAdded;
+    return true;
 }
 
-bool MaximumDetectionList::insert(const Detection & detection)
+DetectionList StreamingSearch::poll(unsigned int numDetections)
 {
-    if (this->m_detections.empty())
+    if (this->m_bufferLength == 0)
+        return DetectionList();
+    
+    if (this->m_window && this->m_windowValid && this->m_numNew == 0 && this->m_numExpired == 0)
     {
-        this->m_detections.push_back(detection);
-        return true;
+        // Nothing has changed since the last poll
+        if (numDetections > 0 && numDetections < this->m_detections.size())
+            return DetectionList(this->m_detections.begin(), this->m_detections.begin() + numDetections);
+        return this->m_detections;
+    }
+    
+    StatClock::time_point pollStart = StatClock::now();
+    
+    // Create a view of the current window
+    DataTensor::Index numRetained = (this->m_window && this->m_numExpired < this->m_window->length())
+                                    ? this->m_window->length() - this->m_numExpired
+                                    : 0;
+    bool reinit = (numRetained == 0 || !this->m_windowValid);
+    ReflessIndexVector shape = this->m_buffer->shape();
+    shape.t = this->m_bufferLength;
+    DataTensor::Index samplesPerStep = shape.x * shape.y * shape.z;
+    std::shared_ptr<DataTensor> window = std::make_shared<DataTensor>(
+        this->m_buffer->raw() + this->m_bufferOffset * samplesPerStep * shape.d, shape
+    );
+    
+    // Transfer the mask of retained samples and mask missing samples among the new ones
+    if (numRetained > 0)
+    {
+        DataTensor::Index numExpiredSamples = this->m_numExpired * samplesPerStep;
+        for (DataTensor::Index s : this->m_window->getMissingSampleIndices())
+            if (s >= numExpiredSamples)
+                window->setMissingSample(s - numExpiredSamples);
     }
-    else if (this->m_maxDetections == 1)
+    const DataTensor & constWindow = *window;
+    for (DataTensor::Index s = numRetained * samplesPerStep; s < window->numSamples(); ++s)
+        if (constWindow.sample(s).hasNaN())
+            window->setMissingSample(s);
+    this->m_stats.preprocessingTime += secondsSince(pollStart);
+    
+    // Move the divergence forward
+    StatClock::time_point start = StatClock::now();
+    DataTensor::Index newStart;
+    if (reinit)
     {
-        if (detection < this->m_detections.front())
-        {
-            this->m_detections.front() = detection;
-            return true;
-        }
-        else
-            return false;
+        this->m_divergence->init(window);
+        this->m_candidates.clear();
+        newStart = 0;
+        this->m_windowValid = true;
     }
     else
     {
-        iterator pos;
-        for (pos = this->m_detections.begin(); pos != this->m_detections.end() && *pos < detection; ++pos)
-            if (this->m_overlap_th < 1.0 && pos->IoU(detection) > this->m_overlap_th)
-                return false;
-        
-        if (pos != this->m_detections.end())
+        this->m_divergence->update(window, this->m_numExpired);
+        newStart = numRetained;
+    }
+    this->m_stats.initTime += secondsSince(start);
+    start = StatClock::now();
+    this->m_proposals->init(window);
+    this->m_stats.proposalTime += secondsSince(start);
+    this->m_window = window;
+    this->m_numNew = this->m_numExpired = 0;
+    
+    // Discard candidates which are not entirely contained in the window anymore
+    DetectionList candidates;
+    candidates.swap(this->m_candidates);
+    candidates.erase(
+        std::remove_if(candidates.begin(), candidates.end(),
+                       [this](const Detection & detection) { return detection.a.t < this->m_streamOffset; }),
+        candidates.end()
+    );
+    const std::size_t numCandidateBatches = (candidates.size() + MAXDIV_SCORE_BATCH_SIZE - 1) / MAXDIV_SCORE_BATCH_SIZE;
+    
+    // Only ranges ending after newStart have to be scored. Determine the first start point of such ranges.
+    DataTensor::Index maxLength = this->m_proposals->getLengthRange().b.t;
+    DataTensor::Index firstStartPoint = ((maxLength > 0 && newStart >= maxLength) ? newStart - maxLength + 1 : 0) * samplesPerStep;
+    DataTensor::Index numStartPoints = this->m_proposals->numStartPoints() - firstStartPoint;
+    DataTensor::Index chunkSize = this->m_chunkSize;
+    if (chunkSize == 0)
+        chunkSize = std::max(numStartPoints / MAXDIV_DYNAMIC_SCHEDULE_CHUNKS, static_cast<DataTensor::Index>(1));
+    DataTensor::Index numChunks = (numStartPoints + chunkSize - 1) / chunkSize;
+    
+    // Score new ranges and re-score the candidates, since the distribution of the remaining data in the window
+    // has changed. New detections are collected per chunk to be independent of the number of threads.
+    bool offlineNMS = (window->numSamples() <= MAXDIV_NMP_LIMIT);
+    ChunkedDetections chunkDetections((offlineNMS) ? numChunks : 0, 0);
+    std::vector<MaximumDetectionList> detectionLists((offlineNMS) ? 0 : numChunks, MaximumDetectionList(this->m_overlap_th));
+    start = StatClock::now();
+    Eigen::setNbThreads(1);
+    #pragma omp parallel
+    {
+        StatClock::time_point threadStart = StatClock::now();
+        std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
+        divergence->resetStatistics();
+        ScoringBuffers buffers;
+        DetectionList * localDetections = (offlineNMS) ? &chunkDetections.local() : nullptr;
+        unsigned long long numScored = 0;
+        DataTensor::Index chunk;
+        #pragma omp for schedule(dynamic,1) nowait
+        for (chunk = 0; chunk < numChunks; ++chunk)
         {
-            this->m_detections.insert(pos, detection);
-            if (this->m_overlap_th < 1.0)
-                while (pos != this->m_detections.end())
+            std::size_t begin = (offlineNMS) ? localDetections->size() : 0;
+            MaximumDetectionList * localMaxDetections = (offlineNMS) ? nullptr : &detectionLists[chunk];
+            numScored += scoreProposals(
+                this->m_proposals->iterateStartPoints(firstStartPoint + chunk * chunkSize, firstStartPoint + (chunk + 1) * chunkSize),
+                this->m_proposals->end(), *divergence, buffers,
+                [newStart](const IndexRange & range) { return range.b.t > newStart; },
+                [localDetections, localMaxDetections](Detection && detection)
                 {
-                    if (pos->IoU(detection) > this->m_overlap_th)
-                        pos = this->m_detections.erase(pos);
+                    if (localDetections != nullptr)
+                        localDetections->push_back(std::move(detection));
                     else
-                        ++pos;
+                        localMaxDetections->insert(std::move(detection));
                 }
-            if (this->m_maxDetections > 0 && this->m_detections.size() > this->m_maxDetections)
-                this->m_detections.pop_back();
-            return true;
+            );
+            if (offlineNMS)
+                chunkDetections.assign(chunk, begin);
         }
-        else if (this->m_maxDetections > 0 || this->m_detections.size() < this->m_maxDetections)
+        std::size_t batch;
+        #pragma omp for schedule(dynamic,1) nowait
+        for (batch = 0; batch < numCandidateBatches; ++batch)
         {
-            this->m_detections.push_back(detection);
-            return true;
+            const std::size_t first = batch * MAXDIV_SCORE_BATCH_SIZE;
+            const std::size_t last = std::min(first + MAXDIV_SCORE_BATCH_SIZE, candidates.size());
+            buffers.batch.clear();
+            for (std::size_t i = first; i < last; ++i)
+            {
+                IndexRange range(candidates[i]);
+                range.a.t -= this->m_streamOffset;
+                range.b.t -= this->m_streamOffset;
+                buffers.batch.push_back(range);
+            }
+            divergence->score(buffers.batch, buffers.scores.data());
+            for (std::size_t i = first; i < last; ++i)
+                candidates[i].score = buffers.scores[i - first];
+            numScored += last - first;
         }
-        else
-            return false;
+        this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
+    }
+    Eigen::setNbThreads(0);
+    this->m_stats.scoringTime += secondsSince(start);
+    
+    // Combine new detections with the candidates
+    DetectionList detections;
+    detections.swap(candidates);
+    std::size_t numRetainedCandidates = detections.size();
+    chunkDetections.concatenate(detections);
+    for (auto detection = detections.begin() + numRetainedCandidates; detection != detections.end(); ++detection)
+    {
+        detection->a.t += this->m_streamOffset;
+        detection->b.t += this->m_streamOffset;
     }
+    for (MaximumDetectionList & localDetections : detectionLists)
+        for (Detection detection : localDetections)
+        {
+            detection.a.t += this->m_streamOffset;
+            detection.b.t += this->m_streamOffset;
+            detections.push_back(detection);
+        }
+    
+    // Non-maximum suppression, which keeps the ranges suppressed by the detections as candidates for later polls
+    start = StatClock::now();
+    this->m_candidates.swap(detections);
+    layeredNonMaximumSuppression(this->m_candidates, detections, MAXDIV_STREAM_CANDIDATE_LAYERS, this->m_overlap_th);
+    this->m_stats.nmsTime += secondsSince(start);
+    this->m_stats.totalTime += secondsSince(pollStart);
+    ++this->m_stats.numSearches;
+    this->m_detections = detections;
+    if (numDetections > 0 && numDetections < detections.size())
+        detections.resize(numDetections);
+    return detections;
 }
 
-bool MaximumDetectionList::insert(Detection && detection)
+void StreamingSearch::resetStream()
 {
-    if (this->m_detections.empty())
+    this->m_buffer.reset();
+    this->m_bufferOffset = this->m_bufferLength = this->m_streamOffset = 0;
+    this->m_numNew = this->m_numExpired = 0;
+    this->m_window.reset();
+    this->m_windowValid = false;
+    this->m_detections.clear();
+    this->m_candidates.clear();
+    this->m_divergence->reset();
+    this->m_proposals->reset();
+}
+
+DetectionList StreamingSearch::detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections)
+{
+    DetectionList detections = ProposalSearch::detect(data, numDetections);
+    // The divergence has been initialized with other data, so the window has to be processed from scratch on the next poll
+    this->m_windowValid = false;
+    return detections;
+}
+
+
+
+namespace
+{
+
+/**
+* A group of ranges processed by BranchAndBoundSearch, given by the first and the last start point and the first
+* and the last end point (exclusive) along each dimension. A group with a single start and end point along each
+* dimension may also be a single range which has already been scored.
+*/
+struct BranchAndBoundGroup
+{
+    Scalar bound; /**< Upper bound on the scores of the ranges in the group or the actual score of a scored range. */
+    bool scored; /**< Specifies whether this is a single range whose score is given by `bound`. */
+    ReflessIndexVector firstStart;
+    ReflessIndexVector lastStart;
+    ReflessIndexVector firstEnd;
+    ReflessIndexVector lastEnd;
+    
+    /**
+    * Order for the priority queue: Groups with higher bounds come first and scored ranges take precedence over
+    * groups with the same bound.
+    */
+    bool operator<(const BranchAndBoundGroup & other) const
+    {
+        return (this->bound < other.bound || (this->bound == other.bound && !this->scored && other.scored));
+    };
+    
+    IndexRange hull(const ReflessIndexVector & shape) const
+    {
+        IndexRange range(IndexVector(shape, this->firstStart), IndexVector(shape, this->lastEnd));
+        range.a.d = 0;
+        range.b.d = shape.d;
+        return range;
+    };
+    
+    IndexRange core(const ReflessIndexVector & shape) const
     {
-        this->m_detections.push_back(std::move(detection));
+        IndexRange range(IndexVector(shape, this->lastStart), IndexVector(shape, this->firstEnd));
+        range.a.d = 0;
+        range.b.d = shape.d;
+        return range;
+    };
+    
+    /**
+    * Removes start and end points which can not be part of any range satisfying the given length constraints.
+    *
+    * @return Returns `false` if the group does not contain any range satisfying the constraints.
+    */
+    bool tighten(const ReflessIndexVector & minLength, const ReflessIndexVector & maxLength)
+    {
+        for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+        {
+            if (this->lastEnd.ind[i] < this->firstStart.ind[i] + minLength.ind[i] || this->firstEnd.ind[i] > this->lastStart.ind[i] + maxLength.ind[i])
+                return false;
+            this->firstEnd.ind[i] = std::max(this->firstEnd.ind[i], this->firstStart.ind[i] + minLength.ind[i]);
+            this->lastEnd.ind[i] = std::min(this->lastEnd.ind[i], this->lastStart.ind[i] + maxLength.ind[i]);
+            this->lastStart.ind[i] = std::min(this->lastStart.ind[i], this->lastEnd.ind[i] - minLength.ind[i]);
+            if (this->firstEnd.ind[i] > maxLength.ind[i])
+                this->firstStart.ind[i] = std::max(this->firstStart.ind[i], this->firstEnd.ind[i] - maxLength.ind[i]);
+            if (this->firstStart.ind[i] > this->lastStart.ind[i] || this->firstEnd.ind[i] > this->lastEnd.ind[i])
+                return false;
+        }
         return true;
+    };
+    
+    /**
+    * @return Returns the number of combinations of start and end points in this group, which is an upper bound on the number of ranges.
+    */
+    Scalar size() const
+    {
+        Scalar size = 1;
+        for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+            size *= static_cast<Scalar>(this->lastStart.ind[i] - this->firstStart.ind[i] + 1) * static_cast<Scalar>(this->lastEnd.ind[i] - this->firstEnd.ind[i] + 1);
+        return size;
+    };
+    
+    /**
+    * Checks whether all ranges in this group have an IoU greater than @p overlap_th with a given @p detection.
+    */
+    bool isSuppressedBy(const Detection & detection, Scalar overlap_th) const
+    {
+        // Every range contains the core and is contained in the hull, so that its intersection with the detection is
+        // at least the intersection of the core and its union with the detection is at most the union of the hull.
+        Scalar intersection = 1, hullVolume = 1, detectionVolume = 1;
+        for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+        {
+            DataTensor::Index a = std::max(this->lastStart.ind[i], detection.a.ind[i]), b = std::min(this->firstEnd.ind[i], detection.b.ind[i]);
+            if (b <= a)
+                return false;
+            intersection *= b - a;
+            hullVolume *= this->lastEnd.ind[i] - this->firstStart.ind[i];
+            detectionVolume *= detection.b.ind[i] - detection.a.ind[i];
+        }
+        return (intersection / (hullVolume + detectionVolume - intersection) > overlap_th);
+    };
+};
+
+}
+
+
+BranchAndBoundSearch::BranchAndBoundSearch()
+: SearchStrategy(), m_lengthRange(), m_leafSize(MAXDIV_BNB_LEAF_SIZE) {}
+
+BranchAndBoundSearch::BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence)
+: SearchStrategy(divergence), m_lengthRange(), m_leafSize(MAXDIV_BNB_LEAF_SIZE) {}
+
+BranchAndBoundSearch::BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange)
+: SearchStrategy(divergence), m_lengthRange(lengthRange), m_leafSize(MAXDIV_BNB_LEAF_SIZE) {}
+
+BranchAndBoundSearch::BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                                           const std::shared_ptr<const PreprocessingPipeline> & preprocessing)
+: SearchStrategy(divergence, preprocessing), m_lengthRange(lengthRange), m_leafSize(MAXDIV_BNB_LEAF_SIZE) {}
+
+std::shared_ptr<SearchStrategy> BranchAndBoundSearch::clone() const
+{
+    std::shared_ptr<BranchAndBoundSearch> copy = std::make_shared<BranchAndBoundSearch>(*this);
+    copy->m_divergence = this->m_divergence->clone();
+    copy->resetStatistics();
+    return copy;
+}
+
+DetectionList BranchAndBoundSearch::detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections)
+{
+    DetectionList detections;
+    if (!data || data->empty())
+        return detections;
+    
+    // Initialize density estimator
+    StatClock::time_point start = StatClock::now();
+    this->m_divergence->init(data);
+    this->m_stats.initTime += secondsSince(start);
+    start = StatClock::now();
+    
+    // Determine the length constraints in the same way as DenseProposalGenerator
+    const ReflessIndexVector shape = data->shape();
+    ReflessIndexVector minLength, maxLength;
+    BranchAndBoundGroup root;
+    root.scored = false;
+    for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+    {
+        minLength.ind[i] = std::min(std::max(this->m_lengthRange.a.ind[i], static_cast<DataTensor::Index>(1)), shape.ind[i]);
+        maxLength.ind[i] = (this->m_lengthRange.b.ind[i] == 0 || this->m_lengthRange.b.ind[i] > shape.ind[i]) ? shape.ind[i] : this->m_lengthRange.b.ind[i];
+        root.firstStart.ind[i] = 0;
+        root.lastStart.ind[i] = shape.ind[i] - 1;
+        root.firstEnd.ind[i] = 1;
+        root.lastEnd.ind[i] = shape.ind[i];
     }
-    else if (this->m_maxDetections == 1)
+    // A range spanning the entire time series would not leave any sample for the outer distribution
+    if (shape.prod(1, MAXDIV_INDEX_DIMENSION - 2) == 1 && shape.t > 1 && maxLength.t >= shape.t)
+        maxLength.t = shape.t - 1;
+    
+    // Checks whether a range covers all valid samples, so that its score would be undefined
+    const DataTensor::Index numValidSamples = data->numValidSamples();
+    auto coversAllSamples = [&data, numValidSamples](const IndexRange & range)
+    {
+        DataTensor::Index rangeSize = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2);
+        return (rangeSize - data->numMissingSamplesInRange(range) >= numValidSamples);
+    };
+    
+    // Checks whether a group would be suppressed entirely by one of the detections found so far
+    bool nms = (this->m_overlap_th < 1.0);
+    auto isSuppressed = [&detections, nms, this](const BranchAndBoundGroup & group)
     {
-        if (detection < this->m_detections.front())
+        if (nms)
+            for (const Detection & detection : detections)
+                if (group.isSuppressedBy(detection, this->m_overlap_th))
+                    return true;
+        return false;
+    };
+    
+    std::priority_queue<BranchAndBoundGroup> queue;
+    if (root.tighten(minLength, maxLength))
+    {
+        root.bound = this->m_divergence->upperBound(root.core(shape), root.hull(shape));
+        if (std::isnan(root.bound))
+            root.bound = std::numeric_limits<Scalar>::infinity();
+        queue.push(root);
+    }
+    
+    unsigned long long numScored = 0;
+    SearchController * controller = this->m_controller.get();
+    while (!queue.empty() && (numDetections == 0 || detections.size() < numDetections))
+    {
+        BranchAndBoundGroup group = queue.top();
+        queue.pop();
+        
+        // A stopped search only reports the ranges which have been scored already, in the order of their scores
+        if (!group.scored && controller != nullptr && controller->shouldStop())
+            continue;
+        
+        if (group.scored)
         {
-            this->m_detections.front() = std::move(detection);
-            return true;
+            // No range which has not been scored yet can have a higher score than this one
+            Detection detection(group.hull(shape), group.bound);
+            bool suppressed = false;
+            if (nms)
+                for (const Detection & prevDetection : detections)
+                    if (prevDetection.IoU(detection) > this->m_overlap_th)
+                    {
+                        suppressed = true;
+                        break;
+                    }
+            if (!suppressed)
+                detections.push_back(detection);
+        }
+        else if (isSuppressed(group)) // there may be new detections since the group has been added to the queue
+            continue;
+        else if (group.size() <= this->m_leafSize)
+        {
+            // Enumerate the combinations of start and end points along each dimension
+            std::vector< std::pair<DataTensor::Index, DataTensor::Index> > bounds[MAXDIV_INDEX_DIMENSION - 1];
+            bool nonEmpty = true;
+            for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1 && nonEmpty; ++i)
+            {
+                for (DataTensor::Index s = group.firstStart.ind[i]; s <= group.lastStart.ind[i]; ++s)
+                    for (DataTensor::Index e = std::max(group.firstEnd.ind[i], s + minLength.ind[i]); e <= std::min(group.lastEnd.ind[i], s + maxLength.ind[i]); ++e)
+                        bounds[i].push_back(std::make_pair(s, e));
+                nonEmpty = !bounds[i].empty();
+            }
+            
+            // Score all ranges which would not be suppressed anyway
+            std::size_t pos[MAXDIV_INDEX_DIMENSION - 1] = { 0 };
+            BranchAndBoundGroup range;
+            range.scored = true;
+            while (nonEmpty)
+            {
+                for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+                {
+                    range.firstStart.ind[i] = range.lastStart.ind[i] = bounds[i][pos[i]].first;
+                    range.firstEnd.ind[i] = range.lastEnd.ind[i] = bounds[i][pos[i]].second;
+                }
+                IndexRange innerRange = range.hull(shape);
+                if (!data->isRangeReducable(innerRange) && !coversAllSamples(innerRange) && !isSuppressed(range))
+                {
+                    // Non-finite scores would break the ordering of the queue
+                    range.bound = (*(this->m_divergence))(innerRange);
+                    if (std::isfinite(range.bound))
+                        queue.push(range);
+                    ++numScored;
+                }
+                
+                // Move on to the next combination
+                unsigned int i;
+                for (i = 0; i < MAXDIV_INDEX_DIMENSION - 1 && pos[i] + 1 >= bounds[i].size(); ++i)
+                    pos[i] = 0;
+                if (i < MAXDIV_INDEX_DIMENSION - 1)
+                    ++pos[i];
+                else
+                    nonEmpty = false;
+            }
         }
         else
-            return false;
+        {
+            // Split the widest interval of start or end points in half
+            unsigned int splitDim = 0;
+            bool splitStart = true;
+            DataTensor::Index maxWidth = 0;
+            for (unsigned int i = 0; i < MAXDIV_INDEX_DIMENSION - 1; ++i)
+            {
+                if (group.lastStart.ind[i] - group.firstStart.ind[i] > maxWidth)
+                {
+                    maxWidth = group.lastStart.ind[i] - group.firstStart.ind[i];
+                    splitDim = i;
+                    splitStart = true;
+                }
+                if (group.lastEnd.ind[i] - group.firstEnd.ind[i] > maxWidth)
+                {
+                    maxWidth = group.lastEnd.ind[i] - group.firstEnd.ind[i];
+                    splitDim = i;
+                    splitStart = false;
+                }
+            }
+            
+            BranchAndBoundGroup children[2] = { group, group };
+            if (splitStart)
+            {
+                children[0].lastStart.ind[splitDim] = group.firstStart.ind[splitDim] + maxWidth / 2;
+                children[1].firstStart.ind[splitDim] = children[0].lastStart.ind[splitDim] + 1;
+            }
+            else
+            {
+                children[0].lastEnd.ind[splitDim] = group.firstEnd.ind[splitDim] + maxWidth / 2;
+                children[1].firstEnd.ind[splitDim] = children[0].lastEnd.ind[splitDim] + 1;
+            }
+            
+            for (BranchAndBoundGroup & child : children)
+                if (child.tighten(minLength, maxLength) && !isSuppressed(child))
+                {
+                    // The bound of the parent holds for the child as well
+                    child.bound = this->m_divergence->upperBound(child.core(shape), child.hull(shape));
+                    if (std::isnan(child.bound) || child.bound > group.bound)
+                        child.bound = group.bound;
+                    queue.push(child);
+                }
+        }
     }
-    else
+    this->addThreadStatistics(numScored, secondsSince(start), *(this->m_divergence));
+    this->m_stats.scoringTime += secondsSince(start);
+    
+    // Release memory
+    if (this->autoReset)
+        this->m_divergence->reset();
+    
+    return detections;
+}
+
+
+MultiResolutionSearch::MultiResolutionSearch()
+: SearchStrategy(), m_lengthRange(), m_levels(2), m_factor(24) {}
+
+MultiResolutionSearch::MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence)
+: SearchStrategy(divergence), m_lengthRange(), m_levels(2), m_factor(24) {}
+
+MultiResolutionSearch::MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                                             unsigned int levels, DataTensor::Index factor)
+: SearchStrategy(divergence), m_lengthRange(lengthRange), m_levels(levels), m_factor(factor)
+{
+    if (levels == 0)
+        throw std::invalid_argument("levels must be greater than 0.");
+    if (factor < 2)
+        throw std::invalid_argument("factor must be greater than 1.");
+}
+
+MultiResolutionSearch::MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                                             unsigned int levels, DataTensor::Index factor,
+                                             const std::shared_ptr<const PreprocessingPipeline> & preprocessing)
+: SearchStrategy(divergence, preprocessing), m_lengthRange(lengthRange), m_levels(levels), m_factor(factor)
+{
+    if (levels == 0)
+        throw std::invalid_argument("levels must be greater than 0.");
+    if (factor < 2)
+        throw std::invalid_argument("factor must be greater than 1.");
+}
+
+std::shared_ptr<SearchStrategy> MultiResolutionSearch::clone() const
+{
+    std::shared_ptr<MultiResolutionSearch> copy = std::make_shared<MultiResolutionSearch>(*this);
+    copy->m_divergence = this->m_divergence->clone();
+    copy->resetStatistics();
+    return copy;
+}
+
+std::shared_ptr<DataTensor> MultiResolutionSearch::temporalPooling(const DataTensor & data, DataTensor::Index factor)
+{
+    ReflessIndexVector shape = data.shape();
+    shape.t = (shape.t + factor - 1) / factor;
+    std::shared_ptr<DataTensor> pooled = std::make_shared<DataTensor>(shape, 0);
+    if (pooled->empty())
+        return pooled;
+    
+    // Sum up the valid samples of each block
+    const DataTensor::Index numLocations = data.numSamples() / data.length();
+    std::vector<DataTensor::Index> counts(pooled->numSamples(), 0);
+    Eigen::Map<const ScalarMatrix> samples = data.data();
+    Eigen::Map<ScalarMatrix> pooledSamples = pooled->data();
+    for (DataTensor::Index s = 0; s < data.numSamples(); ++s)
+        if (!data.isMissingSample(s))
+        {
+            DataTensor::Index ps = (s / numLocations / factor) * numLocations + s % numLocations;
+            pooledSamples.row(ps) += samples.row(s);
+            ++counts[ps];
+        }
+    
+    // Divide by the number of valid samples and mark empty blocks as missing
+    for (DataTensor::Index ps = 0; ps < pooled->numSamples(); ++ps)
+        if (counts[ps] > 0)
+            pooledSamples.row(ps) /= static_cast<Scalar>(counts[ps]);
+    for (DataTensor::Index ps = 0; ps < pooled->numSamples(); ++ps)
+        if (counts[ps] == 0)
+            pooled->setMissingSample(ps);
+    return pooled;
+}
+
+DetectionList MultiResolutionSearch::detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections)
+{
+    DetectionList detections;
+    if (!data || data->empty())
+        return detections;
+    
+    // Build the pyramid, stopping early if the coarsest level would not be longer than a single block of the next one
+    StatClock::time_point start = StatClock::now();
+    std::vector< std::shared_ptr<const DataTensor> > pyramid(1, data);
+    std::vector<DataTensor::Index> resolution(1, 1);
+    while (pyramid.size() < this->m_levels && pyramid.back()->length() > this->m_factor)
     {
-        iterator pos;
-        for (pos = this->m_detections.begin(); pos != this->m_detections.end() && *pos < detection; ++pos)
-            if (this->m_overlap_th < 1.0 && pos->IoU(detection) > this->m_overlap_th)
-                return false;
+        pyramid.push_back(temporalPooling(*(pyramid.back()), this->m_factor));
+        resolution.push_back(resolution.back() * this->m_factor);
+    }
+    this->m_stats.preprocessingTime += secondsSince(start);
+    
+    // Scales the temporal length constraints down to the resolution of a level
+    auto levelLengthRange = [this](DataTensor::Index res)
+    {
+        IndexRange lengthRange = this->m_lengthRange;
+        lengthRange.a.t = std::max(lengthRange.a.t / res, static_cast<DataTensor::Index>(1));
+        if (lengthRange.b.t > 0)
+            lengthRange.b.t = (lengthRange.b.t + res - 1) / res;
+        return lengthRange;
+    };
+    
+    // Search for candidates on the coarsest level
+    const std::size_t coarsest = pyramid.size() - 1;
+    unsigned int numCandidates = (coarsest > 0) ? numDetections * MAXDIV_MULTIRES_CANDIDATE_FACTOR : numDetections;
+    ProposalSearch coarseSearch(this->m_divergence, std::make_shared<DenseProposalGenerator>(levelLengthRange(resolution[coarsest])));
+    coarseSearch.setOverlapTh(this->m_overlap_th);
+    coarseSearch.autoReset = this->autoReset;
+    coarseSearch.setController(this->m_controller);
+    detections = coarseSearch(pyramid[coarsest], numCandidates);
+    
+    // The coarse search is not counted as a search of its own and its total time is part of the total time of this one
+    SearchStatistics coarseStats = coarseSearch.getStatistics();
+    coarseStats.numSearches = 0;
+    coarseStats.numPartialSearches = 0;
+    coarseStats.totalTime = 0;
+    this->m_stats += coarseStats;
+    
+    // Refine the candidates level by level
+    SearchController * controller = this->m_controller.get();
+    for (std::size_t level = coarsest; level-- > 0 && !detections.empty(); )
+    {
+        const DataTensor & levelData = *(pyramid[level]);
+        const DataTensor::Index length = levelData.length(), q = this->m_factor;
+        IndexRange lengthRange = levelLengthRange(resolution[level]);
+        const DataTensor::Index minLength = std::min(lengthRange.a.t, length);
+        const DataTensor::Index maxLength = (lengthRange.b.t == 0 || lengthRange.b.t > length) ? length : lengthRange.b.t;
         
-        if (pos != this->m_detections.end())
+        start = StatClock::now();
+        this->m_divergence->init(pyramid[level]);
+        this->m_stats.initTime += secondsSince(start);
+        
+        // Search for the best range whose start and end point are within a block around those of each candidate
+        // and move the window as long as the best range is at its border and its score improves
+        start = StatClock::now();
+        const DataTensor::Index numCandidateRanges = detections.size();
+        std::vector<char> found(numCandidateRanges, 0);
+        Eigen::setNbThreads(1);
+        #pragma omp parallel
         {
-            iterator det = this->m_detections.insert(pos, std::move(detection));
-            if (this->m_overlap_th < 1.0)
-                while (pos != this->m_detections.end())
+            StatClock::time_point threadStart = StatClock::now();
+            std::shared_ptr<Divergence> divergence = this->m_divergence->clone();
+            divergence->resetStatistics();
+            unsigned long long numScored = 0;
+            DataTensor::Index c;
+            #pragma omp for schedule(dynamic,1)
+            for (c = 0; c < numCandidateRanges; ++c)
+            {
+                Detection & candidate = detections[c];
+                DataTensor::Index centerStart = candidate.a.t * q, centerEnd = std::min(candidate.b.t * q, length);
+                IndexRange range(IndexVector(levelData.shape(), candidate.a), IndexVector(levelData.shape(), candidate.b));
+                if (controller != nullptr && controller->shouldStop())
                 {
-                    if (pos->IoU(*det) > this->m_overlap_th)
-                        pos = this->m_detections.erase(pos);
-                    else
-                        ++pos;
+                    // A stopped search keeps the candidate with its coarse score, scaled to this level without refinement
+                    range.a.t = centerStart;
+                    range.b.t = centerEnd;
+                    candidate = Detection(range, candidate.score);
+                    found[c] = 1;
+                    continue;
                 }
-            if (this->m_maxDetections > 0 && this->m_detections.size() > this->m_maxDetections)
-                this->m_detections.pop_back();
-            return true;
+                Detection best;
+                bool moveWindow = true;
+                while (moveWindow)
+                {
+                    const DataTensor::Index firstStart = (centerStart > q) ? centerStart - q : 0;
+                    const DataTensor::Index lastStart = std::min(centerStart + q, length - 1);
+                    const DataTensor::Index firstEnd = (centerEnd > q + 1) ? centerEnd - q : 1;
+                    const DataTensor::Index lastEnd = std::min(centerEnd + q, length);
+                    bool improved = false;
+                    for (DataTensor::Index s = firstStart; s <= lastStart; ++s)
+                        for (DataTensor::Index e = std::max(firstEnd, s + minLength); e <= std::min(lastEnd, s + maxLength); ++e)
+                        {
+                            range.a.t = s;
+                            range.b.t = e;
+                            if (!levelData.isRangeReducable(range))
+                            {
+                                Scalar score = (*divergence)(range);
+                                ++numScored;
+                                if (!found[c] || score > best.score)
+                                {
+                                    best = Detection(range, score);
+                                    found[c] = 1;
+                                    improved = true;
+                                }
+                            }
+                        }
+                    moveWindow = improved && ((best.a.t == firstStart && firstStart > 0) || (best.a.t == lastStart && lastStart < length - 1)
+                                               || (best.b.t == firstEnd && firstEnd > 1) || (best.b.t == lastEnd && lastEnd < length));
+                    centerStart = best.a.t;
+                    centerEnd = best.b.t;
+                }
+                if (found[c])
+                    candidate = best;
+            }
+            this->addThreadStatistics(numScored, secondsSince(threadStart), *divergence);
         }
-        else if (this->m_maxDetections > 0 || this->m_detections.size() < this->m_maxDetections)
+        Eigen::setNbThreads(0);
+        this->m_stats.scoringTime += secondsSince(start);
+        
+        // Discard candidates without any valid range and suppress candidates which have converged to the same range
+        start = StatClock::now();
+        DataTensor::Index numFound = 0;
+        for (DataTensor::Index c = 0; c < numCandidateRanges; ++c)
+            if (found[c])
+                detections[numFound++] = detections[c];
+        detections.resize(numFound);
+        nonMaximumSuppression(detections, (level > 0) ? numCandidates : numDetections, this->m_overlap_th);
+        this->m_stats.nmsTime += secondsSince(start);
+    }
+    
+    // Release memory
+    if (this->autoReset)
+        this->m_divergence->reset();
+    
+    return detections;
+}
+
+
+MaximumDetectionList::MaximumDetectionList()
+: m_detections(), m_maxDetections(0), m_overlap_th(0.0), m_startIndex(), m_maxLength(0), m_scoreThreshold(nullptr) {}
+
+MaximumDetectionList::MaximumDetectionList(unsigned int maxDetections)
+: m_detections(), m_maxDetections(maxDetections), m_overlap_th(0.0), m_startIndex(), m_maxLength(0), m_scoreThreshold(nullptr) {}
+
+MaximumDetectionList::MaximumDetectionList(Scalar overlap_th)
+: m_detections(), m_maxDetections(0), m_overlap_th(overlap_th), m_startIndex(), m_maxLength(0), m_scoreThreshold(nullptr) {}
+
+MaximumDetectionList::MaximumDetectionList(unsigned int maxDetections, Scalar overlap_th)
+: m_detections(), m_maxDetections(maxDetections), m_overlap_th(overlap_th), m_startIndex(), m_maxLength(0), m_scoreThreshold(nullptr) {}
+
+MaximumDetectionList::MaximumDetectionList(const MaximumDetectionList & other)
+: m_detections(other.m_detections), m_maxDetections(other.m_maxDetections), m_overlap_th(other.m_overlap_th),
+  m_startIndex(), m_maxLength(other.m_maxLength), m_scoreThreshold(other.m_scoreThreshold), m_suppressed(other.m_suppressed)
+{
+    this->buildIndex();
+}
+
+MaximumDetectionList::MaximumDetectionList(MaximumDetectionList && other)
+: m_detections(std::move(other.m_detections)), m_maxDetections(other.m_maxDetections), m_overlap_th(other.m_overlap_th),
+  m_startIndex(), m_maxLength(other.m_maxLength), m_scoreThreshold(std::move(other.m_scoreThreshold)),
+  m_suppressed(std::move(other.m_suppressed))
+{
+    this->buildIndex();
+    other.m_startIndex.clear();
+}
+
+MaximumDetectionList & MaximumDetectionList::operator=(const MaximumDetectionList & other)
+{
+    this->m_detections = other.m_detections;
+    this->m_maxDetections = other.m_maxDetections;
+    this->m_overlap_th = other.m_overlap_th;
+    this->m_maxLength = other.m_maxLength;
+    this->m_scoreThreshold = other.m_scoreThreshold;
+    this->m_suppressed = other.m_suppressed;
+    this->buildIndex();
+    return *this;
+}
+
+MaximumDetectionList & MaximumDetectionList::operator=(MaximumDetectionList && other)
+{
+    this->m_detections = std::move(other.m_detections);
+    this->m_maxDetections = other.m_maxDetections;
+    this->m_overlap_th = other.m_overlap_th;
+    this->m_maxLength = other.m_maxLength;
+    this->m_scoreThreshold = std::move(other.m_scoreThreshold);
+    this->m_suppressed = std::move(other.m_suppressed);
+    this->buildIndex();
+    other.m_startIndex.clear();
+    return *this;
+}
+
+bool MaximumDetectionList::insert(const Detection & detection)
+{
+    return this->insert(Detection(detection));
+}
+
+bool MaximumDetectionList::insert(Detection && detection)
+{
+    // Scores which are not finite (e.g., of ranges without any outer sample) can not be ordered
+    if (!std::isfinite(detection.score))
+        return false;
+    
+    // Reject detections which can not be among the final ones anymore
+    if (this->m_scoreThreshold && detection.score < this->m_scoreThreshold->load(std::memory_order_relaxed))
+        return false;
+    if (this->m_maxDetections > 0 && this->m_detections.size() >= this->m_maxDetections)
+    {
+        // A full list only accepts detections which would not be placed at the end of the list,
+        // i.e., detections whose score is not less than that of the last one.
+        // If only the maximum is of interest, the detection must have a strictly greater score, though.
+        const Detection & last = *(this->m_detections.rbegin());
+        if ((this->m_maxDetections == 1) ? !(detection < last) : (last < detection))
+            return false;
+    }
+    
+    if (this->m_maxDetections == 1)
+    {
+        // Shortcut if only the maximum is of interest
+        this->m_detections.clear();
+        this->m_startIndex.clear();
+    }
+    else if (this->m_overlap_th < 1.0)
+    {
+        // Compare the new detection with all detections which may intersect it. Those must start before the end
+        // of the new detection and not before the start of the new detection minus the maximum length.
+        std::vector<start_index_type::iterator> suppressed;
+        start_index_type::iterator it = this->m_startIndex.lower_bound(
+            (detection.a.t >= this->m_maxLength) ? detection.a.t - this->m_maxLength + 1 : 0
+        );
+        start_index_type::iterator itEnd = this->m_startIndex.lower_bound(detection.b.t);
+        for (; it != itEnd; ++it)
+            if (it->second->IoU(detection) > this->m_overlap_th)
+            {
+                if (*(it->second) < detection)
+                    return false;
+                suppressed.push_back(it);
+            }
+        
+        // Remove overlapping detections with a lower score
+        for (start_index_type::iterator & sup : suppressed)
         {
-            this->m_detections.push_back(std::move(detection));
-            return true;
+            this->m_detections.erase(sup->second);
+            this->m_startIndex.erase(sup);
         }
-        else
-            return false;
     }
+    
+    // Insert the new detection in front of all detections with the same score
+    this->m_maxLength = std::max(this->m_maxLength, detection.b.t - detection.a.t);
+    const_iterator pos = this->m_detections.insert(this->m_detections.lower_bound(detection), std::move(detection));
+    this->m_startIndex.insert(std::make_pair(pos->a.t, pos));
+    if (this->m_maxDetections > 0 && this->m_detections.size() > this->m_maxDetections)
+        this->erase(std::prev(this->m_detections.end()));
+    
+    // Raise shared threshold
+    if (this->m_scoreThreshold && (this->m_maxDetections == 1 || this->m_overlap_th >= 1.0)
+            && this->m_maxDetections > 0 && this->m_detections.size() >= this->m_maxDetections)
+    {
+        Scalar minScore = this->m_detections.rbegin()->score;
+        Scalar threshold = this->m_scoreThreshold->load(std::memory_order_relaxed);
+        while (threshold < minScore && !this->m_scoreThreshold->compare_exchange_weak(threshold, minScore, std::memory_order_relaxed));
+    }
+    
+    return true;
 }
 
 MaximumDetectionList::const_iterator MaximumDetectionList::erase(const_iterator pos)
 {
-#if defined(__GNUC__) && (__GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ <= 8))
-    // gcc <= 4.8 does not support erasure of const_iterator
-    iterator it = this->m_detections.begin();
-    std::advance(it, std::distance(this->m_detections.cbegin(), pos));
-    return this->m_detections.erase(it);
-#else
+    std::pair<start_index_type::iterator, start_index_type::iterator> range = this->m_startIndex.equal_range(pos->a.t);
+    for (start_index_type::iterator it = range.first; it != range.second; ++it)
+        if (it->second == pos)
+        {
+            this->m_startIndex.erase(it);
+            break;
+        }
     return this->m_detections.erase(pos);
-#endif
 }
 
 void MaximumDetectionList::merge(MaximumDetectionList & other)
 {
-    this->m_detections.merge(other.m_detections);
+    this->m_detections.insert(other.m_detections.begin(), other.m_detections.end());
+    this->m_detections.insert(other.m_suppressed.begin(), other.m_suppressed.end());
+    this->m_maxLength = std::max(this->m_maxLength, other.m_maxLength);
+    other.m_detections.clear();
+    other.m_startIndex.clear();
+    other.m_suppressed.clear();
     this->nonMaximumSuppression();
 }
 
 void MaximumDetectionList::merge(MaximumDetectionList && other)
 {
-    this->m_detections.merge(std::move(other.m_detections));
-    this->nonMaximumSuppression();
+    this->merge(other);
 }
 
 void MaximumDetectionList::merge(std::vector<MaximumDetectionList>::iterator first, std::vector<MaximumDetectionList>::iterator last)
 {
     for (; first != last; ++first)
-        this->m_detections.merge(first->m_detections);
+    {
+        this->m_detections.insert(first->m_detections.begin(), first->m_detections.end());
+        this->m_detections.insert(first->m_suppressed.begin(), first->m_suppressed.end());
+        this->m_maxLength = std::max(this->m_maxLength, first->m_maxLength);
+        first->m_detections.clear();
+        first->m_startIndex.clear();
+        first->m_suppressed.clear();
+    }
+    this->nonMaximumSuppression();
+}
+
+void MaximumDetectionList::mergeCandidates(const DetectionList & candidates)
+{
+    for (const Detection & detection : candidates)
+        if (std::isfinite(detection.score))
+        {
+            this->m_detections.insert(detection);
+            this->m_maxLength = std::max(this->m_maxLength, detection.b.t - detection.a.t);
+        }
     this->nonMaximumSuppression();
 }
 
@@ -388,27 +1789,59 @@ MaximumDetectionList::const_iterator MaximumDetectionList::end() const
 
 void MaximumDetectionList::nonMaximumSuppression()
 {
+    // Detections suppressed by previous merges compete with the others again
+    this->m_detections.insert(this->m_suppressed.begin(), this->m_suppressed.end());
+    this->m_suppressed.clear();
+    
     if (this->m_maxDetections != 1 && this->m_overlap_th < 1.0)
-        for (iterator major = this->m_detections.begin(); major != this->m_detections.end(); ++major)
+    {
+        // Greedy non-maximum suppression, comparing each detection only with the preceding detections
+        // which may intersect it
+        start_index_type selected;
+        iterator det = this->m_detections.begin();
+        while (det != this->m_detections.end() && (this->m_maxDetections == 0 || selected.size() < this->m_maxDetections))
         {
-            iterator minor = major;
-            std::advance(minor, 1);
-            while (minor != this->m_detections.end())
+            bool isSuppressed = false;
+            start_index_type::const_iterator it = selected.lower_bound(
+                (det->a.t >= this->m_maxLength) ? det->a.t - this->m_maxLength + 1 : 0
+            );
+            start_index_type::const_iterator itEnd = selected.lower_bound(det->b.t);
+            for (; it != itEnd && !isSuppressed; ++it)
+                isSuppressed = (it->second->IoU(*det) > this->m_overlap_th);
+            if (isSuppressed)
             {
-                if (major->IoU(*minor) > this->m_overlap_th)
-                    minor = this->m_detections.erase(minor);
-                else
-                    ++minor;
+                this->m_suppressed.insert(this->m_suppressed.end(), *det);
+                det = this->m_detections.erase(det);
+            }
+            else
+            {
+                selected.insert(std::make_pair(det->a.t, det));
+                ++det;
             }
         }
-    if (this->m_maxDetections > 0 && this->m_detections.size() > this->m_maxDetections)
+        this->m_suppressed.insert(det, this->m_detections.end());
+        this->m_detections.erase(det, this->m_detections.end());
+        this->m_startIndex.swap(selected);
+    }
+    else
     {
-        iterator eraseStart = this->m_detections.begin();
-        std::advance(eraseStart, this->m_maxDetections);
-        this->m_detections.erase(eraseStart, this->m_detections.end());
+        if (this->m_maxDetections > 0 && this->m_detections.size() > this->m_maxDetections)
+        {
+            iterator cutOff = std::next(this->m_detections.begin(), this->m_maxDetections);
+            this->m_suppressed.insert(cutOff, this->m_detections.end());
+            this->m_detections.erase(cutOff, this->m_detections.end());
+        }
+        this->buildIndex();
     }
 }
 
+void MaximumDetectionList::buildIndex()
+{
+    this->m_startIndex.clear();
+    for (const_iterator det = this->m_detections.begin(); det != this->m_detections.end(); ++det)
+        this->m_startIndex.insert(std::make_pair(det->a.t, det));
+}
+
 
 void MaxDiv::nonMaximumSuppression(DetectionList & detections, unsigned int numDetections, double overlap_th)
 {
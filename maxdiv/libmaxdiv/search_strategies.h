@@ -20,7 +20,12 @@
 
 #include <memory>
 #include <vector>
-#include <list>
+#include <set>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
 #include "DataTensor.h"
 #include "proposals.h"
 #include "divergences.h"
@@ -59,10 +64,19 @@ typedef std::vector<Detection> DetectionList;
 * @brief A sorted list of detections which applies non-maximum suppression on insertion.
 *
 * The detections in this list are sorted in descending order by their score. Whenever a new
-* detection is to be inserted, its size will be compared to all detections before and after
-* the position of the new one: If there is an overlapping detection with a higher score, the
-* new one won't be inserted at all. Otherwise, all overlapping detections with a lower score
-* will be removed from the list.
+* detection is to be inserted, it will be compared to all overlapping detections in the list:
+* If there is an overlapping detection with a higher score, the new one won't be inserted at all.
+* Otherwise, all overlapping detections with a lower score will be removed from the list.
+*
+* The detections are indexed by their start along the time axis, so that only those detections
+* which may intersect a new one have to be compared to it and large lists can be maintained
+* efficiently.
+*
+* Several lists can share a score threshold, which detections must exceed to be inserted (see
+* `shareScoreThreshold()`).
+*
+* Several lists can be merged by `merge()`, which retains the detections suppressed by the merge (see
+* `getSuppressed()`), so that merging lists is associative.
 *
 * @author Bjoern Barz <bjoern.barz@uni-jena.de>
 */
@@ -70,9 +84,11 @@ class MaximumDetectionList
 {
 public:
 
-    typedef std::list<Detection> container_type;
+    typedef std::multiset<Detection> container_type;
     typedef container_type::iterator iterator;
     typedef container_type::const_iterator const_iterator;
+    
+    typedef std::atomic<Scalar> ScoreThreshold; /**< Score threshold which can be shared among several lists. */
 
     /**
     * Constructs a new MaximumDetectionList which has no limit on the number of detections in the list
@@ -135,6 +151,8 @@ public:
     * The detection won't be added if there already is an overlapping detection with a higher score
     * or if the maximum number of detections has been reached. On the other hand, if the detection
     * is added to the list, all overlapping detections with a lower score will be removed from the list.
+    * Detections whose score is not finite are never added. Detections suppressed by a previous `merge()`
+    * are not considered.
     *
     * @param[in] detection The detection to be added.
     *
@@ -148,6 +166,8 @@ public:
     * The detection won't be added if there already is an overlapping detection with a higher score
     * or if the maximum number of detections has been reached. On the other hand, if the detection
     * is added to the list, all overlapping detections with a lower score will be removed from the list.
+    * Detections whose score is not finite are never added. Detections suppressed by a previous `merge()`
+    * are not considered.
     *
     * @param[in] detection The detection to be added.
     *
@@ -164,10 +184,30 @@ public:
     */
     virtual const_iterator erase(const_iterator pos);
     
+    /**
+    * Shares a lower bound on the scores of the detections which can still be among the final detections
+    * with other lists.
+    *
+    * Detections with a score less than the shared threshold will be rejected by `insert()` right away.
+    * Whenever this list is full, the threshold will be raised to the score of its last detection. This
+    * is only done if the list is limited to a single detection or non-maximum suppression is disabled
+    * (i.e., the overlap threshold is at least 1), because otherwise detections can be suppressed by
+    * detections from other lists after merging, so that the last detection of this list is not a valid
+    * lower bound for the scores of the final detections.
+    *
+    * The threshold is read and updated without locking, so that it can be shared by lists which are
+    * filled concurrently by several threads.
+    *
+    * @param[in] threshold Pointer to the shared threshold, which should be initialized with
+    * `-std::numeric_limits<Scalar>::infinity()`. May be `nullptr` to stop sharing.
+    */
+    void shareScoreThreshold(const std::shared_ptr<ScoreThreshold> & threshold) { this->m_scoreThreshold = threshold; };
+    
     /**
     * Merges another sorted detection list into this one.
     *
-    * The resulting list will be sorted and non-maximum suppression will be applied afterwards.
+    * The resulting list will be sorted and non-maximum suppression will be applied afterwards to the
+    * detections of both lists and those suppressed by previous merges. See `merge(first, last)` for details.
     *
     * @param[in] other The list to be merged into this one. Will be left empty.
     */
@@ -176,7 +216,8 @@ public:
     /**
     * Merges another sorted detection list into this one.
     *
-    * The resulting list will be sorted and non-maximum suppression will be applied afterwards.
+    * The resulting list will be sorted and non-maximum suppression will be applied afterwards to the
+    * detections of both lists and those suppressed by previous merges. See `merge(first, last)` for details.
     *
     * @param[in] other The list to be merged into this one. Will be left empty.
     */
@@ -185,7 +226,13 @@ public:
     /**
     * Merges some other sorted detection lists into this one.
     *
-    * The resulting list will be sorted and non-maximum suppression will be applied afterwards.
+    * The resulting list will be sorted and greedy non-maximum suppression will be applied afterwards to the
+    * detections of all lists and those suppressed by previous merges of any of them. Detections suppressed or
+    * cut off by the maximum number of detections are retained (see `getSuppressed()`), since they may become
+    * detections again when the result is merged with further lists whose detections suppress the ones that
+    * suppressed them. Thus, merging is associative: merging several lists at once yields the same detections as
+    * merging them one after another or by any tree of merges, as long as no detections are inserted into the
+    * intermediate results. Apart from ties of the scores, the result does not depend on the order of the lists.
     *
     * Every merged list will be left empty.
     *
@@ -195,6 +242,22 @@ public:
     */
     virtual void merge(std::vector<MaximumDetectionList>::iterator first, std::vector<MaximumDetectionList>::iterator last);
     
+    /**
+    * Merges detections which may overlap each other into this list like the detections of another list and those
+    * suppressed by its previous merges. This allows merging the detections of a list and its suppressed detections
+    * after they have been transferred elsewhere, e.g., to another process.
+    *
+    * @param[in] candidates The detections to be merged into this list, in any order. Detections whose score is
+    * not finite are ignored.
+    */
+    virtual void mergeCandidates(const DetectionList & candidates);
+    
+    /**
+    * @return Returns the detections suppressed or cut off by the last `merge()`, which are retained for
+    * further merges, in descending order by their score.
+    */
+    const container_type & getSuppressed() const { return this->m_suppressed; };
+    
     /**
     * @return Returns an iterator to the first detection in the list.
     */
@@ -230,11 +293,195 @@ public:
 
 protected:
 
+    typedef std::multimap<IndexVector::Index, const_iterator> start_index_type;
+
     container_type m_detections;
     unsigned int m_maxDetections;
     Scalar m_overlap_th;
+    start_index_type m_startIndex; /**< Iterators to the detections in the list, indexed by their start along the time axis. */
+    IndexVector::Index m_maxLength; /**< Upper bound on the length of the detections in the list along the time axis. */
+    std::shared_ptr<ScoreThreshold> m_scoreThreshold; /**< Shared score threshold (may be `nullptr`). */
+    container_type m_suppressed; /**< Detections suppressed by `merge()`, which may become detections again in further merges. */
     
+    /**
+    * Applies greedy non-maximum suppression to all detections in the list and moves the suppressed detections
+    * to `m_suppressed`.
+    */
     virtual void nonMaximumSuppression();
+    
+    /**
+    * Re-builds `m_startIndex` from scratch.
+    */
+    void buildIndex();
+
+};
+
+
+/**
+* @brief Profiling information collected by a SearchStrategy
+*
+* All times are wall-clock times in seconds, accumulated over all searches since the statistics have been reset.
+* Since only a few timestamps are taken per search and thread, the statistics are always collected.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+struct SearchStatistics
+{
+    unsigned long long numSearches; /**< Number of searches performed. */
+    unsigned long long numProposals; /**< Total number of proposed ranges which have been scored. */
+    double preprocessingTime; /**< Time spent on masking and pre-processing the data. */
+    double initTime; /**< Time spent on initializing the divergence and its density estimator, e.g., computing cumulative sums. */
+    double proposalTime; /**< Time spent on initializing the proposal generator, e.g., computing point-wise scores. */
+    double scoringTime; /**< Time spent on fitting distributions to proposed ranges and computing their divergence. */
+    double nmsTime; /**< Time spent on non-maximum suppression after scoring. With online non-maximum suppression, this only includes merging the detections of different threads. */
+    double totalTime; /**< Total time spent on searching, including pre-processing. */
+    unsigned long long numPreprocCacheHits; /**< Number of searches whose pre-processed data have been loaded from the pre-processing cache. */
+    unsigned long long numPartialSearches; /**< Number of searches which have been stopped by a SearchController before all proposals had been scored. */
+    std::vector<unsigned long long> threadProposals; /**< Number of proposed ranges scored by each thread. */
+    std::vector<double> threadTime; /**< Time spent on scoring by each thread. */
+    EstimatorStatistics estimator; /**< Counters collected by the density estimators of all threads. */
+    
+    SearchStatistics()
+    : numSearches(0), numProposals(0), preprocessingTime(0), initTime(0), proposalTime(0), scoringTime(0), nmsTime(0), totalTime(0),
+      numPreprocCacheHits(0), numPartialSearches(0)
+    {};
+    
+    /**
+    * Adds the statistics of @p other to this object. The counters of the threads are added element-wise.
+    */
+    SearchStatistics & operator+=(const SearchStatistics & other);
+    
+    /**
+    * Adds the scoring statistics of a single thread.
+    *
+    * @param[in] thread The number of the thread.
+    *
+    * @param[in] numProposals The number of proposed ranges scored by the thread.
+    *
+    * @param[in] time The time spent on scoring by the thread.
+    *
+    * @param[in] estimatorStats The counters of the density estimator used by the thread.
+    */
+    void addThread(std::size_t thread, unsigned long long numProposals, double time, const EstimatorStatistics & estimatorStats);
+};
+
+
+/**
+* @brief Bounds the time spent by a search, reports its progress and allows for cancelling it
+*
+* A search strategy checks the controller attached to it by `SearchStrategy::setController()` regularly while
+* scoring proposals. Once the deadline of the controller has passed or `cancel()` has been called, possibly from
+* another thread, the search stops scoring and returns the best detections among the ranges scored so far, to which
+* non-maximum suppression is applied as usual. `isPartial()` tells afterwards whether this has happened.
+*
+* While a controller is attached, `ProposalSearch` scores chunks of start points in the order of decreasing
+* point-wise scores, so that the most promising ranges are scored first, and reports the fraction of start points
+* processed to the progress callback. If the controller has a deadline, it also applies non-maximum suppression
+* online while scoring, even if the data are small enough for offline non-maximum suppression of all scores, which
+* could not be stopped at the deadline. The detections may hence differ slightly from those of a search without
+* a controller. Without a deadline, a search which is not cancelled yields the same detections as a search without
+* a controller, and a cancelled one applies offline non-maximum suppression to the scores obtained so far. Since pre-processing and
+* the initialization of the divergence can not be interrupted, a search may still exceed its deadline by the time
+* those take, in addition to the time needed for merging the few detections retained for each chunk.
+*
+* A controller is meant to be used for a single search, but may be shared by the clones of a search strategy.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class SearchController
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+    
+    /**
+    * Callback receiving the fraction of the search completed so far (between 0 and 1). It is called from the threads
+    * performing the search, but never concurrently, and should return quickly.
+    */
+    typedef std::function<void(Scalar)> ProgressCallback;
+    
+
+    /**
+    * Constructs a controller without a deadline, which only stops a search when it is cancelled.
+    */
+    SearchController();
+    
+    /**
+    * Constructs a controller with a deadline relative to the time of construction.
+    *
+    * @param[in] timeout Number of seconds after which searches will be stopped. If this is not positive,
+    * there will be no deadline.
+    */
+    SearchController(double timeout);
+    
+    /**
+    * Constructs a controller with a given deadline.
+    *
+    * @param[in] deadline Point in time at which searches will be stopped.
+    */
+    SearchController(const Clock::time_point & deadline);
+    
+    /**
+    * Changes the callback which the progress of the search will be reported to.
+    *
+    * @param[in] callback The new callback. May be empty.
+    */
+    void setProgressCallback(const ProgressCallback & callback) { this->m_progressCallback = callback; };
+    
+    /**
+    * Requests the search to stop as soon as possible. May be called from any thread.
+    */
+    void cancel() { this->m_cancelled = true; };
+    
+    /**
+    * @return Returns `true` if `cancel()` has been called.
+    */
+    bool isCancelled() const { return this->m_cancelled; };
+    
+    /**
+    * @return Returns `true` if this controller stops searches at a deadline.
+    */
+    bool hasDeadline() const { return this->m_hasDeadline; };
+    
+    /**
+    * @return Returns `true` if a search has been stopped by this controller before all proposals had been scored,
+    * i.e. if its detections are the best ones found so far instead of the final result.
+    */
+    bool isPartial() const { return this->m_stopped; };
+    
+    /**
+    * Checks whether a search should stop because it has been cancelled or its deadline has passed.
+    * If so, the search is marked as partial. May be called concurrently by several threads.
+    *
+    * @return Returns `true` if the search should stop.
+    */
+    bool shouldStop();
+    
+    /**
+    * Starts reporting progress towards a given amount of work.
+    *
+    * @param[in] total The total amount of work of the search, e.g., the number of start points.
+    */
+    void beginProgress(unsigned long long total);
+    
+    /**
+    * Adds a given amount of completed work and calls the progress callback. May be called concurrently by several threads.
+    *
+    * @param[in] amount The amount of work completed since the last call.
+    */
+    void addProgress(unsigned long long amount);
+
+
+protected:
+
+    bool m_hasDeadline; /**< Specifies whether `m_deadline` is valid. */
+    Clock::time_point m_deadline; /**< Point in time at which searches will be stopped. */
+    std::atomic<bool> m_cancelled; /**< Set by `cancel()`. */
+    std::atomic<bool> m_stopped; /**< Set by `shouldStop()` when it returns `true` for the first time. */
+    unsigned long long m_progress; /**< Amount of work completed so far. */
+    unsigned long long m_total; /**< Total amount of work given to `beginProgress()`. */
+    ProgressCallback m_progressCallback; /**< Callback receiving the progress. May be empty. */
+    std::mutex m_progressMutex; /**< Guards `m_progress` and serializes calls of the progress callback. */
 
 };
 
@@ -275,6 +522,18 @@ public:
     
     virtual ~SearchStrategy() {};
     
+    /**
+    * Creates a copy of this search strategy which can be used independently from this one, e.g., for running
+    * several searches with the same configuration concurrently in different threads.
+    *
+    * The divergence measure and all other components which are modified during the search are cloned, while
+    * the pre-processing pipeline is shared, since it is not modified by pre-processing unless profiling or
+    * storing of parameters has been enabled for it or its pre-processors.
+    *
+    * @return Returns a pointer to a copy of this object.
+    */
+    virtual std::shared_ptr<SearchStrategy> clone() const =0;
+    
     /**
     * Searches for anomalous sub-blocks in a given DataTensor.
     *
@@ -298,6 +557,28 @@ public:
     */
     virtual DetectionList operator()(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections = 0);
     
+    /**
+    * Searches for anomalous sub-blocks in a given DataTensor, using a given workspace for the copy of the data
+    * which is needed if they have to be masked or pre-processed.
+    *
+    * The workspace is resized as needed, but its memory is only re-allocated if it is too small. Thus, if the same
+    * workspace is passed to repeated searches on data of the same size, no memory will be allocated for the copy of
+    * the data after the first call. The workspace may also be a view of an external buffer with at least as many
+    * elements as @p data. Pre-processors which change the shape of the data, such as embeddings, may still allocate
+    * memory for their results.
+    *
+    * @param[in] data The spatio-temporal data. They will not be modified.
+    *
+    * @param[in,out] workspace The tensor which the data will be copied to if necessary. Its contents on return are
+    * undefined. If this is `NULL`, a temporary tensor will be allocated.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order.
+    */
+    virtual DetectionList operator()(const std::shared_ptr<const DataTensor> & data, const std::shared_ptr<DataTensor> & workspace,
+                                     unsigned int numDetections = 0);
+    
     /**
     * @return Returns a pointer to the divergence measure used by this strategy to compare a sub-block of data with the remaining data.
     */
@@ -308,6 +589,11 @@ public:
     */
     const std::shared_ptr<const PreprocessingPipeline> & getPreprocessingPipeline() const { return this->m_preproc; };
     
+    /**
+    * @return Returns a pointer to the cache for pre-processed data used by this strategy. May be `NULL`.
+    */
+    const std::shared_ptr<const PreprocessingCache> & getPreprocessingCache() const { return this->m_preprocCache; };
+    
     /**
     * @return Returns the current overlap threshold used for non-maximum suppression:
     * Intervals with an Intersection over Union (IoU) greater than this threshold will be considered overlapping.
@@ -328,6 +614,14 @@ public:
     */
     void setPreprocessingPipeline(const std::shared_ptr<const PreprocessingPipeline> & preprocessing) { this->m_preproc = preprocessing; };
     
+    /**
+    * Changes the cache used to store the results of the pre-processing pipeline, so that repeated searches on the same
+    * data can skip pre-processing. The configuration key of the cache must identify the pre-processing pipeline.
+    *
+    * @param[in] cache Pointer to the cache or `NULL` to disable caching of pre-processed data.
+    */
+    void setPreprocessingCache(const std::shared_ptr<const PreprocessingCache> & cache) { this->m_preprocCache = cache; };
+    
     /**
     * Changes the overlap threshold used for non-maximum suppression.
     *
@@ -335,13 +629,52 @@ public:
     * Must be in the range `[0,1]`.
     */
     void setOverlapTh(Scalar overlap_th) { if (overlap_th >= 0 and overlap_th <= 1) this->m_overlap_th = overlap_th; };
+    
+    /**
+    * @return Returns the profiling information collected by this strategy since its construction or the
+    * last call to `resetStatistics()`. Clones start with empty statistics.
+    */
+    const SearchStatistics & getStatistics() const { return this->m_stats; };
+    
+    /**
+    * Discards the profiling information collected so far.
+    */
+    void resetStatistics() { this->m_stats = SearchStatistics(); };
+    
+    /**
+    * @return Returns a pointer to the controller bounding the time spent by searches. May be `NULL`.
+    */
+    const std::shared_ptr<SearchController> & getController() const { return this->m_controller; };
+    
+    /**
+    * Attaches a controller which limits the time spent by subsequent searches, receives their progress and can be
+    * used to cancel them. Clones created afterwards share the controller.
+    *
+    * @param[in] controller Pointer to the controller or `NULL` to let searches run until they are complete.
+    */
+    void setController(const std::shared_ptr<SearchController> & controller) { this->m_controller = controller; };
 
 
 protected:
 
     std::shared_ptr<Divergence> m_divergence; /**< The divergence measure used to compare a sub-block of the data with the remaining data. */
     std::shared_ptr<const PreprocessingPipeline> m_preproc; /**< The pre-processing pipeline to be applied to the data before searching for anomalous sub-blocks. */
+    std::shared_ptr<const PreprocessingCache> m_preprocCache; /**< Optional cache for the results of the pre-processing pipeline. */
     Scalar m_overlap_th; /**< Overlap threshold for non-maximum suppression: Intervals with a greater IoU will be considered overlapping. */
+    SearchStatistics m_stats; /**< Profiling information returned by `getStatistics()`. */
+    std::shared_ptr<SearchController> m_controller; /**< Optional controller bounding the time spent by searches. */
+    
+    /**
+    * Adds the scoring statistics of the calling thread to `m_stats`. May be called concurrently by several
+    * threads of the same OpenMP team.
+    *
+    * @param[in] numProposals The number of proposed ranges scored by the calling thread.
+    *
+    * @param[in] time The time spent on scoring by the calling thread.
+    *
+    * @param[in] divergence The divergence used by the calling thread, whose estimator counters will be added.
+    */
+    void addThreadStatistics(unsigned long long numProposals, double time, const Divergence & divergence);
     
     /**
     * Searches for anomalous sub-blocks in a given pre-processed DataTensor.
@@ -368,6 +701,16 @@ class ProposalSearch : public SearchStrategy
 {
 public:
 
+    /**
+    * Strategies for distributing the start points of the proposed ranges among several threads.
+    */
+    enum class Scheduling
+    {
+        STATIC,     /**< Each thread processes an equally sized, contiguous slice of start points. */
+        DYNAMIC     /**< Start points are split up into chunks which are fetched by idle threads from a shared work queue. */
+    };
+    
+
     /**
     * Constructs a ProposalSearch with the default divergence measure, dense proposals and no pre-processing.
     */
@@ -407,6 +750,8 @@ public:
                    const std::shared_ptr<ProposalGenerator> & generator,
                    const std::shared_ptr<const PreprocessingPipeline> & preprocessing);
     
+    virtual std::shared_ptr<SearchStrategy> clone() const override;
+    
     /**
     * @return Returns a pointer to the proposal generator.
     */
@@ -418,11 +763,504 @@ public:
     * @param[in] generator The new proposal generator.
     */
     void setProposalGenerator(const std::shared_ptr<ProposalGenerator> & generator) { this->m_proposals = generator; };
+    
+    /**
+    * @return Returns the strategy used to distribute start points among threads.
+    */
+    Scheduling getScheduling() const { return this->m_scheduling; };
+    
+    /**
+    * @return Returns the number of start points per chunk used for dynamic scheduling.
+    * A value of 0 means that the chunk size is determined automatically.
+    */
+    DataTensor::Index getChunkSize() const { return this->m_chunkSize; };
+    
+    /**
+    * Changes the strategy used to distribute the start points of the proposed ranges among threads.
+    *
+    * Static scheduling has the least overhead, but may leave threads idle if the number of proposals
+    * per start point varies a lot (e.g., for dense proposals without a maximum length or for point-wise
+    * proposals clustered around a few peaks). Dynamic scheduling balances the load by distributing small
+    * chunks of start points on demand. The detections obtained with dynamic scheduling do not depend on
+    * the number of threads.
+    *
+    * @param[in] scheduling The new scheduling strategy.
+    *
+    * @param[in] chunkSize Number of consecutive start points processed by a thread at once when using
+    * dynamic scheduling. If set to 0, the data will be divided into `MAXDIV_DYNAMIC_SCHEDULE_CHUNKS` chunks.
+    */
+    void setScheduling(Scheduling scheduling, DataTensor::Index chunkSize = 0) { this->m_scheduling = scheduling; this->m_chunkSize = chunkSize; };
+    
+    /**
+    * @return Returns the number of partitions the start points are divided into.
+    */
+    unsigned int getNumPartitions() const { return this->m_numPartitions; };
+    
+    /**
+    * @return Returns the index of the partition of start points scored by this search.
+    */
+    unsigned int getPartition() const { return this->m_partition; };
+    
+    /**
+    * Restricts the search to a single partition of the start points of the proposed ranges, so that the work can
+    * be distributed among several processes or machines, each of which searches the entire data for the ranges
+    * starting in its own partition.
+    *
+    * The start points are split up into chunks as for dynamic scheduling, and each partition consists of an equal
+    * number of consecutive chunks. The detections of all partitions can be merged by `MaximumDetectionList::merge()`,
+    * either at once or by a tree of merges, and the order of the lists does not matter. Since non-maximum suppression
+    * has already been applied to each partition, the result may still differ from that of a single search in rare cases.
+    *
+    * @param[in] numPartitions The number of partitions. A value of 1 disables partitioning.
+    *
+    * @param[in] partition The index of the partition to be searched. Must be less than `numPartitions`.
+    */
+    void setPartition(unsigned int numPartitions, unsigned int partition);
 
 
 protected:
 
     std::shared_ptr<ProposalGenerator> m_proposals; /**< The proposal generator to be used to retrieve a list of possibly anomalous ranges. */
+    Scheduling m_scheduling; /**< Strategy used to distribute start points among threads. */
+    DataTensor::Index m_chunkSize; /**< Number of start points per chunk for dynamic scheduling (0 = automatic). */
+    unsigned int m_numPartitions; /**< Number of partitions the start points are divided into. */
+    unsigned int m_partition; /**< Index of the partition of start points scored by this search. */
+    
+    /**
+    * Searches for anomalous sub-blocks in a given pre-processed DataTensor.
+    *
+    * This function will be called by `operator()` after pre-processing to perform the actual detection.
+    *
+    * @param[in] data The pre-processed spatio-temporal data. If the data contain missing values, they must have been
+    * masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order.
+    */
+    virtual DetectionList detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections = 0) override;
+
+    /**
+    * Initializes the proposal generator with given data, scores all proposed ranges and applies non-maximum
+    * suppression to them. The divergence must have been initialized with the same data before.
+    *
+    * @param[in] data The pre-processed spatio-temporal data.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order.
+    */
+    DetectionList searchProposals(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections);
+
+};
+
+
+/**
+* @brief Searches for anomalous intervals in a stream of data using a sliding window
+*
+* New time steps are appended to the stream using `push()`. Only the latest time steps which fit into a window
+* of a given length are retained, older ones are discarded. Calling `poll()` moves the divergence forward to
+* the current window using `Divergence::update()`, which avoids a complete re-initialization if supported by
+* the divergence and density estimator in use, and scores only those proposals which end after the first time
+* step that has been appended since the last poll.
+*
+* Thus, the cost of scoring the proposals of a poll scales with the number of new time steps instead of the length
+* of the window. Since the scores of all ranges depend on the remaining data in the window, a few candidates from
+* previous polls are retained and re-scored on each poll along with the new ranges: the detections and, in
+* `MAXDIV_STREAM_CANDIDATE_LAYERS - 1` further layers, the ranges non-maximum suppression would keep among those
+* suppressed by the previous layers. Candidates which are not entirely contained in the window anymore are discarded.
+* Ranges which have been suppressed by a detection that has expired or got a lower score in the meantime can hence
+* be recovered if they are among the candidates. The detections may still differ from those obtained by searching
+* the current window with a ProposalSearch, since ranges which have not been a candidate at the time their end was
+* appended are never scored again. Further limitations apply:
+*
+* - Only KLDivergence with a GaussianDensityEstimator or an EnsembleOfRandomProjectionHistograms is updated
+*   incrementally. All other divergences and density estimators are re-initialized from scratch on every poll
+*   (see `Divergence::update()`).
+* - If the proposal generator has no maximum length, every start point may have ranges ending among the new
+*   time steps. All O(L^2) proposals of a window of length L are then still enumerated on every poll, although
+*   only those ending among the new time steps are scored.
+* - If the overlap threshold is 1, no ranges are suppressed and all ranges scored so far remain candidates.
+*
+* Pre-processing is not applied to the stream. `operator()` can still be used for searching entire data sets
+* at once and behaves exactly as with a ProposalSearch in that case, but invalidates the state of the stream,
+* so that the window will be processed from scratch on the next poll.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class StreamingSearch : public ProposalSearch
+{
+public:
+
+    /**
+    * Constructs a StreamingSearch with the default divergence measure and dense proposals.
+    *
+    * @param[in] windowLength The maximum number of time steps in the sliding window. Must be greater than 0.
+    */
+    StreamingSearch(DataTensor::Index windowLength);
+    
+    /**
+    * Constructs a StreamingSearch with a given divergence measure and dense proposals.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] windowLength The maximum number of time steps in the sliding window. Must be greater than 0.
+    */
+    StreamingSearch(const std::shared_ptr<Divergence> & divergence, DataTensor::Index windowLength);
+    
+    /**
+    * Constructs a StreamingSearch with a given divergence measure and proposal generator.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] generator The proposal generator to be used to retrieve a list of possibly anomalous ranges.
+    * Must not be `NULL`.
+    *
+    * @param[in] windowLength The maximum number of time steps in the sliding window. Must be greater than 0.
+    */
+    StreamingSearch(const std::shared_ptr<Divergence> & divergence, const std::shared_ptr<ProposalGenerator> & generator,
+                    DataTensor::Index windowLength);
+    
+    /**
+    * Creates a StreamingSearch with the same configuration as this one, but with an empty stream.
+    *
+    * @return Returns a pointer to the new object.
+    */
+    virtual std::shared_ptr<SearchStrategy> clone() const override;
+    
+    /**
+    * Appends new time steps to the stream. If the window would be longer than its maximum length afterwards,
+    * the oldest time steps will be discarded.
+    *
+    * @param[in] samples The new time steps. All dimensions except the temporal one must have the same size as
+    * the samples pushed before. Missing samples have to be marked as such using `DataTensor::mask()` or encoded
+    * as `NaN`.
+    *
+    * @return Returns `false` if the shape of @p samples does not match the shape of the stream, otherwise `true`.
+    */
+    bool push(const DataTensor & samples);
+    
+    /**
+    * Searches for anomalous intervals in the current window, taking only those intervals into account which
+    * end in one of the time steps appended since the last call to this function or have been retained as
+    * candidates by previous calls. If no time steps have been appended since the last call to this function,
+    * the detections of that call are returned again.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order. The time
+    * indices of the ranges are relative to the first time step ever pushed to the stream.
+    */
+    DetectionList poll(unsigned int numDetections = 0);
+    
+    /**
+    * Discards all time steps and detections in the stream.
+    */
+    void resetStream();
+    
+    /**
+    * @return Returns the maximum number of time steps in the sliding window.
+    */
+    DataTensor::Index getWindowLength() const { return this->m_windowLength; };
+    
+    /**
+    * @return Returns the number of time steps which are currently in the window.
+    */
+    DataTensor::Index getCurrentLength() const { return this->m_bufferLength; };
+    
+    /**
+    * @return Returns the index of the first time step in the current window, relative to the first time step
+    * ever pushed to the stream.
+    */
+    DataTensor::Index getStreamOffset() const { return this->m_streamOffset; };
+
+
+protected:
+
+    DataTensor::Index m_windowLength; /**< Maximum number of time steps in the window. */
+    std::shared_ptr<DataTensor> m_buffer; /**< Buffer with space for twice the window length holding the current window, compacted when its end is reached. */
+    DataTensor::Index m_bufferOffset; /**< Index of the first time step of the current window in `m_buffer`. */
+    DataTensor::Index m_bufferLength; /**< Number of time steps in the current window. */
+    DataTensor::Index m_streamOffset; /**< Index of the first time step of the current window in the entire stream. */
+    DataTensor::Index m_numNew; /**< Number of time steps pushed since the last poll. */
+    DataTensor::Index m_numExpired; /**< Number of time steps discarded since the last poll. */
+    std::shared_ptr<DataTensor> m_window; /**< View of the window processed by the last poll. */
+    bool m_windowValid; /**< Specifies whether the divergence and the proposal generator have been initialized with `m_window`. */
+    DetectionList m_detections; /**< Detections of the last poll, with time indices relative to the entire stream. */
+    DetectionList m_candidates; /**< Candidates retained from previous polls, including the detections, with time indices relative to the entire stream. */
+    
+    /**
+    * Searches for anomalous sub-blocks in a given pre-processed DataTensor just like ProposalSearch does
+    * and invalidates the state of the stream afterwards.
+    *
+    * @param[in] data The pre-processed spatio-temporal data. If the data contain missing values, they must have been
+    * masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order.
+    */
+    virtual DetectionList detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections = 0) override;
+
+};
+
+
+/**
+* @brief Exact search over all ranges proposed by a DenseProposalGenerator which skips groups of ranges by means of upper bounds on their scores
+*
+* The ranges are organized in groups given by an interval of start points and an interval of end points along each dimension.
+* All ranges in such a group contain the block from the last start point to the first end point and are contained in the block
+* from the first start point to the last end point, which is used for bounding their scores with `Divergence::upperBound()`.
+* Starting with a single group comprising all ranges, the group with the highest bound is taken from a priority queue and split
+* up along its widest interval of start or end points, until a group contains at most `MAXDIV_BNB_LEAF_SIZE` ranges, which are
+* then scored explicitly and put back into the queue with their score. A scored range at the top of the queue has a score at
+* least as high as the bound of all ranges which have not been scored yet, so that ranges are obtained in the order of decreasing
+* scores and can be subjected to non-maximum suppression right away.
+*
+* Thus, the detections are the same as those obtained from a ProposalSearch with a DenseProposalGenerator using the same length
+* range and offline non-maximum suppression. The search stops as soon as the requested number of detections has been found,
+* so that groups whose bound is below the score of the last detection are never split up. Groups which would be suppressed entirely
+* by one of the detections found so far are discarded early.
+*
+* This is efficient if only a few detections are requested and the divergence provides tight bounds, which is currently the case
+* for the KL divergence with a GaussianDensityEstimator using the covariance mode `ID` or `SHARED`. Otherwise, all ranges will be
+* scored eventually. The search is performed by a single thread.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class BranchAndBoundSearch : public SearchStrategy
+{
+public:
+
+    /**
+    * Constructs a BranchAndBoundSearch with the default divergence measure, no restrictions on the length of the ranges
+    * and no pre-processing.
+    */
+    BranchAndBoundSearch();
+    
+    /**
+    * Constructs a BranchAndBoundSearch with a given divergence measure, no restrictions on the length of the ranges
+    * and no pre-processing.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    */
+    BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence);
+    
+    /**
+    * Constructs a BranchAndBoundSearch with a given divergence measure and length range, but without pre-processing.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length, just like for a DenseProposalGenerator. The attribute dimension will be ignored.
+    */
+    BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange);
+    
+    /**
+    * Constructs a BranchAndBoundSearch with a given divergence measure, length range and pre-processing pipeline.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length, just like for a DenseProposalGenerator. The attribute dimension will be ignored.
+    *
+    * @param[in] preprocessing The pre-processing pipeline to be applied to the data before searching for anomalous sub-blocks.
+    */
+    BranchAndBoundSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                         const std::shared_ptr<const PreprocessingPipeline> & preprocessing);
+    
+    virtual std::shared_ptr<SearchStrategy> clone() const override;
+    
+    /**
+    * @return Returns a range whose start specifies the minimum length of the ranges searched for each dimension and
+    * whose end specifies the maximum length.
+    */
+    const IndexRange & getLengthRange() const { return this->m_lengthRange; };
+    
+    /**
+    * @return Returns the maximum number of ranges in a group which will be scored explicitly instead of splitting it up.
+    */
+    DataTensor::Index getLeafSize() const { return this->m_leafSize; };
+    
+    /**
+    * Changes the minimum and maximum length of the ranges searched.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length. The attribute dimension will be ignored.
+    */
+    void setLengthRange(const IndexRange & lengthRange) { this->m_lengthRange = lengthRange; };
+    
+    /**
+    * Changes the maximum number of ranges in a group which will be scored explicitly instead of splitting it up.
+    *
+    * @param[in] leafSize The new leaf size. Must be greater than 0.
+    */
+    void setLeafSize(DataTensor::Index leafSize) { if (leafSize > 0) this->m_leafSize = leafSize; };
+
+
+protected:
+
+    IndexRange m_lengthRange; /**< Minimum (start) and maximum (end) length of the ranges along each dimension. */
+    DataTensor::Index m_leafSize; /**< Maximum number of ranges in a group which is scored explicitly. */
+    
+    /**
+    * Searches for anomalous sub-blocks in a given pre-processed DataTensor.
+    *
+    * This function will be called by `operator()` after pre-processing to perform the actual detection.
+    *
+    * @param[in] data The pre-processed spatio-temporal data. If the data contain missing values, they must have been
+    * masked by calling `DataTensor::mask()`.
+    *
+    * @param[in] numDetections Maximum number of detections to return. Set this to `0` to retrieve all detections.
+    *
+    * @return Returns a list of detected ranges, sorted by detection score in decreasing order.
+    */
+    virtual DetectionList detect(const std::shared_ptr<const DataTensor> & data, unsigned int numDetections = 0) override;
+
+};
+
+
+/**
+* @brief Coarse-to-fine search for anomalous intervals on a temporal pyramid of the data
+*
+* The data are pooled along the time axis repeatedly by averaging the valid samples in non-overlapping blocks of
+* `factor` time steps, which yields a pyramid of `levels` levels, the coarsest one having a temporal resolution
+* of `factor^(levels-1)` time steps. A ProposalSearch with dense proposals, whose length range has been scaled
+* down accordingly, is performed on the coarsest level to retrieve `MAXDIV_MULTIRES_CANDIDATE_FACTOR` times as
+* many candidates as detections have been requested. Going down the pyramid, the start and end point of each
+* candidate are refined at the next finer level by scoring all ranges whose start and end point are within a
+* single coarse block of the previous ones. This window is moved as long as the best range lies at its border.
+* The spatial extent of the candidates is not altered by refinement.
+*
+* The number of ranges scored hence scales with the square of the length of the data divided by the coarsest
+* resolution instead of the square of the length of the data, which makes the search feasible for very long
+* time series. As a trade-off, the search is not exact: Anomalies which are shorter than the coarsest resolution
+* or which only stand out at a fine resolution may be missed. The minimum length divided by the coarsest resolution
+* should also be large enough for fitting the density estimator, e.g., greater than the number of attributes for
+* a GaussianDensityEstimator with full covariance matrices.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+class MultiResolutionSearch : public SearchStrategy
+{
+public:
+
+    /**
+    * Constructs a MultiResolutionSearch with the default divergence measure, no restrictions on the length of the ranges,
+    * a pyramid of 2 levels with a pooling factor of 24 and no pre-processing.
+    */
+    MultiResolutionSearch();
+    
+    /**
+    * Constructs a MultiResolutionSearch with a given divergence measure, no restrictions on the length of the ranges,
+    * a pyramid of 2 levels with a pooling factor of 24 and no pre-processing.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    */
+    MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence);
+    
+    /**
+    * Constructs a MultiResolutionSearch with a given divergence measure, length range and pyramid, but without pre-processing.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length at full resolution, just like for a DenseProposalGenerator. The attribute dimension
+    * will be ignored.
+    *
+    * @param[in] levels The number of levels of the pyramid, including the original data. A value of 1 is equivalent
+    * to a ProposalSearch with dense proposals. Must be greater than 0.
+    *
+    * @param[in] factor The number of time steps pooled into a single one from one level to the next coarser one.
+    * Must be greater than 1.
+    */
+    MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                          unsigned int levels, DataTensor::Index factor);
+    
+    /**
+    * Constructs a MultiResolutionSearch with a given divergence measure, length range, pyramid and pre-processing pipeline.
+    *
+    * @param[in] divergence The divergence measure used to compare a sub-block of the data with the remaining data.
+    * Must not be `NULL`.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length at full resolution, just like for a DenseProposalGenerator. The attribute dimension
+    * will be ignored.
+    *
+    * @param[in] levels The number of levels of the pyramid, including the original data. A value of 1 is equivalent
+    * to a ProposalSearch with dense proposals. Must be greater than 0.
+    *
+    * @param[in] factor The number of time steps pooled into a single one from one level to the next coarser one.
+    * Must be greater than 1.
+    *
+    * @param[in] preprocessing The pre-processing pipeline to be applied to the data before searching for anomalous sub-blocks.
+    */
+    MultiResolutionSearch(const std::shared_ptr<Divergence> & divergence, const IndexRange & lengthRange,
+                          unsigned int levels, DataTensor::Index factor,
+                          const std::shared_ptr<const PreprocessingPipeline> & preprocessing);
+    
+    virtual std::shared_ptr<SearchStrategy> clone() const override;
+    
+    /**
+    * @return Returns a range whose start specifies the minimum length of the ranges searched for each dimension and
+    * whose end specifies the maximum length.
+    */
+    const IndexRange & getLengthRange() const { return this->m_lengthRange; };
+    
+    /**
+    * @return Returns the number of levels of the pyramid, including the original data.
+    */
+    unsigned int getLevels() const { return this->m_levels; };
+    
+    /**
+    * @return Returns the number of time steps pooled into a single one from one level to the next coarser one.
+    */
+    DataTensor::Index getFactor() const { return this->m_factor; };
+    
+    /**
+    * Changes the minimum and maximum length of the ranges searched.
+    *
+    * @param[in] lengthRange A range whose start specifies the minimum length of the ranges for each dimension and whose
+    * end specifies the maximum length at full resolution. The attribute dimension will be ignored.
+    */
+    void setLengthRange(const IndexRange & lengthRange) { this->m_lengthRange = lengthRange; };
+    
+    /**
+    * Changes the pyramid used for the search.
+    *
+    * @param[in] levels The number of levels of the pyramid, including the original data. Must be greater than 0.
+    *
+    * @param[in] factor The number of time steps pooled into a single one from one level to the next coarser one.
+    * Must be greater than 1.
+    */
+    void setPyramid(unsigned int levels, DataTensor::Index factor) { if (levels > 0 && factor > 1) { this->m_levels = levels; this->m_factor = factor; } };
+    
+    /**
+    * Pools a DataTensor along the time axis by averaging the valid samples in non-overlapping blocks of time steps.
+    * Samples of the result whose block does not contain any valid sample will be missing.
+    *
+    * @param[in] data The data to be pooled.
+    *
+    * @param[in] factor The number of consecutive time steps pooled into a single one. If the length of the data is not
+    * a multiple of this number, the last block will be shorter.
+    *
+    * @return Returns a DataTensor whose length is `ceil(data.length() / factor)`.
+    */
+    static std::shared_ptr<DataTensor> temporalPooling(const DataTensor & data, DataTensor::Index factor);
+
+
+protected:
+
+    IndexRange m_lengthRange; /**< Minimum (start) and maximum (end) length of the ranges along each dimension at full resolution. */
+    unsigned int m_levels; /**< Number of levels of the pyramid, including the original data. */
+    DataTensor::Index m_factor; /**< Pooling factor from one level to the next coarser one. */
     
     /**
     * Searches for anomalous sub-blocks in a given pre-processed DataTensor.
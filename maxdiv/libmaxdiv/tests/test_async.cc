@@ -0,0 +1,134 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that `maxdiv_exec_async()` without a deadline yields the same detections as `maxdiv_exec()` and reports
+* its progress up to completion, that a search is stopped as partial by a deadline, and that a search cancelled
+* while scoring applies non-maximum suppression to the ranges scored so far.
+*/
+
+#include "test_utils.h"
+#include "libmaxdiv.h"
+#include <vector>
+
+using namespace MaxDiv;
+
+
+static void recordProgress(MaxDivScalar progress, void * user_data)
+{
+    static_cast<std::vector<MaxDivScalar>*>(user_data)->push_back(progress);
+}
+
+
+static void checkComplete(unsigned int pipeline, DataTensor & data, const unsigned int * shape)
+{
+    const unsigned int maxDetections = 5;
+    detection_t expected[maxDetections], detections[maxDetections];
+    unsigned int numExpected = maxDetections, numDetections = maxDetections;
+    maxdiv_exec(pipeline, data.raw(), shape, expected, &numExpected);
+    MAXDIV_CHECK(numExpected > 0);
+    
+    std::vector<MaxDivScalar> progress;
+    unsigned int job = maxdiv_exec_async(pipeline, data.raw(), shape, maxDetections, 0, recordProgress, &progress);
+    MAXDIV_CHECK(job != 0);
+    MAXDIV_CHECK(maxdiv_wait(job, detections, &numDetections) == MAXDIV_JOB_COMPLETE);
+    
+    // A complete search without a deadline applies the same non-maximum suppression as maxdiv_exec()
+    MAXDIV_CHECK(numDetections == numExpected);
+    for (unsigned int i = 0; i < std::min(numDetections, numExpected); ++i)
+    {
+        MAXDIV_CHECK(detections[i].range_start[0] == expected[i].range_start[0] && detections[i].range_end[0] == expected[i].range_end[0]);
+        MAXDIV_CHECK_CLOSE(detections[i].score, expected[i].score, 1e-8);
+    }
+    
+    MAXDIV_CHECK(!progress.empty() && progress.back() == 1);
+    for (std::size_t i = 1; i < progress.size(); ++i)
+        MAXDIV_CHECK(progress[i] >= progress[i - 1]);
+}
+
+
+static void checkDeadline(unsigned int pipeline, DataTensor & data, const unsigned int * shape)
+{
+    const unsigned int maxDetections = 5;
+    detection_t detections[maxDetections];
+    unsigned int numDetections = maxDetections;
+    
+    // The deadline has passed before the first proposal is scored
+    unsigned int job = maxdiv_exec_async(pipeline, data.raw(), shape, maxDetections, 1e-9);
+    MAXDIV_CHECK(job != 0);
+    MAXDIV_CHECK(maxdiv_wait(job, detections, &numDetections) == MAXDIV_JOB_PARTIAL);
+    MAXDIV_CHECK(numDetections <= maxDetections);
+    for (unsigned int i = 0; i < numDetections; ++i)
+        MAXDIV_CHECK(detections[i].range_start[0] < detections[i].range_end[0] && detections[i].range_end[0] <= data.length());
+    MAXDIV_CHECK(maxdiv_job_status(job) == MAXDIV_JOB_INVALID);
+}
+
+
+static void checkCancel(const std::shared_ptr<const DataTensor> & data)
+{
+    ProposalSearch detector(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()),
+        std::make_shared<DenseProposalGenerator>(10, 50)
+    );
+    detector.setScheduling(ProposalSearch::Scheduling::DYNAMIC, 10);
+    DetectionList reference = detector(data, 0);
+    unsigned long long numProposals = detector.getStatistics().numProposals;
+    MAXDIV_CHECK(!reference.empty());
+    
+    // Cancel the search once the first chunk has been scored
+    std::shared_ptr<SearchController> controller = std::make_shared<SearchController>();
+    SearchController * controllerPtr = controller.get();
+    controller->setProgressCallback([controllerPtr](Scalar progress) { if (progress > 0) controllerPtr->cancel(); });
+    detector.setController(controller);
+    detector.resetStatistics();
+    DetectionList detections = detector(data, 0);
+    MAXDIV_CHECK(controller->isPartial());
+    MAXDIV_CHECK(detector.getStatistics().numProposals > 0 && detector.getStatistics().numProposals < numProposals);
+    
+    // Non-maximum suppression has been applied to the ranges scored so far
+    MAXDIV_CHECK(!detections.empty() && detections.size() <= reference.size());
+    for (std::size_t i = 0; i < detections.size(); ++i)
+    {
+        MAXDIV_CHECK(detections[i].score <= reference.front().score);
+        for (std::size_t j = 0; j < i; ++j)
+            MAXDIV_CHECK(detections[j].score >= detections[i].score && detections[j].IoU(detections[i]) <= detector.getOverlapTh());
+    }
+}
+
+
+int main()
+{
+    std::shared_ptr<DataTensor> data = MaxDivTest::noisySeries(1000, 2, { {300, 330}, {700, 740} });
+    const unsigned int shape[MAXDIV_INDEX_DIMENSION] = { 1000, 1, 1, 1, 2 };
+    
+    maxdiv_params_t params;
+    maxdiv_init_params(&params);
+    params.min_size[0] = 10;
+    params.max_size[0] = 50;
+    unsigned int pipeline = maxdiv_compile_pipeline(&params);
+    MAXDIV_CHECK(pipeline != 0);
+    
+    checkComplete(pipeline, *data, shape);
+    checkDeadline(pipeline, *data, shape);
+    maxdiv_free_pipeline(pipeline);
+    
+    checkCancel(data);
+    
+    return MaxDivTest::result();
+}
@@ -0,0 +1,94 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that `maxdiv_exec_batch()` yields the same detections for each series as `maxdiv_exec()`, for short series
+* processed concurrently, a long series processed with all threads, series with missing values and empty series,
+* and that it does not modify constant data.
+*/
+
+#include "test_utils.h"
+#include "libmaxdiv.h"
+#include "config.h"
+#include <limits>
+
+using namespace MaxDiv;
+
+
+int main()
+{
+    const unsigned int maxDetections = 5;
+    std::vector<std::shared_ptr<DataTensor>> series = {
+        MaxDivTest::noisySeries(200, 2, { {50, 70} }, 2.5, 1),
+        MaxDivTest::noisySeries(0, 2, {}),
+        MaxDivTest::noisySeries(150, 2, { {10, 30}, {100, 110} }, 2.5, 2),
+        MaxDivTest::noisySeries(MAXDIV_BATCH_INNER_PARALLEL_SIZE + 100, 2, { {5000, 5015} }, 2.5, 3),
+        MaxDivTest::noisySeries(300, 2, { {200, 220} }, 2.5, 4)
+    };
+    series[4]->sample(7)(1) = std::numeric_limits<Scalar>::quiet_NaN();
+    series[4]->sample(150)(0) = std::numeric_limits<Scalar>::quiet_NaN();
+    
+    std::vector<MaxDivScalar*> data;
+    std::vector<unsigned int> shapes;
+    std::vector<DataTensor> originals;
+    for (const std::shared_ptr<DataTensor> & s : series)
+    {
+        data.push_back(s->raw());
+        for (unsigned int d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+            shapes.push_back(s->shape().ind[d]);
+        originals.push_back(*s);
+    }
+    
+    maxdiv_params_t params;
+    maxdiv_init_params(&params);
+    params.min_size[0] = 10;
+    params.max_size[0] = 20;
+    unsigned int pipeline = maxdiv_compile_pipeline(&params);
+    MAXDIV_CHECK(pipeline != 0);
+    
+    std::vector<detection_t> batchDetections(series.size() * maxDetections);
+    std::vector<unsigned int> numDetections(series.size());
+    maxdiv_exec_batch(pipeline, series.size(), data.data(), shapes.data(), batchDetections.data(), maxDetections, numDetections.data());
+    
+    for (std::size_t i = 0; i < series.size(); ++i)
+    {
+        // Constant data are not modified, including missing values
+        MAXDIV_CHECK(series[i]->data().cwiseEqual(originals[i].data()).count()
+                     + (series[i]->data().array() != series[i]->data().array()).count() == series[i]->numEl());
+        
+        detection_t detections[maxDetections];
+        unsigned int numExpected = maxDetections;
+        maxdiv_exec(pipeline, series[i]->raw(), shapes.data() + i * MAXDIV_INDEX_DIMENSION, detections, &numExpected);
+        MAXDIV_CHECK(numDetections[i] == numExpected);
+        MAXDIV_CHECK(series[i]->numEl() > 0 || numDetections[i] == 0);
+        for (unsigned int j = 0; j < std::min(numDetections[i], numExpected); ++j)
+        {
+            const detection_t & detection = batchDetections[i * maxDetections + j];
+            MAXDIV_CHECK(detection.range_start[0] == detections[j].range_start[0] && detection.range_end[0] == detections[j].range_end[0]);
+            MAXDIV_CHECK_CLOSE(detection.score, detections[j].score, 1e-8);
+        }
+    }
+    
+    // The anomaly in the long series has been found
+    MAXDIV_CHECK(numDetections[3] > 0 && batchDetections[3 * maxDetections].range_start[0] >= 4995
+                 && batchDetections[3 * maxDetections].range_end[0] <= 5020);
+    
+    maxdiv_free_pipeline(pipeline);
+    return MaxDivTest::result();
+}
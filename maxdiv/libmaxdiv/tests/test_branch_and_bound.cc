@@ -0,0 +1,90 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that branch and bound search finds the same detections as an exhaustive search over all ranges,
+* including the default length constraints, which would admit ranges without any sample left outside.
+*/
+
+#include "test_utils.h"
+
+using namespace MaxDiv;
+
+
+static std::shared_ptr<Divergence> makeDivergence(KLDivergence::KLMode mode)
+{
+    return std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), mode);
+}
+
+
+/**
+* Compares branch and bound search with a length range of [@p minLength, @p maxLength] against a dense proposal
+* search with the given maximum length for the exhaustive reference.
+*
+* @param[in] numDetections Number of detections to retrieve (0 = all ranges, which requires `overlapTh = 1`).
+*/
+static void compare(const char * name, const std::shared_ptr<const DataTensor> & data, KLDivergence::KLMode mode,
+                    DataTensor::Index minLength, DataTensor::Index maxLength, DataTensor::Index referenceMaxLength,
+                    Scalar overlapTh, unsigned int numDetections)
+{
+    ProposalSearch exhaustive(makeDivergence(mode), std::make_shared<DenseProposalGenerator>(minLength, referenceMaxLength));
+    exhaustive.setOverlapTh(overlapTh);
+    DetectionList reference = exhaustive(data, numDetections);
+    
+    BranchAndBoundSearch bnb(makeDivergence(mode), IndexRange(
+        IndexVector(minLength, minLength, minLength, minLength, 0),
+        IndexVector(maxLength, maxLength, maxLength, maxLength, 0)
+    ));
+    bnb.setOverlapTh(overlapTh);
+    DetectionList detections = bnb(data, numDetections);
+    
+    bool allFinite = true, ordered = true;
+    for (std::size_t i = 0; i < detections.size(); ++i)
+    {
+        allFinite = allFinite && std::isfinite(detections[i].score);
+        ordered = ordered && (i == 0 || !(detections[i - 1].score < detections[i].score));
+    }
+    MAXDIV_CHECK(allFinite);
+    MAXDIV_CHECK(ordered);
+    MAXDIV_CHECK(!reference.empty() && (numDetections == 0 || reference.size() == numDetections));
+    if (!MaxDivTest::sameDetections(reference, detections, 1e-6))
+    {
+        std::cerr << name << ": branch and bound search differs from exhaustive search" << std::endl;
+        MaxDivTest::printDetections("exhaustive", reference);
+        MaxDivTest::printDetections("branch and bound", detections);
+        ++MaxDivTest::numFailures;
+    }
+}
+
+
+int main()
+{
+    // Bounded lengths
+    std::shared_ptr<const DataTensor> data = MaxDivTest::noisySeries(1000, 2, { {300, 360}, {700, 730} });
+    compare("bounded", data, KLDivergence::KLMode::I_OMEGA, 20, 100, 100, 0.2, 3);
+    
+    // Unbounded lengths: the range covering the entire series has no outer samples and must not be scored,
+    // since its undefined score would break the order of the priority queue. Retrieving all ranges without
+    // non-maximum suppression makes sure that every single score is compared.
+    std::shared_ptr<const DataTensor> univariate = MaxDivTest::noisySeries(60, 1, {});
+    compare("unbounded", univariate, KLDivergence::KLMode::UNBIASED, 2, 0, 59, 1.0, 0);
+    compare("unbounded top", MaxDivTest::noisySeries(1000, 1, { {300, 360} }), KLDivergence::KLMode::UNBIASED, 0, 0, 999, 0.2, 3);
+    
+    return MaxDivTest::result();
+}
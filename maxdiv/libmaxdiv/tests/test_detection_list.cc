@@ -0,0 +1,189 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks insertion into MaximumDetectionList and merging of several lists, and that a tree of merges yields the
+* same detections as merging all lists at once, both for MaximumDetectionList and `maxdiv_merge_detections()`.
+*/
+
+#include "test_utils.h"
+#include "libmaxdiv.h"
+#include <limits>
+
+using namespace MaxDiv;
+
+
+/**
+* Creates a detection of the time steps [@p a, @p b).
+*/
+static Detection interval(DataTensor::Index a, DataTensor::Index b, Scalar score)
+{
+    return Detection(IndexVector(a, 0, 0, 0, 0), IndexVector(b, 1, 1, 1, 1), score);
+}
+
+
+/**
+* @return Returns the detections in a list in the order of decreasing scores.
+*/
+static DetectionList toList(const MaximumDetectionList & list)
+{
+    return DetectionList(list.begin(), list.end());
+}
+
+
+/**
+* Creates lists of random, partially overlapping detections, to which non-maximum suppression has been applied.
+*/
+static std::vector<MaximumDetectionList> randomLists(std::size_t numLists, unsigned int maxDetections, Scalar overlap_th)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<DataTensor::Index> start(0, 200), length(5, 30);
+    std::uniform_real_distribution<Scalar> score(0, 10);
+    std::vector<MaximumDetectionList> lists(numLists, MaximumDetectionList(maxDetections, overlap_th));
+    for (MaximumDetectionList & list : lists)
+        for (int i = 0; i < 20; ++i)
+        {
+            DataTensor::Index a = start(rng);
+            list.insert(interval(a, a + length(rng), score(rng)));
+        }
+    return lists;
+}
+
+
+/**
+* Merges @p lists by a pairwise tree reduction.
+*/
+static DetectionList treeMerge(std::vector<MaximumDetectionList> lists)
+{
+    for (std::size_t step = 1; step < lists.size(); step *= 2)
+        for (std::size_t i = 0; i + step < lists.size(); i += 2 * step)
+            lists[i].merge(lists[i + step]);
+    return toList(lists[0]);
+}
+
+
+/**
+* Merges @p lists with `maxdiv_merge_detections()`, either at once or by a pairwise tree reduction whose
+* intermediate merges keep the suppressed detections.
+*/
+static std::vector<detection_t> mergeWithLibrary(unsigned int pipeline, const std::vector<MaximumDetectionList> & lists, unsigned int maxDetections, bool tree)
+{
+    std::vector<std::vector<detection_t>> buffers;
+    for (const MaximumDetectionList & list : lists)
+    {
+        buffers.emplace_back();
+        for (const Detection & detection : list)
+        {
+            detection_t det = { { static_cast<unsigned int>(detection.a.t), 0, 0, 0 }, { static_cast<unsigned int>(detection.b.t), 1, 1, 1 }, detection.score };
+            buffers.back().push_back(det);
+        }
+    }
+    
+    std::size_t numRemaining = buffers.size(), step = (tree) ? 2 : buffers.size();
+    while (numRemaining > 1)
+    {
+        std::vector<std::vector<detection_t>> merged;
+        for (std::size_t i = 0; i < numRemaining; i += step)
+        {
+            std::vector<const detection_t*> ptrs;
+            std::vector<unsigned int> sizes;
+            unsigned int totalSize = 0;
+            for (std::size_t j = i; j < std::min(i + step, numRemaining); ++j)
+            {
+                ptrs.push_back(buffers[j].data());
+                sizes.push_back(buffers[j].size());
+                totalSize += buffers[j].size();
+            }
+            bool final = (step >= numRemaining);
+            unsigned int bufSize = (final) ? maxDetections : totalSize;
+            merged.emplace_back(std::max(bufSize, 1u));
+            maxdiv_merge_detections(pipeline, ptrs.size(), ptrs.data(), sizes.data(), merged.back().data(), &bufSize, !final);
+            merged.back().resize(bufSize);
+        }
+        buffers.swap(merged);
+        numRemaining = buffers.size();
+    }
+    return buffers[0];
+}
+
+
+int main()
+{
+    // Scores which are not finite must be rejected instead of breaking the order of the list
+    MaximumDetectionList list(3, 0.0);
+    MAXDIV_CHECK(list.insert(interval(0, 10, 1)));
+    MAXDIV_CHECK(!list.insert(interval(5, 15, std::numeric_limits<Scalar>::quiet_NaN())));
+    MAXDIV_CHECK(!list.insert(interval(20, 30, std::numeric_limits<Scalar>::infinity())));
+    MAXDIV_CHECK(!list.insert(interval(20, 30, -std::numeric_limits<Scalar>::infinity())));
+    MAXDIV_CHECK(list.insert(interval(12, 20, 3)));
+    MAXDIV_CHECK(!list.insert(interval(8, 14, 2)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(toList(list), { interval(12, 20, 3), interval(0, 10, 1) }));
+    
+    // Merging all lists at once keeps a detection which is only suppressed by a detection suppressed itself.
+    // So does merging the result of a previous merge, which retains the detection it suppressed.
+    std::vector<MaximumDetectionList> lists(3, MaximumDetectionList(3, 0.3));
+    lists[0].insert(interval(0, 10, 3));
+    lists[1].insert(interval(5, 15, 2));
+    lists[2].insert(interval(10, 20, 1));
+    std::vector<MaximumDetectionList> nestedLists = lists;
+    lists[0].merge(lists.begin() + 1, lists.end());
+    MAXDIV_CHECK(MaxDivTest::sameDetections(toList(lists[0]), { interval(0, 10, 3), interval(10, 20, 1) }));
+    nestedLists[1].merge(nestedLists[2]);
+    MAXDIV_CHECK(MaxDivTest::sameDetections(toList(nestedLists[1]), { interval(5, 15, 2) }));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(DetectionList(nestedLists[1].getSuppressed().begin(), nestedLists[1].getSuppressed().end()), { interval(10, 20, 1) }));
+    nestedLists[0].merge(nestedLists[1]);
+    MAXDIV_CHECK(MaxDivTest::sameDetections(toList(nestedLists[0]), toList(lists[0])));
+    
+    // Detections transferred together with the suppressed ones can be merged again
+    MaximumDetectionList transferred(3, 0.3);
+    transferred.mergeCandidates({ interval(5, 15, 2), interval(10, 20, 1), interval(0, 10, 3) });
+    MAXDIV_CHECK(MaxDivTest::sameDetections(toList(transferred), toList(lists[0])));
+    
+    // A tree of merges of random lists yields the same detections as a single merge, also with a limited number of detections
+    for (unsigned int maxDetections : { 0u, 4u })
+    {
+        std::vector<MaximumDetectionList> randomLists8 = randomLists(8, maxDetections, 0.2), flat = randomLists8;
+        flat[0].merge(flat.begin() + 1, flat.end());
+        DetectionList expected = toList(flat[0]);
+        MAXDIV_CHECK(expected.size() >= 4);
+        MAXDIV_CHECK(MaxDivTest::sameDetections(treeMerge(randomLists8), expected));
+        
+        // Merging one list after another is a degenerate tree
+        for (std::size_t i = 1; i < randomLists8.size(); ++i)
+            randomLists8[0].merge(randomLists8[i]);
+        MAXDIV_CHECK(MaxDivTest::sameDetections(toList(randomLists8[0]), expected));
+    }
+    
+    // The same with maxdiv_merge_detections()
+    maxdiv_params_t params;
+    maxdiv_init_params(&params);
+    params.overlap_th = 0.2;
+    unsigned int pipeline = maxdiv_compile_pipeline(&params);
+    MAXDIV_CHECK(pipeline != 0);
+    std::vector<MaximumDetectionList> randomLists8 = randomLists(8, 4, 0.2);
+    std::vector<detection_t> expected = mergeWithLibrary(pipeline, randomLists8, 5, false),
+                             merged = mergeWithLibrary(pipeline, randomLists8, 5, true);
+    MAXDIV_CHECK(expected.size() == 5 && merged.size() == expected.size());
+    for (std::size_t i = 0; i < std::min(merged.size(), expected.size()); ++i)
+        MAXDIV_CHECK(merged[i].range_start[0] == expected[i].range_start[0] && merged[i].range_end[0] == expected[i].range_end[0]
+                     && merged[i].score == expected[i].score);
+    maxdiv_free_pipeline(pipeline);
+    
+    return MaxDivTest::result();
+}
@@ -0,0 +1,213 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks the histograms obtained from the cumulative counts of EnsembleOfRandomProjectionHistograms against
+* a direct count of the bins of the samples, both with compact counts and for data with so many locations that
+* full cumulative counts are stored for every time step. Also checks that updating the cumulative counts for a
+* sliding window yields the same bins as initializing the estimator with the window from scratch, keeping
+* automatically determined numbers of bins.
+*/
+
+#include "test_utils.h"
+
+using namespace MaxDiv;
+
+
+/**
+* Gives access to the bins of the samples and the histograms of an EnsembleOfRandomProjectionHistograms.
+*/
+class InspectableERPH : public EnsembleOfRandomProjectionHistograms
+{
+public:
+
+    InspectableERPH(DataTensor::Index numBins = 4) : EnsembleOfRandomProjectionHistograms(3, numBins) {};
+    
+    bool hasDeltas() const { return static_cast<bool>(this->m_count_deltas); };
+    
+    bool isUpdated() const { return static_cast<bool>(this->m_index_buffer); };
+    
+    bool sameBins(const InspectableERPH & other) const { return this->m_indices->data() == other.m_indices->data(); };
+    
+    bool sameBinNum(const InspectableERPH & other) const { return this->m_hist_bins == other.m_hist_bins; };
+    
+    /**
+    * Makes `init()` keep the current numbers of bins instead of determining them automatically.
+    */
+    void keepBinNum() { this->m_num_bins = 1; };
+    
+    /**
+    * Compares the histograms of the range passed to `fit()` with the bins of the samples in that range.
+    */
+    bool checkHistograms(const DataTensor & data, const IndexRange & range) const
+    {
+        IntTensor::Sample inner = IntTensor::Sample::Zero(this->m_hist_inner.size()), outer = inner;
+        const ReflessIndexVector & shape = data.shape();
+        ReflessIndexVector ind;
+        DataTensor::Index sample = 0;
+        for (ind.t = 0; ind.t < shape.t; ++ind.t)
+            for (ind.x = 0; ind.x < shape.x; ++ind.x)
+                for (ind.y = 0; ind.y < shape.y; ++ind.y)
+                    for (ind.z = 0; ind.z < shape.z; ++ind.z, ++sample)
+                        if (!data.isMissingSample(sample))
+                        {
+                            bool isInner = true;
+                            for (unsigned int d = 0; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+                                isInner = isInner && ind.ind[d] >= range.a.ind[d] && ind.ind[d] < range.b.ind[d];
+                            IntTensor::Sample & hist = (isInner) ? inner : outer;
+                            for (DataTensor::Index h = 0; h < this->m_num_hist; ++h)
+                                ++hist(this->m_hist_offsets(h) + this->m_indices->sample(sample)(h));
+                        }
+        return (inner == this->m_hist_inner && outer == this->m_hist_outer);
+    };
+    
+};
+
+
+/**
+* Creates a tensor of random data with a few missing samples.
+*/
+static std::shared_ptr<DataTensor> randomTensor(const ReflessIndexVector & shape)
+{
+    std::shared_ptr<DataTensor> data = std::make_shared<DataTensor>(shape);
+    std::mt19937 rng(0);
+    std::normal_distribution<Scalar> normal;
+    for (DataTensor::Index i = 0; i < data->numEl(); ++i)
+        data->raw()[i] = normal(rng);
+    for (DataTensor::Index s = 7; s < data->numSamples(); s += 997)
+        data->setMissingSample(s);
+    return data;
+}
+
+
+static void checkRanges(const char * name, const std::shared_ptr<const DataTensor> & data, bool expectDeltas)
+{
+    InspectableERPH erph;
+    erph.init(data);
+    MAXDIV_CHECK(erph.hasDeltas() == expectDeltas);
+    
+    const ReflessIndexVector & shape = data->shape();
+    const IndexRange ranges[] = {
+        IndexRange(IndexVector(0, 0, 0, 0, 0), IndexVector(shape.t, shape.x, shape.y, shape.z, shape.d)),
+        IndexRange(IndexVector(1, 2, 3, 0, 0), IndexVector(shape.t, shape.x - 1, shape.y, shape.z, shape.d)),
+        IndexRange(IndexVector(shape.t - 1, 0, 5, 0, 0), IndexVector(shape.t, shape.x / 2, shape.y - 5, shape.z, shape.d)),
+        IndexRange(IndexVector(0, shape.x / 3, 1, 0, 0), IndexVector(1, shape.x, shape.y / 2, shape.z, shape.d))
+    };
+    for (const IndexRange & range : ranges)
+    {
+        erph.fit(range);
+        if (!erph.checkHistograms(*data, range))
+        {
+            std::cerr << name << ": wrong histogram for range [" << range.a.t << "," << range.b.t << ") x ["
+                      << range.a.x << "," << range.b.x << ") x [" << range.a.y << "," << range.b.y << ")" << std::endl;
+            ++MaxDivTest::numFailures;
+        }
+    }
+}
+
+
+/**
+* Sets 8 consecutive samples of 3-dimensional data, starting at @p first, to the corners of a cube of the given
+* size. Their projections are the minimum and the maximum of the projections of all points in the cube.
+*/
+static void setCorners(DataTensor & data, DataTensor::Index first, Scalar size)
+{
+    for (DataTensor::Index k = 0; k < 8; ++k)
+        for (DataTensor::Index d = 0; d < 3; ++d)
+            data.sample(first + k)(d) = ((k >> d) & 1) ? size : -size;
+}
+
+
+static void checkUpdate(DataTensor::Index numBins)
+{
+    // Periodic extremes keep the range of the projections of every window the same
+    std::shared_ptr<DataTensor> series = randomTensor(ReflessIndexVector(600, 1, 1, 1, 3));
+    for (DataTensor::Index t = 25; t < series->length(); t += 50)
+        setCorners(*series, t, 100);
+    for (DataTensor::Index t = 5; t < series->length(); t += 37)
+        if (t % 50 < 25 || t % 50 >= 33)
+            series->setMissingSample(t);
+    
+    const DataTensor::Index windowLength = 100, stepSize = 20;
+    InspectableERPH erph(numBins);
+    erph.init(MaxDivTest::timeSteps(*series, 0, windowLength));
+    InspectableERPH lastInit(erph);
+    for (DataTensor::Index offset = stepSize; offset + windowLength <= series->length(); offset += stepSize)
+    {
+        std::shared_ptr<DataTensor> window = MaxDivTest::timeSteps(*series, offset, windowLength);
+        if (offset + windowLength == series->length())
+            setCorners(*window, windowLength - 8, 200); // exceeds the range of the projections
+        erph.update(window, stepSize);
+        MAXDIV_CHECK(erph.isUpdated() == (offset + windowLength < series->length()));
+        
+        // Automatically determined numbers of bins are kept until init() is called again
+        if (erph.isUpdated())
+            MAXDIV_CHECK(erph.sameBinNum(lastInit));
+        else
+            lastInit = erph;
+        
+        // The copy shares the projection vectors and the numbers of bins
+        InspectableERPH reference(erph);
+        reference.keepBinNum();
+        reference.init(window);
+        if (!erph.sameBins(reference))
+        {
+            std::cerr << "update: bins differ from init() for window at " << offset << " with " << numBins << " bins" << std::endl;
+            ++MaxDivTest::numFailures;
+        }
+        
+        const IndexRange ranges[] = {
+            IndexRange(IndexVector(0, 0, 0, 0, 0), IndexVector(windowLength, 1, 1, 1, 3)),
+            IndexRange(IndexVector(0, 0, 0, 0, 0), IndexVector(37, 1, 1, 1, 3)),
+            IndexRange(IndexVector(13, 0, 0, 0, 0), IndexVector(windowLength, 1, 1, 1, 3)),
+            IndexRange(IndexVector(windowLength - 1, 0, 0, 0, 0), IndexVector(windowLength, 1, 1, 1, 3))
+        };
+        for (const IndexRange & range : ranges)
+        {
+            erph.fit(range);
+            if (!erph.checkHistograms(*window, range))
+            {
+                std::cerr << "update: wrong histogram for range [" << range.a.t << "," << range.b.t << ") of window at "
+                          << offset << " with " << numBins << " bins" << std::endl;
+                ++MaxDivTest::numFailures;
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    // Compact counts relative to checkpoints of blocks of time steps
+    checkRanges("compact", randomTensor(ReflessIndexVector(40, 30, 20, 1, 2)), true);
+    
+    // More than 65535 locations per time step: full cumulative counts for each time step
+    checkRanges("full", randomTensor(ReflessIndexVector(3, 300, 250, 1, 2)), false);
+    
+    // Constant data, whose normalized projections are not finite
+    std::shared_ptr<DataTensor> constant = randomTensor(ReflessIndexVector(50, 10, 12, 1, 2));
+    constant->data().setConstant(1);
+    checkRanges("constant", constant, true);
+    
+    // Sliding window over purely temporal data with a fixed and with an automatically determined number of bins
+    checkUpdate(4);
+    checkUpdate(0);
+    
+    return MaxDivTest::result();
+}
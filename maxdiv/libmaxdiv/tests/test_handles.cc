@@ -0,0 +1,136 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that handles of freed pipelines become invalid and are never valid again, even after their slot has been
+* re-used so often that its generation counter would wrap around, and that a pipeline can be executed concurrently
+* while other pipelines are compiled and freed.
+*/
+
+#include "test_utils.h"
+#include "libmaxdiv.h"
+#include <set>
+#include <thread>
+
+using namespace MaxDiv;
+
+
+static bool isValid(unsigned int handle)
+{
+    maxdiv_stats_t stats;
+    return maxdiv_get_stats(handle, &stats);
+}
+
+
+static void checkReuse()
+{
+    maxdiv_params_t params;
+    maxdiv_init_params(&params);
+    
+    // Enough cycles to exceed the generation counter of a slot
+    std::set<unsigned int> handles;
+    std::vector<unsigned int> stale;
+    for (unsigned int i = 0; i < 5000; ++i)
+    {
+        unsigned int handle = maxdiv_compile_pipeline(&params);
+        MAXDIV_CHECK(handle != 0 && isValid(handle));
+        if (!handles.insert(handle).second)
+        {
+            std::cerr << "Handle " << handle << " has been issued twice." << std::endl;
+            ++MaxDivTest::numFailures;
+            break;
+        }
+        maxdiv_free_pipeline(handle);
+        MAXDIV_CHECK(!isValid(handle));
+        if (i % 500 == 0)
+            stale.push_back(handle);
+    }
+    
+    // Stale handles do not refer to pipelines compiled later
+    unsigned int handle = maxdiv_compile_pipeline(&params);
+    for (unsigned int staleHandle : stale)
+        MAXDIV_CHECK(!isValid(staleHandle));
+    MAXDIV_CHECK(isValid(handle));
+    maxdiv_free_pipeline(handle);
+    
+    // Freeing a pipeline twice or invalid handles has no effect
+    maxdiv_free_pipeline(handle);
+    maxdiv_free_pipeline(0);
+    MAXDIV_CHECK(!isValid(0));
+}
+
+
+static void checkConcurrency()
+{
+    std::shared_ptr<DataTensor> series = MaxDivTest::noisySeries(200, 2, { {50, 70} });
+    const unsigned int shape[] = { 200, 1, 1, 1, 2 };
+    maxdiv_params_t params;
+    maxdiv_init_params(&params);
+    params.min_size[0] = 10;
+    params.max_size[0] = 40;
+    unsigned int pipeline = maxdiv_compile_pipeline(&params);
+    
+    detection_t expected[5];
+    unsigned int numExpected = 5;
+    maxdiv_exec(pipeline, series->raw(), shape, expected, &numExpected);
+    MAXDIV_CHECK(numExpected > 0);
+    
+    // Execute the pipeline from several threads while other pipelines are compiled and freed
+    const unsigned int numThreads = 4;
+    std::vector<int> mismatches(numThreads, 0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < numThreads; ++t)
+        threads.emplace_back([&, t]() {
+            for (unsigned int i = 0; i < 10; ++i)
+            {
+                detection_t detections[5];
+                unsigned int numDetections = 5;
+                maxdiv_exec(pipeline, series->raw(), shape, detections, &numDetections);
+                if (numDetections != numExpected)
+                    ++mismatches[t];
+                else
+                    for (unsigned int j = 0; j < numDetections; ++j)
+                        if (detections[j].range_start[0] != expected[j].range_start[0]
+                                || detections[j].range_end[0] != expected[j].range_end[0])
+                            ++mismatches[t];
+            }
+        });
+    maxdiv_params_t otherParams;
+    maxdiv_init_params(&otherParams);
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        unsigned int other = maxdiv_compile_pipeline(&otherParams);
+        MAXDIV_CHECK(other != pipeline && isValid(pipeline));
+        maxdiv_free_pipeline(other);
+    }
+    for (std::thread & thread : threads)
+        thread.join();
+    for (unsigned int t = 0; t < numThreads; ++t)
+        MAXDIV_CHECK(mismatches[t] == 0);
+    
+    maxdiv_free_pipeline(pipeline);
+}
+
+
+int main()
+{
+    checkReuse();
+    checkConcurrency();
+    return MaxDivTest::result();
+}
@@ -0,0 +1,125 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks the covariance matrices obtained from the cumulative sums and lagged outer products of the series
+* underlying a time-delay embedding, which GaussianDensityEstimator uses when given the series by
+* `setTimeDelayEmbedding()`, against those obtained from block prefix sums of the embedded data. Also checks
+* that a search with a TimeDelayEmbedding passes the series to the estimator and finds the same detections
+* as a search of the embedded data, for all border policies.
+*/
+
+#include "test_utils.h"
+#include "config.h"
+
+using namespace MaxDiv;
+
+
+static void checkSearch(BorderPolicy borderPolicy, const char * name)
+{
+    const int k = 3, T = 2;
+    const DataTensor::Index d = 2;
+    std::shared_ptr<const DataTensor> data = MaxDivTest::noisySeries(400, d, { {250, 290} });
+    std::shared_ptr<PreprocessingPipeline> preproc = std::make_shared<PreprocessingPipeline>();
+    preproc->push_back(std::make_shared<TimeDelayEmbedding>(k, T, borderPolicy));
+    ProposalSearch detector(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()),
+        std::make_shared<DenseProposalGenerator>(10, 60),
+        preproc
+    ), reference(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()),
+        std::make_shared<DenseProposalGenerator>(10, 60)
+    );
+    
+    detector.autoReset = false;
+    DetectionList detections = detector(data, 5);
+    
+    // Only the cumulative sums of the series and its lagged outer products have been computed
+    DataTensor::Index border = (k - 1) * T, seriesLength = data->length() + ((borderPolicy == BorderPolicy::VALID) ? 0 : border);
+    if (detector.getDivergence()->getStatistics().cumulativeMemory != static_cast<std::size_t>(seriesLength * (d + k * d * d)) * sizeof(Scalar))
+    {
+        std::cerr << name << ": sums have not been computed from the series underlying the embedding" << std::endl;
+        ++MaxDivTest::numFailures;
+    }
+    
+    std::shared_ptr<const DataTensor> embedded = std::make_shared<DataTensor>(time_delay_embedding(*data, k, T, borderPolicy));
+    DetectionList expected = reference(embedded, 5);
+    if (borderPolicy == BorderPolicy::VALID)
+        for (Detection & detection : expected)
+        {
+            detection.a.t += border;
+            detection.b.t += border;
+        }
+    if (!MaxDivTest::sameDetections(detections, expected))
+    {
+        std::cerr << name << ": detections differ from a search of the embedded data" << std::endl;
+        MaxDivTest::printDetections("detections", detections);
+        MaxDivTest::printDetections("expected", expected);
+        ++MaxDivTest::numFailures;
+    }
+}
+
+
+int main()
+{
+    // Time-delay embedding of a random time-series with 4 attributes, embedding dimension 16 and delay 1,
+    // which is just long enough for the cumulative sums of outer products to exceed the size limit
+    const DataTensor::Index k = 16, d = 4, D = k * d;
+    const DataTensor::Index length = MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT / (D * D * sizeof(Scalar)) + 500;
+    std::shared_ptr<const DataTensor> series = MaxDivTest::noisySeries(length + k - 1, d, { {20000, 20300} });
+    std::shared_ptr<DataTensor> embedded = std::make_shared<DataTensor>(ReflessIndexVector(length, 1, 1, 1, D));
+    for (DataTensor::Index t = 0; t < length; ++t)
+        for (DataTensor::Index l = 0; l < k; ++l)
+            embedded->data().block(t, l * d, 1, d) = series->data().row(t + k - 1 - l);
+    std::shared_ptr<const DataTensor> data = embedded;
+    
+    GaussianDensityEstimator lagged, blocked(GaussianDensityEstimator::CovMode::FULL, 64);
+    lagged.setIncrementalFit(false);
+    blocked.setIncrementalFit(false);
+    lagged.setTimeDelayEmbedding(series, k, 1);
+    lagged.init(data);
+    blocked.init(data);
+    
+    // Only the cumulative sums of the series and its lagged outer products, which take less memory than the full ones would
+    EstimatorStatistics stats = lagged.getStatistics();
+    MAXDIV_CHECK(stats.cumulativeMemory == static_cast<std::size_t>((length + k - 1) * (d + k * d * d)) * sizeof(Scalar));
+    MAXDIV_CHECK(stats.cumulativeMemory < static_cast<std::size_t>(MAXDIV_GAUSSIAN_CUMULATIVE_SIZE_LIMIT) / 4);
+    
+    const DataTensor::Index bounds[][2] = { {0, 100}, {19990, 20310}, {1, length - 1}, {length - 700, length} };
+    for (const auto & b : bounds)
+    {
+        IndexRange range(IndexVector(b[0], 0, 0, 0, 0), IndexVector(b[1], 1, 1, 1, D));
+        lagged.fit(range);
+        blocked.fit(range);
+        MAXDIV_CHECK((lagged.getInnerMean() - blocked.getInnerMean()).cwiseAbs().maxCoeff() < 1e-8);
+        MAXDIV_CHECK((lagged.getInnerCov() - blocked.getInnerCov()).cwiseAbs().maxCoeff() < 1e-8);
+        MAXDIV_CHECK((lagged.getOuterCov() - blocked.getOuterCov()).cwiseAbs().maxCoeff() < 1e-8);
+        MAXDIV_CHECK_CLOSE(lagged.getInnerCovLogDet(), blocked.getInnerCovLogDet(), 1e-8);
+        MAXDIV_CHECK_CLOSE(lagged.getOuterCovLogDet(), blocked.getOuterCovLogDet(), 1e-8);
+    }
+    
+    // No sums of outer products must have been computed explicitly
+    MAXDIV_CHECK(lagged.getStatistics().numCacheFallbacks == 0);
+    
+    checkSearch(BorderPolicy::MIRROR, "MIRROR");
+    checkSearch(BorderPolicy::CONSTANT, "CONSTANT");
+    checkSearch(BorderPolicy::VALID, "VALID");
+    
+    return MaxDivTest::result();
+}
@@ -0,0 +1,125 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks the residuals of OLSDetrending, which solves the block-structured normal equations without a design
+* matrix, against a rank-revealing least-squares solution with the explicit design matrix, also for spatial
+* locations with missing samples.
+*/
+
+#include "test_utils.h"
+#include "preproc.h"
+#include <Eigen/QR>
+#include <random>
+
+using namespace MaxDiv;
+
+
+/**
+* Builds the design matrix of the model of OLSDetrending explicitly.
+*/
+ScalarMatrix designMatrix(const OLSDetrending & ols, DataTensor::Index length)
+{
+    ScalarMatrix A = ScalarMatrix::Zero(length, ols.getNumParams());
+    A.col(0).setConstant(1);
+    if (ols.linear_trend)
+        A.col(1).setLinSpaced(static_cast<Scalar>(0), static_cast<Scalar>(length - 1));
+    for (DataTensor::Index t = 0; t < length; ++t)
+    {
+        DataTensor::Index offs = (ols.linear_trend) ? 2 : 1;
+        for (const OLSDetrending::Period & period : ols.periods)
+        {
+            DataTensor::Index ind = (t / period.len) % period.num;
+            A(t, offs + ind) = static_cast<Scalar>(1);
+            if (ols.linear_season_trend)
+                A(t, offs + ols.totalSeasonNum() + ind) = static_cast<Scalar>(t) / static_cast<Scalar>(period.num);
+            offs += period.num;
+        }
+    }
+    return A;
+}
+
+
+/**
+* Detrends a time-series with 2 spatial locations and 2 attributes using @p ols and compares the residuals
+* of all valid samples with those of the reference solution.
+*
+* @param[in] name Name of the test case.
+*
+* @param[in] ols The detrending to be tested.
+*
+* @param[in] length Length of the time-series.
+*
+* @param[in] missing Time steps of samples which are missing at the second spatial location.
+*/
+void compare(const char * name, const OLSDetrending & ols, DataTensor::Index length, const std::vector<DataTensor::Index> & missing)
+{
+    std::cerr << name << std::endl;
+    
+    // Random data with linear trend and a seasonal pattern
+    std::mt19937 rng(42);
+    std::normal_distribution<Scalar> normal;
+    DataTensor data(ReflessIndexVector(length, 2, 1, 1, 2));
+    for (DataTensor::Index t = 0; t < length; ++t)
+        for (DataTensor::Index x = 0; x < 2; ++x)
+            for (DataTensor::Index d = 0; d < 2; ++d)
+                data({ t, x, 0, 0, d }) = normal(rng) + 0.01 * t + std::sin(static_cast<Scalar>(t % 24) + x + d);
+    for (DataTensor::Index t : missing)
+        data.setMissingSample(t, 1, 0, 0);
+    
+    DataTensor residuals;
+    ols(data, residuals);
+    MAXDIV_CHECK(residuals.shape() == data.shape());
+    
+    ScalarMatrix A = designMatrix(ols, length);
+    for (DataTensor::Index x = 0; x < 2; ++x)
+    {
+        ScalarMatrix maskedA = A;
+        if (x == 1)
+            for (DataTensor::Index t : missing)
+                maskedA.row(t).setZero();
+        Eigen::CompleteOrthogonalDecomposition<ScalarMatrix> cod(maskedA);
+        
+        for (DataTensor::Index d = 0; d < 2; ++d)
+        {
+            Sample y(length);
+            for (DataTensor::Index t = 0; t < length; ++t)
+                y(t) = (data.isMissingSample(t, x, 0, 0)) ? 0 : data({ t, x, 0, 0, d });
+            Sample expected = y - A * cod.solve(y);
+            
+            Scalar maxError = 0;
+            for (DataTensor::Index t = 0; t < length; ++t)
+                if (!data.isMissingSample(t, x, 0, 0))
+                    maxError = std::max(maxError, std::abs(residuals({ t, x, 0, 0, d }) - expected(t)));
+            MAXDIV_CHECK(maxError < 1e-8);
+        }
+    }
+}
+
+
+int main()
+{
+    compare("Single period with linear trend", OLSDetrending(24), 500, {});
+    compare("Single period without linear trend", OLSDetrending(24, false), 500, {});
+    compare("Two periods with seasonal trend", OLSDetrending({ {7, 24}, {24, 1} }, true, true), 24 * 7 * 3 + 5, {});
+    compare("Missing samples", OLSDetrending({ {7, 24}, {24, 1} }, true, false), 24 * 7 * 3, { 0, 1, 17, 200, 201, 202, 503 });
+    compare("Missing samples with seasonal trend", OLSDetrending(24, true, true), 300, { 5, 29, 53, 77, 100, 299 });
+    
+    return MaxDivTest::result();
+}
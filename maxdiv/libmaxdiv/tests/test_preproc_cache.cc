@@ -0,0 +1,139 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that a search with a PreprocessingCache misses on new data, hits when the same data are searched again,
+* with the same detections as without the cache, and misses again after the data or the configuration key of the
+* cache have changed, with and without missing values.
+*/
+
+#include "test_utils.h"
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+using namespace MaxDiv;
+
+
+static const std::string cacheDir = ".";
+
+
+/**
+* Removes the files of the entry with the given key from the cache directory.
+*/
+static void removeEntry(uint64_t key)
+{
+    std::ostringstream path;
+    path << cacheDir << "/maxdiv-" << std::hex << std::setfill('0') << std::setw(16) << key;
+    std::remove((path.str() + ".meta").c_str());
+    std::remove((path.str() + ".mdt").c_str());
+}
+
+
+/**
+* Searches @p data with @p detector and checks whether the pre-processed data have been loaded from the cache.
+*/
+static DetectionList search(ProposalSearch & detector, const std::shared_ptr<const DataTensor> & data, bool expectHit, const char * name)
+{
+    unsigned long long numHits = detector.getStatistics().numPreprocCacheHits;
+    DetectionList detections = detector(data, 5);
+    bool hit = (detector.getStatistics().numPreprocCacheHits > numHits);
+    if (hit != expectHit)
+    {
+        std::cerr << name << ": expected a cache " << ((expectHit) ? "hit" : "miss") << std::endl;
+        ++MaxDivTest::numFailures;
+    }
+    MAXDIV_CHECK(!detections.empty());
+    return detections;
+}
+
+
+static void checkCache(const std::shared_ptr<const DataTensor> & data, const std::shared_ptr<const DataTensor> & modifiedData)
+{
+    std::shared_ptr<PreprocessingPipeline> preproc = std::make_shared<PreprocessingPipeline>();
+    preproc->push_back(std::make_shared<Normalizer>(false));
+    preproc->push_back(std::make_shared<TimeDelayEmbedding>(3, 1, BorderPolicy::VALID));
+    ProposalSearch detector(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()),
+        std::make_shared<DenseProposalGenerator>(10, 30),
+        preproc
+    );
+
+    std::shared_ptr<PreprocessingCache> cache = std::make_shared<PreprocessingCache>(cacheDir, 1), otherCache = std::make_shared<PreprocessingCache>(cacheDir, 2);
+    DataTensor masked(*data), maskedModified(*modifiedData);
+    masked.mask();
+    maskedModified.mask();
+    const uint64_t keys[] = { cache->key(masked), cache->key(maskedModified), otherCache->key(masked) };
+    MAXDIV_CHECK(keys[0] != keys[1] && keys[0] != keys[2]);
+    for (uint64_t key : keys)
+        removeEntry(key);
+
+    // Reference without the cache
+    DetectionList reference = detector(data, 5);
+    MAXDIV_CHECK(detector.getStatistics().numPreprocCacheHits == 0);
+
+    detector.setPreprocessingCache(cache);
+    DetectionList detections = search(detector, data, false, "first search");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, reference));
+
+    // Searching the same data again loads the stored entry and yields the same detections, including the
+    // offset of the border cut off by the embedding
+    detections = search(detector, data, true, "same data");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, reference));
+    detections = search(detector, std::make_shared<DataTensor>(*data), true, "copy of the same data");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, reference));
+
+    // Modified data miss, but have an entry of their own afterwards
+    DetectionList modifiedReference = search(detector, modifiedData, false, "modified data");
+    detections = search(detector, modifiedData, true, "modified data again");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, modifiedReference));
+
+    // A different configuration key does not use the entries of the first one
+    detector.setPreprocessingCache(otherCache);
+    detections = search(detector, data, false, "other configuration");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, reference));
+    detections = search(detector, data, true, "other configuration again");
+    MAXDIV_CHECK(MaxDivTest::sameDetections(detections, reference));
+
+    for (uint64_t key : keys)
+        removeEntry(key);
+
+    // Removed entries miss again
+    detector.setPreprocessingCache(cache);
+    search(detector, data, false, "removed entry");
+    removeEntry(keys[0]);
+}
+
+
+int main()
+{
+    std::shared_ptr<DataTensor> data = MaxDivTest::noisySeries(200, 2, { {120, 140} });
+    std::shared_ptr<DataTensor> modifiedData = std::make_shared<DataTensor>(*data);
+    modifiedData->sample(50)(1) += 1;
+    checkCache(data, modifiedData);
+
+    // Missing values are masked before the key is computed
+    data->sample(30)(0) = std::numeric_limits<Scalar>::quiet_NaN();
+    modifiedData = std::make_shared<DataTensor>(*data);
+    modifiedData->sample(31)(0) = std::numeric_limits<Scalar>::quiet_NaN();
+    checkCache(data, modifiedData);
+
+    return MaxDivTest::result();
+}
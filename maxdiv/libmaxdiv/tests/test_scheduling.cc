@@ -0,0 +1,94 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that dynamic scheduling of start points finds the same detections as static scheduling with offline
+* non-maximum suppression and that its detections do not depend on the number of threads. Also checks that
+* the detections of several partitions of the start points equal those of a single search, whether they are
+* merged at once or by a pairwise tree of merges.
+*/
+
+#include "test_utils.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace MaxDiv;
+
+
+static DetectionList search(const std::shared_ptr<const DataTensor> & data, ProposalSearch::Scheduling scheduling,
+                            DataTensor::Index chunkSize, int numThreads, unsigned int numPartitions = 1, unsigned int partition = 0)
+{
+    #ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+    #else
+    (void) numThreads;
+    #endif
+    ProposalSearch detector(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::I_OMEGA),
+        std::make_shared<DenseProposalGenerator>(20, 100)
+    );
+    detector.setOverlapTh(0.2);
+    detector.setScheduling(scheduling, chunkSize);
+    detector.setPartition(numPartitions, partition);
+    return detector(data, 5);
+}
+
+
+static DetectionList searchPartitioned(const std::shared_ptr<const DataTensor> & data, unsigned int numPartitions, int numThreads, bool tree = false)
+{
+    std::vector<MaximumDetectionList> lists(numPartitions, MaximumDetectionList(5, 0.2));
+    for (unsigned int partition = 0; partition < numPartitions; ++partition)
+        for (const Detection & detection : search(data, ProposalSearch::Scheduling::DYNAMIC, 0, numThreads, numPartitions, partition))
+            lists[partition].insert(detection);
+    if (tree)
+    {
+        for (unsigned int step = 1; step < numPartitions; step *= 2)
+            for (unsigned int i = 0; i + step < numPartitions; i += 2 * step)
+                lists[i].merge(lists[i + step]);
+    }
+    else
+        lists[0].merge(lists.begin() + 1, lists.end());
+    return DetectionList(lists[0].begin(), lists[0].end());
+}
+
+
+int main()
+{
+    // Offline non-maximum suppression: the order of the scores does not matter at all
+    std::shared_ptr<const DataTensor> shortSeries = MaxDivTest::noisySeries(3000, 2, { {500, 560}, {2000, 2040} });
+    DetectionList reference = search(shortSeries, ProposalSearch::Scheduling::STATIC, 0, 1);
+    MAXDIV_CHECK(reference.size() == 5);
+    MAXDIV_CHECK(MaxDivTest::sameDetections(reference, search(shortSeries, ProposalSearch::Scheduling::STATIC, 0, 3)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(reference, search(shortSeries, ProposalSearch::Scheduling::DYNAMIC, 0, 3)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(reference, search(shortSeries, ProposalSearch::Scheduling::DYNAMIC, 7, 2)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(reference, searchPartitioned(shortSeries, 4, 2)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(reference, searchPartitioned(shortSeries, 4, 2, true)));
+    
+    // Online non-maximum suppression: dynamic scheduling must not depend on the number of threads
+    std::shared_ptr<const DataTensor> longSeries = MaxDivTest::noisySeries(MAXDIV_NMP_LIMIT + 2000, 1, { {1000, 1080}, {9000, 9050} });
+    DetectionList dynamicReference = search(longSeries, ProposalSearch::Scheduling::DYNAMIC, 0, 1);
+    MAXDIV_CHECK(dynamicReference.size() == 5);
+    MAXDIV_CHECK(MaxDivTest::sameDetections(dynamicReference, search(longSeries, ProposalSearch::Scheduling::DYNAMIC, 0, 3)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(dynamicReference, searchPartitioned(longSeries, 4, 3)));
+    MAXDIV_CHECK(MaxDivTest::sameDetections(dynamicReference, searchPartitioned(longSeries, 4, 3, true)));
+    
+    return MaxDivTest::result();
+}
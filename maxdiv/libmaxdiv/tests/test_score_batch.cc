@@ -0,0 +1,160 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that `Divergence::score()` yields the same scores for a batch of ranges as `operator()` for each range,
+* for the KL divergence in all modes, the cross-entropy and the JS divergence combined with Gaussian distributions,
+* histograms and kernel density estimates with a cumulative or an approximated kernel matrix, on temporal and
+* spatio-temporal data with missing samples. Gaussian distributions are also checked for univariate data and
+* the maximum number of attributes of the fixed-size implementation. In builds with `MAXDIV_OFFLOAD`, this checks
+* the Gaussian divergences computed on the device.
+*/
+
+#include "test_utils.h"
+#include "config.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+using namespace MaxDiv;
+
+
+/**
+* Creates a tensor of random data with a shifted block and a few missing samples.
+*/
+static std::shared_ptr<DataTensor> randomTensor(const ReflessIndexVector & shape)
+{
+    std::shared_ptr<DataTensor> data = std::make_shared<DataTensor>(shape);
+    std::mt19937 rng(0);
+    std::normal_distribution<Scalar> normal;
+    for (DataTensor::Index i = 0; i < data->numEl(); ++i)
+        data->raw()[i] = normal(rng);
+    for (DataTensor::Index t = shape.t / 3; t < shape.t / 2; ++t)
+        data->data().block(t * data->numSamples() / shape.t, 0, data->numSamples() / shape.t, shape.d).array() += 2;
+    for (DataTensor::Index s = 5; s < data->numSamples(); s += 97)
+        data->setMissingSample(s);
+    return data;
+}
+
+
+/**
+* Collects a batch of ranges of various sizes which contain at least one non-missing sample, but not all of them.
+*/
+static std::vector<IndexRange> batchRanges(const DataTensor & data, std::size_t maxRanges)
+{
+    const ReflessIndexVector & shape = data.shape();
+    std::vector<IndexRange> ranges;
+    DataTensor::Index length = std::max<DataTensor::Index>(1, shape.t / 20);
+    for (DataTensor::Index t = 0; t < shape.t && ranges.size() < maxRanges; t += std::max<DataTensor::Index>(1, shape.t / 40))
+        for (DataTensor::Index len = 1; len <= 4 * length && t + len <= shape.t && ranges.size() < maxRanges; len += length)
+        {
+            IndexRange range(IndexVector(t, 0, 0, 0, 0), IndexVector(t + len, shape.x, shape.y, shape.z, shape.d));
+            if (shape.x > 1)
+            {
+                range.a.x = t % shape.x;
+                range.b.x = std::min(range.a.x + 1 + len % 3, shape.x);
+            }
+            if (shape.y > 1)
+                range.b.y = shape.y - (len % shape.y);
+            DataTensor::Index numValid = range.shape().prod(0, MAXDIV_INDEX_DIMENSION - 2) - data.numMissingSamplesInRange(range);
+            if (numValid > 0 && numValid < data.numValidSamples())
+                ranges.push_back(range);
+        }
+    return ranges;
+}
+
+
+static void checkDivergence(const std::string & name, const std::shared_ptr<Divergence> & divergence,
+                            const std::shared_ptr<const DataTensor> & data, std::size_t maxRanges = 120)
+{
+    std::vector<IndexRange> ranges = batchRanges(*data, maxRanges);
+    MAXDIV_CHECK(ranges.size() > 10);
+
+    divergence->init(data);
+    std::shared_ptr<Divergence> reference = divergence->clone();
+    std::vector<Scalar> scores(ranges.size());
+    divergence->score(ranges, scores.data());
+    MAXDIV_CHECK(divergence->getStatistics().numFits == ranges.size());
+
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        Scalar expected = (*reference)(ranges[i]);
+        if (!(std::abs(scores[i] - expected) <= 1e-8 * std::max(Scalar(1), std::abs(expected))))
+        {
+            std::cerr << std::setprecision(12) << name << ": batch score " << scores[i] << " differs from " << expected << " for range " << i << std::endl;
+            ++MaxDivTest::numFailures;
+            return;
+        }
+    }
+}
+
+
+static void checkEstimator(const std::string & name, const std::function<std::shared_ptr<DensityEstimator>()> & estimator,
+                           const std::shared_ptr<const DataTensor> & data, std::size_t maxRanges = 120)
+{
+    const std::pair<const char*, KLDivergence::KLMode> modes[] = {
+        { "I_OMEGA", KLDivergence::KLMode::I_OMEGA }, { "OMEGA_I", KLDivergence::KLMode::OMEGA_I },
+        { "SYM", KLDivergence::KLMode::SYM }, { "UNBIASED", KLDivergence::KLMode::UNBIASED }
+    };
+    for (const auto & mode : modes)
+    {
+        checkDivergence(name + " KL " + mode.first, std::make_shared<KLDivergence>(estimator(), mode.second), data, maxRanges);
+        checkDivergence(name + " CE " + mode.first, std::make_shared<CrossEntropy>(estimator(), mode.second), data, maxRanges);
+    }
+    checkDivergence(name + " JSD", std::make_shared<JSDivergence>(estimator()), data, maxRanges);
+}
+
+
+int main()
+{
+    const std::shared_ptr<const DataTensor> datasets[] = {
+        randomTensor(ReflessIndexVector(300, 1, 1, 1, 2)),
+        randomTensor(ReflessIndexVector(30, 8, 5, 1, 3))
+    };
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        std::ostringstream suffix;
+        suffix << " (data " << i << ")";
+
+        // The histograms of the copy share the projections with the original
+        checkEstimator("ERPH" + suffix.str(), []() { return std::make_shared<EnsembleOfRandomProjectionHistograms>(10, 0); }, datasets[i]);
+        checkEstimator("KDE" + suffix.str(), []() { return std::make_shared<KernelDensityEstimator>(); }, datasets[i]);
+        checkEstimator("Gaussian" + suffix.str(), []() { return std::make_shared<GaussianDensityEstimator>(); }, datasets[i]);
+    }
+
+    // Univariate Gaussian distributions and the maximum number of attributes of fixed-size Gaussian distributions
+    const DataTensor::Index numAttribs[] = { 1, std::max<DataTensor::Index>(MAXDIV_GAUSSIAN_FIXED_SIZE_LIMIT, 1) };
+    for (DataTensor::Index d : numAttribs)
+    {
+        std::ostringstream name;
+        name << "Gaussian (" << d << " attributes)";
+        checkEstimator(name.str(), []() { return std::make_shared<GaussianDensityEstimator>(); }, randomTensor(ReflessIndexVector(300, 1, 1, 1, d)));
+    }
+
+    // Too many samples for the cumulative kernel matrix, but a low-rank approximation
+    std::shared_ptr<const DataTensor> large = randomTensor(ReflessIndexVector(MAXDIV_KDE_CUMULATIVE_SIZE_LIMIT + 100, 1, 1, 1, 1));
+    checkEstimator("approximated KDE", []() {
+        std::shared_ptr<KernelDensityEstimator> kde = std::make_shared<KernelDensityEstimator>();
+        kde->setApproximationRank(20);
+        return kde;
+    }, large, 40);
+
+    return MaxDivTest::result();
+}
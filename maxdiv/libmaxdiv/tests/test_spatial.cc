@@ -0,0 +1,124 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks sums of spatio-temporal sub-blocks restored from cumulative sums, with and without a z extent, against
+* explicit sums, and that SpatialRegionProposalGenerator finds the same anomaly as dense proposals on a grid
+* while scoring fewer ranges.
+*/
+
+#include "test_utils.h"
+
+using namespace MaxDiv;
+
+
+static void checkSums(const ReflessIndexVector & shape)
+{
+    DataTensor data(shape);
+    std::mt19937 rng(0);
+    std::normal_distribution<Scalar> normal;
+    for (DataTensor::Index i = 0; i < data.numEl(); ++i)
+        data.raw()[i] = normal(rng);
+    DataTensor cumsums(data);
+    cumsums.cumsum(0, MAXDIV_INDEX_DIMENSION - 2);
+    
+    for (unsigned int i = 0; i < 200; ++i)
+    {
+        IndexRange range;
+        for (unsigned int d = 0; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+        {
+            std::uniform_int_distribution<DataTensor::Index> start(0, shape.ind[d] - 1);
+            range.a.ind[d] = start(rng);
+            std::uniform_int_distribution<DataTensor::Index> end(range.a.ind[d] + 1, shape.ind[d]);
+            range.b.ind[d] = end(rng);
+        }
+        range.b.d = shape.d;
+        
+        DataTensor::Sample expected = DataTensor::Sample::Zero(shape.d);
+        ReflessIndexVector ind;
+        for (ind.t = range.a.t; ind.t < range.b.t; ++ind.t)
+            for (ind.x = range.a.x; ind.x < range.b.x; ++ind.x)
+                for (ind.y = range.a.y; ind.y < range.b.y; ++ind.y)
+                    for (ind.z = range.a.z; ind.z < range.b.z; ++ind.z)
+                        expected += data.sample(ind);
+        
+        DataTensor::Sample sum = cumsums.sumFromCumsum(range);
+        bool correct = sum.isApprox(expected, 1e-8) || (sum - expected).norm() < 1e-8;
+        for (DataTensor::Index d = 0; d < shape.d; ++d)
+            correct = correct && std::abs(cumsums.sumFromCumsum(range, d) - expected(d)) <= 1e-8 * std::max(static_cast<Scalar>(1), std::abs(expected(d)));
+        if (!correct)
+        {
+            std::cerr << "Wrong sum for shape " << shape.t << "x" << shape.x << "x" << shape.y << "x" << shape.z << "x" << shape.d << std::endl;
+            ++MaxDivTest::numFailures;
+            return;
+        }
+    }
+}
+
+
+static void checkSpatialProposals()
+{
+    // Noise on a grid with an anomaly in a small spatio-temporal block
+    std::shared_ptr<DataTensor> data = std::make_shared<DataTensor>(ReflessIndexVector(24, 10, 10, 1, 1));
+    std::mt19937 rng(0);
+    std::normal_distribution<Scalar> normal;
+    for (DataTensor::Index i = 0; i < data->numEl(); ++i)
+        data->raw()[i] = normal(rng);
+    const IndexRange anomaly(IndexVector(10, 3, 5, 0, 0), IndexVector(16, 6, 8, 1, 1));
+    ReflessIndexVector ind;
+    for (ind.t = anomaly.a.t; ind.t < anomaly.b.t; ++ind.t)
+        for (ind.x = anomaly.a.x; ind.x < anomaly.b.x; ++ind.x)
+            for (ind.y = anomaly.a.y; ind.y < anomaly.b.y; ++ind.y)
+                data->sample(ind) += DataTensor::Sample::Constant(1, 5);
+    
+    const IndexRange lengthRange(IndexVector(3, 2, 2, 1, 0), IndexVector(8, 4, 4, 1, 0));
+    std::shared_ptr<SpatialRegionProposalGenerator> spatialProposals = std::make_shared<SpatialRegionProposalGenerator>(lengthRange);
+    ProposalSearch spatialSearch(std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()), spatialProposals);
+    ProposalSearch denseSearch(std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>()), std::make_shared<DenseProposalGenerator>(lengthRange));
+    spatialSearch.autoReset = false;
+    
+    DetectionList spatial = spatialSearch(data, 1), dense = denseSearch(data, 1);
+    MAXDIV_CHECK(spatial.size() == 1 && dense.size() == 1);
+    if (!MaxDivTest::sameDetections(spatial, dense))
+    {
+        MaxDivTest::printDetections("SpatialRegionProposalGenerator", spatial);
+        MaxDivTest::printDetections("DenseProposalGenerator", dense);
+        ++MaxDivTest::numFailures;
+    }
+    MAXDIV_CHECK(!dense.empty() && dense.front().IoU(anomaly) > 0.5);
+    MAXDIV_CHECK(spatialSearch.getStatistics().numProposals < denseSearch.getStatistics().numProposals / 4);
+    
+    // The anomaly lies within one of the regions
+    bool contained = false;
+    for (const IndexRange & region : spatialProposals->getRegions())
+        contained = contained || (region.a.x <= anomaly.a.x && region.a.y <= anomaly.a.y && region.b.x >= anomaly.b.x && region.b.y >= anomaly.b.y);
+    MAXDIV_CHECK(contained);
+}
+
+
+int main()
+{
+    // Two spatial dimensions use a shortcut
+    checkSums(ReflessIndexVector(9, 5, 6, 1, 2));
+    checkSums(ReflessIndexVector(9, 5, 6, 4, 2));
+    checkSums(ReflessIndexVector(9, 1, 6, 1, 3));
+    
+    checkSpatialProposals();
+    return MaxDivTest::result();
+}
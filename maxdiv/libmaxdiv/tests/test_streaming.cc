@@ -0,0 +1,195 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that a StreamingSearch only scores the ranges ending among the new time steps and a few candidates on
+* each poll, that the scores of its detections are those on the current window, and that it finds the same
+* anomalies as a ProposalSearch over the current window, with both incrementally updated density estimators.
+*/
+
+#include "test_utils.h"
+#include <map>
+
+using namespace MaxDiv;
+
+
+static const DataTensor::Index windowLength = 300, minLength = 10, maxLength = 50;
+static const DataTensor::Index pushSizes[] = { 250, 50, 50, 50, 50 };
+
+
+/**
+* @return Returns the given detections shifted by @p offset along the time axis.
+*/
+static DetectionList shifted(DetectionList detections, DataTensor::Index offset)
+{
+    for (Detection & detection : detections)
+    {
+        detection.a.t += offset;
+        detection.b.t += offset;
+    }
+    return detections;
+}
+
+
+/**
+* Checks that the detections of a poll lie in the window `[offset, end)`, are sorted and do not overlap.
+*/
+static void checkWindow(const DetectionList & detections, DataTensor::Index offset, DataTensor::Index end, double overlapTh)
+{
+    MAXDIV_CHECK(!detections.empty());
+    for (std::size_t i = 0; i < detections.size(); ++i)
+    {
+        MAXDIV_CHECK(detections[i].a.t >= offset && detections[i].b.t <= end);
+        MAXDIV_CHECK(i == 0 || detections[i].score <= detections[i - 1].score);
+        for (std::size_t j = 0; j < i; ++j)
+            MAXDIV_CHECK(detections[i].IoU(detections[j]) <= overlapTh);
+    }
+}
+
+
+static void checkGaussian()
+{
+    std::shared_ptr<const DataTensor> series = MaxDivTest::noisySeries(450, 2, { {60, 90}, {320, 340} });
+
+    StreamingSearch stream(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::I_OMEGA),
+        std::make_shared<DenseProposalGenerator>(minLength, maxLength), windowLength
+    );
+    stream.setOverlapTh(0.2);
+    ProposalSearch detector(
+        std::make_shared<KLDivergence>(std::make_shared<GaussianDensityEstimator>(), KLDivergence::KLMode::I_OMEGA),
+        std::make_shared<DenseProposalGenerator>(minLength, maxLength)
+    );
+
+    DataTensor::Index end = 0;
+    for (DataTensor::Index numNew : pushSizes)
+    {
+        MAXDIV_CHECK(stream.push(*MaxDivTest::timeSteps(*series, end, numNew)));
+        end += numNew;
+        unsigned long long numScored = stream.getStatistics().numProposals;
+        DetectionList detections = stream.poll();
+        numScored = stream.getStatistics().numProposals - numScored;
+        DataTensor::Index offset = (end > windowLength) ? end - windowLength : 0;
+        MAXDIV_CHECK(stream.getStreamOffset() == offset);
+        checkWindow(detections, offset, end, 0.2);
+
+        // Score all ranges of the same window from scratch
+        std::shared_ptr<DataTensor> window = MaxDivTest::timeSteps(*series, offset, end - offset);
+        detector.setOverlapTh(1.0);
+        DetectionList allRanges = shifted(detector(window, 0), offset);
+        std::map<std::pair<DataTensor::Index, DataTensor::Index>, Scalar> scores;
+        unsigned long long numNewRanges = 0;
+        for (const Detection & range : allRanges)
+        {
+            scores[std::make_pair(range.a.t, range.b.t)] = range.score;
+            if (range.b.t > end - numNew)
+                ++numNewRanges;
+        }
+        detector.setOverlapTh(0.2);
+        DetectionList reference = shifted(detector(window, 0), offset);
+        MAXDIV_CHECK(!reference.empty());
+
+        if (numNew == end)
+        {
+            // The first poll searches the entire window
+            MAXDIV_CHECK(numScored == allRanges.size());
+            if (!MaxDivTest::sameDetections(detections, reference, 1e-6))
+            {
+                std::cerr << "Detections of the first poll differ from a ProposalSearch." << std::endl;
+                MaxDivTest::printDetections("StreamingSearch", detections);
+                MaxDivTest::printDetections("ProposalSearch", reference);
+                ++MaxDivTest::numFailures;
+            }
+        }
+        else
+        {
+            // Besides the new ranges, only a few candidates have been re-scored
+            MAXDIV_CHECK(numScored >= numNewRanges && numScored < numNewRanges + windowLength);
+            MAXDIV_CHECK(numScored < allRanges.size() / 2);
+
+            // The scores of all detections are those on the current window
+            for (const Detection & detection : detections)
+            {
+                auto score = scores.find(std::make_pair(detection.a.t, detection.b.t));
+                MAXDIV_CHECK(score != scores.end());
+                if (score != scores.end())
+                    MAXDIV_CHECK_CLOSE(detection.score, score->second, 1e-6);
+            }
+
+            // The most anomalous range has been found
+            if (!(detections.front() == reference.front()))
+            {
+                std::cerr << "Top detection differs from a ProposalSearch after " << end << " time steps." << std::endl;
+                MaxDivTest::printDetections("StreamingSearch", detections);
+                MaxDivTest::printDetections("ProposalSearch", reference);
+                ++MaxDivTest::numFailures;
+            }
+        }
+
+        // Polling again without new time steps must not change the detections
+        MAXDIV_CHECK(MaxDivTest::sameDetections(detections, stream.poll()));
+    }
+}
+
+
+static void checkERPH()
+{
+    // The default parameters determine the number of bins automatically
+    std::shared_ptr<const DataTensor> series = MaxDivTest::noisySeries(450, 2, { {60, 90}, {320, 340} }, 4.0);
+    StreamingSearch stream(
+        std::make_shared<KLDivergence>(std::make_shared<EnsembleOfRandomProjectionHistograms>(), KLDivergence::KLMode::I_OMEGA),
+        std::make_shared<DenseProposalGenerator>(minLength, maxLength), windowLength
+    );
+    stream.setOverlapTh(0.2);
+
+    const IndexRange anomalies[] = {
+        IndexRange(IndexVector(60, 0, 0, 0, 0), IndexVector(90, 1, 1, 1, 2)),
+        IndexRange(IndexVector(320, 0, 0, 0, 0), IndexVector(340, 1, 1, 1, 2))
+    };
+    DataTensor::Index end = 0;
+    for (DataTensor::Index numNew : pushSizes)
+    {
+        MAXDIV_CHECK(stream.push(*MaxDivTest::timeSteps(*series, end, numNew)));
+        end += numNew;
+        DetectionList detections = stream.poll();
+        DataTensor::Index offset = (end > windowLength) ? end - windowLength : 0;
+        checkWindow(detections, offset, end, 0.2);
+
+        // The top detection is one of the anomalies in the window
+        bool found = false;
+        for (const IndexRange & anomaly : anomalies)
+            found = found || (anomaly.a.t >= offset && anomaly.b.t <= end && detections.front().IoU(anomaly) >= 0.5);
+        if (!found)
+        {
+            std::cerr << "ERPH: top detection is no anomaly after " << end << " time steps." << std::endl;
+            MaxDivTest::printDetections("StreamingSearch", detections);
+            ++MaxDivTest::numFailures;
+        }
+
+        MAXDIV_CHECK(MaxDivTest::sameDetections(detections, stream.poll()));
+    }
+}
+
+
+int main()
+{
+    checkGaussian();
+    checkERPH();
+    return MaxDivTest::result();
+}
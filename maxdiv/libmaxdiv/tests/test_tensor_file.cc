@@ -0,0 +1,102 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Checks that spatio-temporal data with missing samples survive a round-trip through a binary tensor file, both
+* when reading and when mapping the file, that modifying mapped data does not change the file, and that invalid
+* files are rejected.
+*/
+
+#include "test_utils.h"
+#include "utils.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace MaxDiv;
+
+
+/**
+* Checks if two tensors have the same shape, the same missing samples and the same values in all other samples.
+*/
+static bool sameTensor(const DataTensor & a, const DataTensor & b)
+{
+    if (a.shape() != b.shape() || a.numMissingSamples() != b.numMissingSamples())
+        return false;
+    for (DataTensor::Index s = 0; s < a.numSamples(); ++s)
+        if (a.isMissingSample(s) != b.isMissingSample(s) || (!a.isMissingSample(s) && a.sample(s) != b.sample(s)))
+            return false;
+    return true;
+}
+
+
+int main()
+{
+    const std::string filename = "test_tensor_file.mdt", invalidFilename = "test_tensor_file.txt";
+    
+    std::shared_ptr<DataTensor> data = std::make_shared<DataTensor>(ReflessIndexVector(20, 4, 3, 2, 3));
+    std::mt19937 rng(0);
+    std::normal_distribution<Scalar> normal;
+    for (DataTensor::Index i = 0; i < data->numEl(); ++i)
+        data->raw()[i] = normal(rng);
+    for (DataTensor::Index s = 3; s < data->numSamples(); s += 17)
+        data->setMissingSample(s);
+    
+    // Round-trip with a mask of missing samples
+    MAXDIV_CHECK(writeTensorFile(filename, *data));
+    MAXDIV_CHECK(isTensorFile(filename));
+    DataTensor read = readTensorFile(filename);
+    MAXDIV_CHECK(sameTensor(read, *data));
+    {
+        std::shared_ptr<DataTensor> mapped = mapTensorFile(filename);
+        MAXDIV_CHECK(mapped && sameTensor(*mapped, *data));
+        
+        // The mapping is private
+        if (mapped)
+            mapped->data().setConstant(42);
+    }
+    MAXDIV_CHECK(sameTensor(readTensorFile(filename), *data));
+    
+    // Without a mask, missing samples are stored with their place-holder value
+    MAXDIV_CHECK(writeTensorFile(filename, *data, false));
+    read = readTensorFile(filename);
+    MAXDIV_CHECK(read.shape() == data->shape() && !read.hasMissingSamples());
+    
+    // Invalid and truncated files are rejected
+    {
+        std::ofstream invalid(invalidFilename);
+        invalid << "1 2 3" << std::endl;
+    }
+    MAXDIV_CHECK(!isTensorFile(invalidFilename));
+    MAXDIV_CHECK(readTensorFile(invalidFilename).empty());
+    MAXDIV_CHECK(!mapTensorFile(invalidFilename));
+    MAXDIV_CHECK(writeTensorFile(filename, *data));
+    {
+        std::ifstream file(filename, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::ofstream truncated(invalidFilename, std::ios::binary);
+        truncated.write(contents.data(), contents.size() / 2);
+    }
+    MAXDIV_CHECK(readTensorFile(invalidFilename).empty());
+    MAXDIV_CHECK(!mapTensorFile(invalidFilename));
+    
+    std::remove(filename.c_str());
+    std::remove(invalidFilename.c_str());
+    return MaxDivTest::result();
+}
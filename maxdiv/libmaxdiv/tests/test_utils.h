@@ -0,0 +1,145 @@
+//  Copyright (C) 2016 Bjoern Barz (University of Jena)
+//
+//  This file is part of libmaxdiv.
+//
+//  libmaxdiv is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libmaxdiv is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libmaxdiv. If not, see <http://www.gnu.org/licenses/>.
+
+/**
+* @file
+*
+* Helpers shared by the regression tests of libmaxdiv.
+*
+* Every test is a separate executable registered with CTest, which reports each failed check on `stderr`
+* and exits with a non-zero status if any check has failed.
+*
+* @author Bjoern Barz <bjoern.barz@uni-jena.de>
+*/
+
+#ifndef MAXDIV_TEST_UTILS_H
+#define MAXDIV_TEST_UTILS_H
+
+#include "search_strategies.h"
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace MaxDivTest
+{
+
+/**
+* Number of checks which have failed so far.
+*/
+static int numFailures = 0;
+
+}
+
+/**
+* Checks if a condition holds and reports it as failure otherwise.
+*/
+#define MAXDIV_CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+            ++MaxDivTest::numFailures; \
+        } \
+    } while (false)
+
+/**
+* Checks if two scalars differ by at most `tol` relative to the larger magnitude of both.
+*/
+#define MAXDIV_CHECK_CLOSE(a, b, tol) \
+    do { \
+        double _maxdiv_a = (a), _maxdiv_b = (b); \
+        if (!(std::abs(_maxdiv_a - _maxdiv_b) <= (tol) * std::max(1.0, std::max(std::abs(_maxdiv_a), std::abs(_maxdiv_b))))) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #a << " == " << #b \
+                      << " (" << _maxdiv_a << " vs. " << _maxdiv_b << ")" << std::endl; \
+            ++MaxDivTest::numFailures; \
+        } \
+    } while (false)
+
+namespace MaxDivTest
+{
+
+/**
+* @return Returns the exit status of a test: 0 if all checks have passed, 1 otherwise.
+*/
+inline int result()
+{
+    if (numFailures > 0)
+        std::cerr << numFailures << " check(s) failed." << std::endl;
+    return (numFailures > 0) ? 1 : 0;
+}
+
+/**
+* Generates a multivariate time-series of standard normal noise, to which `offset` is added
+* within each of the given ranges of time steps.
+*/
+inline std::shared_ptr<MaxDiv::DataTensor> noisySeries(MaxDiv::DataTensor::Index length, MaxDiv::DataTensor::Index numAttrib,
+                                                       const std::vector<std::pair<MaxDiv::DataTensor::Index, MaxDiv::DataTensor::Index>> & anomalies,
+                                                       MaxDiv::Scalar offset = 2.5, unsigned int seed = 0)
+{
+    std::shared_ptr<MaxDiv::DataTensor> data = std::make_shared<MaxDiv::DataTensor>(MaxDiv::ReflessIndexVector(length, 1, 1, 1, numAttrib));
+    std::mt19937 rng(seed);
+    std::normal_distribution<MaxDiv::Scalar> normal;
+    for (MaxDiv::DataTensor::Index i = 0; i < data->numEl(); ++i)
+        data->raw()[i] = normal(rng);
+    for (const auto & anomaly : anomalies)
+        data->data().middleRows(anomaly.first, anomaly.second - anomaly.first).array() += offset;
+    return data;
+}
+
+/**
+* Creates a copy of the time steps `[first, first + num)` of purely temporal data, including the mask.
+*/
+inline std::shared_ptr<MaxDiv::DataTensor> timeSteps(const MaxDiv::DataTensor & data, MaxDiv::DataTensor::Index first, MaxDiv::DataTensor::Index num)
+{
+    std::shared_ptr<MaxDiv::DataTensor> steps = std::make_shared<MaxDiv::DataTensor>(MaxDiv::ReflessIndexVector(num, 1, 1, 1, data.numAttrib()));
+    steps->data() = data.data().middleRows(first, num);
+    for (MaxDiv::DataTensor::Index t = 0; t < num; ++t)
+        if (data.isMissingSample(first + t))
+            steps->setMissingSample(t);
+    return steps;
+}
+
+/**
+* Checks if two lists of detections consist of the same ranges with scores equal up to a relative tolerance.
+*/
+inline bool sameDetections(const MaxDiv::DetectionList & a, const MaxDiv::DetectionList & b, double tol = 1e-8)
+{
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (!(a[i] == b[i]) || !(std::abs(a[i].score - b[i].score) <= tol * std::max(1.0, std::abs(a[i].score))))
+            return false;
+    return true;
+}
+
+/**
+* Prints a list of detections to `stderr` for diagnosing failed checks.
+*/
+inline void printDetections(const char * name, const MaxDiv::DetectionList & detections)
+{
+    std::cerr << name << ":";
+    for (const MaxDiv::Detection & det : detections)
+        std::cerr << " [" << det.a.t << "," << det.b.t << ") " << det.score;
+    std::cerr << std::endl;
+}
+
+}
+
+#endif
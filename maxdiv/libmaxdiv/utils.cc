@@ -17,11 +17,167 @@
 
 #include "utils.h"
 #include <cctype>
+#include <cstring>
 #include <fstream>
+#include <algorithm>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MAXDIV_HAS_MMAP
+#endif
+
 using namespace MaxDiv;
 using namespace std;
 
 
+uint64_t MaxDiv::hashCombine(uint64_t seed, uint64_t value)
+{
+    // Multiply-rotate mixing step as used by MurmurHash2 and its descendants
+    value *= 0x87c37b91114253d5ULL;
+    value = (value << 31) | (value >> 33);
+    value *= 0x4cf5ad432745937fULL;
+    seed ^= value;
+    seed = (seed << 27) | (seed >> 37);
+    return seed * 5 + 0x52dce729;
+}
+
+
+uint64_t MaxDiv::fingerprint(const DataTensor & data, uint64_t seed)
+{
+    uint64_t hash = hashCombine(seed, sizeof(Scalar));
+    for (unsigned int d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+        hash = hashCombine(hash, data.shape().ind[d]);
+    
+    // Hash the raw bytes of the data in blocks of 64 bits
+    const unsigned char * bytes = reinterpret_cast<const unsigned char*>(data.raw());
+    std::size_t numBytes = static_cast<std::size_t>(data.numEl()) * sizeof(Scalar), i;
+    uint64_t block;
+    for (i = 0; i + sizeof(block) <= numBytes; i += sizeof(block))
+    {
+        std::memcpy(&block, bytes + i, sizeof(block));
+        hash = hashCombine(hash, block);
+    }
+    if (i < numBytes)
+    {
+        block = 0;
+        std::memcpy(&block, bytes + i, numBytes - i);
+        hash = hashCombine(hash, block);
+    }
+    
+    // Hash the mask, which does not depend on the order of iteration over the set of missing samples
+    if (data.hasMissingSamples())
+    {
+        uint64_t maskHash = 0;
+        for (DataTensor::Index sample : data.getMissingSampleIndices())
+            maskHash += hashCombine(0, sample);
+        hash = hashCombine(hashCombine(hash, data.numMissingSamples()), maskHash);
+    }
+    
+    return hashCombine(hash, numBytes);
+}
+
+
+static const char TENSOR_FILE_MAGIC[8] = { 'M', 'D', 'T', 'E', 'N', 'S', 'O', 'R' };
+static const uint32_t TENSOR_FILE_VERSION = 1;
+static const uint32_t TENSOR_FILE_FLAG_MASK = 1;
+#ifdef MAXDIV_FLOAT
+static const uint32_t TENSOR_FILE_SCALAR_DTYPE = 0;
+#else
+static const uint32_t TENSOR_FILE_SCALAR_DTYPE = 1;
+#endif
+
+/**
+* Reads and validates the header of a binary tensor file.
+*
+* @param[in] file The file, positioned at its beginning.
+*
+* @param[in] fileSize The size of the file in bytes.
+*
+* @param[out] header The header.
+*
+* @return Returns `true` if the header is valid and the file is large enough for the data and the mask.
+*/
+static bool readTensorFileHeader(istream & file, uint64_t fileSize, TensorFileHeader & header)
+{
+    if (fileSize < sizeof(TensorFileHeader) || !file.read(reinterpret_cast<char*>(&header), sizeof(TensorFileHeader)))
+        return false;
+    if (memcmp(header.magic, TENSOR_FILE_MAGIC, sizeof(TENSOR_FILE_MAGIC)) != 0 || header.version != TENSOR_FILE_VERSION
+            || header.dtype > 1 || (header.flags & ~TENSOR_FILE_FLAG_MASK) != 0 || (header.flags & TENSOR_FILE_FLAG_MASK) != (header.maskOffset != 0))
+        return false;
+    
+    // The size of the data must not overflow, since a corrupt shape could otherwise pass the checks below and
+    // lead to a buffer which is smaller than the tensor
+    uint64_t numSamples = 1, dataSize;
+    for (int d = 0; d < MAXDIV_INDEX_DIMENSION - 1; ++d)
+    {
+        if (header.shape[d] != 0 && numSamples > numeric_limits<uint64_t>::max() / header.shape[d])
+            return false;
+        numSamples *= header.shape[d];
+    }
+    uint64_t elementSize = (header.dtype == 0) ? sizeof(float) : sizeof(double);
+    if (header.shape[MAXDIV_INDEX_DIMENSION - 1] != 0 && numSamples > numeric_limits<uint64_t>::max() / elementSize / header.shape[MAXDIV_INDEX_DIMENSION - 1])
+        return false;
+    dataSize = numSamples * header.shape[MAXDIV_INDEX_DIMENSION - 1] * elementSize;
+    if (dataSize == 0 || dataSize > numeric_limits<size_t>::max() || numSamples > static_cast<uint64_t>(numeric_limits<DataTensor::Index>::max()))
+        return false;
+    if (header.dataOffset < sizeof(TensorFileHeader) || header.dataOffset > fileSize || fileSize - header.dataOffset < dataSize)
+        return false;
+    if (header.maskOffset != 0 && (header.maskOffset < header.dataOffset || header.maskOffset - header.dataOffset < dataSize || header.maskOffset > fileSize || fileSize - header.maskOffset < numSamples))
+        return false;
+    return true;
+}
+
+/**
+* Opens a binary tensor file and reads its header.
+*
+* @param[in] filename The path of the file.
+*
+* @param[out] file The opened file, positioned after the header.
+*
+* @param[out] header The header.
+*
+* @return Returns `true` if the file could be opened and has a valid header.
+*/
+static bool openTensorFile(const string & filename, ifstream & file, TensorFileHeader & header)
+{
+    file.open(filename.c_str(), ios_base::in | ios_base::binary);
+    if (!file.is_open() || !file.seekg(0, ios_base::end))
+        return false;
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    return readTensorFileHeader(file, fileSize, header);
+}
+
+static ReflessIndexVector tensorFileShape(const TensorFileHeader & header)
+{
+    ReflessIndexVector shape;
+    for (int d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+        shape.ind[d] = static_cast<DataTensor::Index>(header.shape[d]);
+    return shape;
+}
+
+/**
+* Reads elements of type `T` from a file into a buffer of `Scalar` values in chunks.
+*/
+template<typename T>
+static bool readTensorFileElements(istream & file, Scalar * data, uint64_t numEl)
+{
+    vector<T> buffer(static_cast<size_t>(min(numEl, static_cast<uint64_t>(1 << 16))));
+    for (uint64_t pos = 0; pos < numEl; pos += buffer.size())
+    {
+        size_t chunkSize = static_cast<size_t>(min(numEl - pos, static_cast<uint64_t>(buffer.size())));
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), sizeof(T) * chunkSize))
+            return false;
+        copy(buffer.begin(), buffer.begin() + chunkSize, data + pos);
+    }
+    return true;
+}
+
+
 string MaxDiv::trim(string str)
 {
     size_t pos = str.find_first_not_of(" \r\n\t");
@@ -128,3 +284,125 @@ DataTensor MaxDiv::readDataFromCSV(const string & filename, char delimiter, Data
     }
     return data;
 }
+
+bool MaxDiv::isTensorFile(const string & filename)
+{
+    ifstream file;
+    TensorFileHeader header;
+    return openTensorFile(filename, file, header);
+}
+
+bool MaxDiv::writeTensorFile(const string & filename, const DataTensor & data, bool writeMask)
+{
+    ofstream file(filename.c_str(), ios_base::out | ios_base::trunc | ios_base::binary);
+    if (!file.is_open())
+        return false;
+    
+    TensorFileHeader header;
+    memset(&header, 0, sizeof(TensorFileHeader));
+    memcpy(header.magic, TENSOR_FILE_MAGIC, sizeof(TENSOR_FILE_MAGIC));
+    header.version = TENSOR_FILE_VERSION;
+    header.dtype = TENSOR_FILE_SCALAR_DTYPE;
+    for (int d = 0; d < MAXDIV_INDEX_DIMENSION; ++d)
+        header.shape[d] = data.shape().ind[d];
+    header.dataOffset = (sizeof(TensorFileHeader) + MAXDIV_TENSOR_FILE_ALIGNMENT - 1) / MAXDIV_TENSOR_FILE_ALIGNMENT * MAXDIV_TENSOR_FILE_ALIGNMENT;
+    if (writeMask && data.hasMissingSamples())
+    {
+        header.flags |= TENSOR_FILE_FLAG_MASK;
+        header.maskOffset = header.dataOffset + sizeof(Scalar) * data.numEl();
+    }
+    
+    // Write header, padding and data
+    file.write(reinterpret_cast<const char*>(&header), sizeof(TensorFileHeader));
+    vector<char> padding(header.dataOffset - sizeof(TensorFileHeader), 0);
+    file.write(padding.data(), padding.size());
+    if (!data.empty())
+        file.write(reinterpret_cast<const char*>(data.raw()), sizeof(Scalar) * data.numEl());
+    
+    // Write mask
+    if (header.maskOffset != 0)
+    {
+        vector<unsigned char> mask(data.numSamples(), 0);
+        for (DataTensor::Index s = 0; s < data.numSamples(); ++s)
+            if (data.isMissingSample(s))
+                mask[s] = 1;
+        file.write(reinterpret_cast<const char*>(mask.data()), mask.size());
+    }
+    
+    return file.good();
+}
+
+DataTensor MaxDiv::readTensorFile(const string & filename)
+{
+    ifstream file;
+    TensorFileHeader header;
+    if (!openTensorFile(filename, file, header))
+        return DataTensor();
+    
+    // Read data
+    DataTensor data(tensorFileShape(header));
+    file.seekg(header.dataOffset);
+    bool success = (header.dtype == 0) ? readTensorFileElements<float>(file, data.raw(), data.numEl())
+                                       : readTensorFileElements<double>(file, data.raw(), data.numEl());
+    if (!success)
+        return DataTensor();
+    
+    // Read mask
+    if (header.maskOffset != 0)
+    {
+        vector<unsigned char> mask(data.numSamples());
+        file.seekg(header.maskOffset);
+        if (!file.read(reinterpret_cast<char*>(mask.data()), mask.size()))
+            return DataTensor();
+        for (DataTensor::Index s = 0; s < data.numSamples(); ++s)
+            if (mask[s])
+                data.setMissingSample(s);
+    }
+    
+    return data;
+}
+
+shared_ptr<DataTensor> MaxDiv::mapTensorFile(const string & filename)
+{
+    ifstream file;
+    TensorFileHeader header;
+    if (!openTensorFile(filename, file, header))
+        return nullptr;
+    file.close();
+    
+    #ifdef MAXDIV_HAS_MMAP
+    if (header.dtype == TENSOR_FILE_SCALAR_DTYPE && header.dataOffset % sizeof(Scalar) == 0)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+        size_t mapSize = static_cast<size_t>(fileStat.st_size);
+        void * addr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return nullptr;
+        
+        shared_ptr<DataTensor> data(
+            new DataTensor(reinterpret_cast<Scalar*>(static_cast<char*>(addr) + header.dataOffset), tensorFileShape(header)),
+            [addr, mapSize](DataTensor * tensor) { delete tensor; munmap(addr, mapSize); }
+        );
+        if (header.maskOffset != 0)
+        {
+            const unsigned char * mask = static_cast<const unsigned char*>(addr) + header.maskOffset;
+            for (DataTensor::Index s = 0; s < data->numSamples(); ++s)
+                if (mask[s])
+                    data->setMissingSample(s);
+        }
+        return data;
+    }
+    #endif
+    
+    shared_ptr<DataTensor> data = make_shared<DataTensor>(readTensorFile(filename));
+    return (data->empty()) ? nullptr : data;
+}
@@ -27,6 +27,8 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include "DataTensor.h"
 
 namespace MaxDiv
@@ -93,6 +95,116 @@ DataTensor readDataFromCSV(const std::string & filename, char delimiter = ',',
                            DataTensor::Index firstRow = 0, DataTensor::Index firstCol = 0,
                            DataTensor::Index lastCol = -1);
 
+
+#define MAXDIV_TENSOR_FILE_ALIGNMENT 64 /**< Alignment of the data in binary tensor files in bytes. */
+
+/**
+* @brief Header of binary tensor files
+*
+* A binary tensor file consists of this header, followed by the raw data of the tensor starting at the byte offset
+* `dataOffset`, and, optionally, by a mask indicating missing samples starting at the byte offset `maskOffset`.
+* All integers and floating point numbers are stored in the native byte order of the machine which has written
+* the file, so that the data can be mapped without conversion. Files are hence not portable between machines with
+* different byte orders, but such files are rejected when being read, since their `version` does not match.
+*
+* The data are stored in the same order as in memory, i.e., the attribute dimension varies fastest and the time
+* dimension slowest. Each element is a single (`dtype == 0`) or double (`dtype == 1`) precision floating point
+* number. Missing samples may either be encoded as `NaN` or be marked in the mask, which stores one byte per
+* sample (`1` = missing, `0` = valid) in the same order as the data, but without the attribute dimension.
+*
+* The offset of the data is a multiple of `MAXDIV_TENSOR_FILE_ALIGNMENT` bytes, so that the data can be mapped
+* into memory directly using `mapTensorFile()`.
+*/
+struct TensorFileHeader
+{
+    char magic[8]; /**< The characters `MDTENSOR`. */
+    uint32_t version; /**< Version of the file format. Currently always 1. */
+    uint32_t dtype; /**< Type of the elements: 0 = `float`, 1 = `double`. */
+    uint32_t flags; /**< Bit 0 is set if the file contains a mask of missing samples. All other bits are reserved and must be 0. */
+    uint32_t reserved; /**< Reserved for future use, must be 0. */
+    uint64_t shape[MAXDIV_INDEX_DIMENSION]; /**< The size of the tensor along the time, x, y, z and attribute dimension. */
+    uint64_t dataOffset; /**< Byte offset of the first element of the data from the beginning of the file. */
+    uint64_t maskOffset; /**< Byte offset of the mask of missing samples from the beginning of the file or 0 if there is no mask. */
+};
+
+/**
+* Mixes a 64-bit value into a hash.
+*
+* @param[in] seed The hash so far.
+*
+* @param[in] value The value to be added to the hash.
+*
+* @return Returns the new hash.
+*/
+uint64_t hashCombine(uint64_t seed, uint64_t value);
+
+/**
+* Computes a 64-bit fingerprint of the contents of a DataTensor, i.e., its shape, the values of its elements
+* and its mask of missing samples.
+*
+* The fingerprint is not a cryptographic hash. It is intended to identify identical data, e.g., as key for caches.
+*
+* @param[in] data The tensor.
+*
+* @param[in] seed Initial value of the hash, which can be used to derive fingerprints for different purposes
+* from the same data.
+*
+* @return Returns the fingerprint of the tensor.
+*/
+uint64_t fingerprint(const DataTensor & data, uint64_t seed = 0);
+
+/**
+* Checks whether a given file is a binary tensor file by reading its header.
+*
+* @param[in] filename The path of the file.
+*
+* @return Returns `true` if the file exists and has a valid binary tensor file header, otherwise `false`.
+*/
+bool isTensorFile(const std::string & filename);
+
+/**
+* Writes a DataTensor to a binary tensor file (see TensorFileHeader), using the precision of `Scalar`.
+*
+* @param[in] filename The path of the file. It will be overwritten if it exists already.
+*
+* @param[in] data The data to be written.
+*
+* @param[in] writeMask If set to `true` and the tensor has missing samples, a mask of the missing samples will be
+* written to the file as well. Otherwise, the missing samples will be stored with their place-holder value.
+*
+* @return Returns `true` on success and `false` if the file could not be written.
+*/
+bool writeTensorFile(const std::string & filename, const DataTensor & data, bool writeMask = true);
+
+/**
+* Reads a DataTensor from a binary tensor file (see TensorFileHeader) into memory, converting the elements to `Scalar`
+* if necessary. Samples marked in the mask of missing samples will be masked in the returned tensor.
+*
+* @param[in] filename The path of the file.
+*
+* @return Returns a DataTensor containing the data read from the file. The tensor will be empty if
+* the file could not be read or is not a valid binary tensor file.
+*/
+DataTensor readTensorFile(const std::string & filename);
+
+/**
+* Maps a binary tensor file (see TensorFileHeader) into memory and returns a DataTensor wrapping the mapped data
+* without copying them.
+*
+* The mapping is private and writable, so that modifications of the data, e.g., by in-place pre-processing or by
+* masking missing samples, only affect copies of the modified pages in memory and not the file itself. The file
+* will be unmapped when the returned tensor is destroyed.
+*
+* If the elements in the file do not have the same type as `Scalar` or memory mapped files are not supported by
+* the platform, the data will be read using `readTensorFile()` instead.
+*
+* @param[in] filename The path of the file.
+*
+* @return Returns a pointer to a DataTensor wrapping the contents of the file or `NULL` if the file could not be
+* mapped or is not a valid binary tensor file.
+*/
+std::shared_ptr<DataTensor> mapTensorFile(const std::string & filename);
+
 }
 
 #endif
\ No newline at end of file
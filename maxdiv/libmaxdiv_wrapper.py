@@ -8,6 +8,10 @@ The _LibMaxDiv class provides exactly the same functions as libmaxdiv.
 In addition, this module provides a 'maxdiv' function which mimics the interface of maxdiv.maxdiv,
 but delegates the call to libmaxdiv instead of performing the computations in Python code.
 
+The functions of libmaxdiv are called without holding the global interpreter lock, so that searches can be
+run from several Python threads concurrently. Data arrays with the scalar type of libmaxdiv are passed to
+`maxdiv_exec` as strided views without copying them in Python.
+
 This wrapper assumes that libmaxdiv has been compiled using double floating point precision.
 If single precision is being used instead, the value of `maxdiv_scalar` has to be adjusted accordingly.
 """
@@ -24,7 +28,10 @@ maxdiv_scalar = c_double
 
 # enumeration constants according to  libmaxdiv.h
 enums = {
-    'MAXDIV_PROPOSAL_SEARCH'    : 0,
+    'MAXDIV_PROPOSAL_SEARCH'            : 0,
+    'MAXDIV_STREAMING_SEARCH'           : 1,
+    'MAXDIV_BRANCH_AND_BOUND_SEARCH'    : 2,
+    'MAXDIV_MULTIRES_SEARCH'            : 3,
     
     'MAXDIV_KL_DIVERGENCE'      : 0,
     'MAXDIV_JS_DIVERGENCE'      : 1,
@@ -37,6 +44,8 @@ enums = {
     'MAXDIV_DENSE_PROPOSALS'                    : 0,
     'MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST'    : 1,
     'MAXDIV_POINTWISE_PROPOSALS_KDE'            : 2,
+    'MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST'      : 3,
+    'MAXDIV_SPATIAL_PROPOSALS_KDE'              : 4,
     
     'MAXDIV_KL_I_OMEGA' : 0,
     'MAXDIV_KL_OMEGA_I' : 1,
@@ -63,7 +72,20 @@ enums = {
     
     'MAXDIV_PROJECT_NONE'   : 0,
     'MAXDIV_PROJECT_PCA'    : 1,
-    'MAXDIV_PROJECT_RANDOM' : 2
+    'MAXDIV_PROJECT_RANDOM' : 2,
+    
+    'MAXDIV_PCA_AUTO'       : 0,
+    'MAXDIV_PCA_DENSE'      : 1,
+    'MAXDIV_PCA_RANDOMIZED' : 2,
+    
+    'MAXDIV_SCHEDULE_STATIC'    : 0,
+    'MAXDIV_SCHEDULE_DYNAMIC'   : 1,
+    
+    'MAXDIV_JOB_INVALID'    : 0,
+    'MAXDIV_JOB_RUNNING'    : 1,
+    'MAXDIV_JOB_COMPLETE'   : 2,
+    'MAXDIV_JOB_PARTIAL'    : 3,
+    'MAXDIV_JOB_FAILED'     : 4
 }
 
 
@@ -73,6 +95,9 @@ index_vector_t = c_uint * 5
 # index vector with 4 elements (1 temporal and 3 spatial dimensions)
 point_t = c_uint * 4
 
+# strides of the 5 dimensions of a data array in number of elements
+stride_vector_t = c_ssize_t * 5
+
 # detection_t structure definition according to libmaxdiv.h
 class detection_t(Structure):
     _fields_ = [('range_start', point_t),
@@ -114,7 +139,10 @@ class detrending_params_t(Structure):
 
 class projection_params_t(Structure):
     _fields_ = [('method', c_int),
-                ('ndims', c_uint)]
+                ('ndims', c_uint),
+                ('pca_solver', c_int),
+                ('pca_oversampling', c_uint),
+                ('pca_power_iterations', c_uint)]
 
 class preproc_params_t(Structure):
     _fields_ = [('normalization', c_int),
@@ -122,6 +150,25 @@ class preproc_params_t(Structure):
                 ('detrending', detrending_params_t),
                 ('dimensionality_reduction', projection_params_t)]
 
+class scheduling_params_t(Structure):
+    _fields_ = [('mode', c_int),
+                ('chunk_size', c_uint),
+                ('num_partitions', c_uint),
+                ('partition', c_uint)]
+
+class streaming_params_t(Structure):
+    _fields_ = [('window_length', c_uint)]
+
+class multires_params_t(Structure):
+    _fields_ = [('levels', c_uint),
+                ('factor', c_uint)]
+
+class spatial_proposal_params_t(Structure):
+    _fields_ = [('margin', c_uint)]
+
+class preproc_cache_params_t(Structure):
+    _fields_ = [('directory', c_char_p)]
+
 # maxdiv_params_t structure definition according to libmaxdiv.h
 class maxdiv_params_t(Structure):
     _fields_ = [('strategy', c_int),
@@ -136,7 +183,30 @@ class maxdiv_params_t(Structure):
                 ('kernel_sigma_sq', maxdiv_scalar),
                 ('gaussian_cov_mode', c_int),
                 ('erph', erph_params_t),
-                ('preproc', preproc_params_t)]
+                ('preproc', preproc_params_t),
+                ('scheduling', scheduling_params_t),
+                ('streaming', streaming_params_t),
+                ('gaussian_block_size', c_uint),
+                ('kde_approx_rank', c_uint),
+                ('multires', multires_params_t),
+                ('spatial_proposals', spatial_proposal_params_t),
+                ('preproc_cache', preproc_cache_params_t)]
+
+class maxdiv_stats_t(Structure):
+    _fields_ = [('num_searches', c_ulonglong),
+                ('num_proposals', c_ulonglong),
+                ('num_fits', c_ulonglong),
+                ('num_incremental_fits', c_ulonglong),
+                ('num_cache_fallbacks', c_ulonglong),
+                ('cumulative_memory', c_size_t),
+                ('preprocessing_time', c_double),
+                ('init_time', c_double),
+                ('proposal_time', c_double),
+                ('scoring_time', c_double),
+                ('nms_time', c_double),
+                ('total_time', c_double),
+                ('num_preproc_cache_hits', c_ulonglong),
+                ('num_partial_searches', c_ulonglong)]
 
 
 
@@ -145,6 +215,12 @@ c_uint_p = POINTER(c_uint)
 maxdiv_scalar_p = POINTER(maxdiv_scalar)
 detection_p = POINTER(detection_t)
 maxdiv_params_p = POINTER(maxdiv_params_t)
+maxdiv_stats_p = POINTER(maxdiv_stats_t)
+c_ulonglong_p = POINTER(c_ulonglong)
+c_double_p = POINTER(c_double)
+
+# Callback types
+maxdiv_progress_callback_t = CFUNCTYPE(None, maxdiv_scalar, c_void_p)
 
 
 
@@ -182,6 +258,84 @@ class _LibMaxDiv(object):
              (1, 'const_data', True), (1, 'custom_missing_value', False), (1, 'missing_value', 0))
         )
         
+        # maxdiv_exec_workspace function
+        self._register_func('maxdiv_exec_workspace',
+            (c_void_p, c_uint, maxdiv_scalar_p, index_vector_t, detection_p, c_uint_p, maxdiv_scalar_p, c_size_t, c_bool, maxdiv_scalar),
+            ((1, 'pipeline'), (1, 'data'), (1, 'shape'), (1, 'detection_buf'), (1, 'detection_buf_size'),
+             (1, 'workspace'), (1, 'workspace_size'), (1, 'custom_missing_value', False), (1, 'missing_value', 0))
+        )
+        
+        # maxdiv_exec_strided function
+        self._register_func('maxdiv_exec_strided',
+            (c_void_p, c_uint, maxdiv_scalar_p, index_vector_t, stride_vector_t, detection_p, c_uint_p, c_bool, maxdiv_scalar),
+            ((1, 'pipeline'), (1, 'data'), (1, 'shape'), (1, 'strides'), (1, 'detection_buf'), (1, 'detection_buf_size'),
+             (1, 'custom_missing_value', False), (1, 'missing_value', 0))
+        )
+        
+        # maxdiv_merge_detections function
+        self._register_func('maxdiv_merge_detections',
+            (c_void_p, c_uint, c_uint, POINTER(detection_p), c_uint_p, detection_p, c_uint_p, c_bool),
+            ((1, 'pipeline'), (1, 'num_lists'), (1, 'lists'), (1, 'list_sizes'), (1, 'detection_buf'), (1, 'detection_buf_size'),
+             (1, 'keep_suppressed', False))
+        )
+        
+        # maxdiv_exec_batch function
+        self._register_func('maxdiv_exec_batch',
+            (c_void_p, c_uint, c_uint, POINTER(maxdiv_scalar_p), c_uint_p, detection_p, c_uint, c_uint_p, c_bool, c_bool, maxdiv_scalar),
+            ((1, 'pipeline'), (1, 'num_series'), (1, 'data'), (1, 'shapes'), (1, 'detection_buf'), (1, 'max_detections'),
+             (1, 'num_detections'), (1, 'const_data', True), (1, 'custom_missing_value', False), (1, 'missing_value', 0))
+        )
+        
+        # maxdiv_exec_async function
+        self._register_func('maxdiv_exec_async',
+            (c_uint, c_uint, maxdiv_scalar_p, index_vector_t, c_uint, c_double, maxdiv_progress_callback_t, c_void_p, c_bool, maxdiv_scalar),
+            ((1, 'pipeline'), (1, 'data'), (1, 'shape'), (1, 'max_detections'), (1, 'timeout', 0), (1, 'progress_callback', maxdiv_progress_callback_t()),
+             (1, 'user_data', None), (1, 'custom_missing_value', False), (1, 'missing_value', 0))
+        )
+        
+        # maxdiv_cancel function
+        self._register_func('maxdiv_cancel',
+            (c_void_p, c_uint),
+            ((1, 'job'),)
+        )
+        
+        # maxdiv_job_status function
+        self._register_func('maxdiv_job_status',
+            (c_int, c_uint),
+            ((1, 'job'),)
+        )
+        
+        # maxdiv_wait function
+        self._register_func('maxdiv_wait',
+            (c_int, c_uint, detection_p, c_uint_p),
+            ((1, 'job'), (1, 'detection_buf'), (1, 'detection_buf_size'))
+        )
+        
+        # maxdiv_stream_push function
+        self._register_func('maxdiv_stream_push',
+            (c_bool, c_uint, maxdiv_scalar_p, index_vector_t, c_bool, maxdiv_scalar),
+            ((1, 'pipeline'), (1, 'data'), (1, 'shape'), (1, 'custom_missing_value', False), (1, 'missing_value', 0))
+        )
+        
+        # maxdiv_stream_poll function
+        self._register_func('maxdiv_stream_poll',
+            (c_void_p, c_uint, detection_p, c_uint_p),
+            ((1, 'pipeline'), (1, 'detection_buf'), (1, 'detection_buf_size'))
+        )
+        
+        # maxdiv_stream_reset function
+        self._register_func('maxdiv_stream_reset',
+            (c_void_p, c_uint),
+            ((1, 'pipeline'),)
+        )
+        
+        # maxdiv_get_stats function
+        self._register_func('maxdiv_get_stats',
+            (c_bool, c_uint, maxdiv_stats_p, c_ulonglong_p, c_double_p, c_uint_p, c_bool),
+            ((1, 'pipeline'), (1, 'stats'), (1, 'thread_proposals', None), (1, 'thread_time', None), (1, 'num_threads', None),
+             (1, 'reset', False))
+        )
+        
         # maxdiv function
         self._register_func('maxdiv',
             (c_void_p, maxdiv_params_p, maxdiv_scalar_p, index_vector_t, detection_p, c_uint_p, c_bool, c_bool, maxdiv_scalar),
@@ -260,7 +414,26 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
     # Overlap Threshold
     if 'overlap_th' in kwargs:
         params.overlap_th = kwargs['overlap_th']
+
+    # Persistent cache for pre-processed data
+    if ('preproc_cache_dir' in kwargs) and (kwargs['preproc_cache_dir'] is not None):
+        cache_dir = kwargs['preproc_cache_dir']
+        params.preproc_cache.directory = cache_dir.encode() if isinstance(cache_dir, str) else cache_dir
     
+    # Parallelization
+    if 'scheduling' in kwargs:
+        scheduling = kwargs['scheduling'].lower()
+        if scheduling == 'static':
+            params.scheduling.mode = enums['MAXDIV_SCHEDULE_STATIC']
+        elif scheduling == 'dynamic':
+            params.scheduling.mode = enums['MAXDIV_SCHEDULE_DYNAMIC']
+        else:
+            raise ValueError('Unknown scheduling mode: {}'.format(scheduling))
+    if 'chunk_size' in kwargs:
+        params.scheduling.chunk_size = kwargs['chunk_size'] if (kwargs['chunk_size'] is not None) and (kwargs['chunk_size'] > 0) else 0
+    if 'partition' in kwargs:
+        params.scheduling.num_partitions, params.scheduling.partition = kwargs['partition']
+
     # Method
     method = method.lower()
     if method in ('gaussian_cov', 'gaussian_cov_ts', 'gaussian_ts'):
@@ -268,6 +441,8 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
         params.gaussian_cov_mode = enums['MAXDIV_GAUSSIAN_COV_FULL']
         if method in ('gaussian_cov_ts', 'gaussian_ts'):
             kwargs['mode'] = 'TS'
+        if 'gaussian_block_size' in kwargs:
+            params.gaussian_block_size = kwargs['gaussian_block_size'] if (kwargs['gaussian_block_size'] is not None) and (kwargs['gaussian_block_size'] > 0) else 0
     elif method == 'gaussian_global_cov':
         params.estimator = enums['MAXDIV_GAUSSIAN']
         params.gaussian_cov_mode = enums['MAXDIV_GAUSSIAN_COV_SHARED']
@@ -280,6 +455,8 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
             params.kernel_sigma_sq = kwargs['kernelparameters']['kernel_sigma_sq']
         elif 'kernel_sigma_sq' in kwargs:
             params.kernel_sigma_sq = kwargs['kernel_sigma_sq']
+        if 'kde_approx_rank' in kwargs:
+            params.kde_approx_rank = kwargs['kde_approx_rank'] if (kwargs['kde_approx_rank'] is not None) and (kwargs['kde_approx_rank'] > 0) else 0
     elif method == 'erph':
         params.estimator = enums['MAXDIV_ERPH']
         if 'num_hist' in kwargs:
@@ -327,8 +504,19 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
         params.proposal_generator = enums['MAXDIV_POINTWISE_PROPOSALS_HOTELLINGST']
     elif proposals == 'kde':
         params.proposal_generator = enums['MAXDIV_POINTWISE_PROPOSALS_KDE']
+    elif proposals == 'spatial_hotellings_t':
+        params.proposal_generator = enums['MAXDIV_SPATIAL_PROPOSALS_HOTELLINGST']
+    elif proposals == 'spatial_kde':
+        params.proposal_generator = enums['MAXDIV_SPATIAL_PROPOSALS_KDE']
     else:
         raise ValueError('Unknown proposal generator: {}'.format(proposals))
+    if ('multires_levels' in kwargs) and (kwargs['multires_levels'] is not None) and (kwargs['multires_levels'] > 1):
+        if proposals != 'dense':
+            raise ValueError('Multi-resolution search requires dense proposals.')
+        params.strategy = enums['MAXDIV_MULTIRES_SEARCH']
+        params.multires.levels = kwargs['multires_levels']
+        if 'multires_factor' in kwargs:
+            params.multires.factor = kwargs['multires_factor']
     if 'proposalparameters' in kwargs:
         pp = kwargs['proposalparameters']
         if ('filter' in pp) and (pp['filter'] is None):
@@ -337,6 +525,8 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
             params.pointwise_proposals.mad = pp['useMAD']
         if 'sd_th' in pp:
             params.pointwise_proposals.sd_th = pp['sd_th']
+        if 'margin' in pp:
+            params.spatial_proposals.margin = pp['margin']
     
     # Pre-processing
     params.preproc.embedding.kt = 1
@@ -377,6 +567,20 @@ def maxdiv(X, method = 'gaussian_cov', num_intervals = 1, proposals = 'dense', *
     if ('pca_dim' in kwargs) and (kwargs['pca_dim'] > 0):
         params.preproc.dimensionality_reduction.method = enums['MAXDIV_PROJECT_PCA']
         params.preproc.dimensionality_reduction.ndims = kwargs['pca_dim']
+        if 'pca_solver' in kwargs:
+            pca_solver = kwargs['pca_solver'].lower()
+            if pca_solver == 'auto':
+                params.preproc.dimensionality_reduction.pca_solver = enums['MAXDIV_PCA_AUTO']
+            elif pca_solver == 'dense':
+                params.preproc.dimensionality_reduction.pca_solver = enums['MAXDIV_PCA_DENSE']
+            elif pca_solver == 'randomized':
+                params.preproc.dimensionality_reduction.pca_solver = enums['MAXDIV_PCA_RANDOMIZED']
+            else:
+                raise ValueError('Unknown PCA solver: {}'.format(pca_solver))
+        if 'pca_oversampling' in kwargs:
+            params.preproc.dimensionality_reduction.pca_oversampling = kwargs['pca_oversampling']
+        if 'pca_power_iterations' in kwargs:
+            params.preproc.dimensionality_reduction.pca_power_iterations = kwargs['pca_power_iterations']
     elif ('random_projection_dim' in kwargs) and (kwargs['random_projection_dim'] > 0):
         params.preproc.dimensionality_reduction.method = enums['MAXDIV_PROJECT_RANDOM']
         params.preproc.dimensionality_reduction.ndims = kwargs['random_projection_dim']
@@ -403,14 +607,6 @@ def maxdiv_exec(X, params, num_intervals = 1):
     if libmaxdiv is None:
         raise RuntimeError('libmaxdiv could not be found or loaded.')
     
-    isSpatioTemporal = False
-    if X.ndim == 1:
-        X = X.reshape((1, len(X)))
-    elif X.ndim == 5:
-        isSpatioTemporal = True
-    elif X.ndim != 2:
-        raise ValueError('Unsupported number of data dimensions: {}'.format(X.ndim))
-    
     if not (isinstance(params, maxdiv_params_t) or isinstance(params, int)):
         raise ValueError('Parameters must be given as maxdiv_params_t structure or integral handle.')
     
@@ -421,26 +617,308 @@ def maxdiv_exec(X, params, num_intervals = 1):
     det_buf = (detection_t * num_intervals)()
     
     # Prepare data
+    X, shape, strides, isSpatioTemporal = _prepare_view(X)
+    
+    # Run algorithm
+    pipeline = libmaxdiv.maxdiv_compile_pipeline(params) if isinstance(params, maxdiv_params_t) else params
+    try:
+        libmaxdiv.maxdiv_exec_strided(pipeline, X.ctypes.data_as(maxdiv_scalar_p), shape, strides, det_buf, pointer(det_buf_size))
+    finally:
+        if pipeline is not params:
+            libmaxdiv.maxdiv_free_pipeline(pipeline)
+    
+    return _convert_detections(det_buf, det_buf_size.value, isSpatioTemporal)
+
+
+def maxdiv_exec_batch(series, params, num_intervals = 1):
+    """ Runs the MaxDiv algorithm using libmaxdiv on a batch of independent series.
+    
+    Small series are distributed among several threads instead of parallelizing the search within
+    each series, which is more efficient than calling `maxdiv_exec()` for each of them.
+    
+    series - List of np.ndarray objects, each of which is layed out as described for `maxdiv_exec()`.
+    params - Either a maxdiv_params_t object or a handle to a compiled pipeline obtained from `libmaxdiv.maxdiv_compile_pipeline()`
+    num_intervals - Number of detections to be returned per series. Can be set to None to return as many
+                    detections as possible.
+    
+    Returns: a list with a list of detections for each series, as returned by `maxdiv_exec()`.
+    """
+    
+    if libmaxdiv is None:
+        raise RuntimeError('libmaxdiv could not be found or loaded.')
+    
+    if not (isinstance(params, maxdiv_params_t) or isinstance(params, int)):
+        raise ValueError('Parameters must be given as maxdiv_params_t structure or integral handle.')
+    
+    if len(series) == 0:
+        return []
+    
+    # Prepare data
+    prepared = [_prepare_data(X) for X in series]
+    data = (maxdiv_scalar_p * len(prepared))(*(X.ctypes.data_as(maxdiv_scalar_p) for X, _, _ in prepared))
+    shapes = (c_uint * (5 * len(prepared)))()
+    for i, (_, shape, _) in enumerate(prepared):
+        shapes[5*i:5*(i+1)] = shape[:]
+    
+    # Create buffer for detections
+    if (num_intervals is None) or (num_intervals < 1):
+        num_intervals = 1000
+    det_buf = (detection_t * (num_intervals * len(prepared)))()
+    num_detections = (c_uint * len(prepared))()
+    
+    # Run algorithm
+    pipeline = libmaxdiv.maxdiv_compile_pipeline(params) if isinstance(params, maxdiv_params_t) else params
+    try:
+        libmaxdiv.maxdiv_exec_batch(pipeline, len(prepared), data, shapes, det_buf, num_intervals, num_detections, True)
+    finally:
+        if pipeline is not params:
+            libmaxdiv.maxdiv_free_pipeline(pipeline)
+    
+    return [_convert_detections(det_buf[i*num_intervals:(i+1)*num_intervals], num_detections[i], isSpatioTemporal)
+            for i, (_, _, isSpatioTemporal) in enumerate(prepared)]
+
+
+def maxdiv_exec_async(X, params, num_intervals = 1, timeout = None, progress = None):
+    """ Starts the MaxDiv algorithm using libmaxdiv in the background.
+    
+    X - np.ndarray layed out as described for `maxdiv_exec()`.
+    params - Either a maxdiv_params_t object or a handle to a compiled pipeline obtained from `libmaxdiv.maxdiv_compile_pipeline()`
+    num_intervals - Number of detections to be returned. Can be set to None to return as many
+                    detections as possible.
+    timeout - Number of seconds after which the search will be stopped and the best detections found
+              so far will be returned. None means no deadline.
+    progress - Optional callable which will be called with the fraction of the search completed.
+               It is called from the threads performing the search.
+    
+    Returns: a `MaxDivJob` object.
+    """
+    
+    if libmaxdiv is None:
+        raise RuntimeError('libmaxdiv could not be found or loaded.')
+    
+    if not (isinstance(params, maxdiv_params_t) or isinstance(params, int)):
+        raise ValueError('Parameters must be given as maxdiv_params_t structure or integral handle.')
+    
+    if (num_intervals is None) or (num_intervals < 1):
+        num_intervals = 100000
+    
+    X, shape, isSpatioTemporal = _prepare_data(X)
+    callback = maxdiv_progress_callback_t(lambda p, user_data: progress(p)) if progress is not None else maxdiv_progress_callback_t()
+    
+    # The job keeps its own reference to the pipeline, so a temporary one can be freed right away
+    pipeline = libmaxdiv.maxdiv_compile_pipeline(params) if isinstance(params, maxdiv_params_t) else params
+    try:
+        job = libmaxdiv.maxdiv_exec_async(pipeline, X.ctypes.data_as(maxdiv_scalar_p), shape, num_intervals,
+                                          timeout if timeout is not None else 0, callback, None)
+    finally:
+        if pipeline is not params:
+            libmaxdiv.maxdiv_free_pipeline(pipeline)
+    
+    if job == 0:
+        raise ValueError('Invalid parameters.')
+    return MaxDivJob(job, X, callback, num_intervals, isSpatioTemporal)
+
+
+class MaxDivJob(object):
+    """ An execution of the MaxDiv algorithm in the background started by `maxdiv_exec_async()`. """
+    
+    def __init__(self, handle, data, callback, num_intervals, isSpatioTemporal):
+        
+        object.__init__(self)
+        self._handle = handle
+        self._data = data           # must be kept alive until the search is done
+        self._callback = callback   # same here
+        self._num_intervals = num_intervals
+        self._isSpatioTemporal = isSpatioTemporal
+        self._result = None
+    
+    
+    def cancel(self):
+        """ Stops the search as soon as possible. `wait()` will then return the best detections found so far. """
+        
+        if self._result is None:
+            libmaxdiv.maxdiv_cancel(self._handle)
+    
+    
+    def done(self):
+        """ Returns True if the search is not running anymore. """
+        
+        return (self._result is not None) or (libmaxdiv.maxdiv_job_status(self._handle) != enums['MAXDIV_JOB_RUNNING'])
+    
+    
+    def wait(self):
+        """ Waits for the search to finish.
+        
+        Returns: a tuple with a list of detections as returned by `maxdiv_exec()` and a flag indicating
+                 whether the search was complete or has been stopped by the deadline or cancelled.
+        """
+        
+        if self._result is None:
+            det_buf_size = c_uint(self._num_intervals)
+            det_buf = (detection_t * self._num_intervals)()
+            status = libmaxdiv.maxdiv_wait(self._handle, det_buf, pointer(det_buf_size))
+            self._data = self._callback = None
+            if status == enums['MAXDIV_JOB_FAILED']:
+                raise RuntimeError('[libmaxdiv] Search failed')
+            self._result = (_convert_detections(det_buf, det_buf_size.value, self._isSpatioTemporal), status == enums['MAXDIV_JOB_COMPLETE'])
+        return self._result
+    
+    
+    def __del__(self):
+        
+        if self._result is None:
+            libmaxdiv.maxdiv_cancel(self._handle)
+            libmaxdiv.maxdiv_wait(self._handle, None, None)
+
+
+def _prepare_view(X):
+    """ Provides a data array to libmaxdiv without copying it if possible.
+    
+    Arrays with the scalar type of libmaxdiv are passed as views with arbitrary strides, which libmaxdiv
+    uses directly if they match its memory layout and gathers itself otherwise. All other arrays are
+    converted as by `_prepare_data()`.
+    
+    Returns: a tuple with the array, its shape as index_vector_t, its strides as stride_vector_t and a flag
+             indicating whether the data are spatio-temporal.
+    """
+    
+    isSpatioTemporal = False
+    if X.ndim == 1:
+        X = X.reshape((1, len(X)))
+    elif X.ndim == 5:
+        isSpatioTemporal = True
+    elif X.ndim != 2:
+        raise ValueError('Unsupported number of data dimensions: {}'.format(X.ndim))
+    
     if np.ma.isMaskedArray(X):
         X = X.filled(np.nan)
-    X = np.require(X if isSpatioTemporal else X.T, np.float32 if maxdiv_scalar == c_float else np.float64, ['C_CONTIGUOUS'])
+    if not isSpatioTemporal:
+        X = X.T
+    dtype = np.float32 if maxdiv_scalar == c_float else np.float64
+    if (X.dtype != dtype) or any(s % X.itemsize != 0 for s in X.strides):
+        X = np.require(X, dtype, ['C_CONTIGUOUS'])
+    
+    strides = [s // X.itemsize for s in X.strides]
     if isSpatioTemporal:
         shape = index_vector_t()
         shape[:] = X.shape
+        strides = stride_vector_t(*strides)
     else:
         shape = index_vector_t(X.shape[0], 1, 1, 1, X.shape[1])
+        strides = stride_vector_t(strides[0], 0, 0, 0, strides[1])
     
-    # Run algorithm
-    if isinstance(params, maxdiv_params_t):
-        libmaxdiv.maxdiv(params, X.ctypes.data_as(maxdiv_scalar_p), shape, det_buf, pointer(det_buf_size), True)
+    return X, shape, strides, isSpatioTemporal
+
+
+def _prepare_data(X):
+    """ Converts a data array to the memory layout expected by libmaxdiv.
+    
+    Returns: a tuple with the contiguous array, its shape as index_vector_t and a flag indicating
+             whether the data are spatio-temporal.
+    """
+    
+    isSpatioTemporal = False
+    if X.ndim == 1:
+        X = X.reshape((1, len(X)))
+    elif X.ndim == 5:
+        isSpatioTemporal = True
+    elif X.ndim != 2:
+        raise ValueError('Unsupported number of data dimensions: {}'.format(X.ndim))
+    
+    if np.ma.isMaskedArray(X):
+        X = X.filled(np.nan)
+    X = np.require(X if isSpatioTemporal else X.T, np.float32 if maxdiv_scalar == c_float else np.float64, ['C_CONTIGUOUS'])
+    if isSpatioTemporal:
+        shape = index_vector_t()
+        shape[:] = X.shape
     else:
-        libmaxdiv.maxdiv_exec(params, X.ctypes.data_as(maxdiv_scalar_p), shape, det_buf, pointer(det_buf_size), True)
+        shape = index_vector_t(X.shape[0], 1, 1, 1, X.shape[1])
+    
+    return X, shape, isSpatioTemporal
+
+
+def _convert_detections(det_buf, num_detections, isSpatioTemporal):
+    """ Converts detections returned by libmaxdiv to a list of `(a, b, score)` tuples. """
     
-    # Convert detections to tuples
     if isSpatioTemporal:
-        return [(det_buf[i].range_start[:4], det_buf[i].range_end[:4], det_buf[i].score) for i in range(det_buf_size.value)]
+        return [(det_buf[i].range_start[:4], det_buf[i].range_end[:4], det_buf[i].score) for i in range(num_detections)]
     else:
-        return [(det_buf[i].range_start[0], det_buf[i].range_end[0], det_buf[i].score) for i in range(det_buf_size.value)]
+        return [(det_buf[i].range_start[0], det_buf[i].range_end[0], det_buf[i].score) for i in range(num_detections)]
+
+
+def maxdiv_merge_detections(detections, pipeline, num_intervals = 1, keep_suppressed = False):
+    """ Merges the detections found by pipelines searching different partitions of the same data.
+    
+    The detections of all partitions can be merged by a single call or by a tree of merges, e.g., a pairwise
+    reduction. In the latter case, intermediate merges must set `keep_suppressed`, so that detections suppressed
+    by them can still become final detections.
+    
+    detections - List with a list of detections for each partition, as returned by `maxdiv_exec()`.
+    pipeline - Handle to a compiled pipeline obtained from `libmaxdiv.maxdiv_compile_pipeline()`, whose
+               overlap threshold will be used for non-maximum suppression.
+    num_intervals - Number of detections to be returned. Can be set to None to return as many
+                    detections as possible.
+    keep_suppressed - If set to True, the detections will be followed by the suppressed ones, so that the
+                      result can be merged again. `num_intervals` should be None for intermediate merges.
+    
+    Returns: a list of detections as returned by `maxdiv_exec()`.
+    """
+    
+    if libmaxdiv is None:
+        raise RuntimeError('libmaxdiv could not be found or loaded.')
+    
+    isSpatioTemporal = any(not np.isscalar(det[0]) for dets in detections for det in dets)
+    lists = (detection_p * len(detections))()
+    list_sizes = (c_uint * len(detections))()
+    buffers = []
+    for i, dets in enumerate(detections):
+        buf = (detection_t * max(len(dets), 1))()
+        for j, (a, b, score) in enumerate(dets):
+            buf[j].range_start[:] = a if isSpatioTemporal else [a, 0, 0, 0]
+            buf[j].range_end[:] = b if isSpatioTemporal else [b, 1, 1, 1]
+            buf[j].score = score
+        buffers.append(buf)
+        lists[i] = cast(buf, detection_p)
+        list_sizes[i] = len(dets)
+    
+    if (num_intervals is None) or (num_intervals < 1):
+        num_intervals = max(sum(list_sizes), 1)
+    det_buf_size = c_uint(num_intervals)
+    det_buf = (detection_t * num_intervals)()
+    libmaxdiv.maxdiv_merge_detections(pipeline, len(detections), lists, list_sizes, det_buf, pointer(det_buf_size), keep_suppressed)
+    return _convert_detections(det_buf, det_buf_size.value, isSpatioTemporal)
+
+
+def maxdiv_get_stats(pipeline, reset = False):
+    """ Retrieves the profiling information collected by a compiled pipeline.
+    
+    pipeline - Handle to a compiled pipeline obtained from `libmaxdiv.maxdiv_compile_pipeline()`.
+    reset - If set to True, the statistics of the pipeline will be reset afterwards.
+    
+    Returns: a dictionary with the fields of `maxdiv_stats_t`, extended by the lists `thread_proposals`
+             and `thread_time` with the number of proposals scored by each thread and the time spent on that.
+    """
+    
+    if libmaxdiv is None:
+        raise RuntimeError('libmaxdiv could not be found or loaded.')
+    
+    # Query the number of threads first
+    stats = maxdiv_stats_t()
+    num_threads = c_uint(0)
+    if not libmaxdiv.maxdiv_get_stats(pipeline, stats, None, None, pointer(num_threads), False):
+        raise ValueError('Invalid pipeline handle.')
+    
+    buf_size = num_threads.value + 1
+    thread_proposals = (c_ulonglong * buf_size)()
+    thread_time = (c_double * buf_size)()
+    num_threads = c_uint(buf_size)
+    libmaxdiv.maxdiv_get_stats(pipeline, stats, thread_proposals, thread_time, pointer(num_threads), reset)
+    
+    result = { field : getattr(stats, field) for field, _ in maxdiv_stats_t._fields_ }
+    num_copied = min(num_threads.value, buf_size)
+    result['thread_proposals'] = thread_proposals[:num_copied]
+    result['thread_time'] = thread_time[:num_copied]
+    return result
 
 
 